@@ -89,6 +89,10 @@ void example_data_pipeline(void) {
     visualmem_context_t pipeline_ctx;
     visualmem_init(&pipeline_ctx, VISUALMEM_MODE_SIMULATE, 1200, 900);
     
+    // Nothing watches the pipeline's pixels: encode them only at the
+    // autonomous transition
+    visualmem_set_lazy_pixels(&pipeline_ctx, 1);
+    
     // Simulate processing financial transactions
     const int num_transactions = 10;
     transaction_t transactions[num_transactions];
@@ -205,7 +209,8 @@ void example_shared_memory(void) {
         .status_message = "System operational - All services running"
     };
     
-    void* status_addr = visualmem_alloc(&shared_ctx, sizeof(status), "system_status");
+    // Small unlabelled record: packed into a shared slab
+    void* status_addr = visualmem_alloc(&shared_ctx, sizeof(status), NULL);
     visualmem_write(&shared_ctx, status_addr, &status, sizeof(status));
     
     // Transition to autonomous mode
@@ -175,37 +175,35 @@ int visualmem_v2_init_x11_backend(visualmem_v2_context_t* ctx) {
         return VISUALMEM_V2_ERROR_INIT_FAILED;
     }
     
-    // Create XImage for pixel manipulation
-    int bytes_per_pixel = (ctx->x11.depth + 7) / 8;
-    size_t image_size = ctx->width * ctx->height * bytes_per_pixel;
-    
-    char* image_data = (char*)malloc(image_size);
-    if (!image_data) {
-        printf("[X11] ERROR: Failed to allocate image buffer\n");
-        XFreeGC(ctx->x11.display, ctx->x11.gc);
-        XDestroyWindow(ctx->x11.display, ctx->x11.window);
-        XCloseDisplay(ctx->x11.display);
-        return VISUALMEM_V2_ERROR_OUT_OF_VIDEO_MEMORY;
-    }
-    
+    // Create XImage for pixel manipulation. The server's pixmap format
+    // decides bits per pixel (32 at depth 24), so size the buffer from
+    // the image's own scanline length
     ctx->x11.ximage = XCreateImage(
         ctx->x11.display, ctx->x11.visual, ctx->x11.depth,
-        ZPixmap, 0, image_data,
+        ZPixmap, 0, NULL,
         ctx->width, ctx->height,
         32, 0
     );
     
     if (!ctx->x11.ximage) {
         printf("[X11] ERROR: Failed to create XImage\n");
-        free(image_data);
         XFreeGC(ctx->x11.display, ctx->x11.gc);
         XDestroyWindow(ctx->x11.display, ctx->x11.window);
         XCloseDisplay(ctx->x11.display);
         return VISUALMEM_V2_ERROR_INIT_FAILED;
     }
     
-    // Clear the image
-    memset(image_data, 0, image_size);
+    size_t image_size = (size_t)ctx->x11.ximage->bytes_per_line * ctx->height;
+    ctx->x11.ximage->data = (char*)calloc(1, image_size);
+    if (!ctx->x11.ximage->data) {
+        printf("[X11] ERROR: Failed to allocate image buffer\n");
+        XDestroyImage(ctx->x11.ximage);
+        ctx->x11.ximage = NULL;
+        XFreeGC(ctx->x11.display, ctx->x11.gc);
+        XDestroyWindow(ctx->x11.display, ctx->x11.window);
+        XCloseDisplay(ctx->x11.display);
+        return VISUALMEM_V2_ERROR_OUT_OF_VIDEO_MEMORY;
+    }
     
     // Force initial display update
     XPutImage(ctx->x11.display, ctx->x11.window, ctx->x11.gc,
@@ -218,6 +216,65 @@ int visualmem_v2_init_x11_backend(visualmem_v2_context_t* ctx) {
     return VISUALMEM_V2_SUCCESS;
 }
 
+// === X11 COLOR CONVERSION ===
+// TrueColor visuals below 24 bits (e.g. RGB565) keep only the top bits of
+// each channel; pack and unpack through the image channel masks so colors
+// degrade by quantization instead of being truncated to the low bytes.
+
+static int mask_shift(unsigned long mask) {
+    int shift = 0;
+    while (mask && !(mask & 1)) {
+        mask >>= 1;
+        shift++;
+    }
+    return shift;
+}
+
+static int mask_bits(unsigned long mask) {
+    int bits = 0;
+    for (mask >>= mask_shift(mask); mask & 1; mask >>= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+static unsigned long pack_channel(uint32_t value, unsigned long mask) {
+    int bits = mask_bits(mask);
+    if (bits == 0) return 0;
+    unsigned long scaled = bits >= 8 ? (unsigned long)value << (bits - 8) : value >> (8 - bits);
+    return (scaled << mask_shift(mask)) & mask;
+}
+
+static uint32_t unpack_channel(unsigned long pixel, unsigned long mask) {
+    int bits = mask_bits(mask);
+    if (bits == 0) return 0;
+    unsigned long value = (pixel & mask) >> mask_shift(mask);
+    if (bits >= 8) return (uint32_t)(value >> (bits - 8));
+    return (uint32_t)(value * 255 / ((1UL << bits) - 1)); // Expand to the full 0-255 range
+}
+
+static int is_direct_rgb888(const XImage* image) {
+    return image->red_mask == 0xFF0000 && image->green_mask == 0x00FF00 && image->blue_mask == 0x0000FF;
+}
+
+static unsigned long x11_pack_color(const XImage* image, uint32_t color) {
+    if (is_direct_rgb888(image) || !image->red_mask) {
+        return color & 0x00FFFFFF;
+    }
+    return pack_channel((color >> 16) & 0xFF, image->red_mask) |
+           pack_channel((color >> 8) & 0xFF, image->green_mask) |
+           pack_channel(color & 0xFF, image->blue_mask);
+}
+
+static uint32_t x11_unpack_pixel(const XImage* image, unsigned long pixel) {
+    if (is_direct_rgb888(image) || !image->red_mask) {
+        return (uint32_t)pixel;
+    }
+    return (unpack_channel(pixel, image->red_mask) << 16) |
+           (unpack_channel(pixel, image->green_mask) << 8) |
+           unpack_channel(pixel, image->blue_mask);
+}
+
 /**
  * Write pixel to X11 display
  */
@@ -230,10 +287,8 @@ int visualmem_v2_x11_write_pixel(visualmem_v2_context_t* ctx, int x, int y, uint
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
-    // Convert RGBA to X11 pixel format
-    unsigned long pixel = color & 0x00FFFFFF; // Remove alpha channel for X11
-    
-    XPutPixel(ctx->x11.ximage, x, y, pixel);
+    // Convert RGBA to X11 pixel format (alpha is dropped)
+    XPutPixel(ctx->x11.ximage, x, y, x11_pack_color(ctx->x11.ximage, color));
     
     return VISUALMEM_V2_SUCCESS;
 }
@@ -251,7 +306,7 @@ uint32_t visualmem_v2_x11_read_pixel(visualmem_v2_context_t* ctx, int x, int y)
     }
     
     unsigned long pixel = XGetPixel(ctx->x11.ximage, x, y);
-    return (uint32_t)(pixel | 0xFF000000); // Add alpha channel
+    return x11_unpack_pixel(ctx->x11.ximage, pixel) | 0xFF000000; // Add alpha channel
 }
 
 /**
@@ -273,6 +328,21 @@ int visualmem_v2_x11_refresh(visualmem_v2_context_t* ctx) {
     return VISUALMEM_V2_SUCCESS;
 }
 
+/**
+ * Push one screen rectangle to the X11 window (dirty tile refresh)
+ */
+int visualmem_v2_x11_refresh_region(visualmem_v2_context_t* ctx, int x, int y, int width, int height) {
+    if (!ctx || !ctx->x11.display || !ctx->x11.window || !ctx->x11.ximage) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    XPutImage(ctx->x11.display, ctx->x11.window, ctx->x11.gc,
+              ctx->x11.ximage, x, y, x, y, width, height);
+    XFlush(ctx->x11.display);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
 /**
  * Cleanup X11 backend
  */
@@ -282,9 +352,9 @@ void visualmem_v2_cleanup_x11_backend(visualmem_v2_context_t* ctx) {
     printf("[X11] Cleaning up X11 backend...\n");
     
     if (ctx->x11.ximage) {
-        if (ctx->x11.ximage->data) {
-            free(ctx->x11.ximage->data);
-        }
+        // XDestroyImage would free data again
+        free(ctx->x11.ximage->data);
+        ctx->x11.ximage->data = NULL;
         XDestroyImage(ctx->x11.ximage);
         ctx->x11.ximage = NULL;
     }
@@ -216,5 +216,18 @@ int visualmem_v2_x11_refresh(visualmem_v2_context_t* ctx) {
         }
     }
     
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Push one screen rectangle of the image buffer (dirty tile refresh)
+int visualmem_v2_x11_refresh_region(visualmem_v2_context_t* ctx, int x, int y, int width, int height) {
+    if (!ctx || !ctx->x11.display || !ctx->x11.window || !ctx->x11.ximage) {
+        return VISUALMEM_V2_ERROR_DISPLAY_LOST;
+    }
+    
+    XPutImage(ctx->x11.display, ctx->x11.window, ctx->x11.gc, ctx->x11.ximage,
+              x, y, x, y, width, height);
+    XFlush(ctx->x11.display);
+    
     return VISUALMEM_V2_SUCCESS;
 }
\ No newline at end of file
@@ -15,6 +15,14 @@
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VISUALMEM_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 // === INTERNAL CONSTANTS ===
 #define VISUALMEM_MAGIC_HEADER 0x56495355  // "VISU" in hex
@@ -22,6 +30,18 @@
 #define VISUALMEM_BYTE_SPACING_Y 2   // Vertical spacing between bytes
 #define VISUALMEM_MEMORY_START_X 20  // Skip header area
 #define VISUALMEM_MEMORY_START_Y 20
+#define VISUALMEM_TILE_ROWS 16       // Pixel rows per sparse framebuffer tile
+
+// Framed encodings (framed binary, dense, palette) store one block per row: a sync
+// pixel carrying the encoding tag and row sequence number, a length pixel
+// carrying the block payload size, then payload pixels back to back.
+#define VISUALMEM_BLOCK_HEADER_PIXELS 2
+#define VISUALMEM_BLOCK_TAG_DENSE_RGB  0xD3
+#define VISUALMEM_BLOCK_TAG_DENSE_RGBA 0xD4
+#define VISUALMEM_BLOCK_TAG_PALETTE_2BPP 0xD5
+#define VISUALMEM_BLOCK_TAG_PALETTE_4BPP 0xD6
+#define VISUALMEM_BLOCK_TAG_PALETTE_8BPP 0xD7
+#define VISUALMEM_BLOCK_TAG_BINARY_FRAMED 0xD8
 
 // === INTERNAL STRUCTURES ===
 typedef struct {
@@ -32,425 +52,3093 @@ typedef struct {
     int height;
     int allocation_count;
     uint64_t timestamp;
+    visualmem_encoding_t encoding;
 } visualmem_header_t;
 
-// === COORDINATE CONVERSION ===
-static inline void* coord_to_addr(int x, int y) {
-    return (void*)((uintptr_t)((y << 16) | x));
+// === ADDRESS HANDLES ===
+// Visual addresses are opaque handles: the low bits hold the allocation slot
+// plus one (so a handle is never NULL), the high bits the slot's generation.
+// Freeing a slot bumps its generation, so stale handles stop matching.
+// Slab objects set the top slot bit and pack slab and object index below it.
+// Arena handles set the next bit instead: the low bits hold the arena index
+// and a stamp, the high bits the payload offset inside the arena (0 for the
+// arena itself).
+#define HANDLE_SLOT_BITS (sizeof(uintptr_t) * 4)
+#define HANDLE_SLOT_MASK (((uintptr_t)1 << HANDLE_SLOT_BITS) - 1)
+#define HANDLE_GENERATION_BITS (sizeof(uintptr_t) * 8 - HANDLE_SLOT_BITS)
+#define HANDLE_GENERATION_MASK ((uint32_t)(((uint64_t)1 << HANDLE_GENERATION_BITS) - 1))
+#define HANDLE_SLAB_FLAG ((uintptr_t)1 << (HANDLE_SLOT_BITS - 1))
+#define HANDLE_ARENA_FLAG ((uintptr_t)1 << (HANDLE_SLOT_BITS - 2))
+#define SLAB_OBJECT_BITS 6      // log2(VISUALMEM_SLAB_OBJECTS)
+#define ARENA_INDEX_BITS (HANDLE_SLOT_BITS / 2 - 2)
+#define ARENA_INDEX_MASK (((uintptr_t)1 << ARENA_INDEX_BITS) - 1)
+#define ARENA_STAMP_MASK (((uintptr_t)1 << (HANDLE_SLOT_BITS / 2)) - 1)
+
+static inline void* make_handle(int slot, uint32_t generation) {
+    return (void*)(((uintptr_t)generation << HANDLE_SLOT_BITS) | (uintptr_t)(slot + 1));
+}
+
+static inline int handle_slot(void* handle) {
+    return (int)((uintptr_t)handle & HANDLE_SLOT_MASK) - 1;
+}
+
+static inline void* make_slab_handle(int32_t slab, int object, uint32_t generation) {
+    return (void*)(((uintptr_t)generation << HANDLE_SLOT_BITS) | HANDLE_SLAB_FLAG |
+                   ((uintptr_t)slab << SLAB_OBJECT_BITS) | (uintptr_t)object);
+}
+
+static inline int is_slab_handle(void* handle) {
+    return ((uintptr_t)handle & HANDLE_SLAB_FLAG) != 0;
+}
+
+static inline void* make_arena_handle(int32_t arena, uint32_t stamp, size_t offset) {
+    return (void*)(((uintptr_t)offset << HANDLE_SLOT_BITS) | HANDLE_ARENA_FLAG |
+                   (((uintptr_t)stamp & ARENA_STAMP_MASK) << ARENA_INDEX_BITS) | (uintptr_t)arena);
+}
+
+static inline int is_arena_handle(void* handle) {
+    return ((uintptr_t)handle & (HANDLE_SLAB_FLAG | HANDLE_ARENA_FLAG)) == HANDLE_ARENA_FLAG;
+}
+
+// === THREAD-SAFE MODE ===
+// With visualmem_set_thread_safe on, data calls resolve handles without a
+// lock. A reader announces the epoch it started in; allocator calls hold the
+// writer lock, and whatever they take away from readers (an outgrown record
+// array, a freed or moved block) is retired with the current epoch, which
+// then advances. Retired entries are reclaimed once every active reader
+// started in a later epoch.
+typedef struct visualmem_reader {
+    uint64_t epoch;                 // Epoch the running data call started in, 0 when idle
+    int depth;                      // Nested data calls on the owning thread
+    const void* owner;              // Thread token of the owning thread
+    visualmem_allocation_t info;    // This thread's visualmem_get_allocation_info record
+    struct visualmem_reader* next;
+} visualmem_reader_t;
+
+typedef struct {
+    uint64_t stamp;                 // Epoch the entry was retired in
+    void* memory;                   // Host memory to free, or NULL for a block
+    size_t byte_index;              // Block to hand back to the buddy allocator
+    size_t size;                    // Bytes of the block that may hold data
+} retired_t;
+
+struct visualmem_sync {
+    pthread_mutex_t writer;
+    const void* writer_owner;       // Thread token of the writer lock holder
+    int writer_depth;               // Allocator calls nest (batches, realloc)
+    uint64_t serial;                // Tells thread caches apart from older contexts
+    uint64_t epoch;                 // Starts at 1; 0 marks an idle reader
+    visualmem_reader_t* readers;    // Never shrinks while the mode is on
+    retired_t* retired;             // In stamp order
+    int retired_count;
+    int retired_capacity;
+};
+
+static uint64_t sync_serial;                     // Last serial handed out
+static __thread char thread_token;               // Its address identifies the thread
+static __thread uint64_t cached_serial;          // Context of cached_reader
+static __thread visualmem_reader_t* cached_reader;
+
+// This thread's reader record, created on its first data call; a record
+// left by an exited thread whose token address is reused is taken over
+static visualmem_reader_t* reader_register(struct visualmem_sync* sync) {
+    visualmem_reader_t* reader = __atomic_load_n(&sync->readers, __ATOMIC_ACQUIRE);
+    while (reader && reader->owner != &thread_token) {
+        reader = reader->next;
+    }
+    
+    if (!reader) {
+        reader = calloc(1, sizeof(*reader));
+        if (!reader) return NULL;
+        reader->owner = &thread_token;
+        reader->next = __atomic_load_n(&sync->readers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&sync->readers, &reader->next, reader, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    
+    cached_serial = sync->serial;
+    cached_reader = reader;
+    return reader;
+}
+
+// Start a data call; *reader stays NULL outside thread-safe mode. 0 when the
+// thread's record cannot be created
+static int reader_enter(visualmem_context_t* ctx, visualmem_reader_t** reader) {
+    struct visualmem_sync* sync = ctx->sync;
+    *reader = NULL;
+    if (!sync) return 1;
+    
+    visualmem_reader_t* self = cached_serial == sync->serial ? cached_reader : reader_register(sync);
+    if (!self) return 0;
+    
+    // Announce the epoch before loading anything a writer may retire. The
+    // exchange and the writer's read of it (oldest_reader_epoch) are both
+    // read-modify-writes of this word, so one of them sees the other
+    if (self->depth++ == 0) {
+        __atomic_exchange_n(&self->epoch, __atomic_load_n(&sync->epoch, __ATOMIC_ACQUIRE), __ATOMIC_ACQ_REL);
+    }
+    *reader = self;
+    return 1;
+}
+
+static void reader_exit(visualmem_reader_t* reader) {
+    if (reader && --reader->depth == 0) {
+        __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// Epoch of the longest running data call, UINT64_MAX when there is none
+static uint64_t oldest_reader_epoch(struct visualmem_sync* sync) {
+    uint64_t oldest = UINT64_MAX;
+    for (visualmem_reader_t* reader = __atomic_load_n(&sync->readers, __ATOMIC_ACQUIRE);
+         reader; reader = reader->next) {
+        // Read-modify-write: either this sees the reader's announced epoch,
+        // or the reader sees everything unpublished before this call
+        uint64_t epoch = __atomic_fetch_add(&reader->epoch, 0, __ATOMIC_ACQ_REL);
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    return oldest;
+}
+
+// Close the current epoch and wait until no data call started in it or before
+static void wait_for_readers(struct visualmem_sync* sync) {
+    uint64_t stamp = sync->epoch;
+    __atomic_store_n(&sync->epoch, stamp + 1, __ATOMIC_RELEASE);
+    while (oldest_reader_epoch(sync) <= stamp) {
+        sched_yield();
+    }
+}
+
+// Queue memory or a block for reclamation; 0 when the queue cannot grow.
+// The caller has already unpublished it.
+static int retire(struct visualmem_sync* sync, void* memory, size_t byte_index, size_t size) {
+    if (sync->retired_count == sync->retired_capacity) {
+        int new_capacity = sync->retired_capacity ? sync->retired_capacity * 2 : 16;
+        retired_t* grown = realloc(sync->retired, sizeof(*grown) * (size_t)new_capacity);
+        if (!grown) return 0;
+        sync->retired = grown;
+        sync->retired_capacity = new_capacity;
+    }
+    
+    retired_t* entry = &sync->retired[sync->retired_count++];
+    entry->stamp = sync->epoch;
+    entry->memory = memory;
+    entry->byte_index = byte_index;
+    entry->size = size;
+    __atomic_store_n(&sync->epoch, sync->epoch + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Free host memory that readers may still be walking once they are done
+static void retire_memory(visualmem_context_t* ctx, void* memory) {
+    if (!memory || retire(ctx->sync, memory, 0, 0)) return;
+    wait_for_readers(ctx->sync);
+    free(memory);
+}
+
+// Larger copy of a record array. Lock-free readers may still hold the old
+// one, so then it is copied instead of reallocated; the caller publishes the
+// result and hands the old array to retire_records.
+static void* grow_records(visualmem_context_t* ctx, void* records, size_t old_bytes, size_t new_bytes) {
+    if (!ctx->sync) return realloc(records, new_bytes);
+    
+    void* grown = malloc(new_bytes);
+    if (grown && old_bytes > 0) memcpy(grown, records, old_bytes);
+    return grown;
+}
+
+static void retire_records(visualmem_context_t* ctx, void* records) {
+    if (ctx->sync) retire_memory(ctx, records);
+}
+
+// === ALLOCATION TABLE ===
+// Starts empty (init stays O(1)) and doubles when the free-slot stack runs
+// dry. A failed grow leaves the table usable at its old capacity.
+// Arrays are published before the capacity that covers them.
+#define TABLE_GROW(ctx, table, field, old_count, count) do { \
+        void* old = (table)->field; \
+        void* grown = grow_records(ctx, old, sizeof(*(table)->field) * (size_t)(old_count), \
+                                   sizeof(*(table)->field) * (size_t)(count)); \
+        if (!grown) return VISUALMEM_ERROR_ALLOCATION_FAILED; \
+        __atomic_store_n(&(table)->field, grown, __ATOMIC_RELEASE); \
+        retire_records(ctx, old); \
+    } while (0)
+
+static int table_grow(visualmem_context_t* ctx, visualmem_alloc_table_t* table) {
+    // Handles store slot + 1 below the arena flag; the last doubling is
+    // clamped so every slot that fits is used
+    const uintptr_t max_capacity = HANDLE_ARENA_FLAG - 1 < (uintptr_t)INT_MAX ? HANDLE_ARENA_FLAG - 1 : (uintptr_t)INT_MAX;
+    int old_capacity = table->capacity;
+    if ((uintptr_t)old_capacity >= max_capacity) return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    uintptr_t wanted = old_capacity ? (uintptr_t)old_capacity * 2 : VISUALMEM_ALLOC_TABLE_INITIAL;
+    int new_capacity = (int)(wanted < max_capacity ? wanted : max_capacity);
+    
+    TABLE_GROW(ctx, table, byte_index, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, size, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, generation, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, is_active, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, checksum, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, timestamp, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, label, old_capacity, new_capacity);
+    TABLE_GROW(ctx, table, free_slots, old_capacity, new_capacity);
+    
+    size_t added = (size_t)(new_capacity - old_capacity);
+    memset(table->generation + old_capacity, 0, added * sizeof(*table->generation));
+    memset(table->is_active + old_capacity, 0, added * sizeof(*table->is_active));
+    
+    // Push the new slots so the lowest index is handed out first
+    for (int slot = new_capacity - 1; slot >= old_capacity; slot--) {
+        table->free_slots[table->free_slot_count++] = slot;
+    }
+    __atomic_store_n(&table->capacity, new_capacity, __ATOMIC_RELEASE);
+    
+    return VISUALMEM_SUCCESS;
+}
+
+static int table_acquire(visualmem_context_t* ctx, visualmem_alloc_table_t* table) {
+    if (table->free_slot_count == 0 && table_grow(ctx, table) != VISUALMEM_SUCCESS) {
+        return -1;
+    }
+    return table->free_slots[--table->free_slot_count];
+}
+
+// Make a filled-in slot visible to lookups. The generation was bumped on
+// retire; the active bit publishes it with the record
+static void table_publish(visualmem_alloc_table_t* table, int slot) {
+    __atomic_store_n(&table->is_active[slot], 1, __ATOMIC_RELEASE);
+}
+
+// Lock-free readers load these elements: the new generation goes out first,
+// so an active bit is never paired with the generation before it
+static void table_retire(visualmem_alloc_table_t* table, int slot) {
+    __atomic_store_n(&table->generation[slot], table->generation[slot] + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->is_active[slot], 0, __ATOMIC_RELEASE);
+    table->free_slots[table->free_slot_count++] = slot;
+}
+
+static void table_release(visualmem_alloc_table_t* table) {
+    free(table->byte_index);
+    free(table->size);
+    free(table->generation);
+    free(table->is_active);
+    free(table->checksum);
+    free(table->timestamp);
+    free(table->label);
+    free(table->free_slots);
+    memset(table, 0, sizeof(*table));
+}
+
+// Slot of a live allocation, or -1 for NULL, unknown or stale handles.
+// Safe without the writer lock: the capacity is loaded before the arrays.
+static int table_lookup(const visualmem_alloc_table_t* table, void* visual_addr) {
+    int slot = handle_slot(visual_addr);
+    int capacity = __atomic_load_n(&table->capacity, __ATOMIC_ACQUIRE);
+    if (is_slab_handle(visual_addr) || slot < 0 || slot >= capacity ||
+        !__atomic_load_n(&__atomic_load_n(&table->is_active, __ATOMIC_ACQUIRE)[slot], __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    uint32_t generation = __atomic_load_n(&__atomic_load_n(&table->generation, __ATOMIC_ACQUIRE)[slot],
+                                          __ATOMIC_ACQUIRE);
+    if (make_handle(slot, generation) != visual_addr) return -1;
+    return slot;
+}
+
+// === PAYLOAD LAYOUT ===
+static int encoding_bytes_per_pixel(visualmem_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_ENCODING_DENSE_RGB: return 3;
+        case VISUALMEM_ENCODING_DENSE_RGBA: return 4;
+        default: return 0; // Binary: several pixels per byte
+    }
+}
+
+// Bits per pixel of the palette encodings (0 for everything else); framed
+// binary is handled by the binary kernels, not the palette tables
+static int encoding_palette_bits(visualmem_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_ENCODING_PALETTE_2BPP: return 2;
+        case VISUALMEM_ENCODING_PALETTE_4BPP: return 4;
+        case VISUALMEM_ENCODING_PALETTE_8BPP: return 8;
+        default: return 0;
+    }
+}
+
+static int encoding_is_valid(visualmem_encoding_t encoding) {
+    return encoding == VISUALMEM_ENCODING_BINARY ||
+           encoding == VISUALMEM_ENCODING_BINARY_FRAMED ||
+           encoding_bytes_per_pixel(encoding) > 0 ||
+           encoding_palette_bits(encoding) > 0;
+}
+
+static uint8_t encoding_block_tag(visualmem_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_ENCODING_DENSE_RGBA: return VISUALMEM_BLOCK_TAG_DENSE_RGBA;
+        case VISUALMEM_ENCODING_PALETTE_2BPP: return VISUALMEM_BLOCK_TAG_PALETTE_2BPP;
+        case VISUALMEM_ENCODING_PALETTE_4BPP: return VISUALMEM_BLOCK_TAG_PALETTE_4BPP;
+        case VISUALMEM_ENCODING_PALETTE_8BPP: return VISUALMEM_BLOCK_TAG_PALETTE_8BPP;
+        case VISUALMEM_ENCODING_BINARY_FRAMED: return VISUALMEM_BLOCK_TAG_BINARY_FRAMED;
+        default: return VISUALMEM_BLOCK_TAG_DENSE_RGB;
+    }
 }
 
-static inline void addr_to_coord(void* addr, int* x, int* y) {
-    uintptr_t val = (uintptr_t)addr;
-    *x = val & 0xFFFF;
-    *y = (val >> 16) & 0xFFFF;
+// Dense payload bytes fill a pixel in memory order (B, G, R, then A), so
+// on little-endian hosts a run of RGBA pixels is a straight byte copy.
+static inline int dense_channel_shift(int channel) {
+    return channel * 8;
 }
 
-static void calculate_byte_position(int byte_index, int* x, int* y, int width) {
-    int bytes_per_row = (width - VISUALMEM_MEMORY_START_X) / VISUALMEM_BYTE_SPACING_X;
-    int row = byte_index / bytes_per_row;
-    int col = byte_index % bytes_per_row;
+static void compute_layout(visualmem_context_t* ctx) {
+    int rows;
+    
+    if (ctx->encoding == VISUALMEM_ENCODING_BINARY) {
+        ctx->bytes_per_row = (ctx->width - VISUALMEM_MEMORY_START_X) / VISUALMEM_BYTE_SPACING_X;
+        rows = (ctx->height - VISUALMEM_MEMORY_START_Y) / VISUALMEM_BYTE_SPACING_Y;
+    } else {
+        int payload_pixels = ctx->width - VISUALMEM_MEMORY_START_X - VISUALMEM_BLOCK_HEADER_PIXELS;
+        int palette_bits = encoding_palette_bits(ctx->encoding);
+        if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) {
+            ctx->bytes_per_row = payload_pixels / VISUALMEM_BITS_PER_BYTE;
+        } else if (palette_bits > 0) {
+            ctx->bytes_per_row = payload_pixels * palette_bits / 8;
+        } else {
+            ctx->bytes_per_row = payload_pixels * encoding_bytes_per_pixel(ctx->encoding);
+        }
+        rows = ctx->height - VISUALMEM_MEMORY_START_Y;
+    }
     
-    *x = VISUALMEM_MEMORY_START_X + (col * VISUALMEM_BYTE_SPACING_X);
-    *y = VISUALMEM_MEMORY_START_Y + (row * VISUALMEM_BYTE_SPACING_Y);
+    if (ctx->bytes_per_row < 0) ctx->bytes_per_row = 0;
+    if (rows < 0) rows = 0;
+    ctx->capacity_bytes = (size_t)ctx->bytes_per_row * rows;
+}
+
+static int row_spacing(const visualmem_context_t* ctx) {
+    return ctx->encoding == VISUALMEM_ENCODING_BINARY ? VISUALMEM_BYTE_SPACING_Y : 1;
+}
+
+static void calculate_byte_position(const visualmem_context_t* ctx, size_t byte_index,
+                                    int* x, int* y, int* channel) {
+    int row = (int)(byte_index / ctx->bytes_per_row);
+    int col = (int)(byte_index % ctx->bytes_per_row);
+    
+    if (ctx->encoding == VISUALMEM_ENCODING_BINARY) {
+        *x = VISUALMEM_MEMORY_START_X + (col * VISUALMEM_BYTE_SPACING_X);
+        *y = VISUALMEM_MEMORY_START_Y + (row * VISUALMEM_BYTE_SPACING_Y);
+        *channel = 0;
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) {
+        *x = VISUALMEM_MEMORY_START_X + VISUALMEM_BLOCK_HEADER_PIXELS + (col * VISUALMEM_BITS_PER_BYTE);
+        *y = VISUALMEM_MEMORY_START_Y + row;
+        *channel = 0;
+    } else if (encoding_palette_bits(ctx->encoding) > 0) {
+        int pixels_per_byte = 8 / encoding_palette_bits(ctx->encoding);
+        *x = VISUALMEM_MEMORY_START_X + VISUALMEM_BLOCK_HEADER_PIXELS + (col * pixels_per_byte);
+        *y = VISUALMEM_MEMORY_START_Y + row;
+        *channel = 0;
+    } else {
+        int bytes_per_pixel = encoding_bytes_per_pixel(ctx->encoding);
+        *x = VISUALMEM_MEMORY_START_X + VISUALMEM_BLOCK_HEADER_PIXELS + (col / bytes_per_pixel);
+        *y = VISUALMEM_MEMORY_START_Y + row;
+        *channel = col % bytes_per_pixel;
+    }
 }
 
 // === FRAMEBUFFER OPERATIONS ===
-static void set_pixel_color(visualmem_context_t* ctx, int x, int y, uint32_t color) {
-    if (x >= 0 && x < ctx->width && y >= 0 && y < ctx->height) {
-        int index = y * ctx->width + x;
-        uint32_t* framebuffer = (uint32_t*)ctx->framebuffer;
+// Until the autonomous transition the RAM buffer is authoritative and the
+// framebuffer is synchronized once by visualmem_enter_autonomous_mode();
+// afterwards the framebuffer is the only copy.
+//
+// Legacy binary payloads only ever use the visualmem_color_t colors, so in
+// simulate mode both buffers hold 4-bit color indices, two pixels per byte
+// with the left pixel in the high nibble, and pixels are expanded to ARGB
+// only when read out. Other encodings carry arbitrary colors and keep
+// 32-bit pixels.
+//
+// Indexed buffers are also sparse: a buffer is a directory of tiles of
+// VISUALMEM_TILE_ROWS rows, and a tile is only allocated (filled with the
+// free color) when a row in it is first written. Rows of untouched tiles
+// read from a shared all-free row, so startup cost and resident memory
+// follow the data stored rather than the screen size.
+enum {
+    PIXEL_INDEX_BIT_0,
+    PIXEL_INDEX_BIT_1,
+    PIXEL_INDEX_START,
+    PIXEL_INDEX_END,
+    PIXEL_INDEX_ADDR,
+    PIXEL_INDEX_FREE,
+    PIXEL_INDEX_RESERVED
+};
+
+static const uint32_t indexed_colors[16] = {
+    [PIXEL_INDEX_BIT_0]    = VISUALMEM_COLOR_BIT_0,
+    [PIXEL_INDEX_BIT_1]    = VISUALMEM_COLOR_BIT_1,
+    [PIXEL_INDEX_START]    = VISUALMEM_COLOR_START,
+    [PIXEL_INDEX_END]      = VISUALMEM_COLOR_END,
+    [PIXEL_INDEX_ADDR]     = VISUALMEM_COLOR_ADDR,
+    [PIXEL_INDEX_FREE]     = VISUALMEM_COLOR_FREE,
+    [PIXEL_INDEX_RESERVED] = VISUALMEM_COLOR_RESERVED
+};
+
+static int uses_indexed_pixels(visualmem_mode_t mode, visualmem_encoding_t encoding) {
+    return mode == VISUALMEM_MODE_SIMULATE && encoding == VISUALMEM_ENCODING_BINARY;
+}
+
+static size_t pixel_row_bytes(const visualmem_context_t* ctx) {
+    if (ctx->pixel_bits == 4) {
+        return ((size_t)ctx->width + 1) / 2;
+    }
+    return (size_t)ctx->width * sizeof(uint32_t);
+}
+
+static uint8_t free_index_row[(VISUALMEM_MAX_WIDTH + 1) / 2]; // Never written through
+
+static inline int tile_count(const visualmem_context_t* ctx) {
+    return (ctx->height + VISUALMEM_TILE_ROWS - 1) / VISUALMEM_TILE_ROWS;
+}
+
+static inline size_t tile_bytes(const visualmem_context_t* ctx) {
+    return pixel_row_bytes(ctx) * VISUALMEM_TILE_ROWS;
+}
+
+static void* authoritative_buffer(visualmem_context_t* ctx) {
+    if (ctx->ram_buffer && !ctx->ram_freed) {
+        return ctx->ram_buffer;
+    }
+    return ctx->framebuffer;
+}
+
+// Row for reading; rows of untouched tiles read as free
+static inline uint8_t* pixel_row(visualmem_context_t* ctx, int y) {
+    if (ctx->pixel_bits == 4) {
+        uint8_t* tile = __atomic_load_n(&((uint8_t**)authoritative_buffer(ctx))[y / VISUALMEM_TILE_ROWS],
+                                        __ATOMIC_ACQUIRE);
+        if (!tile) return free_index_row;
+        return tile + (size_t)(y % VISUALMEM_TILE_ROWS) * pixel_row_bytes(ctx);
+    }
+    return (uint8_t*)authoritative_buffer(ctx) + (size_t)y * pixel_row_bytes(ctx);
+}
+
+// Row for writing; materializes its tile, NULL when that allocation fails.
+// Concurrent writers may race to materialize a tile: the first one wins.
+static uint8_t* pixel_row_for_write(visualmem_context_t* ctx, int y) {
+    if (ctx->pixel_bits == 4) {
+        uint8_t** slot = &((uint8_t**)authoritative_buffer(ctx))[y / VISUALMEM_TILE_ROWS];
+        if (!__atomic_load_n(slot, __ATOMIC_ACQUIRE)) {
+            uint8_t* tile = malloc(tile_bytes(ctx));
+            if (!tile) return NULL;
+            memset(tile, PIXEL_INDEX_FREE * 0x11, tile_bytes(ctx));
+            uint8_t* expected = NULL;
+            if (__atomic_compare_exchange_n(slot, &expected, tile, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add(&ctx->resident_bytes, tile_bytes(ctx), __ATOMIC_RELAXED);
+            } else {
+                free(tile);
+            }
+        }
+    }
+    return pixel_row(ctx, y);
+}
+
+// Byte offset of pixel x within its row (x is even for indexed pixels)
+static inline size_t pixel_offset(const visualmem_context_t* ctx, int x) {
+    return ctx->pixel_bits == 4 ? (size_t)x / 2 : (size_t)x * sizeof(uint32_t);
+}
+
+static uint32_t pixel_at(visualmem_context_t* ctx, int x, int y) {
+    const uint8_t* row = pixel_row(ctx, y);
+    if (ctx->pixel_bits == 4) {
+        uint8_t pair = row[x / 2];
+        return indexed_colors[(x & 1) ? (pair & 0x0F) : (pair >> 4)];
+    }
+    return ((const uint32_t*)row)[x];
+}
+
+static void fill_pixels(uint32_t* pixels, size_t count, uint32_t color) {
+    for (size_t i = 0; i < count; i++) {
+        pixels[i] = color;
+    }
+}
+
+// Indexed buffers start as an empty tile directory; 32-bit buffers are
+// allocated whole and optionally filled with the free color
+static void* create_pixel_buffer(visualmem_context_t* ctx, int fill) {
+    if (ctx->pixel_bits == 4) {
+        return calloc(tile_count(ctx), sizeof(uint8_t*));
+    }
+    
+    uint32_t* pixels = malloc(ctx->framebuffer_size);
+    if (pixels) {
+        if (fill) fill_pixels(pixels, (size_t)ctx->width * ctx->height, VISUALMEM_COLOR_FREE);
+        ctx->resident_bytes += ctx->framebuffer_size;
+    }
+    return pixels;
+}
+
+static void destroy_pixel_buffer(visualmem_context_t* ctx, void* buffer) {
+    if (!buffer) return;
+    
+    if (ctx->pixel_bits == 4) {
+        uint8_t** tiles = (uint8_t**)buffer;
+        for (int i = 0; i < tile_count(ctx); i++) {
+            if (tiles[i]) {
+                free(tiles[i]);
+                ctx->resident_bytes -= tile_bytes(ctx);
+            }
+        }
+    } else {
+        ctx->resident_bytes -= ctx->framebuffer_size;
+    }
+    free(buffer);
+}
+
+// === BLOCK FRAMING ===
+static void write_block_headers(visualmem_context_t* ctx) {
+    int rows = ctx->bytes_per_row > 0 ? (int)(ctx->capacity_bytes / ctx->bytes_per_row) : 0;
+    uint32_t tag = encoding_block_tag(ctx->encoding);
+    uint32_t empty_payload = ctx->encoding == VISUALMEM_ENCODING_DENSE_RGBA ? 0x00000000 : 0xFF000000;
+    size_t payload_pixels = ctx->width - VISUALMEM_MEMORY_START_X - VISUALMEM_BLOCK_HEADER_PIXELS;
+    uint32_t* row_start = (uint32_t*)pixel_row_for_write(ctx, VISUALMEM_MEMORY_START_Y) + VISUALMEM_MEMORY_START_X;
+    
+    for (int row = 0; row < rows; row++, row_start += ctx->width) {
+        // Sync pixel: encoding tag + 16-bit block sequence number
+        row_start[0] = 0xFF000000 | (tag << 16) | (row & 0xFFFF);
+        // Length pixel: block payload size in bytes
+        row_start[1] = 0xFF000000 | (ctx->bytes_per_row & 0x00FFFFFF);
+        
+        // Payload pixels start out holding zero bytes
+        fill_pixels(row_start + VISUALMEM_BLOCK_HEADER_PIXELS, payload_pixels, empty_payload);
+    }
+}
+
+// === PALETTE ENCODING ===
+// Palette colors sit on a 3-3-2 RGB level grid (8 red, 8 green, 4 blue
+// levels). Decoding quantizes a pixel to its nearest grid cell and looks
+// the cell up in a per-palette symbol table, so channel errors of up to
+// half a level (16 or more per channel) still decode to the right symbol.
+// The smaller palettes only use grid colors far apart from each other.
+typedef struct {
+    uint32_t colors[256];   // Symbol -> ARGB
+    uint8_t symbols[256];   // 3-3-2 grid cell -> nearest symbol
+} palette_table_t;
+
+static palette_table_t palette_tables[3]; // 2, 4 and 8 bits per pixel
+static uint8_t red_green_level[256];      // Channel value -> nearest of 8 levels
+static uint8_t blue_level[256];           // Channel value -> nearest of 4 levels
+
+static inline uint32_t grid_color(int r, int g, int b) {
+    return 0xFF000000 | ((uint32_t)(r * 255 / 7) << 16) | ((uint32_t)(g * 255 / 7) << 8) | (uint32_t)(b * 255 / 3);
+}
+
+static inline int grid_cell(uint32_t color) {
+    return (red_green_level[(color >> 16) & 0xFF] << 5) |
+           (red_green_level[(color >> 8) & 0xFF] << 2) |
+           blue_level[color & 0xFF];
+}
+
+static const palette_table_t* palette_for(visualmem_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_ENCODING_PALETTE_2BPP: return &palette_tables[0];
+        case VISUALMEM_ENCODING_PALETTE_4BPP: return &palette_tables[1];
+        default: return &palette_tables[2];
+    }
+}
+
+static void build_palette(palette_table_t* palette, int symbol_count) {
+    // Nearest symbol for the center color of every grid cell
+    for (int cell = 0; cell < 256; cell++) {
+        uint32_t center = grid_color(cell >> 5, (cell >> 2) & 7, cell & 3);
+        int best = 0;
+        long best_distance = -1;
+        for (int symbol = 0; symbol < symbol_count; symbol++) {
+            uint32_t color = palette->colors[symbol];
+            long dr = (long)((center >> 16) & 0xFF) - (long)((color >> 16) & 0xFF);
+            long dg = (long)((center >> 8) & 0xFF) - (long)((color >> 8) & 0xFF);
+            long db = (long)(center & 0xFF) - (long)(color & 0xFF);
+            long distance = dr * dr + dg * dg + db * db;
+            if (best_distance < 0 || distance < best_distance) {
+                best_distance = distance;
+                best = symbol;
+            }
+        }
+        palette->symbols[cell] = (uint8_t)best;
+    }
+}
+
+static void palette_tables_init(void) {
+    for (int v = 0; v < 256; v++) {
+        red_green_level[v] = (uint8_t)((v * 7 + 127) / 255);
+        blue_level[v] = (uint8_t)((v * 3 + 127) / 255);
+    }
+    
+    // 2 bpp: black plus three mutually distant secondaries
+    palette_tables[0].colors[0] = grid_color(0, 0, 0);
+    palette_tables[0].colors[1] = grid_color(7, 7, 0);
+    palette_tables[0].colors[2] = grid_color(7, 0, 3);
+    palette_tables[0].colors[3] = grid_color(0, 7, 3);
+    build_palette(&palette_tables[0], 4);
+    
+    // 4 bpp: red and blue on/off, green in four levels
+    static const int green_levels[4] = { 0, 2, 5, 7 };
+    for (int symbol = 0; symbol < 16; symbol++) {
+        palette_tables[1].colors[symbol] = grid_color((symbol >> 3) * 7, green_levels[(symbol >> 1) & 3],
+                                                      (symbol & 1) * 3);
+    }
+    build_palette(&palette_tables[1], 16);
+    
+    // 8 bpp: the full grid, symbol == cell
+    for (int symbol = 0; symbol < 256; symbol++) {
+        palette_tables[2].colors[symbol] = grid_color(symbol >> 5, (symbol >> 2) & 7, symbol & 3);
+        palette_tables[2].symbols[symbol] = (uint8_t)symbol;
+    }
+}
+
+// === INDEXED BINARY CODEC ===
+// With 4-bit pixels a legacy binary group (start marker, 8 bit pixels, end
+// marker) is exactly 5 bytes and starts on a byte boundary, so encoding is
+// a table copy per byte and decoding reads the bit pixels pairwise.
+#define INDEXED_GROUP_BYTES (VISUALMEM_BYTE_SPACING_X / 2)
+
+static uint8_t indexed_binary_groups[256][INDEXED_GROUP_BYTES];
+static uint8_t indexed_pair_bits[256];  // Pixel pair -> 2 bits (high pixel first)
+
+static void indexed_tables_init(void) {
+    for (int value = 0; value < 256; value++) {
+        uint8_t nibbles[VISUALMEM_BYTE_SPACING_X];
+        nibbles[0] = PIXEL_INDEX_START;
+        for (int bit = 0; bit < VISUALMEM_BITS_PER_BYTE; bit++) {
+            nibbles[1 + bit] = ((value >> (7 - bit)) & 1) ? PIXEL_INDEX_BIT_1 : PIXEL_INDEX_BIT_0;
+        }
+        nibbles[9] = PIXEL_INDEX_END;
+        for (int i = 0; i < INDEXED_GROUP_BYTES; i++) {
+            indexed_binary_groups[value][i] = (uint8_t)((nibbles[2 * i] << 4) | nibbles[2 * i + 1]);
+        }
+        
+        indexed_pair_bits[value] = (uint8_t)((((value >> 4) == PIXEL_INDEX_BIT_1) << 1) |
+                                             ((value & 0x0F) == PIXEL_INDEX_BIT_1));
+    }
+    memset(free_index_row, PIXEL_INDEX_FREE * 0x11, sizeof(free_index_row));
+}
+
+static void encode_indexed_binary_run(uint8_t* row, int col, const uint8_t* src, size_t count) {
+    uint8_t* group = row + (size_t)col * INDEXED_GROUP_BYTES;
+    
+    for (size_t i = 0; i < count; i++, group += INDEXED_GROUP_BYTES) {
+        memcpy(group, indexed_binary_groups[src[i]], INDEXED_GROUP_BYTES);
+    }
+}
+
+static void decode_indexed_binary_run(const uint8_t* row, int col, uint8_t* dst, size_t count) {
+    const uint8_t* group = row + (size_t)col * INDEXED_GROUP_BYTES;
+    
+    for (size_t i = 0; i < count; i++, group += INDEXED_GROUP_BYTES) {
+        // Byte 0 is start marker + bit 7, byte 4 is bit 0 + end marker
+        dst[i] = (uint8_t)((((group[0] & 0x0F) == PIXEL_INDEX_BIT_1) << 7) |
+                           (indexed_pair_bits[group[1]] << 5) |
+                           (indexed_pair_bits[group[2]] << 3) |
+                           (indexed_pair_bits[group[3]] << 1) |
+                           ((group[4] >> 4) == PIXEL_INDEX_BIT_1));
+    }
+}
+
+// === SIMD CODEC KERNELS ===
+// Binary-encoded bytes on the same row occupy contiguous pixel groups, so
+// a run of bytes maps to one contiguous pixel span. Each group is 8 bit
+// pixels, wrapped in start/end marker pixels for the legacy binary layout
+// (markers != 0) or packed back to back for framed binary. Kernels expand
+// or collapse whole spans; the best variant is selected once at runtime.
+typedef void (*encode_span_fn)(const uint8_t* src, size_t count, uint32_t* dst, int markers);
+typedef void (*decode_span_fn)(const uint32_t* src, size_t count, uint8_t* dst, int markers);
+
+static uint8_t bit_reverse_table[256];
+
+static inline size_t group_stride(int markers) {
+    return markers ? VISUALMEM_BYTE_SPACING_X : VISUALMEM_BITS_PER_BYTE;
+}
+
+static void encode_binary_span_scalar(const uint8_t* src, size_t count, uint32_t* dst, int markers) {
+    size_t stride = group_stride(markers);
+    uint32_t* bits = dst + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, dst += stride, bits += stride) {
+        uint8_t byte_value = src[i];
+        for (int bit = 0; bit < VISUALMEM_BITS_PER_BYTE; bit++) {
+            bits[bit] = ((byte_value >> (7 - bit)) & 1) ? VISUALMEM_COLOR_BIT_1 : VISUALMEM_COLOR_BIT_0;
+        }
+        if (markers) {
+            dst[0] = VISUALMEM_COLOR_START;
+            dst[9] = VISUALMEM_COLOR_END;
+        }
+    }
+}
+
+static void decode_binary_span_scalar(const uint32_t* src, size_t count, uint8_t* dst, int markers) {
+    size_t stride = group_stride(markers);
+    const uint32_t* bits = src + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, bits += stride) {
+        uint8_t byte_value = 0;
+        for (int bit = 0; bit < VISUALMEM_BITS_PER_BYTE; bit++) {
+            if ((bits[bit] & 0x00FFFFFF) == (VISUALMEM_COLOR_BIT_1 & 0x00FFFFFF)) {
+                byte_value |= (1 << (7 - bit));
+            }
+        }
+        dst[i] = byte_value;
+    }
+}
+
+#ifdef VISUALMEM_HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static void encode_binary_span_sse2(const uint8_t* src, size_t count, uint32_t* dst, int markers) {
+    const __m128i high_bits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const __m128i low_bits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+    const __m128i black = _mm_set1_epi32((int)VISUALMEM_COLOR_BIT_0);
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    size_t stride = group_stride(markers);
+    uint32_t* bits = dst + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, dst += stride, bits += stride) {
+        // Broadcast the byte, then turn each selected bit into an all-ones lane
+        __m128i value = _mm_set1_epi32(src[i]);
+        __m128i high = _mm_cmpeq_epi32(_mm_and_si128(value, high_bits), high_bits);
+        __m128i low = _mm_cmpeq_epi32(_mm_and_si128(value, low_bits), low_bits);
+        
+        _mm_storeu_si128((__m128i*)bits, _mm_or_si128(black, _mm_and_si128(high, rgb_mask)));
+        _mm_storeu_si128((__m128i*)(bits + 4), _mm_or_si128(black, _mm_and_si128(low, rgb_mask)));
+        if (markers) {
+            dst[0] = VISUALMEM_COLOR_START;
+            dst[9] = VISUALMEM_COLOR_END;
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void decode_binary_span_sse2(const uint32_t* src, size_t count, uint8_t* dst, int markers) {
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    size_t stride = group_stride(markers);
+    const uint32_t* bits = src + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, bits += stride) {
+        __m128i high = _mm_loadu_si128((const __m128i*)bits);
+        __m128i low = _mm_loadu_si128((const __m128i*)(bits + 4));
+        high = _mm_cmpeq_epi32(_mm_and_si128(high, rgb_mask), rgb_mask);
+        low = _mm_cmpeq_epi32(_mm_and_si128(low, rgb_mask), rgb_mask);
+        
+        // Lane order is MSB first, movemask is LSB first
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(high)) |
+                   (_mm_movemask_ps(_mm_castsi128_ps(low)) << 4);
+        dst[i] = bit_reverse_table[mask];
+    }
+}
+
+__attribute__((target("avx2")))
+static void encode_binary_span_avx2(const uint8_t* src, size_t count, uint32_t* dst, int markers) {
+    const __m256i bit_lanes = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m256i black = _mm256_set1_epi32((int)VISUALMEM_COLOR_BIT_0);
+    const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+    size_t stride = group_stride(markers);
+    uint32_t* bits = dst + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, dst += stride, bits += stride) {
+        __m256i value = _mm256_set1_epi32(src[i]);
+        __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(value, bit_lanes), bit_lanes);
         
-        if (ctx->ram_buffer && !ctx->ram_freed) {
-            // During initialization - use RAM buffer
-            uint32_t* ram_buf = (uint32_t*)ctx->ram_buffer;
-            ram_buf[index] = color;
+        _mm256_storeu_si256((__m256i*)bits, _mm256_or_si256(black, _mm256_and_si256(set, rgb_mask)));
+        if (markers) {
+            dst[0] = VISUALMEM_COLOR_START;
+            dst[9] = VISUALMEM_COLOR_END;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void decode_binary_span_avx2(const uint32_t* src, size_t count, uint8_t* dst, int markers) {
+    const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+    size_t stride = group_stride(markers);
+    const uint32_t* bits = src + (markers ? 1 : 0);
+    
+    for (size_t i = 0; i < count; i++, bits += stride) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)bits);
+        pixels = _mm256_cmpeq_epi32(_mm256_and_si256(pixels, rgb_mask), rgb_mask);
+        dst[i] = bit_reverse_table[_mm256_movemask_ps(_mm256_castsi256_ps(pixels))];
+    }
+}
+#endif
+
+static encode_span_fn encode_binary_span = encode_binary_span_scalar;
+static decode_span_fn decode_binary_span = decode_binary_span_scalar;
+static const char* codec_backend_name = "scalar";
+static int codec_dispatch_ready = 0;
+
+// Pick the widest kernels the CPU supports. VISUALMEM_SIMD=scalar|sse2
+// in the environment caps the selection (useful for A/B benchmarks).
+static void codec_dispatch_init(void) {
+    if (codec_dispatch_ready) return;
+    
+    for (int i = 0; i < 256; i++) {
+        uint8_t reversed = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (i & (1 << bit)) reversed |= (uint8_t)(0x80 >> bit);
+        }
+        bit_reverse_table[i] = reversed;
+    }
+    palette_tables_init();
+    indexed_tables_init();
+    
+#ifdef VISUALMEM_HAVE_X86_SIMD
+    const char* limit = getenv("VISUALMEM_SIMD");
+    int allow_avx2 = !limit || strcmp(limit, "avx2") == 0;
+    int allow_sse2 = allow_avx2 || strcmp(limit, "sse2") == 0;
+    
+    __builtin_cpu_init();
+    if (allow_avx2 && __builtin_cpu_supports("avx2")) {
+        encode_binary_span = encode_binary_span_avx2;
+        decode_binary_span = decode_binary_span_avx2;
+        codec_backend_name = "avx2";
+    } else if (allow_sse2 && __builtin_cpu_supports("sse2")) {
+        encode_binary_span = encode_binary_span_sse2;
+        decode_binary_span = decode_binary_span_sse2;
+        codec_backend_name = "sse2";
+    }
+#endif
+    
+    codec_dispatch_ready = 1;
+}
+
+// === ROW SPANS ===
+// A byte range is clipped to the data area once, then walked row by row.
+// Each step yields the payload origin of one row and the byte column the
+// run starts at, so no per-byte position math or bounds checks remain in
+// the codecs. Write cursors materialize sparse tiles as rows are reached.
+typedef struct {
+    visualmem_context_t* ctx;
+    int y;                  // Pixel row of the next run
+    int row_step;           // Pixel rows between consecutive payload rows
+    size_t origin_offset;   // Byte offset of the first payload pixel in a row
+    int for_write;
+    int failed;             // A tile could not be materialized
+    size_t remaining;       // Bytes left in the range
+    int col;                // Byte column of the next byte in its row
+    int bytes_per_row;
+} span_cursor_t;
+
+static size_t span_begin(visualmem_context_t* ctx, span_cursor_t* cursor, size_t byte_index, size_t count,
+                         int for_write) {
+    size_t available = byte_index < ctx->capacity_bytes ? ctx->capacity_bytes - byte_index : 0;
+    if (count > available) count = available;
+    
+    cursor->ctx = ctx;
+    cursor->remaining = count;
+    cursor->bytes_per_row = ctx->bytes_per_row;
+    cursor->row_step = row_spacing(ctx);
+    cursor->for_write = for_write;
+    cursor->failed = 0;
+    cursor->col = 0;
+    cursor->y = 0;
+    if (count == 0) return 0;
+    
+    int x, channel;
+    calculate_byte_position(ctx, byte_index, &x, &cursor->y, &channel);
+    cursor->col = (int)(byte_index % ctx->bytes_per_row);
+    
+    int origin_x = VISUALMEM_MEMORY_START_X;
+    if (ctx->encoding != VISUALMEM_ENCODING_BINARY) origin_x += VISUALMEM_BLOCK_HEADER_PIXELS;
+    cursor->origin_offset = pixel_offset(ctx, origin_x);
+    
+    return count;
+}
+
+static size_t span_next(span_cursor_t* cursor, uint8_t** row_origin, int* col) {
+    if (cursor->remaining == 0) return 0;
+    
+    uint8_t* row = cursor->for_write ? pixel_row_for_write(cursor->ctx, cursor->y)
+                                     : pixel_row(cursor->ctx, cursor->y);
+    if (!row) {
+        cursor->failed = 1;
+        cursor->remaining = 0;
+        return 0;
+    }
+    
+    size_t run = (size_t)(cursor->bytes_per_row - cursor->col);
+    if (run > cursor->remaining) run = cursor->remaining;
+    
+    *row_origin = row + cursor->origin_offset;
+    *col = cursor->col;
+    
+    cursor->remaining -= run;
+    cursor->y += cursor->row_step;
+    cursor->col = 0;
+    return run;
+}
+
+// === RUN CODECS ===
+// Replace one channel of a dense pixel. The other channels may belong to a
+// neighbouring range; with shared set another thread may be writing them.
+static inline void store_channel(uint32_t* pixel, int shift, uint8_t value, int shared) {
+    uint32_t mask = (uint32_t)0xFF << shift;
+    if (!shared) {
+        *pixel = (*pixel & ~mask) | ((uint32_t)value << shift);
+        return;
+    }
+    
+    uint32_t old = __atomic_load_n(pixel, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(pixel, &old, (old & ~mask) | ((uint32_t)value << shift), 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void encode_dense_run(uint32_t* row, int col, int bytes_per_pixel,
+                             const uint8_t* src, size_t count, int shared) {
+    uint32_t* pixel = row + col / bytes_per_pixel;
+    int channel = col % bytes_per_pixel;
+    
+    // Leading partial pixel
+    while (count > 0 && channel != 0) {
+        store_channel(pixel, dense_channel_shift(channel), *src++, shared);
+        count--;
+        if (++channel == bytes_per_pixel) {
+            channel = 0;
+            pixel++;
+        }
+    }
+    
+    // Whole pixels
+    size_t whole = count / bytes_per_pixel;
+    if (bytes_per_pixel == 4) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(pixel, src, whole * 4);
+#else
+        for (size_t i = 0; i < whole; i++) {
+            const uint8_t* b = src + i * 4;
+            pixel[i] = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+        }
+#endif
+    } else {
+        for (size_t i = 0; i < whole; i++) {
+            const uint8_t* b = src + i * 3;
+            pixel[i] = 0xFF000000 | b[0] | (b[1] << 8) | (b[2] << 16);
+        }
+    }
+    pixel += whole;
+    src += whole * bytes_per_pixel;
+    count -= whole * bytes_per_pixel;
+    
+    // Trailing partial pixel
+    for (channel = 0; count > 0; count--, channel++) {
+        store_channel(pixel, dense_channel_shift(channel), *src++, shared);
+    }
+}
+
+static void decode_dense_run(const uint32_t* row, int col, int bytes_per_pixel,
+                             uint8_t* dst, size_t count) {
+    const uint32_t* pixel = row + col / bytes_per_pixel;
+    int channel = col % bytes_per_pixel;
+    
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = (uint8_t)(__atomic_load_n(pixel, __ATOMIC_RELAXED) >> dense_channel_shift(channel));
+        if (++channel == bytes_per_pixel) {
+            channel = 0;
+            pixel++;
+        }
+    }
+}
+
+// Palette symbols are packed MSB first: the first pixel of a byte holds
+// its top bits.
+static void encode_palette_run(uint32_t* row, int col, int bits, const palette_table_t* palette,
+                               const uint8_t* src, size_t count) {
+    int pixels_per_byte = 8 / bits;
+    uint8_t mask = (uint8_t)((1 << bits) - 1);
+    uint32_t* pixel = row + (size_t)col * pixels_per_byte;
+    
+    for (size_t i = 0; i < count; i++) {
+        for (int shift = 8 - bits; shift >= 0; shift -= bits) {
+            *pixel++ = palette->colors[(src[i] >> shift) & mask];
+        }
+    }
+}
+
+static void decode_palette_run(const uint32_t* row, int col, int bits, const palette_table_t* palette,
+                               uint8_t* dst, size_t count) {
+    int pixels_per_byte = 8 / bits;
+    const uint32_t* pixel = row + (size_t)col * pixels_per_byte;
+    
+    for (size_t i = 0; i < count; i++) {
+        uint8_t byte_value = 0;
+        for (int k = 0; k < pixels_per_byte; k++) {
+            byte_value = (uint8_t)((byte_value << bits) | palette->symbols[grid_cell(*pixel++)]);
+        }
+        dst[i] = byte_value;
+    }
+}
+
+static void encode_run(visualmem_context_t* ctx, uint8_t* row_bytes, int col, const uint8_t* src, size_t count) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    uint32_t* row = (uint32_t*)row_bytes;
+    
+    if (ctx->pixel_bits == 4) {
+        encode_indexed_binary_run(row_bytes, col, src, count);
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY) {
+        encode_binary_span(src, count, row + (size_t)col * VISUALMEM_BYTE_SPACING_X, 1);
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) {
+        encode_binary_span(src, count, row + (size_t)col * VISUALMEM_BITS_PER_BYTE, 0);
+    } else if (palette_bits > 0) {
+        encode_palette_run(row, col, palette_bits, palette_for(ctx->encoding), src, count);
+    } else {
+        encode_dense_run(row, col, encoding_bytes_per_pixel(ctx->encoding), src, count, ctx->sync != NULL);
+    }
+}
+
+static void decode_run(visualmem_context_t* ctx, const uint8_t* row_bytes, int col, uint8_t* dst, size_t count) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    const uint32_t* row = (const uint32_t*)row_bytes;
+    
+    if (ctx->pixel_bits == 4) {
+        decode_indexed_binary_run(row_bytes, col, dst, count);
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY) {
+        decode_binary_span(row + (size_t)col * VISUALMEM_BYTE_SPACING_X, count, dst, 1);
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) {
+        decode_binary_span(row + (size_t)col * VISUALMEM_BITS_PER_BYTE, count, dst, 0);
+    } else if (palette_bits > 0) {
+        decode_palette_run(row, col, palette_bits, palette_for(ctx->encoding), dst, count);
+    } else {
+        decode_dense_run(row, col, encoding_bytes_per_pixel(ctx->encoding), dst, count);
+    }
+}
+
+// === BULK ENCODING/DECODING ===
+static int encode_pixel_bytes(visualmem_context_t* ctx, size_t byte_index, const uint8_t* src, size_t count) {
+    span_cursor_t cursor;
+    uint8_t* row;
+    int col;
+    size_t run;
+    
+    span_begin(ctx, &cursor, byte_index, count, 1);
+    while ((run = span_next(&cursor, &row, &col)) > 0) {
+        encode_run(ctx, row, col, src, run);
+        src += run;
+    }
+    
+    return cursor.failed ? VISUALMEM_ERROR_OUT_OF_MEMORY : VISUALMEM_SUCCESS;
+}
+
+static void decode_pixel_bytes(visualmem_context_t* ctx, size_t byte_index, uint8_t* dst, size_t count) {
+    span_cursor_t cursor;
+    uint8_t* row;
+    int col;
+    size_t run;
+    
+    size_t available = span_begin(ctx, &cursor, byte_index, count, 0);
+    if (available < count) {
+        memset(dst + available, 0, count - available); // Out of bounds reads as zero
+    }
+    
+    while ((run = span_next(&cursor, &row, &col)) > 0) {
+        decode_run(ctx, row, col, dst, run);
+        dst += run;
+    }
+}
+
+// Stored pixel bytes behind each payload byte when every byte owns whole
+// pixels; 0 for dense encodings, whose bytes are channels of shared pixels
+static size_t stored_bytes_per_byte(const visualmem_context_t* ctx) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    
+    if (ctx->pixel_bits == 4) return INDEXED_GROUP_BYTES;
+    if (ctx->encoding == VISUALMEM_ENCODING_BINARY) return VISUALMEM_BYTE_SPACING_X * sizeof(uint32_t);
+    if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) return VISUALMEM_BITS_PER_BYTE * sizeof(uint32_t);
+    if (palette_bits > 0) return (size_t)(8 / palette_bits) * sizeof(uint32_t);
+    return 0;
+}
+
+// Dense bytes one channel at a time, for runs that are not pixel aligned
+static void copy_dense_channels(uint8_t* dst_row, int dst_col, const uint8_t* src_row, int src_col,
+                                int bytes_per_pixel, size_t count, int shared) {
+    uint8_t chunk[64];
+    while (count > 0) {
+        size_t run = count < sizeof(chunk) ? count : sizeof(chunk);
+        decode_dense_run((const uint32_t*)src_row, src_col, bytes_per_pixel, chunk, run);
+        encode_dense_run((uint32_t*)dst_row, dst_col, bytes_per_pixel, chunk, run, shared);
+        src_col += (int)run;
+        dst_col += (int)run;
+        count -= run;
+    }
+}
+
+// Copy a run of encoded bytes to another place without decoding them
+static void copy_run(visualmem_context_t* ctx, uint8_t* dst_row, int dst_col,
+                     const uint8_t* src_row, int src_col, size_t count) {
+    size_t stored = stored_bytes_per_byte(ctx);
+    if (stored > 0) {
+        memcpy(dst_row + dst_col * stored, src_row + src_col * stored, count * stored);
+        return;
+    }
+    
+    // Dense: whole pixels copy straight across when both runs share a channel phase
+    int bytes_per_pixel = encoding_bytes_per_pixel(ctx->encoding);
+    int shared = ctx->sync != NULL;
+    if (src_col % bytes_per_pixel != dst_col % bytes_per_pixel) {
+        copy_dense_channels(dst_row, dst_col, src_row, src_col, bytes_per_pixel, count, shared);
+        return;
+    }
+    
+    size_t head = (size_t)((bytes_per_pixel - src_col % bytes_per_pixel) % bytes_per_pixel);
+    if (head > count) head = count;
+    copy_dense_channels(dst_row, dst_col, src_row, src_col, bytes_per_pixel, head, shared);
+    src_col += (int)head;
+    dst_col += (int)head;
+    count -= head;
+    
+    size_t whole = count / bytes_per_pixel;
+    memcpy((uint32_t*)dst_row + dst_col / bytes_per_pixel,
+           (const uint32_t*)src_row + src_col / bytes_per_pixel, whole * sizeof(uint32_t));
+    
+    size_t done = whole * bytes_per_pixel;
+    copy_dense_channels(dst_row, dst_col + (int)done, src_row, src_col + (int)done,
+                        bytes_per_pixel, count - done, shared);
+}
+
+// Move encoded bytes between two disjoint ranges: both ranges are walked
+// as row spans and each overlapping piece is copied pixel for pixel.
+static int copy_pixel_bytes(visualmem_context_t* ctx, size_t dst_index, size_t src_index, size_t count) {
+    span_cursor_t from, to;
+    uint8_t *src_row = NULL, *dst_row = NULL;
+    int src_col = 0, dst_col = 0;
+    size_t src_run = 0, dst_run = 0;
+    
+    count = span_begin(ctx, &from, src_index, count, 0);
+    span_begin(ctx, &to, dst_index, count, 1);
+    
+    for (;;) {
+        if (src_run == 0 && (src_run = span_next(&from, &src_row, &src_col)) == 0) break;
+        if (dst_run == 0 && (dst_run = span_next(&to, &dst_row, &dst_col)) == 0) break;
+        
+        size_t run = src_run < dst_run ? src_run : dst_run;
+        copy_run(ctx, dst_row, dst_col, src_row, src_col, run);
+        src_col += (int)run;
+        dst_col += (int)run;
+        src_run -= run;
+        dst_run -= run;
+    }
+    
+    return to.failed ? VISUALMEM_ERROR_OUT_OF_MEMORY : VISUALMEM_SUCCESS;
+}
+
+// Encode one byte value across a range. The value is encoded once per run
+// and its pixels are replicated with doubling copies (whole-pixel
+// encodings) or a single pixel fill (dense), so the codec never sees the
+// bulk of the range.
+static int fill_pixel_bytes(visualmem_context_t* ctx, size_t byte_index, uint8_t value, size_t count) {
+    size_t stored = stored_bytes_per_byte(ctx);
+    int bytes_per_pixel = encoding_bytes_per_pixel(ctx->encoding);
+    int shared = ctx->sync != NULL;
+    uint8_t pattern[4];
+    uint32_t dense_pixel = 0;
+    memset(pattern, value, sizeof(pattern));
+    if (stored == 0) {
+        encode_dense_run(&dense_pixel, 0, bytes_per_pixel, pattern, (size_t)bytes_per_pixel, 0);
+    }
+    
+    span_cursor_t cursor;
+    uint8_t* row;
+    int col;
+    size_t run;
+    
+    span_begin(ctx, &cursor, byte_index, count, 1);
+    while ((run = span_next(&cursor, &row, &col)) > 0) {
+        if (stored > 0) {
+            uint8_t* span = row + col * stored;
+            size_t total = run * stored;
+            encode_run(ctx, row, col, pattern, 1);
+            for (size_t filled = stored; filled < total; filled *= 2) {
+                memcpy(span + filled, span, filled < total - filled ? filled : total - filled);
+            }
+            continue;
+        }
+        
+        // Dense: partial pixels at the ends keep their neighbours' channels
+        size_t head = (size_t)((bytes_per_pixel - col % bytes_per_pixel) % bytes_per_pixel);
+        if (head > run) head = run;
+        encode_dense_run((uint32_t*)row, col, bytes_per_pixel, pattern, head, shared);
+        col += (int)head;
+        run -= head;
+        
+        size_t whole = run / bytes_per_pixel;
+        fill_pixels((uint32_t*)row + col / bytes_per_pixel, whole, dense_pixel);
+        encode_dense_run((uint32_t*)row, col + (int)(whole * bytes_per_pixel), bytes_per_pixel,
+                         pattern, run - whole * bytes_per_pixel, shared);
+    }
+    
+    return cursor.failed ? VISUALMEM_ERROR_OUT_OF_MEMORY : VISUALMEM_SUCCESS;
+}
+
+// === LAZY PIXELS ===
+// With lazy pixels on (simulate mode only), the raw store holds every
+// payload byte and is authoritative: writes and reads are plain copies
+// and only mark whole payload rows stale. Stale rows are encoded into
+// pixels when something observes them (display, pixel reads, the
+// autonomous transition).
+static size_t payload_rows(const visualmem_context_t* ctx) {
+    return ctx->bytes_per_row > 0 ? ctx->capacity_bytes / ctx->bytes_per_row : 0;
+}
+
+static size_t clip_to_capacity(const visualmem_context_t* ctx, size_t byte_index, size_t count) {
+    size_t available = byte_index < ctx->capacity_bytes ? ctx->capacity_bytes - byte_index : 0;
+    return count < available ? count : available;
+}
+
+static void mark_rows_stale(visualmem_context_t* ctx, size_t byte_index, size_t count) {
+    if (count == 0) return;
+    
+    size_t last = (byte_index + count - 1) / ctx->bytes_per_row;
+    for (size_t row = byte_index / ctx->bytes_per_row; row <= last; row++) {
+        __atomic_fetch_or(&ctx->stale_rows[row / 64], 1ULL << (row % 64), __ATOMIC_RELAXED);
+    }
+}
+
+// Encode every stale row into pixels. A row's bit is taken before it is
+// encoded, so a concurrent write to the row marks it stale again.
+static int materialize_pixels(visualmem_context_t* ctx) {
+    if (!ctx->raw_store) return VISUALMEM_SUCCESS;
+    
+    size_t rows = payload_rows(ctx);
+    for (size_t word = 0; word < (rows + 63) / 64; word++) {
+        uint64_t stale;
+        while ((stale = __atomic_load_n(&ctx->stale_rows[word], __ATOMIC_RELAXED)) != 0) {
+            uint64_t bit = stale & -stale;
+            size_t row = word * 64 + __builtin_ctzll(stale);
+            size_t offset = row * ctx->bytes_per_row;
+            __atomic_fetch_and(&ctx->stale_rows[word], ~bit, __ATOMIC_ACQUIRE);
+            int result = encode_pixel_bytes(ctx, offset, ctx->raw_store + offset, ctx->bytes_per_row);
+            if (result != VISUALMEM_SUCCESS) {
+                __atomic_fetch_or(&ctx->stale_rows[word], bit, __ATOMIC_RELAXED);
+                return result;
+            }
+        }
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+static int encode_bytes(visualmem_context_t* ctx, size_t byte_index, const uint8_t* src, size_t count) {
+    if (!ctx->raw_store) {
+        return encode_pixel_bytes(ctx, byte_index, src, count);
+    }
+    
+    count = clip_to_capacity(ctx, byte_index, count);
+    memcpy(ctx->raw_store + byte_index, src, count);
+    mark_rows_stale(ctx, byte_index, count);
+    return VISUALMEM_SUCCESS;
+}
+
+static void decode_bytes(visualmem_context_t* ctx, size_t byte_index, uint8_t* dst, size_t count) {
+    if (!ctx->raw_store) {
+        decode_pixel_bytes(ctx, byte_index, dst, count);
+        return;
+    }
+    
+    size_t available = clip_to_capacity(ctx, byte_index, count);
+    memcpy(dst, ctx->raw_store + byte_index, available);
+    memset(dst + available, 0, count - available); // Out of bounds reads as zero
+}
+
+static int fill_bytes(visualmem_context_t* ctx, size_t byte_index, uint8_t value, size_t count) {
+    if (!ctx->raw_store) {
+        return fill_pixel_bytes(ctx, byte_index, value, count);
+    }
+    
+    count = clip_to_capacity(ctx, byte_index, count);
+    memset(ctx->raw_store + byte_index, value, count);
+    mark_rows_stale(ctx, byte_index, count);
+    return VISUALMEM_SUCCESS;
+}
+
+// Move payload bytes between disjoint ranges, staying in the encoded form
+static int copy_bytes(visualmem_context_t* ctx, size_t dst_index, size_t src_index, size_t count) {
+    if (!ctx->raw_store) {
+        return copy_pixel_bytes(ctx, dst_index, src_index, count);
+    }
+    
+    count = clip_to_capacity(ctx, src_index, count);
+    count = clip_to_capacity(ctx, dst_index, count);
+    memcpy(ctx->raw_store + dst_index, ctx->raw_store + src_index, count);
+    mark_rows_stale(ctx, dst_index, count);
+    return VISUALMEM_SUCCESS;
+}
+
+// === ADDRESS SPACE ALLOCATOR ===
+// Binary buddy allocator over the payload bytes after the context header.
+// Blocks are VISUALMEM_ALLOC_UNIT << order bytes and aligned to their own
+// size relative to the base, so a block's buddy is one flipped bit of its
+// unit index. Alloc pops the smallest non-empty order (found with one bit
+// scan) and splits it down; free merges with free buddies back up. Both
+// are O(log n) and placements never overlap.
+#define BLOCK_FREE 0x80
+#define BLOCK_INTERIOR 0x7F     // Unit inside a block, not its head
+
+static void buddy_push(visualmem_buddy_t* buddy, int32_t unit, int order) {
+    buddy->block_state[unit] = (uint8_t)(BLOCK_FREE | order);
+    buddy->free_prev[unit] = -1;
+    buddy->free_next[unit] = buddy->free_head[order];
+    if (buddy->free_head[order] >= 0) {
+        buddy->free_prev[buddy->free_head[order]] = unit;
+    }
+    buddy->free_head[order] = unit;
+    buddy->free_orders |= 1u << order;
+    buddy->free_units += 1 << order;
+}
+
+static void buddy_unlink(visualmem_buddy_t* buddy, int32_t unit, int order) {
+    int32_t prev = buddy->free_prev[unit];
+    int32_t next = buddy->free_next[unit];
+    
+    if (prev >= 0) {
+        buddy->free_next[prev] = next;
+    } else {
+        buddy->free_head[order] = next;
+    }
+    if (next >= 0) {
+        buddy->free_prev[next] = prev;
+    }
+    if (buddy->free_head[order] < 0) {
+        buddy->free_orders &= ~(1u << order);
+    }
+    buddy->free_units -= 1 << order;
+}
+
+static void buddy_release(visualmem_buddy_t* buddy) {
+    free(buddy->block_state);
+    free(buddy->free_next);
+    free(buddy->free_prev);
+    free(buddy->dirty);
+    buddy->block_state = NULL;
+    buddy->free_next = NULL;
+    buddy->free_prev = NULL;
+    buddy->dirty = NULL;
+    buddy->unit_count = 0;
+    buddy->free_units = 0;
+    buddy->free_orders = 0;
+    buddy->dirty_units = 0;
+}
+
+static int buddy_init(visualmem_buddy_t* buddy, size_t base, size_t limit) {
+    memset(buddy, 0, sizeof(*buddy));
+    for (int order = 0; order <= VISUALMEM_ALLOC_MAX_ORDER; order++) {
+        buddy->free_head[order] = -1;
+    }
+    buddy->base = base;
+    
+    size_t units = limit > base ? (limit - base) / VISUALMEM_ALLOC_UNIT : 0;
+    if (units == 0) return VISUALMEM_SUCCESS;
+    
+    buddy->unit_count = (int)units;
+    buddy->block_state = malloc(units);
+    buddy->free_next = malloc(units * sizeof(int32_t));
+    buddy->free_prev = malloc(units * sizeof(int32_t));
+    buddy->dirty = calloc(units, 1);
+    if (!buddy->block_state || !buddy->free_next || !buddy->free_prev || !buddy->dirty) {
+        buddy_release(buddy);
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    memset(buddy->block_state, BLOCK_INTERIOR, units);
+    
+    // Cover the area with the largest aligned blocks that fit
+    int32_t unit = 0;
+    while (unit < buddy->unit_count) {
+        int order = 0;
+        while (order < VISUALMEM_ALLOC_MAX_ORDER &&
+               (unit & ((1 << (order + 1)) - 1)) == 0 &&
+               unit + (1 << (order + 1)) <= buddy->unit_count) {
+            order++;
+        }
+        buddy_push(buddy, unit, order);
+        unit += 1 << order;
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+static int32_t buddy_unit(const visualmem_buddy_t* buddy, size_t byte_index) {
+    return (int32_t)((byte_index - buddy->base) / VISUALMEM_ALLOC_UNIT);
+}
+
+// Allocate a block of the given order out of the free block at unit
+static void buddy_take(visualmem_buddy_t* buddy, int32_t unit, int order) {
+    int found = buddy->block_state[unit] & ~BLOCK_FREE;
+    buddy_unlink(buddy, unit, found);
+    
+    // Split down to the requested order, freeing the upper halves
+    while (found > order) {
+        found--;
+        buddy_push(buddy, unit + (1 << found), found);
+    }
+    
+    buddy->block_state[unit] = (uint8_t)order;
+}
+
+// Smallest order holding size bytes (VISUALMEM_ALLOC_MAX_ORDER + 1 if none)
+static int buddy_order(size_t size) {
+    size_t units = (size + VISUALMEM_ALLOC_UNIT - 1) / VISUALMEM_ALLOC_UNIT;
+    int order = 0;
+    while (order <= VISUALMEM_ALLOC_MAX_ORDER && ((size_t)1 << order) < units) {
+        order++;
+    }
+    return order;
+}
+
+static int buddy_alloc(visualmem_buddy_t* buddy, size_t size, size_t* byte_index) {
+    int order = buddy_order(size);
+    if (order > VISUALMEM_ALLOC_MAX_ORDER) return 0;
+    
+    uint32_t candidates = buddy->free_orders & ~((1u << order) - 1);
+    if (!candidates) return 0;
+    
+    int found = __builtin_ctz(candidates);
+    int32_t unit = buddy->free_head[found];
+    buddy_take(buddy, unit, order);
+    *byte_index = buddy->base + (size_t)unit * VISUALMEM_ALLOC_UNIT;
+    return 1;
+}
+
+static void buddy_free(visualmem_buddy_t* buddy, size_t byte_index) {
+    int32_t unit = (int32_t)((byte_index - buddy->base) / VISUALMEM_ALLOC_UNIT);
+    int order = buddy->block_state[unit];
+    
+    // Coalesce with free buddies of the same order
+    while (order < VISUALMEM_ALLOC_MAX_ORDER) {
+        int32_t mate = unit ^ (1 << order);
+        if (mate + (1 << order) > buddy->unit_count ||
+            buddy->block_state[mate] != (BLOCK_FREE | order)) {
+            break;
+        }
+        buddy_unlink(buddy, mate, order);
+        buddy->block_state[unit > mate ? unit : mate] = BLOCK_INTERIOR;
+        if (mate < unit) unit = mate;
+        order++;
+    }
+    
+    buddy_push(buddy, unit, order);
+}
+
+// Resize an allocated block where it is: shrinking frees its upper halves,
+// growing absorbs the free buddies above it. 0 when it cannot grow in place.
+static int buddy_resize(visualmem_buddy_t* buddy, size_t byte_index, size_t size) {
+    int32_t unit = (int32_t)((byte_index - buddy->base) / VISUALMEM_ALLOC_UNIT);
+    int order = buddy->block_state[unit];
+    int wanted = buddy_order(size);
+    if (wanted > VISUALMEM_ALLOC_MAX_ORDER) return 0;
+    
+    // Growing needs every buddy up to the wanted order to be a free upper half
+    for (int k = order; k < wanted; k++) {
+        int32_t mate = unit + (1 << k);
+        if ((unit & ((1 << (k + 1)) - 1)) != 0 || mate + (1 << k) > buddy->unit_count ||
+            buddy->block_state[mate] != (BLOCK_FREE | k)) {
+            return 0;
+        }
+    }
+    for (int k = order; k < wanted; k++) {
+        int32_t mate = unit + (1 << k);
+        buddy_unlink(buddy, mate, k);
+        buddy->block_state[mate] = BLOCK_INTERIOR;
+    }
+    
+    // The upper halves of a shrinking block have an allocated buddy: no merging
+    while (order > wanted) {
+        order--;
+        buddy_push(buddy, unit + (1 << order), order);
+    }
+    
+    buddy->block_state[unit] = (uint8_t)wanted;
+    return 1;
+}
+
+// === DEFERRED CLEARING ===
+// Freeing a block only flags its units dirty, so free costs a flag per
+// VISUALMEM_ALLOC_UNIT bytes instead of re-encoding every byte. The zeroes
+// are written when the space is handed out again (claim_bytes) or ahead of
+// time by visualmem_scrub, one fill per run of dirty units. A unit holding
+// live bytes is never dirty.
+static void mark_dirty(visualmem_buddy_t* buddy, size_t byte_index, size_t size) {
+    int32_t end = buddy_unit(buddy, byte_index + size - 1) + 1;
+    for (int32_t unit = buddy_unit(buddy, byte_index); unit < end; unit++) {
+        buddy->dirty_units += !buddy->dirty[unit];
+        buddy->dirty[unit] = 1;
+    }
+}
+
+// Zero the dirty units in [first, end); returns the bytes written
+static size_t clear_dirty_units(visualmem_context_t* ctx, int32_t first, int32_t end) {
+    visualmem_buddy_t* buddy = &ctx->buddy;
+    size_t cleared = 0;
+    int32_t unit = first;
+    
+    while (unit < end) {
+        if (!buddy->dirty[unit]) {
+            unit++;
+            continue;
+        }
+        int32_t run = unit;
+        while (unit < end && buddy->dirty[unit]) {
+            buddy->dirty[unit++] = 0;
+        }
+        buddy->dirty_units -= unit - run;
+        
+        size_t bytes = (size_t)(unit - run) * VISUALMEM_ALLOC_UNIT;
+        fill_bytes(ctx, buddy->base + (size_t)run * VISUALMEM_ALLOC_UNIT, 0, bytes);
+        cleared += bytes;
+    }
+    
+    return cleared;
+}
+
+// Make bytes that are being handed out read as zero
+static void claim_bytes(visualmem_context_t* ctx, size_t byte_index, size_t size) {
+    if (ctx->buddy.dirty_units == 0 || size == 0) return;
+    clear_dirty_units(ctx, buddy_unit(&ctx->buddy, byte_index),
+                      buddy_unit(&ctx->buddy, byte_index + size - 1) + 1);
+}
+
+// Hand a block whose first size bytes may hold data back, without clearing them
+static void return_block(visualmem_context_t* ctx, size_t byte_index, size_t size) {
+    if (size > 0) mark_dirty(&ctx->buddy, byte_index, size);
+    buddy_free(&ctx->buddy, byte_index);
+}
+
+// Give up a block; in thread-safe mode data calls may still be using it,
+// so it is only returned once they finish
+static void release_block(visualmem_context_t* ctx, size_t byte_index, size_t size) {
+    if (ctx->sync) {
+        if (retire(ctx->sync, NULL, byte_index, size)) return;
+        wait_for_readers(ctx->sync); // No room to queue it: wait instead
+    }
+    return_block(ctx, byte_index, size);
+}
+
+// === RECLAMATION ===
+// Retired entries are released by the writer, at the end of each allocator
+// call and whenever the buddy allocator runs out of space.
+static void reclaim_retired(visualmem_context_t* ctx, int wait) {
+    struct visualmem_sync* sync = ctx->sync;
+    if (sync->retired_count == 0) return;
+    if (wait) wait_for_readers(sync);
+    
+    uint64_t oldest = oldest_reader_epoch(sync);
+    int kept = 0;
+    for (int i = 0; i < sync->retired_count; i++) {
+        retired_t* entry = &sync->retired[i];
+        if (entry->stamp >= oldest) {
+            sync->retired[kept++] = *entry;
+        } else if (entry->memory) {
+            free(entry->memory);
+        } else {
+            return_block(ctx, entry->byte_index, entry->size);
+        }
+    }
+    sync->retired_count = kept;
+}
+
+// buddy_alloc, waiting for readers of retired blocks when space runs out
+static int place_block(visualmem_context_t* ctx, size_t size, size_t* byte_index) {
+    if (buddy_alloc(&ctx->buddy, size, byte_index)) return 1;
+    if (!ctx->sync || ctx->sync->retired_count == 0) return 0;
+    
+    reclaim_retired(ctx, 1);
+    return buddy_alloc(&ctx->buddy, size, byte_index);
+}
+
+// Allocator calls take the writer lock; calls made from inside one nest
+static void writer_lock(visualmem_context_t* ctx) {
+    struct visualmem_sync* sync = ctx->sync;
+    if (!sync) return;
+    
+    if (__atomic_load_n(&sync->writer_owner, __ATOMIC_RELAXED) == &thread_token) {
+        sync->writer_depth++;
+        return;
+    }
+    pthread_mutex_lock(&sync->writer);
+    __atomic_store_n(&sync->writer_owner, &thread_token, __ATOMIC_RELAXED);
+    sync->writer_depth = 1;
+}
+
+static void writer_unlock(visualmem_context_t* ctx) {
+    struct visualmem_sync* sync = ctx->sync;
+    if (!sync || --sync->writer_depth > 0) return;
+    
+    reclaim_retired(ctx, 0);
+    __atomic_store_n(&sync->writer_owner, NULL, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&sync->writer);
+}
+
+static inline void count_operation(visualmem_context_t* ctx) {
+    if (ctx->sync) {
+        __atomic_fetch_add(&ctx->operations_count, 1, __ATOMIC_RELAXED);
+    } else {
+        ctx->operations_count++;
+    }
+}
+
+// === SMALL OBJECT SLABS ===
+// Each slab is one buddy block holding VISUALMEM_SLAB_OBJECTS objects of a
+// single size class, with a free bitmap word. Per object the slab keeps only
+// a generation and the requested size; no allocation table slot is used.
+// Slabs with free objects sit on their class's partial list, and a slab
+// whose last object is freed hands its block back to the buddy allocator.
+static int slab_class(size_t size) {
+    int size_class = 0;
+    while (((size_t)VISUALMEM_SLAB_MIN_OBJECT << size_class) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+static void slab_list_push(visualmem_slab_cache_t* cache, int32_t index) {
+    visualmem_slab_t* slab = &cache->slabs[index];
+    int32_t head = cache->partial_head[slab->size_class];
+    slab->prev = -1;
+    slab->next = head;
+    if (head >= 0) cache->slabs[head].prev = index;
+    cache->partial_head[slab->size_class] = index;
+}
+
+static void slab_list_unlink(visualmem_slab_cache_t* cache, int32_t index) {
+    visualmem_slab_t* slab = &cache->slabs[index];
+    if (slab->prev >= 0) {
+        cache->slabs[slab->prev].next = slab->next;
+    } else {
+        cache->partial_head[slab->size_class] = slab->next;
+    }
+    if (slab->next >= 0) cache->slabs[slab->next].prev = slab->prev;
+}
+
+static void slab_cache_init(visualmem_slab_cache_t* cache) {
+    memset(cache, 0, sizeof(*cache));
+    for (int c = 0; c < VISUALMEM_SLAB_CLASSES; c++) {
+        cache->partial_head[c] = -1;
+    }
+    cache->free_record = -1;
+}
+
+static void slab_cache_release(visualmem_slab_cache_t* cache) {
+    free(cache->slabs);
+    slab_cache_init(cache);
+}
+
+// New slab for a size class, already on its partial list; -1 on failure
+static int32_t slab_create(visualmem_context_t* ctx, int size_class) {
+    visualmem_slab_cache_t* cache = &ctx->slabs;
+    int32_t index = cache->free_record;
+    
+    if (index < 0) {
+        if ((uintptr_t)cache->count >= (HANDLE_SLAB_FLAG >> SLAB_OBJECT_BITS)) return -1;
+        if (cache->count == cache->capacity) {
+            int new_capacity = cache->capacity ? cache->capacity * 2 : 16;
+            visualmem_slab_t* old = cache->slabs;
+            visualmem_slab_t* grown = grow_records(ctx, old, sizeof(*grown) * (size_t)cache->capacity,
+                                                   sizeof(*grown) * (size_t)new_capacity);
+            if (!grown) return -1;
+            __atomic_store_n(&cache->slabs, grown, __ATOMIC_RELEASE);
+            retire_records(ctx, old);
+            cache->capacity = new_capacity;
+        }
+        index = cache->count;
+        memset(&cache->slabs[index], 0, sizeof(cache->slabs[index]));
+    }
+    
+    size_t block_bytes = ((size_t)VISUALMEM_SLAB_MIN_OBJECT << size_class) * VISUALMEM_SLAB_OBJECTS;
+    size_t byte_index;
+    if (!place_block(ctx, block_bytes, &byte_index)) return -1;
+    claim_bytes(ctx, byte_index, block_bytes);
+    
+    // Commit the record only once the block is secured
+    if (index == cache->free_record) {
+        cache->free_record = cache->slabs[index].next;
+    } else {
+        __atomic_store_n(&cache->count, cache->count + 1, __ATOMIC_RELEASE);
+    }
+    
+    visualmem_slab_t* slab = &cache->slabs[index];
+    __atomic_store_n(&slab->byte_index, byte_index, __ATOMIC_RELAXED);
+    __atomic_store_n(&slab->free_mask, ~slab->retired_mask, __ATOMIC_RELAXED);
+    __atomic_store_n(&slab->size_class, (uint8_t)size_class, __ATOMIC_RELAXED);
+    __atomic_store_n(&slab->in_use, 1, __ATOMIC_RELEASE);
+    slab_list_push(cache, index);
+    
+    return index;
+}
+
+static void* slab_alloc(visualmem_context_t* ctx, size_t size) {
+    visualmem_slab_cache_t* cache = &ctx->slabs;
+    int size_class = slab_class(size);
+    
+    int32_t index = cache->partial_head[size_class];
+    if (index < 0) {
+        index = slab_create(ctx, size_class);
+        if (index < 0) return NULL;
+    }
+    
+    // The size is in place before the object's free bit clears
+    visualmem_slab_t* slab = &cache->slabs[index];
+    int object = __builtin_ctzll(slab->free_mask);
+    __atomic_store_n(&slab->size[object], (uint8_t)(size - 1), __ATOMIC_RELAXED);
+    __atomic_store_n(&slab->free_mask, slab->free_mask & (slab->free_mask - 1), __ATOMIC_RELEASE);
+    if (!slab->free_mask) {
+        slab_list_unlink(cache, index); // Full
+    }
+    
+    return make_slab_handle(index, object, slab->generation[object]);
+}
+
+// Payload range of a live slab object; 0 for unknown or stale handles.
+// Safe without the writer lock: the count is loaded before the records.
+static int slab_lookup(const visualmem_slab_cache_t* cache, void* visual_addr,
+                       size_t* byte_index, size_t* size) {
+    uintptr_t field = ((uintptr_t)visual_addr & HANDLE_SLOT_MASK) & ~HANDLE_SLAB_FLAG;
+    uintptr_t index = field >> SLAB_OBJECT_BITS;
+    int object = (int)(field & (VISUALMEM_SLAB_OBJECTS - 1));
+    if (index >= (uintptr_t)__atomic_load_n(&cache->count, __ATOMIC_ACQUIRE)) return 0;
+    
+    const visualmem_slab_t* slab = &__atomic_load_n(&cache->slabs, __ATOMIC_ACQUIRE)[index];
+    if (!__atomic_load_n(&slab->in_use, __ATOMIC_ACQUIRE) ||
+        (__atomic_load_n(&slab->free_mask, __ATOMIC_ACQUIRE) >> object) & 1) {
+        return 0;
+    }
+    uint32_t generation = __atomic_load_n(&slab->generation[object], __ATOMIC_ACQUIRE);
+    if (make_slab_handle((int32_t)index, object, generation) != visual_addr ||
+        (__atomic_load_n(&slab->retired_mask, __ATOMIC_ACQUIRE) >> object) & 1) {
+        return 0;
+    }
+    
+    int size_class = __atomic_load_n(&slab->size_class, __ATOMIC_RELAXED);
+    *byte_index = __atomic_load_n(&slab->byte_index, __ATOMIC_RELAXED) +
+                  ((size_t)object * VISUALMEM_SLAB_MIN_OBJECT << size_class);
+    *size = (size_t)__atomic_load_n(&slab->size[object], __ATOMIC_RELAXED) + 1;
+    return 1;
+}
+
+// Release a slab object already validated by slab_lookup
+static void slab_free(visualmem_context_t* ctx, void* visual_addr) {
+    visualmem_slab_cache_t* cache = &ctx->slabs;
+    uintptr_t field = ((uintptr_t)visual_addr & HANDLE_SLOT_MASK) & ~HANDLE_SLAB_FLAG;
+    int32_t index = (int32_t)(field >> SLAB_OBJECT_BITS);
+    int object = (int)(field & (VISUALMEM_SLAB_OBJECTS - 1));
+    visualmem_slab_t* slab = &cache->slabs[index];
+    
+    // As for table slots, the new generation goes out before the free bit.
+    // Once the handle's generation bits would wrap, an older handle could
+    // match again, so the object is retired instead; its retired bit goes
+    // out before the wrapped generation
+    int was_full = slab->free_mask == 0;
+    uint64_t bit = (uint64_t)1 << object;
+    uint32_t generation = slab->generation[object] + 1;
+    int retired = (generation & HANDLE_GENERATION_MASK) == 0;
+    if (retired) {
+        __atomic_store_n(&slab->retired_mask, slab->retired_mask | bit, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&slab->generation[object], generation, __ATOMIC_RELEASE);
+    if (!retired) {
+        __atomic_store_n(&slab->free_mask, slab->free_mask | bit, __ATOMIC_RELEASE);
+    }
+    
+    if ((slab->free_mask | slab->retired_mask) == ~(uint64_t)0) {
+        // Empty: give the block back and recycle the record, unless every
+        // object is retired
+        if (!was_full) slab_list_unlink(cache, index);
+        release_block(ctx, slab->byte_index, 0);
+        __atomic_store_n(&slab->in_use, 0, __ATOMIC_RELEASE);
+        if (slab->retired_mask != ~(uint64_t)0) {
+            slab->next = cache->free_record;
+            cache->free_record = index;
+        }
+    } else if (was_full && slab->free_mask) {
+        slab_list_push(cache, index);
+    }
+}
+
+// === ARENAS ===
+// An arena is one buddy block handed out by bumping an offset. Each
+// allocation is preceded by its length, stored in the arena itself, so no
+// per-allocation records exist. Arena handles are stamped with the record's
+// generation and allocation handles with its epoch; bumping the epoch
+// releases every allocation at once.
+static void arena_cache_init(visualmem_arena_cache_t* cache) {
+    memset(cache, 0, sizeof(*cache));
+    cache->free_record = -1;
+}
+
+static void arena_cache_release(visualmem_arena_cache_t* cache) {
+    free(cache->arenas);
+    arena_cache_init(cache);
+}
+
+static inline size_t arena_handle_offset(void* handle) {
+    return (uintptr_t)handle >> HANDLE_SLOT_BITS;
+}
+
+// Live record behind an arena handle whose stamp matches; NULL otherwise
+static visualmem_arena_t* arena_record(visualmem_arena_cache_t* cache, void* handle, int for_allocation) {
+    uintptr_t field = (uintptr_t)handle & HANDLE_SLOT_MASK;
+    uintptr_t index = field & ARENA_INDEX_MASK;
+    if (!is_arena_handle(handle) || index >= (uintptr_t)__atomic_load_n(&cache->count, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    
+    visualmem_arena_t* arena = &__atomic_load_n(&cache->arenas, __ATOMIC_ACQUIRE)[index];
+    if (!__atomic_load_n(&arena->in_use, __ATOMIC_ACQUIRE)) return NULL;
+    uint32_t stamp = __atomic_load_n(for_allocation ? &arena->epoch : &arena->generation, __ATOMIC_ACQUIRE);
+    if (((field >> ARENA_INDEX_BITS) & ARENA_STAMP_MASK) != (stamp & ARENA_STAMP_MASK)) {
+        return NULL;
+    }
+    return arena;
+}
+
+// Arena named by an arena handle (not one of its allocations)
+static visualmem_arena_t* arena_lookup(visualmem_arena_cache_t* cache, void* handle) {
+    if (arena_handle_offset(handle) != 0) return NULL;
+    return arena_record(cache, handle, 0);
+}
+
+static void arena_store_length(uint8_t header[VISUALMEM_ARENA_HEADER], size_t length) {
+    for (int i = 0; i < VISUALMEM_ARENA_HEADER; i++) {
+        header[i] = (uint8_t)(length >> (8 * i));
+    }
+}
+
+// Payload range of a live arena allocation; 0 for arenas and stale handles
+static int arena_resolve(visualmem_context_t* ctx, void* visual_addr, size_t* byte_index, size_t* size) {
+    const visualmem_arena_t* arena = arena_record(&ctx->arenas, visual_addr, 1);
+    size_t offset = arena_handle_offset(visual_addr);
+    if (!arena) return 0;
+    size_t used = __atomic_load_n(&arena->used, __ATOMIC_ACQUIRE);
+    size_t base = __atomic_load_n(&arena->byte_index, __ATOMIC_RELAXED);
+    if (offset < VISUALMEM_ARENA_HEADER || offset > used) return 0;
+    
+    uint8_t header[VISUALMEM_ARENA_HEADER];
+    size_t length = 0;
+    decode_bytes(ctx, base + offset - VISUALMEM_ARENA_HEADER, header, sizeof(header));
+    for (int i = VISUALMEM_ARENA_HEADER - 1; i >= 0; i--) {
+        length = (length << 8) | header[i];
+    }
+    if (length == 0 || length > used - offset) return 0;
+    
+    *byte_index = base + offset;
+    *size = length;
+    return 1;
+}
+
+// Move the bump offset to the aligned end of the last allocation
+static void arena_advance(visualmem_arena_t* arena, size_t end) {
+    end = (end + VISUALMEM_ARENA_ALIGN - 1) & ~(size_t)(VISUALMEM_ARENA_ALIGN - 1);
+    __atomic_store_n(&arena->used, end < arena->capacity ? end : arena->capacity, __ATOMIC_RELEASE);
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+}
+
+// Make arena bytes [from, to) read as zero before they are handed out. Bytes
+// below the high water mark but past the bump offset were left by an earlier
+// epoch or a shrink, so reset stays O(1) and the bump clears them instead
+static void arena_claim(visualmem_context_t* ctx, visualmem_arena_t* arena, size_t from, size_t to) {
+    claim_bytes(ctx, arena->byte_index + from, to - from);
+    if (from < arena->high_water) {
+        fill_bytes(ctx, arena->byte_index + from, 0, (to < arena->high_water ? to : arena->high_water) - from);
+    }
+}
+
+// Bump a new allocation; the record's used offset moves past it
+static void* arena_bump(visualmem_context_t* ctx, visualmem_arena_t* arena, size_t size) {
+    size_t offset = arena->used + VISUALMEM_ARENA_HEADER;
+    if (offset > arena->capacity || size > arena->capacity - offset) return NULL;
+    arena_claim(ctx, arena, arena->used, offset + size);
+    
+    uint8_t header[VISUALMEM_ARENA_HEADER];
+    arena_store_length(header, size);
+    if (encode_bytes(ctx, arena->byte_index + arena->used, header, sizeof(header)) != VISUALMEM_SUCCESS) {
+        return NULL;
+    }
+    
+    arena_advance(arena, offset + size);
+    return make_arena_handle((int32_t)(arena - ctx->arenas.arenas), arena->epoch, offset);
+}
+
+// Resize in place when the allocation is the arena's last one or shrinks;
+// otherwise bump a copy. NULL (allocation untouched) when the arena is full.
+static void* arena_realloc(visualmem_context_t* ctx, void* visual_addr, size_t byte_index,
+                           size_t old_size, size_t new_size) {
+    visualmem_arena_t* arena = arena_record(&ctx->arenas, visual_addr, 1);
+    size_t offset = arena_handle_offset(visual_addr);
+    size_t old_end = (offset + old_size + VISUALMEM_ARENA_ALIGN - 1) & ~(size_t)(VISUALMEM_ARENA_ALIGN - 1);
+    int is_last = old_end >= arena->used;
+    
+    if (new_size <= old_size || (is_last && new_size <= arena->capacity - offset)) {
+        if (new_size > old_size) arena_claim(ctx, arena, offset + old_size, offset + new_size);
+        uint8_t header[VISUALMEM_ARENA_HEADER];
+        arena_store_length(header, new_size);
+        if (encode_bytes(ctx, byte_index - VISUALMEM_ARENA_HEADER, header, sizeof(header)) != VISUALMEM_SUCCESS) {
+            return NULL;
+        }
+        if (is_last) arena_advance(arena, offset + new_size);
+        return visual_addr;
+    }
+    
+    void* moved = arena_bump(ctx, arena, new_size);
+    if (moved && copy_bytes(ctx, arena->byte_index + arena_handle_offset(moved), byte_index, old_size) != VISUALMEM_SUCCESS) {
+        return NULL;
+    }
+    return moved;
+}
+
+// === DEFRAGMENTATION ===
+// Compaction moves live blocks (allocation records, whole slabs and arenas) into the
+// lowest free block that can hold them, highest block first. Handles resolve
+// through the table slot or slab record, so only the byte position behind a
+// handle changes and caller-held addresses stay valid. Every move goes
+// strictly down, so repeated steps converge.
+typedef enum {
+    DEFRAG_TABLE,
+    DEFRAG_SLAB,
+    DEFRAG_ARENA
+} defrag_kind_t;
+
+typedef struct {
+    defrag_kind_t kind;
+    int index;                  // Table slot, slab or arena record
+    int32_t unit;               // Current block head
+    int order;
+} defrag_block_t;
+
+// Per order k: lowest free block of order k or above, -1 when none
+static void buddy_lowest_free(const visualmem_buddy_t* buddy, int32_t lowest[]) {
+    int32_t best = -1;
+    for (int order = VISUALMEM_ALLOC_MAX_ORDER; order >= 0; order--) {
+        for (int32_t unit = buddy->free_head[order]; unit >= 0; unit = buddy->free_next[unit]) {
+            if (best < 0 || unit < best) best = unit;
+        }
+        lowest[order] = best;
+    }
+}
+
+static void defrag_consider(defrag_block_t* pick, const int32_t lowest[], int order,
+                            int32_t unit, defrag_kind_t kind, int index) {
+    if (unit > pick->unit && lowest[order] >= 0 && lowest[order] < unit) {
+        pick->kind = kind;
+        pick->index = index;
+        pick->unit = unit;
+        pick->order = order;
+    }
+}
+
+// Highest live block that has a lower free block to move into; 0 once compact
+static int defrag_pick(const visualmem_context_t* ctx, const int32_t lowest[], defrag_block_t* pick) {
+    const visualmem_buddy_t* buddy = &ctx->buddy;
+    const visualmem_alloc_table_t* table = &ctx->allocations;
+    const visualmem_slab_cache_t* cache = &ctx->slabs;
+    const visualmem_arena_cache_t* arenas = &ctx->arenas;
+    pick->unit = -1;
+    
+    for (int slot = 0; slot < table->capacity; slot++) {
+        if (!table->is_active[slot]) continue;
+        int32_t unit = buddy_unit(buddy, table->byte_index[slot]);
+        defrag_consider(pick, lowest, buddy->block_state[unit], unit, DEFRAG_TABLE, slot);
+    }
+    for (int index = 0; index < cache->count; index++) {
+        if (!cache->slabs[index].in_use) continue;
+        int32_t unit = buddy_unit(buddy, cache->slabs[index].byte_index);
+        defrag_consider(pick, lowest, buddy->block_state[unit], unit, DEFRAG_SLAB, index);
+    }
+    for (int index = 0; index < arenas->count; index++) {
+        if (!arenas->arenas[index].in_use) continue;
+        int32_t unit = buddy_unit(buddy, arenas->arenas[index].byte_index);
+        defrag_consider(pick, lowest, buddy->block_state[unit], unit, DEFRAG_ARENA, index);
+    }
+    
+    return pick->unit >= 0;
+}
+
+// End unit of the highest live block
+static int32_t live_extent(const visualmem_context_t* ctx) {
+    const visualmem_buddy_t* buddy = &ctx->buddy;
+    const visualmem_alloc_table_t* table = &ctx->allocations;
+    const visualmem_slab_cache_t* cache = &ctx->slabs;
+    const visualmem_arena_cache_t* arenas = &ctx->arenas;
+    int32_t extent = 0;
+    
+    for (int slot = 0; slot < table->capacity; slot++) {
+        if (!table->is_active[slot]) continue;
+        int32_t unit = buddy_unit(buddy, table->byte_index[slot]);
+        int32_t end = unit + (1 << buddy->block_state[unit]);
+        if (end > extent) extent = end;
+    }
+    for (int index = 0; index < cache->count; index++) {
+        if (!cache->slabs[index].in_use) continue;
+        int32_t unit = buddy_unit(buddy, cache->slabs[index].byte_index);
+        int32_t end = unit + (1 << buddy->block_state[unit]);
+        if (end > extent) extent = end;
+    }
+    for (int index = 0; index < arenas->count; index++) {
+        if (!arenas->arenas[index].in_use) continue;
+        int32_t unit = buddy_unit(buddy, arenas->arenas[index].byte_index);
+        int32_t end = unit + (1 << buddy->block_state[unit]);
+        if (end > extent) extent = end;
+    }
+    
+    return extent;
+}
+
+// === CORE LIBRARY FUNCTIONS ===
+
+int visualmem_init(visualmem_context_t* ctx, visualmem_mode_t mode, int width, int height) {
+    return visualmem_init_with_encoding(ctx, mode, width, height, VISUALMEM_ENCODING_BINARY);
+}
+
+int visualmem_init_with_encoding(visualmem_context_t* ctx, visualmem_mode_t mode,
+                                 int width, int height, visualmem_encoding_t encoding) {
+    if (!ctx) return VISUALMEM_ERROR_INVALID_ADDRESS;
+    if (width <= 0 || height <= 0 || width > VISUALMEM_MAX_WIDTH || height > VISUALMEM_MAX_HEIGHT) {
+        return VISUALMEM_ERROR_INVALID_SIZE;
+    }
+    if (!encoding_is_valid(encoding)) {
+        return VISUALMEM_ERROR_INVALID_MODE;
+    }
+    
+    codec_dispatch_init();
+    
+    // Initialize context
+    memset(ctx, 0, sizeof(visualmem_context_t));
+    ctx->width = width;
+    ctx->height = height;
+    ctx->mode = mode;
+    ctx->encoding = encoding;
+    compute_layout(ctx);
+    
+    // Allocate framebuffer (this represents the actual screen/display)
+    ctx->pixel_bits = uses_indexed_pixels(mode, encoding) ? 4 : 32;
+    ctx->framebuffer_size = pixel_row_bytes(ctx) * height;
+    ctx->framebuffer = create_pixel_buffer(ctx, 0);
+    if (!ctx->framebuffer) {
+        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    }
+    
+    // Allocate temporary RAM buffer (will be freed in autonomous mode),
+    // initialized to free; the framebuffer receives it on the autonomous
+    // transition
+    ctx->ram_buffer = create_pixel_buffer(ctx, 1);
+    if (!ctx->ram_buffer) {
+        destroy_pixel_buffer(ctx, ctx->framebuffer);
+        ctx->framebuffer = NULL;
+        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    }
+    
+    // The allocation table starts empty; the header bytes are never handed out
+    slab_cache_init(&ctx->slabs);
+    arena_cache_init(&ctx->arenas);
+    if (buddy_init(&ctx->buddy, VISUALMEM_HEADER_SIZE, ctx->capacity_bytes) != VISUALMEM_SUCCESS) {
+        visualmem_cleanup(ctx);
+        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    }
+    
+    // Set status flags
+    ctx->is_initialized = 1;
+    ctx->ram_freed = 0;
+    ctx->autonomous_mode = 0;
+    ctx->enable_error_correction = 1;
+    ctx->enable_compression = 0;
+    ctx->debug_mode = 0;
+    
+    // Frame every row of the data area for the framed encodings
+    if (encoding != VISUALMEM_ENCODING_BINARY) {
+        write_block_headers(ctx);
+    }
+    
+    // Write header to visual memory
+    visualmem_header_t header = {
+        .magic = VISUALMEM_MAGIC_HEADER,
+        .version = (LIBVISUALMEM_VERSION_MAJOR << 16) | (LIBVISUALMEM_VERSION_MINOR << 8) | LIBVISUALMEM_VERSION_PATCH,
+        .mode = mode,
+        .width = width,
+        .height = height,
+        .allocation_count = 0,
+        .timestamp = time(NULL),
+        .encoding = encoding
+    };
+    
+    // Encode header into first pixels
+    if (encode_bytes(ctx, 0, (const uint8_t*)&header, sizeof(header)) != VISUALMEM_SUCCESS) {
+        visualmem_cleanup(ctx);
+        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    }
+    
+    if (ctx->debug_mode) {
+        printf("Visual memory initialized: %dx%d, mode=%d, encoding=%d, capacity=%zu bytes\n",
+               width, height, mode, encoding, ctx->capacity_bytes);
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+void visualmem_cleanup(visualmem_context_t* ctx) {
+    if (!ctx) return;
+    
+    visualmem_set_thread_safe(ctx, 0);
+    destroy_pixel_buffer(ctx, ctx->ram_buffer);
+    ctx->ram_buffer = NULL;
+    
+    destroy_pixel_buffer(ctx, ctx->framebuffer);
+    ctx->framebuffer = NULL;
+    
+    free(ctx->raw_store);
+    free(ctx->stale_rows);
+    ctx->raw_store = NULL;
+    ctx->stale_rows = NULL;
+    
+    buddy_release(&ctx->buddy);
+    table_release(&ctx->allocations);
+    slab_cache_release(&ctx->slabs);
+    arena_cache_release(&ctx->arenas);
+    
+    ctx->is_initialized = 0;
+    ctx->ram_freed = 1;
+}
+
+int visualmem_enter_autonomous_mode(visualmem_context_t* ctx) {
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    
+    if (ctx->ram_freed) {
+        return VISUALMEM_SUCCESS; // Already in autonomous mode
+    }
+    
+    if (ctx->debug_mode) {
+        printf("CRITICAL TRANSITION: Entering autonomous visual memory mode...\n");
+        printf("Before: RAM buffer=%p, Framebuffer=%p, RAM freed=%s\n",
+               ctx->ram_buffer, ctx->framebuffer, ctx->ram_freed ? "YES" : "NO");
+    }
+    
+    // Lazy pixels live in RAM too: encode everything still pending and
+    // drop the raw store
+    if (ctx->raw_store) {
+        int result = visualmem_set_lazy_pixels(ctx, 0);
+        if (result != VISUALMEM_SUCCESS) return result;
+    }
+    
+    // Final synchronization: copy RAM buffer to framebuffer. Sparse
+    // buffers hand their materialized tiles over instead of copying.
+    if (ctx->ram_buffer && ctx->framebuffer) {
+        if (ctx->pixel_bits == 4) {
+            uint8_t** ram_tiles = (uint8_t**)ctx->ram_buffer;
+            uint8_t** frame_tiles = (uint8_t**)ctx->framebuffer;
+            for (int i = 0; i < tile_count(ctx); i++) {
+                frame_tiles[i] = ram_tiles[i];
+                ram_tiles[i] = NULL;
+            }
+        } else {
+            memcpy(ctx->framebuffer, ctx->ram_buffer, ctx->framebuffer_size);
+        }
+    }
+    
+    // Free RAM buffer - THIS IS THE CRITICAL STEP
+    if (ctx->ram_buffer) {
+        destroy_pixel_buffer(ctx, ctx->ram_buffer);
+        ctx->ram_buffer = NULL;
+        ctx->ram_freed = 1;
+        ctx->autonomous_mode = 1;
+    }
+    
+    if (ctx->debug_mode) {
+        printf("After: RAM buffer=%p, Framebuffer=%p, RAM freed=%s\n",
+               ctx->ram_buffer, ctx->framebuffer, ctx->ram_freed ? "YES" : "NO");
+        printf("✅ AUTONOMOUS MODE ACTIVE: System now operates solely on visual display memory\n");
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_set_lazy_pixels(visualmem_context_t* ctx, int enable) {
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    
+    if (!enable) {
+        if (!ctx->raw_store) return VISUALMEM_SUCCESS;
+        int result = materialize_pixels(ctx);
+        if (result != VISUALMEM_SUCCESS) return result;
+        free(ctx->raw_store);
+        free(ctx->stale_rows);
+        ctx->raw_store = NULL;
+        ctx->stale_rows = NULL;
+        return VISUALMEM_SUCCESS;
+    }
+    
+    if (ctx->raw_store) return VISUALMEM_SUCCESS;
+    if (ctx->mode != VISUALMEM_MODE_SIMULATE || ctx->ram_freed) {
+        return VISUALMEM_ERROR_INVALID_MODE;
+    }
+    
+    size_t words = (payload_rows(ctx) + 63) / 64;
+    ctx->raw_store = malloc(ctx->capacity_bytes > 0 ? ctx->capacity_bytes : 1);
+    ctx->stale_rows = calloc(words > 0 ? words : 1, sizeof(uint64_t));
+    if (!ctx->raw_store || !ctx->stale_rows) {
+        free(ctx->raw_store);
+        free(ctx->stale_rows);
+        ctx->raw_store = NULL;
+        ctx->stale_rows = NULL;
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    // Start from what the pixels hold now; nothing is stale yet
+    decode_pixel_bytes(ctx, 0, ctx->raw_store, ctx->capacity_bytes);
+    
+    if (ctx->debug_mode) {
+        printf("Lazy pixels enabled: %zu byte raw store\n", ctx->capacity_bytes);
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_set_thread_safe(visualmem_context_t* ctx, int enable) {
+    if (!ctx) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    
+    struct visualmem_sync* sync = ctx->sync;
+    if (!enable) {
+        if (!sync) return VISUALMEM_SUCCESS;
+        
+        // No data call is running, so everything retired can go
+        reclaim_retired(ctx, 0);
+        ctx->sync = NULL;
+        while (sync->readers) {
+            visualmem_reader_t* next = sync->readers->next;
+            free(sync->readers);
+            sync->readers = next;
+        }
+        free(sync->retired);
+        pthread_mutex_destroy(&sync->writer);
+        free(sync);
+        return VISUALMEM_SUCCESS;
+    }
+    
+    if (!ctx->is_initialized) return VISUALMEM_ERROR_NOT_INITIALIZED;
+    if (sync) return VISUALMEM_SUCCESS;
+    
+    sync = calloc(1, sizeof(*sync));
+    if (!sync) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    if (pthread_mutex_init(&sync->writer, NULL) != 0) {
+        free(sync);
+        return VISUALMEM_ERROR_INIT_FAILED;
+    }
+    sync->serial = __atomic_add_fetch(&sync_serial, 1, __ATOMIC_RELAXED);
+    sync->epoch = 1;
+    ctx->sync = sync;
+    
+    if (ctx->debug_mode) {
+        printf("Thread-safe mode enabled: lock-free lookups, serialized allocation\n");
+    }
+    
+    return VISUALMEM_SUCCESS;
+}
+
+// Allocation with its own table record; NULL when out of slots or space
+static void* table_alloc(visualmem_context_t* ctx, size_t size, const char* label) {
+    visualmem_alloc_table_t* table = &ctx->allocations;
+    int slot = table_acquire(ctx, table);
+    if (slot < 0) {
+        return NULL; // Allocation table cannot grow
+    }
+    
+    // Place the allocation in a free block of the payload area
+    size_t start_byte;
+    if (!place_block(ctx, size, &start_byte)) {
+        table_retire(table, slot);
+        return NULL; // No free block large enough
+    }
+    claim_bytes(ctx, start_byte, size);
+    
+    // Fill in the allocation record; a stale handle's reader may still load
+    // the place and size, as during realloc
+    __atomic_store_n(&table->byte_index[slot], start_byte, __ATOMIC_RELAXED);
+    __atomic_store_n(&table->size[slot], size, __ATOMIC_RELEASE);
+    table->checksum[slot] = 0; // Will be calculated on write
+    table->timestamp[slot] = time(NULL);
+    
+    if (label) {
+        strncpy(table->label[slot], label, sizeof(table->label[slot]) - 1);
+        table->label[slot][sizeof(table->label[slot]) - 1] = '\0';
+    } else {
+        table->label[slot][0] = '\0';
+    }
+    
+    table_publish(table, slot);
+    return make_handle(slot, table->generation[slot]);
+}
+
+// Payload range of a live allocation: table record, slab object or arena allocation
+static int resolve_address(visualmem_context_t* ctx, void* visual_addr,
+                           size_t* byte_index, size_t* size) {
+    if (is_slab_handle(visual_addr)) {
+        return slab_lookup(&ctx->slabs, visual_addr, byte_index, size);
+    }
+    if (is_arena_handle(visual_addr)) {
+        return arena_resolve(ctx, visual_addr, byte_index, size);
+    }
+    
+    const visualmem_alloc_table_t* table = &ctx->allocations;
+    int slot = table_lookup(table, visual_addr);
+    if (slot < 0) return 0;
+    
+    // realloc publishes the size after the new place, so reading the size
+    // first never pairs a grown size with the smaller old block
+    *size = __atomic_load_n(&__atomic_load_n(&table->size, __ATOMIC_ACQUIRE)[slot], __ATOMIC_ACQUIRE);
+    *byte_index = __atomic_load_n(&__atomic_load_n(&table->byte_index, __ATOMIC_ACQUIRE)[slot], __ATOMIC_RELAXED);
+    return 1;
+}
+
+// Batched calls work through their entries in payload order: sorted by byte
+// index, ranges that each start where the previous one ends form one run
+typedef struct {
+    size_t byte_index;       // Absolute payload byte of the entry
+    size_t size;
+    int entry;               // Position in the caller's array
+} batch_span_t;
+
+static int compare_spans(const void* a, const void* b) {
+    const batch_span_t* x = (const batch_span_t*)a;
+    const batch_span_t* y = (const batch_span_t*)b;
+    if (x->byte_index != y->byte_index) return x->byte_index < y->byte_index ? -1 : 1;
+    return x->entry - y->entry;
+}
+
+static int compare_sizes_desc(const void* a, const void* b) {
+    const batch_span_t* x = (const batch_span_t*)a;
+    const batch_span_t* y = (const batch_span_t*)b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    return x->entry - y->entry;
+}
+
+// Resolve and bound-check every iovec entry, then sort them
+static int resolve_iovecs(visualmem_context_t* ctx, const visualmem_iovec_t* iov, int count,
+                          batch_span_t* spans) {
+    for (int i = 0; i < count; i++) {
+        size_t byte_index, size;
+        if (!iov[i].visual_addr || !iov[i].buffer || iov[i].size == 0 ||
+            !resolve_address(ctx, iov[i].visual_addr, &byte_index, &size)) {
+            return VISUALMEM_ERROR_INVALID_ADDRESS;
+        }
+        if (iov[i].offset > size || iov[i].size > size - iov[i].offset) {
+            return VISUALMEM_ERROR_INVALID_SIZE;
+        }
+        spans[i].byte_index = byte_index + iov[i].offset;
+        spans[i].size = iov[i].size;
+        spans[i].entry = i;
+    }
+    
+    qsort(spans, (size_t)count, sizeof(*spans), compare_spans);
+    return VISUALMEM_SUCCESS;
+}
+
+// End of the run starting at spans[first]; run_bytes receives its length
+static int run_end(const batch_span_t* spans, int first, int count, size_t* run_bytes) {
+    size_t bytes = spans[first].size;
+    int end = first + 1;
+    while (end < count && spans[end].byte_index == spans[first].byte_index + bytes) {
+        bytes += spans[end].size;
+        end++;
+    }
+    *run_bytes = bytes;
+    return end;
+}
+
+// Scratch buffer for the longest run of more than one entry; NULL when there is none
+static uint8_t* run_staging(const batch_span_t* spans, int count, int* result) {
+    size_t longest = 0;
+    for (int first = 0; first < count;) {
+        size_t run_bytes;
+        int end = run_end(spans, first, count, &run_bytes);
+        if (end - first > 1 && run_bytes > longest) longest = run_bytes;
+        first = end;
+    }
+    if (longest == 0) return NULL;
+    
+    uint8_t* staging = malloc(longest);
+    if (!staging) *result = VISUALMEM_ERROR_OUT_OF_MEMORY;
+    return staging;
+}
+
+void* visualmem_alloc(visualmem_context_t* ctx, size_t size, const char* label) {
+    if (!ctx || !ctx->is_initialized || size == 0) {
+        return NULL;
+    }
+    
+    writer_lock(ctx);
+    
+    // Small unlabelled objects share slabs; everything else gets a record
+    void* visual_addr = NULL;
+    if (!label && size <= VISUALMEM_SLAB_MAX_OBJECT) {
+        visual_addr = slab_alloc(ctx, size);
+    }
+    if (!visual_addr) {
+        visual_addr = table_alloc(ctx, size, label);
+    }
+    if (!visual_addr) {
+        writer_unlock(ctx);
+        return NULL;
+    }
+    
+    // Update statistics
+    ctx->total_allocated += size;
+    if (ctx->total_allocated > ctx->peak_usage) {
+        ctx->peak_usage = ctx->total_allocated;
+    }
+    ctx->allocation_count++;
+    writer_unlock(ctx);
+    
+    if (ctx->debug_mode) {
+        printf("Visual memory allocated: %zu bytes at visual address %p, label='%s'\n",
+               size, visual_addr, label ? label : "");
+    }
+    
+    return visual_addr;
+}
+
+int visualmem_free(visualmem_context_t* ctx, void* visual_addr) {
+    if (!ctx || !visual_addr) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    }
+    
+    writer_lock(ctx);
+    
+    // Find allocation; arena allocations are only released with their arena
+    size_t byte_index, size;
+    if (is_arena_handle(visual_addr) || !resolve_address(ctx, visual_addr, &byte_index, &size)) {
+        writer_unlock(ctx);
+        if (ctx->debug_mode) {
+            printf("Visual memory: free of stale, unknown or arena address %p\n", visual_addr);
+        }
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    }
+    
+    // Update statistics
+    ctx->total_allocated -= size;
+    ctx->allocation_count--;
+    
+    if (ctx->debug_mode) {
+        printf("Visual memory freed: %zu bytes at visual address %p\n", size, visual_addr);
+    }
+    
+    // Return the space and retire the handle. Slab objects share their block
+    // and are cleared now; a record's block is only marked for clearing
+    if (is_slab_handle(visual_addr)) {
+        fill_bytes(ctx, byte_index, 0, size);
+        slab_free(ctx, visual_addr);
+    } else {
+        table_retire(&ctx->allocations, handle_slot(visual_addr));
+        release_block(ctx, byte_index, size);
+    }
+    
+    writer_unlock(ctx);
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_alloc_batch(visualmem_context_t* ctx, const size_t* sizes, const char* const* labels,
+                          int count, void** addrs) {
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    if (!sizes || !addrs || count <= 0) {
+        return VISUALMEM_ERROR_INVALID_SIZE;
+    }
+    
+    batch_span_t* order = malloc(sizeof(*order) * (size_t)count);
+    if (!order) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < count; i++) {
+        addrs[i] = NULL;
+        if (sizes[i] == 0) {
+            free(order);
+            return VISUALMEM_ERROR_INVALID_SIZE;
+        }
+        order[i].byte_index = 0;
+        order[i].size = sizes[i];
+        order[i].entry = i;
+    }
+    
+    // Largest first, so small blocks do not split the space big ones need
+    qsort(order, (size_t)count, sizeof(*order), compare_sizes_desc);
+    
+    writer_lock(ctx);
+    int placed = 0;
+    for (; placed < count; placed++) {
+        int entry = order[placed].entry;
+        addrs[entry] = visualmem_alloc(ctx, sizes[entry], labels ? labels[entry] : NULL);
+        if (!addrs[entry]) break;
+    }
+    
+    if (placed < count) {
+        // Hand nothing out: give back what this batch placed
+        while (placed-- > 0) {
+            int entry = order[placed].entry;
+            visualmem_free(ctx, addrs[entry]);
+            addrs[entry] = NULL;
+        }
+        writer_unlock(ctx);
+        free(order);
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    writer_unlock(ctx);
+    free(order);
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_free_batch(visualmem_context_t* ctx, void* const* addrs, int count) {
+    if (!ctx || !addrs || count <= 0) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    }
+    
+    batch_span_t* spans = malloc(sizeof(*spans) * (size_t)count);
+    if (!spans) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    // Check everything first, as for visualmem_free
+    writer_lock(ctx);
+    for (int i = 0; i < count; i++) {
+        if (!addrs[i] || is_arena_handle(addrs[i]) ||
+            !resolve_address(ctx, addrs[i], &spans[i].byte_index, &spans[i].size)) {
+            writer_unlock(ctx);
+            free(spans);
+            return VISUALMEM_ERROR_INVALID_ADDRESS;
+        }
+        spans[i].entry = i;
+    }
+    
+    // Sorting puts an address listed twice next to itself
+    qsort(spans, (size_t)count, sizeof(*spans), compare_spans);
+    for (int i = 1; i < count; i++) {
+        if (addrs[spans[i].entry] == addrs[spans[i - 1].entry]) {
+            writer_unlock(ctx);
+            free(spans);
+            return VISUALMEM_ERROR_INVALID_ADDRESS;
         }
-        
-        // Always update framebuffer (this is the persistent visual memory)
-        framebuffer[index] = color;
     }
+    
+    for (int i = 0; i < count; i++) {
+        visualmem_free(ctx, addrs[spans[i].entry]);
+    }
+    
+    writer_unlock(ctx);
+    free(spans);
+    return VISUALMEM_SUCCESS;
 }
 
-static uint32_t get_pixel_color(visualmem_context_t* ctx, int x, int y) {
-    if (x >= 0 && x < ctx->width && y >= 0 && y < ctx->height) {
-        int index = y * ctx->width + x;
-        
-        if (ctx->ram_buffer && !ctx->ram_freed) {
-            // During initialization - read from RAM buffer
-            uint32_t* ram_buf = (uint32_t*)ctx->ram_buffer;
-            return ram_buf[index];
-        } else {
-            // Autonomous mode - read directly from framebuffer (visual memory)
-            uint32_t* framebuffer = (uint32_t*)ctx->framebuffer;
-            return framebuffer[index];
+// Resize a record's block in place, or move its pixels to a new block; the
+// handle is unchanged either way
+static int table_realloc(visualmem_context_t* ctx, int slot, size_t new_size) {
+    visualmem_alloc_table_t* table = &ctx->allocations;
+    size_t byte_index = table->byte_index[slot];
+    size_t old_size = table->size[slot];
+    
+    if (!buddy_resize(&ctx->buddy, byte_index, new_size)) {
+        size_t new_index;
+        if (!place_block(ctx, new_size, &new_index)) {
+            return VISUALMEM_ERROR_ALLOCATION_FAILED;
+        }
+        claim_bytes(ctx, new_index, new_size);
+        int result = copy_bytes(ctx, new_index, byte_index, old_size);
+        if (result != VISUALMEM_SUCCESS) {
+            release_block(ctx, new_index, old_size);
+            return result;
         }
+        __atomic_store_n(&table->byte_index[slot], new_index, __ATOMIC_RELAXED);
+        release_block(ctx, byte_index, old_size);
+    } else if (new_size > old_size) {
+        claim_bytes(ctx, byte_index + old_size, new_size - old_size);
+    } else if (new_size < old_size) {
+        fill_bytes(ctx, byte_index + new_size, 0, old_size - new_size);
     }
-    return VISUALMEM_COLOR_FREE;
+    
+    __atomic_store_n(&table->size[slot], new_size, __ATOMIC_RELEASE);
+    return VISUALMEM_SUCCESS;
 }
 
-// === BYTE ENCODING/DECODING ===
-static void encode_byte_to_pixels(visualmem_context_t* ctx, int byte_index, uint8_t byte_value) {
-    int base_x, base_y;
-    calculate_byte_position(byte_index, &base_x, &base_y, ctx->width);
-    
-    if (base_x >= ctx->width - 10 || base_y >= ctx->height - 2) {
-        return; // Out of bounds
-    }
+// Resize a slab object within its size class; 0 when it needs a bigger one
+static int slab_resize(visualmem_context_t* ctx, void* visual_addr, size_t byte_index,
+                       size_t old_size, size_t new_size) {
+    uintptr_t field = ((uintptr_t)visual_addr & HANDLE_SLOT_MASK) & ~HANDLE_SLAB_FLAG;
+    visualmem_slab_t* slab = &ctx->slabs.slabs[field >> SLAB_OBJECT_BITS];
+    int object = (int)(field & (VISUALMEM_SLAB_OBJECTS - 1));
     
-    // Place start marker
-    set_pixel_color(ctx, base_x, base_y, VISUALMEM_COLOR_START);
+    if (new_size > ((size_t)VISUALMEM_SLAB_MIN_OBJECT << slab->size_class)) return 0;
     
-    // Encode each bit as a pixel
-    for (int bit = 0; bit < VISUALMEM_BITS_PER_BYTE; bit++) {
-        uint8_t bit_value = (byte_value >> (7 - bit)) & 1;
-        uint32_t pixel_color = bit_value ? VISUALMEM_COLOR_BIT_1 : VISUALMEM_COLOR_BIT_0;
-        set_pixel_color(ctx, base_x + 1 + bit, base_y, pixel_color);
+    if (new_size < old_size) {
+        fill_bytes(ctx, byte_index + new_size, 0, old_size - new_size);
     }
-    
-    // Place end marker
-    set_pixel_color(ctx, base_x + 9, base_y, VISUALMEM_COLOR_END);
+    slab->size[object] = (uint8_t)(new_size - 1);
+    return 1;
 }
 
-static uint8_t decode_byte_from_pixels(visualmem_context_t* ctx, int byte_index) {
-    int base_x, base_y;
-    calculate_byte_position(byte_index, &base_x, &base_y, ctx->width);
+// Move a small object into a new allocation; NULL (old object untouched) on failure
+static void* slab_relocate(visualmem_context_t* ctx, void* visual_addr, size_t byte_index,
+                           size_t old_size, size_t new_size) {
+    void* moved = visualmem_alloc(ctx, new_size, NULL);
+    if (!moved) return NULL;
+    
+    size_t new_index, capacity;
+    resolve_address(ctx, moved, &new_index, &capacity);
+    if (copy_bytes(ctx, new_index, byte_index, old_size) != VISUALMEM_SUCCESS) {
+        visualmem_free(ctx, moved);
+        return NULL;
+    }
     
-    if (base_x >= ctx->width - 10 || base_y >= ctx->height - 2) {
-        return 0; // Out of bounds
+    visualmem_free(ctx, visual_addr);
+    return moved;
+}
+
+// visualmem_realloc under the writer lock
+static void* resize_allocation(visualmem_context_t* ctx, void* visual_addr, size_t new_size) {
+    if (!visual_addr) {
+        return visualmem_alloc(ctx, new_size, NULL);
+    }
+    if (new_size == 0) {
+        visualmem_free(ctx, visual_addr);
+        return NULL;
     }
     
-    uint8_t byte_value = 0;
+    size_t byte_index, old_size;
+    if (!resolve_address(ctx, visual_addr, &byte_index, &old_size)) {
+        return NULL;
+    }
     
-    // Read each bit from pixels
-    for (int bit = 0; bit < VISUALMEM_BITS_PER_BYTE; bit++) {
-        uint32_t pixel_color = get_pixel_color(ctx, base_x + 1 + bit, base_y);
-        
-        // Check if pixel represents bit 1
-        if ((pixel_color & 0x00FFFFFF) == (VISUALMEM_COLOR_BIT_1 & 0x00FFFFFF)) {
-            byte_value |= (1 << (7 - bit));
+    if (is_slab_handle(visual_addr)) {
+        if (!slab_resize(ctx, visual_addr, byte_index, old_size, new_size)) {
+            return slab_relocate(ctx, visual_addr, byte_index, old_size, new_size);
         }
+    } else if (is_arena_handle(visual_addr)) {
+        // Arena allocations stay in their arena and outside the statistics
+        void* resized = arena_realloc(ctx, visual_addr, byte_index, old_size, new_size);
+        if (resized && ctx->debug_mode) {
+            printf("Visual memory resized in arena: %zu -> %zu bytes at visual address %p\n",
+                   old_size, new_size, resized);
+        }
+        return resized;
+    } else if (table_realloc(ctx, handle_slot(visual_addr), new_size) != VISUALMEM_SUCCESS) {
+        return NULL;
     }
     
-    return byte_value;
-}
-
-// === CORE LIBRARY FUNCTIONS ===
-
-int visualmem_init(visualmem_context_t* ctx, visualmem_mode_t mode, int width, int height) {
-    if (!ctx) return VISUALMEM_ERROR_INVALID_ADDRESS;
-    if (width <= 0 || height <= 0 || width > VISUALMEM_MAX_WIDTH || height > VISUALMEM_MAX_HEIGHT) {
-        return VISUALMEM_ERROR_INVALID_SIZE;
+    // Update statistics
+    ctx->total_allocated = ctx->total_allocated - old_size + new_size;
+    if (ctx->total_allocated > ctx->peak_usage) {
+        ctx->peak_usage = ctx->total_allocated;
     }
     
-    // Initialize context
-    memset(ctx, 0, sizeof(visualmem_context_t));
-    ctx->width = width;
-    ctx->height = height;
-    ctx->mode = mode;
-    
-    // Allocate framebuffer (this represents the actual screen/display)
-    size_t framebuffer_size = width * height * sizeof(uint32_t);
-    ctx->framebuffer = malloc(framebuffer_size);
-    if (!ctx->framebuffer) {
-        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    if (ctx->debug_mode) {
+        printf("Visual memory resized: %zu -> %zu bytes at visual address %p\n",
+               old_size, new_size, visual_addr);
     }
     
-    // Allocate temporary RAM buffer (will be freed in autonomous mode)
-    ctx->ram_buffer = malloc(framebuffer_size);
-    if (!ctx->ram_buffer) {
-        free(ctx->framebuffer);
-        return VISUALMEM_ERROR_ALLOCATION_FAILED;
+    return visual_addr;
+}
+
+void* visualmem_realloc(visualmem_context_t* ctx, void* visual_addr, size_t new_size) {
+    if (!ctx || !ctx->is_initialized) {
+        return NULL;
     }
     
-    // Initialize both buffers
-    uint32_t* framebuffer = (uint32_t*)ctx->framebuffer;
-    uint32_t* ram_buffer = (uint32_t*)ctx->ram_buffer;
-    
-    for (int i = 0; i < width * height; i++) {
-        framebuffer[i] = VISUALMEM_COLOR_FREE;
-        ram_buffer[i] = VISUALMEM_COLOR_FREE;
+    writer_lock(ctx);
+    void* resized = resize_allocation(ctx, visual_addr, new_size);
+    writer_unlock(ctx);
+    return resized;
+}
+
+// visualmem_arena_create under the writer lock
+static void* create_arena(visualmem_context_t* ctx, size_t size) {    
+    visualmem_arena_cache_t* cache = &ctx->arenas;
+    int32_t index = cache->free_record;
+    if (index < 0) {
+        if ((uintptr_t)cache->count > ARENA_INDEX_MASK) return NULL;
+        if (cache->count == cache->capacity) {
+            int new_capacity = cache->capacity ? cache->capacity * 2 : 8;
+            visualmem_arena_t* old = cache->arenas;
+            visualmem_arena_t* grown = grow_records(ctx, old, sizeof(*grown) * (size_t)cache->capacity,
+                                                    sizeof(*grown) * (size_t)new_capacity);
+            if (!grown) return NULL;
+            __atomic_store_n(&cache->arenas, grown, __ATOMIC_RELEASE);
+            retire_records(ctx, old);
+            cache->capacity = new_capacity;
+        }
+        index = cache->count;
+        memset(&cache->arenas[index], 0, sizeof(cache->arenas[index]));
     }
     
-    // Initialize allocation tracking
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        ctx->allocations[i].is_active = 0;
+    size_t byte_index;
+    if (!place_block(ctx, size, &byte_index)) {
+        return NULL;
     }
     
-    // Set status flags
-    ctx->is_initialized = 1;
-    ctx->ram_freed = 0;
-    ctx->autonomous_mode = 0;
-    ctx->enable_error_correction = 1;
-    ctx->enable_compression = 0;
-    ctx->debug_mode = 0;
+    // Commit the record only once the block is secured
+    if (index == cache->free_record) {
+        cache->free_record = cache->arenas[index].next_free;
+    } else {
+        __atomic_store_n(&cache->count, cache->count + 1, __ATOMIC_RELEASE);
+    }
     
-    // Write header to visual memory
-    visualmem_header_t header = {
-        .magic = VISUALMEM_MAGIC_HEADER,
-        .version = (LIBVISUALMEM_VERSION_MAJOR << 16) | (LIBVISUALMEM_VERSION_MINOR << 8) | LIBVISUALMEM_VERSION_PATCH,
-        .mode = mode,
-        .width = width,
-        .height = height,
-        .allocation_count = 0,
-        .timestamp = time(NULL)
-    };
+    // Lock-free lookups may hold a stale handle to a recycled record
+    visualmem_arena_t* arena = &cache->arenas[index];
+    __atomic_store_n(&arena->byte_index, byte_index, __ATOMIC_RELAXED);
+    __atomic_store_n(&arena->used, 0, __ATOMIC_RELAXED);
+    arena->capacity = size;
+    arena->high_water = 0;
+    __atomic_store_n(&arena->in_use, 1, __ATOMIC_RELEASE);
     
-    // Encode header into first pixels
-    uint8_t* header_bytes = (uint8_t*)&header;
-    for (size_t i = 0; i < sizeof(header); i++) {
-        encode_byte_to_pixels(ctx, i, header_bytes[i]);
+    // The arena counts as one allocation of its full capacity
+    ctx->total_allocated += size;
+    if (ctx->total_allocated > ctx->peak_usage) {
+        ctx->peak_usage = ctx->total_allocated;
     }
+    ctx->allocation_count++;
     
+    void* visual_addr = make_arena_handle(index, arena->generation, 0);
     if (ctx->debug_mode) {
-        printf("Visual memory initialized: %dx%d, mode=%d, framebuffer=%p, ram_buffer=%p\n",
-               width, height, mode, ctx->framebuffer, ctx->ram_buffer);
+        printf("Visual memory arena created: %zu bytes at visual address %p\n", size, visual_addr);
     }
     
-    return VISUALMEM_SUCCESS;
+    return visual_addr;
 }
 
-void visualmem_cleanup(visualmem_context_t* ctx) {
-    if (!ctx) return;
-    
-    if (ctx->ram_buffer) {
-        free(ctx->ram_buffer);
-        ctx->ram_buffer = NULL;
+void* visualmem_arena_create(visualmem_context_t* ctx, size_t size) {
+    if (!ctx || !ctx->is_initialized || size == 0 || size > HANDLE_SLOT_MASK) {
+        return NULL;
     }
     
-    if (ctx->framebuffer) {
-        free(ctx->framebuffer);
-        ctx->framebuffer = NULL;
+    writer_lock(ctx);
+    void* arena = create_arena(ctx, size);
+    writer_unlock(ctx);
+    return arena;
+}
+
+void* visualmem_arena_alloc(visualmem_context_t* ctx, void* arena, size_t size) {
+    if (!ctx || !arena || size == 0) {
+        return NULL;
     }
     
-    ctx->is_initialized = 0;
-    ctx->ram_freed = 1;
+    writer_lock(ctx);
+    visualmem_arena_t* record = arena_lookup(&ctx->arenas, arena);
+    void* visual_addr = record ? arena_bump(ctx, record, size) : NULL;
+    writer_unlock(ctx);
+    return visual_addr;
 }
 
-int visualmem_enter_autonomous_mode(visualmem_context_t* ctx) {
-    if (!ctx || !ctx->is_initialized) {
-        return VISUALMEM_ERROR_NOT_INITIALIZED;
+int visualmem_arena_reset(visualmem_context_t* ctx, void* arena) {
+    if (!ctx || !arena) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    if (ctx->ram_freed) {
-        return VISUALMEM_SUCCESS; // Already in autonomous mode
+    writer_lock(ctx);
+    visualmem_arena_t* record = arena_lookup(&ctx->arenas, arena);
+    if (!record) {
+        writer_unlock(ctx);
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
+    // A new epoch retires every allocation handle; the bytes are zeroed as
+    // bumps hand them out again (arena_claim)
+    __atomic_store_n(&record->epoch, record->epoch + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->used, 0, __ATOMIC_RELEASE);
+    writer_unlock(ctx);
+    
     if (ctx->debug_mode) {
-        printf("CRITICAL TRANSITION: Entering autonomous visual memory mode...\n");
-        printf("Before: RAM buffer=%p, Framebuffer=%p, RAM freed=%s\n",
-               ctx->ram_buffer, ctx->framebuffer, ctx->ram_freed ? "YES" : "NO");
+        printf("Visual memory arena reset at visual address %p\n", arena);
     }
     
-    // Final synchronization: copy RAM buffer to framebuffer
-    if (ctx->ram_buffer && ctx->framebuffer) {
-        memcpy(ctx->framebuffer, ctx->ram_buffer, 
-               ctx->width * ctx->height * sizeof(uint32_t));
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_arena_destroy(visualmem_context_t* ctx, void* arena) {
+    if (!ctx || !arena) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Free RAM buffer - THIS IS THE CRITICAL STEP
-    if (ctx->ram_buffer) {
-        free(ctx->ram_buffer);
-        ctx->ram_buffer = NULL;
-        ctx->ram_freed = 1;
-        ctx->autonomous_mode = 1;
+    writer_lock(ctx);
+    visualmem_arena_cache_t* cache = &ctx->arenas;
+    visualmem_arena_t* record = arena_lookup(cache, arena);
+    if (!record) {
+        writer_unlock(ctx);
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
+    ctx->total_allocated -= record->capacity;
+    ctx->allocation_count--;
+    
     if (ctx->debug_mode) {
-        printf("After: RAM buffer=%p, Framebuffer=%p, RAM freed=%s\n",
-               ctx->ram_buffer, ctx->framebuffer, ctx->ram_freed ? "YES" : "NO");
-        printf("✅ AUTONOMOUS MODE ACTIVE: System now operates solely on visual display memory\n");
+        printf("Visual memory arena destroyed: %zu bytes at visual address %p\n",
+               record->capacity, arena);
     }
     
+    // Retire the arena handle and every allocation handle, then recycle the
+    // record. The touched bytes are zeroed when the space is reused
+    __atomic_store_n(&record->generation, record->generation + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->epoch, record->epoch + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+    record->next_free = cache->free_record;
+    cache->free_record = (int32_t)(record - cache->arenas);
+    release_block(ctx, record->byte_index, record->high_water);
+    writer_unlock(ctx);
+    
     return VISUALMEM_SUCCESS;
 }
 
-void* visualmem_alloc(visualmem_context_t* ctx, size_t size, const char* label) {
-    if (!ctx || !ctx->is_initialized || size == 0) {
-        return NULL;
+int visualmem_write(visualmem_context_t* ctx, void* visual_addr, const void* data, size_t size) {
+    return visualmem_pwrite(ctx, visual_addr, 0, data, size);
+}
+
+int visualmem_read(visualmem_context_t* ctx, void* visual_addr, void* buffer, size_t size) {
+    return visualmem_pread(ctx, visual_addr, 0, buffer, size);
+}
+
+int visualmem_pwrite(visualmem_context_t* ctx, void* visual_addr, size_t offset,
+                     const void* data, size_t size) {
+    if (!ctx || !visual_addr || !data || size == 0) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Find free allocation slot
-    int slot = -1;
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        if (!ctx->allocations[i].is_active) {
-            slot = i;
-            break;
-        }
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
     }
     
-    if (slot == -1) {
-        return NULL; // No free slots
+    // Find allocation, then encode just the range through the span kernels
+    size_t byte_offset, alloc_size;
+    int result;
+    if (!resolve_address(ctx, visual_addr, &byte_offset, &alloc_size)) {
+        result = VISUALMEM_ERROR_INVALID_ADDRESS;
+    } else if (offset > alloc_size || size > alloc_size - offset) {
+        result = VISUALMEM_ERROR_INVALID_SIZE;
+    } else {
+        result = encode_bytes(ctx, byte_offset + offset, (const uint8_t*)data, size);
+    }
+    reader_exit(reader);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
     }
     
-    // Calculate position for this allocation
-    // Simple linear allocation for now
-    int start_byte = VISUALMEM_HEADER_SIZE + ctx->allocation_count * 200; // Space allocations apart
-    int max_bytes = ((ctx->width - VISUALMEM_MEMORY_START_X) / VISUALMEM_BYTE_SPACING_X) *
-                    ((ctx->height - VISUALMEM_MEMORY_START_Y) / VISUALMEM_BYTE_SPACING_Y);
+    count_operation(ctx);
     
-    if (start_byte + (int)size > max_bytes) {
-        return NULL; // Not enough visual memory
+    if (ctx->debug_mode) {
+        printf("Visual memory write: %zu bytes to visual address %p + %zu\n", size, visual_addr, offset);
     }
     
-    // Create allocation record
-    ctx->allocations[slot].visual_addr = coord_to_addr(start_byte, 0);
-    ctx->allocations[slot].size = size;
-    ctx->allocations[slot].checksum = 0; // Will be calculated on write
-    ctx->allocations[slot].timestamp = time(NULL);
-    ctx->allocations[slot].is_active = 1;
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_pread(visualmem_context_t* ctx, void* visual_addr, size_t offset,
+                    void* buffer, size_t size) {
+    if (!ctx || !visual_addr || !buffer || size == 0) {
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    }
     
-    if (label) {
-        strncpy(ctx->allocations[slot].label, label, sizeof(ctx->allocations[slot].label) - 1);
-        ctx->allocations[slot].label[sizeof(ctx->allocations[slot].label) - 1] = '\0';
-    } else {
-        ctx->allocations[slot].label[0] = '\0';
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
     }
     
-    // Update statistics
-    ctx->total_allocated += size;
-    if (ctx->total_allocated > ctx->peak_usage) {
-        ctx->peak_usage = ctx->total_allocated;
+    // Find allocation, then decode just the range through the span kernels
+    size_t byte_offset, alloc_size;
+    int result = VISUALMEM_SUCCESS;
+    if (!resolve_address(ctx, visual_addr, &byte_offset, &alloc_size)) {
+        result = VISUALMEM_ERROR_INVALID_ADDRESS;
+    } else if (offset > alloc_size || size > alloc_size - offset) {
+        result = VISUALMEM_ERROR_INVALID_SIZE;
+    } else {
+        decode_bytes(ctx, byte_offset + offset, (uint8_t*)buffer, size);
     }
-    ctx->allocation_count++;
+    reader_exit(reader);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
+    }
+    
+    count_operation(ctx);
     
     if (ctx->debug_mode) {
-        printf("Visual memory allocated: %zu bytes at visual address %p, label='%s'\n",
-               size, ctx->allocations[slot].visual_addr, 
-               ctx->allocations[slot].label);
+        printf("Visual memory read: %zu bytes from visual address %p + %zu\n", size, visual_addr, offset);
     }
     
-    return ctx->allocations[slot].visual_addr;
+    return VISUALMEM_SUCCESS;
 }
 
-int visualmem_free(visualmem_context_t* ctx, void* visual_addr) {
-    if (!ctx || !visual_addr) {
+int visualmem_writev(visualmem_context_t* ctx, const visualmem_iovec_t* iov, int count) {
+    if (!ctx || !iov || count <= 0) {
         return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Find allocation
-    int slot = -1;
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        if (ctx->allocations[i].is_active && 
-            ctx->allocations[i].visual_addr == visual_addr) {
-            slot = i;
-            break;
+    batch_span_t* spans = malloc(sizeof(*spans) * (size_t)count);
+    visualmem_reader_t* reader;
+    if (!spans || !reader_enter(ctx, &reader)) {
+        free(spans);
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    int result = resolve_iovecs(ctx, iov, count, spans);
+    
+    // Overlapping writes would have no defined order
+    for (int i = 1; i < count && result == VISUALMEM_SUCCESS; i++) {
+        if (spans[i].byte_index < spans[i - 1].byte_index + spans[i - 1].size) {
+            result = VISUALMEM_ERROR_INVALID_ADDRESS;
         }
     }
     
-    if (slot == -1) {
-        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    uint8_t* staging = NULL;
+    if (result == VISUALMEM_SUCCESS) {
+        staging = run_staging(spans, count, &result);
     }
     
-    // Clear visual memory area
-    int x, y;
-    addr_to_coord(visual_addr, &x, &y);
+    // Gather each run of consecutive ranges and encode it in one pass
+    int runs = 0;
+    for (int first = 0; first < count && result == VISUALMEM_SUCCESS; runs++) {
+        size_t run_bytes;
+        int end = run_end(spans, first, count, &run_bytes);
+        const uint8_t* src = (const uint8_t*)iov[spans[first].entry].buffer;
+        if (end - first > 1) {
+            size_t at = 0;
+            for (int i = first; i < end; i++) {
+                memcpy(staging + at, iov[spans[i].entry].buffer, spans[i].size);
+                at += spans[i].size;
+            }
+            src = staging;
+        }
+        result = encode_bytes(ctx, spans[first].byte_index, src, run_bytes);
+        first = end;
+    }
+    reader_exit(reader);
     
-    // Clear the allocated pixels
-    for (size_t i = 0; i < ctx->allocations[slot].size; i++) {
-        encode_byte_to_pixels(ctx, x + i, 0);
+    free(staging);
+    free(spans);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
     }
     
-    // Update statistics
-    ctx->total_allocated -= ctx->allocations[slot].size;
-    ctx->allocation_count--;
+    count_operation(ctx);
     
     if (ctx->debug_mode) {
-        printf("Visual memory freed: %zu bytes at visual address %p, label='%s'\n",
-               ctx->allocations[slot].size, visual_addr, 
-               ctx->allocations[slot].label);
+        printf("Visual memory writev: %d ranges in %d runs\n", count, runs);
     }
     
-    // Mark allocation as inactive
-    ctx->allocations[slot].is_active = 0;
-    
     return VISUALMEM_SUCCESS;
 }
 
-int visualmem_write(visualmem_context_t* ctx, void* visual_addr, const void* data, size_t size) {
-    if (!ctx || !visual_addr || !data || size == 0) {
+int visualmem_readv(visualmem_context_t* ctx, const visualmem_iovec_t* iov, int count) {
+    if (!ctx || !iov || count <= 0) {
         return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Find allocation
-    const visualmem_allocation_t* alloc = visualmem_get_allocation_info(ctx, visual_addr);
-    if (!alloc) {
-        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    batch_span_t* spans = malloc(sizeof(*spans) * (size_t)count);
+    visualmem_reader_t* reader;
+    if (!spans || !reader_enter(ctx, &reader)) {
+        free(spans);
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
     }
     
-    if (size > alloc->size) {
-        return VISUALMEM_ERROR_INVALID_SIZE;
+    int result = resolve_iovecs(ctx, iov, count, spans);
+    uint8_t* staging = NULL;
+    if (result == VISUALMEM_SUCCESS) {
+        staging = run_staging(spans, count, &result);
     }
     
-    // Get starting byte position from allocation table
-    int byte_offset = -1;
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        if (ctx->allocations[i].is_active && ctx->allocations[i].visual_addr == visual_addr) {
-            int x, y;
-            addr_to_coord(visual_addr, &x, &y);
-            byte_offset = x;
-            break;
+    // Decode each run of consecutive ranges in one pass, then scatter it
+    int runs = 0;
+    for (int first = 0; first < count && result == VISUALMEM_SUCCESS; runs++) {
+        size_t run_bytes;
+        int end = run_end(spans, first, count, &run_bytes);
+        if (end - first == 1) {
+            decode_bytes(ctx, spans[first].byte_index, (uint8_t*)iov[spans[first].entry].buffer, run_bytes);
+        } else {
+            decode_bytes(ctx, spans[first].byte_index, staging, run_bytes);
+            size_t at = 0;
+            for (int i = first; i < end; i++) {
+                memcpy(iov[spans[i].entry].buffer, staging + at, spans[i].size);
+                at += spans[i].size;
+            }
         }
+        first = end;
     }
+    reader_exit(reader);
     
-    if (byte_offset == -1) {
-        return VISUALMEM_ERROR_INVALID_ADDRESS;
-    }
-    
-    // Write data byte by byte to visual memory
-    const uint8_t* src_bytes = (const uint8_t*)data;
-    for (size_t i = 0; i < size; i++) {
-        encode_byte_to_pixels(ctx, byte_offset + i, src_bytes[i]);
+    free(staging);
+    free(spans);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
     }
     
-    ctx->operations_count++;
+    count_operation(ctx);
     
     if (ctx->debug_mode) {
-        printf("Visual memory write: %zu bytes to visual address %p\n", size, visual_addr);
+        printf("Visual memory readv: %d ranges in %d runs\n", count, runs);
     }
     
     return VISUALMEM_SUCCESS;
 }
 
-int visualmem_read(visualmem_context_t* ctx, void* visual_addr, void* buffer, size_t size) {
-    if (!ctx || !visual_addr || !buffer || size == 0) {
+int visualmem_copy(visualmem_context_t* ctx, void* dest_addr, void* src_addr, size_t size) {
+    if (!ctx || !dest_addr || !src_addr || size == 0) {
         return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Find allocation
-    const visualmem_allocation_t* alloc = visualmem_get_allocation_info(ctx, visual_addr);
-    if (!alloc) {
-        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
     }
     
-    if (size > alloc->size) {
-        return VISUALMEM_ERROR_INVALID_SIZE;
+    size_t dest_offset, dest_size, src_offset, src_size;
+    int result = VISUALMEM_SUCCESS;
+    if (!resolve_address(ctx, dest_addr, &dest_offset, &dest_size) ||
+        !resolve_address(ctx, src_addr, &src_offset, &src_size)) {
+        result = VISUALMEM_ERROR_INVALID_ADDRESS;
+    } else if (size > dest_size || size > src_size) {
+        result = VISUALMEM_ERROR_INVALID_SIZE;
+    } else if (dest_offset != src_offset) {
+        // Allocations never overlap, so the only overlapping copy is onto itself
+        result = copy_bytes(ctx, dest_offset, src_offset, size);
+    }
+    reader_exit(reader);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
     }
     
-    // Get starting byte position from allocation table
-    int byte_offset = -1;
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        if (ctx->allocations[i].is_active && ctx->allocations[i].visual_addr == visual_addr) {
-            int x, y;
-            addr_to_coord(visual_addr, &x, &y);
-            byte_offset = x;
-            break;
-        }
+    count_operation(ctx);
+    
+    if (ctx->debug_mode) {
+        printf("Visual memory copy: %zu bytes from %p to %p\n", size, src_addr, dest_addr);
     }
     
-    if (byte_offset == -1) {
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_set(visualmem_context_t* ctx, void* visual_addr, int value, size_t size) {
+    if (!ctx || !visual_addr || size == 0) {
         return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    // Read data byte by byte from visual memory
-    uint8_t* dest_bytes = (uint8_t*)buffer;
-    for (size_t i = 0; i < size; i++) {
-        dest_bytes[i] = decode_byte_from_pixels(ctx, byte_offset + i);
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    size_t byte_offset, alloc_size;
+    int result;
+    if (!resolve_address(ctx, visual_addr, &byte_offset, &alloc_size)) {
+        result = VISUALMEM_ERROR_INVALID_ADDRESS;
+    } else if (size > alloc_size) {
+        result = VISUALMEM_ERROR_INVALID_SIZE;
+    } else {
+        result = fill_bytes(ctx, byte_offset, (uint8_t)value, size);
+    }
+    reader_exit(reader);
+    if (result != VISUALMEM_SUCCESS) {
+        return result;
     }
     
-    ctx->operations_count++;
+    count_operation(ctx);
     
     if (ctx->debug_mode) {
-        printf("Visual memory read: %zu bytes from visual address %p\n", size, visual_addr);
+        printf("Visual memory set: %zu bytes of 0x%02X at visual address %p\n",
+               size, (unsigned)(uint8_t)value, visual_addr);
     }
     
     return VISUALMEM_SUCCESS;
@@ -459,17 +3147,28 @@ int visualmem_read(visualmem_context_t* ctx, void* visual_addr, void* buffer, si
 int visualmem_write_string(visualmem_context_t* ctx, void* visual_addr, const char* str) {
     if (!str) return VISUALMEM_ERROR_INVALID_ADDRESS;
     
+    visualmem_reader_t* reader;
+    if (!ctx) return VISUALMEM_ERROR_INVALID_ADDRESS;
+    if (!reader_enter(ctx, &reader)) return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    
     size_t len = strlen(str);
-    int result = visualmem_write(ctx, visual_addr, str, len);
-    if (result != VISUALMEM_SUCCESS) return result;
+    size_t byte_offset, alloc_size;
+    int result;
+    if (!resolve_address(ctx, visual_addr, &byte_offset, &alloc_size)) {
+        result = VISUALMEM_ERROR_INVALID_ADDRESS;
+    } else if (len + 1 > alloc_size) {
+        result = VISUALMEM_ERROR_INVALID_SIZE; // Terminator would land in a neighbour
+    } else {
+        result = visualmem_write(ctx, visual_addr, str, len);
+    }
     
     // Write null terminator
-    uint8_t null_byte = 0;
-    int x, y;
-    addr_to_coord(visual_addr, &x, &y);
-    encode_byte_to_pixels(ctx, x + len, null_byte);
-    
-    return VISUALMEM_SUCCESS;
+    if (result == VISUALMEM_SUCCESS) {
+        uint8_t null_byte = 0;
+        result = encode_bytes(ctx, byte_offset + len, &null_byte, 1);
+    }
+    reader_exit(reader);
+    return result;
 }
 
 int visualmem_read_string(visualmem_context_t* ctx, void* visual_addr, char* buffer, size_t max_length) {
@@ -477,12 +3176,21 @@ int visualmem_read_string(visualmem_context_t* ctx, void* visual_addr, char* buf
         return VISUALMEM_ERROR_INVALID_ADDRESS;
     }
     
-    int x, y;
-    addr_to_coord(visual_addr, &x, &y);
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) {
+        return VISUALMEM_ERROR_OUT_OF_MEMORY;
+    }
+    
+    size_t byte_offset, alloc_size;
+    if (!resolve_address(ctx, visual_addr, &byte_offset, &alloc_size)) {
+        reader_exit(reader);
+        return VISUALMEM_ERROR_INVALID_ADDRESS;
+    }
     
     // Read characters until null terminator or max length
     for (size_t i = 0; i < max_length - 1; i++) {
-        uint8_t byte_value = decode_byte_from_pixels(ctx, x + i);
+        uint8_t byte_value;
+        decode_bytes(ctx, byte_offset + i, &byte_value, 1);
         buffer[i] = (char)byte_value;
         
         if (byte_value == 0) {
@@ -490,6 +3198,7 @@ int visualmem_read_string(visualmem_context_t* ctx, void* visual_addr, char* buf
         }
     }
     
+    reader_exit(reader);
     buffer[max_length - 1] = '\0'; // Ensure null termination
     
     return VISUALMEM_SUCCESS;
@@ -498,27 +3207,160 @@ int visualmem_read_string(visualmem_context_t* ctx, void* visual_addr, char* buf
 const visualmem_allocation_t* visualmem_get_allocation_info(visualmem_context_t* ctx, void* visual_addr) {
     if (!ctx || !visual_addr) return NULL;
     
-    for (int i = 0; i < VISUALMEM_MAX_ALLOCATIONS; i++) {
-        if (ctx->allocations[i].is_active && 
-            ctx->allocations[i].visual_addr == visual_addr) {
-            return &ctx->allocations[i];
-        }
+    // Each thread fills its own record in thread-safe mode
+    visualmem_reader_t* reader;
+    if (!reader_enter(ctx, &reader)) return NULL;
+    visualmem_allocation_t* info = reader ? &reader->info : &ctx->allocation_info;
+    
+    // One index plus a handle compare; the handle carries the generation
+    if (!resolve_address(ctx, visual_addr, &info->byte_index, &info->size)) {
+        reader_exit(reader);
+        return NULL;
+    }
+    
+    info->visual_addr = visual_addr;
+    info->is_active = 1;
+    if (is_slab_handle(visual_addr) || is_arena_handle(visual_addr)) {
+        info->checksum = 0;
+        info->timestamp = 0;
+        info->label[0] = '\0'; // Slab objects and arena allocations keep no label
+    } else {
+        const visualmem_alloc_table_t* table = &ctx->allocations;
+        int slot = handle_slot(visual_addr);
+        info->checksum = __atomic_load_n(&table->checksum, __ATOMIC_ACQUIRE)[slot];
+        info->timestamp = __atomic_load_n(&table->timestamp, __ATOMIC_ACQUIRE)[slot];
+        memcpy(info->label, __atomic_load_n(&table->label, __ATOMIC_ACQUIRE)[slot], sizeof(info->label));
     }
+    reader_exit(reader);
     
-    return NULL;
+    return info;
+}
+
+size_t visualmem_get_capacity(visualmem_context_t* ctx) {
+    if (!ctx || !ctx->is_initialized) return 0;
+    return ctx->capacity_bytes;
 }
 
 void visualmem_get_stats(visualmem_context_t* ctx, size_t* total_allocated, 
                         size_t* peak_usage, int* fragmentation) {
     if (!ctx) return;
     
+    writer_lock(ctx);
     if (total_allocated) *total_allocated = ctx->total_allocated;
     if (peak_usage) *peak_usage = ctx->peak_usage;
     if (fragmentation) {
-        // Simple fragmentation calculation
-        *fragmentation = ctx->allocation_count > 1 ? 
-            (ctx->allocation_count * 10) : 0; // Rough estimate
+        // Share of free space stranded in holes below the highest live block
+        const visualmem_buddy_t* buddy = &ctx->buddy;
+        int32_t live_units = buddy->unit_count - buddy->free_units;
+        int32_t hole_units = live_extent(ctx) - live_units;
+        *fragmentation = buddy->free_units > 0 ?
+            (int)((int64_t)hole_units * 100 / buddy->free_units) : 0;
+    }
+    writer_unlock(ctx);
+}
+
+int visualmem_defragment_step(visualmem_context_t* ctx, size_t byte_budget, size_t* bytes_moved) {
+    if (bytes_moved) *bytes_moved = 0;
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    
+    writer_lock(ctx);
+    visualmem_buddy_t* buddy = &ctx->buddy;
+    size_t moved = 0;
+    int result = VISUALMEM_SUCCESS;
+    
+    // The first move always happens, even past the budget, so steps make progress
+    while (moved == 0 || moved < byte_budget) {
+        int32_t lowest[VISUALMEM_ALLOC_MAX_ORDER + 1];
+        defrag_block_t block;
+        buddy_lowest_free(buddy, lowest);
+        if (!defrag_pick(ctx, lowest, &block)) break;
+        
+        int32_t target = lowest[block.order];
+        buddy_take(buddy, target, block.order);
+        size_t src = buddy->base + (size_t)block.unit * VISUALMEM_ALLOC_UNIT;
+        size_t dst = buddy->base + (size_t)target * VISUALMEM_ALLOC_UNIT;
+        size_t size, stale; // Bytes to carry over, bytes left dirty behind
+        if (block.kind == DEFRAG_SLAB) {
+            size = ((size_t)VISUALMEM_SLAB_MIN_OBJECT << ctx->slabs.slabs[block.index].size_class) * VISUALMEM_SLAB_OBJECTS;
+            stale = size;
+        } else if (block.kind == DEFRAG_ARENA) {
+            size = ctx->arenas.arenas[block.index].used;
+            stale = ctx->arenas.arenas[block.index].high_water;
+        } else {
+            size = ctx->allocations.size[block.index];
+            stale = size;
+        }
+        
+        claim_bytes(ctx, dst, size);
+        result = copy_bytes(ctx, dst, src, size);
+        if (result != VISUALMEM_SUCCESS) {
+            release_block(ctx, dst, size); // Data is still intact at the old place
+            break;
+        }
+        
+        // Repoint the handle's record, then return the old block for clearing
+        if (block.kind == DEFRAG_SLAB) {
+            __atomic_store_n(&ctx->slabs.slabs[block.index].byte_index, dst, __ATOMIC_RELAXED);
+        } else if (block.kind == DEFRAG_ARENA) {
+            __atomic_store_n(&ctx->arenas.arenas[block.index].byte_index, dst, __ATOMIC_RELAXED);
+            ctx->arenas.arenas[block.index].high_water = size;
+        } else {
+            __atomic_store_n(&ctx->allocations.byte_index[block.index], dst, __ATOMIC_RELAXED);
+        }
+        release_block(ctx, src, stale);
+        moved += size;
+    }
+    
+    count_operation(ctx);
+    writer_unlock(ctx);
+    if (bytes_moved) *bytes_moved = moved;
+    return result;
+}
+
+int visualmem_scrub(visualmem_context_t* ctx, size_t byte_budget, size_t* bytes_cleared) {
+    if (bytes_cleared) *bytes_cleared = 0;
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_ERROR_NOT_INITIALIZED;
+    }
+    
+    writer_lock(ctx);
+    visualmem_buddy_t* buddy = &ctx->buddy;
+    size_t cleared = 0;
+    
+    // Resume where the last slice stopped; each dirty run is one fill
+    while (buddy->dirty_units > 0 && cleared < byte_budget) {
+        if (buddy->scrub_cursor >= buddy->unit_count) buddy->scrub_cursor = 0;
+        int32_t unit = buddy->scrub_cursor;
+        if (!buddy->dirty[unit]) {
+            buddy->scrub_cursor++;
+            continue;
+        }
+        
+        size_t units_left = (byte_budget - cleared + VISUALMEM_ALLOC_UNIT - 1) / VISUALMEM_ALLOC_UNIT;
+        int32_t end = unit;
+        while (end < buddy->unit_count && buddy->dirty[end] && (size_t)(end - unit) < units_left) {
+            end++;
+        }
+        cleared += clear_dirty_units(ctx, unit, end);
+        buddy->scrub_cursor = end;
+    }
+    writer_unlock(ctx);
+    
+    if (bytes_cleared) *bytes_cleared = cleared;
+    return VISUALMEM_SUCCESS;
+}
+
+int visualmem_defragment(visualmem_context_t* ctx) {
+    size_t moved;
+    int result = visualmem_defragment_step(ctx, (size_t)-1, &moved);
+    
+    if (result == VISUALMEM_SUCCESS && ctx->debug_mode) {
+        printf("Visual memory defragmented: %zu bytes moved\n", moved);
     }
+    
+    return result;
 }
 
 const char* visualmem_get_error_string(visualmem_error_t error_code) {
@@ -542,15 +3384,34 @@ const char* visualmem_get_version(void) {
     return LIBVISUALMEM_VERSION;
 }
 
+const char* visualmem_get_codec_backend(void) {
+    codec_dispatch_init();
+    return codec_backend_name;
+}
+
 void visualmem_set_debug_mode(visualmem_context_t* ctx, int enable) {
     if (ctx) {
         ctx->debug_mode = enable;
     }
 }
 
+uint32_t visualmem_get_pixel(visualmem_context_t* ctx, int x, int y) {
+    if (!ctx || !ctx->is_initialized || x < 0 || x >= ctx->width || y < 0 || y >= ctx->height) {
+        return 0;
+    }
+    writer_lock(ctx);
+    materialize_pixels(ctx);
+    uint32_t color = pixel_at(ctx, x, y);
+    writer_unlock(ctx);
+    return color;
+}
+
 void visualmem_display_contents(visualmem_context_t* ctx, const visualmem_rect_t* rect) {
     if (!ctx || !ctx->framebuffer) return;
     
+    writer_lock(ctx);
+    materialize_pixels(ctx);
+    
     int start_x = rect ? rect->x : 0;
     int start_y = rect ? rect->y : 0;
     int end_x = rect ? (rect->x + rect->width) : ctx->width;
@@ -560,9 +3421,13 @@ void visualmem_display_contents(visualmem_context_t* ctx, const visualmem_rect_t
     if (end_y > ctx->height) end_y = ctx->height;
     
     printf("\n=== Visual Memory Contents ===\n");
-    printf("Legend: '.'=bit0, '#'=bit1, 'S'=start, 'E'=end, ' '=free\n\n");
-    
-    uint32_t* framebuffer = (uint32_t*)ctx->framebuffer;
+    if (ctx->encoding == VISUALMEM_ENCODING_BINARY) {
+        printf("Legend: '.'=bit0, '#'=bit1, 'S'=start, 'E'=end, ' '=free\n\n");
+    } else if (ctx->encoding == VISUALMEM_ENCODING_BINARY_FRAMED) {
+        printf("Legend: '|'=block header, '.'=bit0, '#'=bit1, ' '=free\n\n");
+    } else {
+        printf("Legend: '|'=block header, '.'=empty pixel, '#'=data pixel, ' '=free\n\n");
+    }
     
     // Show first 80 characters of each row for readability
     int display_width = (end_x - start_x > 80) ? 80 : (end_x - start_x);
@@ -570,9 +3435,25 @@ void visualmem_display_contents(visualmem_context_t* ctx, const visualmem_rect_t
     for (int y = start_y; y < end_y && y < start_y + 20; y++) {
         printf("%2d ", y);
         for (int x = start_x; x < start_x + display_width; x++) {
-            uint32_t color = framebuffer[y * ctx->width + x];
+            uint32_t color = pixel_at(ctx, x, y);
             
             char c = ' ';
+            if (ctx->encoding != VISUALMEM_ENCODING_BINARY) {
+                // Framed rows: classify header pixels by position, payload by color
+                int row = y - VISUALMEM_MEMORY_START_Y;
+                if (x < VISUALMEM_MEMORY_START_X || row < 0 ||
+                    (size_t)row * ctx->bytes_per_row >= ctx->capacity_bytes) {
+                    c = ' ';
+                } else if (x < VISUALMEM_MEMORY_START_X + VISUALMEM_BLOCK_HEADER_PIXELS) {
+                    c = '|';
+                } else {
+                    uint32_t payload_mask = ctx->encoding == VISUALMEM_ENCODING_DENSE_RGBA ?
+                        0xFFFFFFFF : 0x00FFFFFF;
+                    c = (color & payload_mask) ? '#' : '.';
+                }
+                printf("%c", c);
+                continue;
+            }
             switch (color & 0x00FFFFFF) {
                 case (VISUALMEM_COLOR_BIT_0 & 0x00FFFFFF): c = '.'; break;
                 case (VISUALMEM_COLOR_BIT_1 & 0x00FFFFFF): c = '#'; break;
@@ -587,5 +3468,6 @@ void visualmem_display_contents(visualmem_context_t* ctx, const visualmem_rect_t
         printf("\n");
     }
     
+    writer_unlock(ctx);
     printf("\n=== End Visual Memory Contents ===\n");
 }
\ No newline at end of file
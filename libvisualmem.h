@@ -33,8 +33,16 @@
 #define VISUALMEM_MAX_WIDTH 1920
 #define VISUALMEM_MAX_HEIGHT 1080
 #define VISUALMEM_BITS_PER_BYTE 8
-#define VISUALMEM_MAX_ALLOCATIONS 1024
+#define VISUALMEM_ALLOC_TABLE_INITIAL 64  // Allocation slots on first alloc; the table doubles on demand
 #define VISUALMEM_HEADER_SIZE 64  // Reserved screen area for metadata
+#define VISUALMEM_ALLOC_UNIT 32        // Smallest allocator block in payload bytes
+#define VISUALMEM_ALLOC_MAX_ORDER 26   // Largest block: VISUALMEM_ALLOC_UNIT << 26 bytes
+#define VISUALMEM_SLAB_MIN_OBJECT 16   // Smallest slab object in payload bytes
+#define VISUALMEM_SLAB_CLASSES 4       // Slab object sizes 16, 32, 64 and 128 bytes
+#define VISUALMEM_SLAB_MAX_OBJECT (VISUALMEM_SLAB_MIN_OBJECT << (VISUALMEM_SLAB_CLASSES - 1))
+#define VISUALMEM_SLAB_OBJECTS 64      // Objects per slab (one free bitmap word)
+#define VISUALMEM_ARENA_HEADER 4       // In-band length stored before each arena allocation
+#define VISUALMEM_ARENA_ALIGN 4        // Arena allocations start on this byte boundary
 
 // === MEMORY MODES ===
 typedef enum {
@@ -55,6 +63,17 @@ typedef enum {
     VISUALMEM_COLOR_RESERVED  = 0xFF800080   // Purple for reserved areas
 } visualmem_color_t;
 
+// === PAYLOAD ENCODINGS ===
+typedef enum {
+    VISUALMEM_ENCODING_BINARY,        // 10 pixels per byte: start marker, 8 bit pixels, end marker
+    VISUALMEM_ENCODING_DENSE_RGB,     // 3 bytes per pixel packed into R/G/B, one framed block per row
+    VISUALMEM_ENCODING_DENSE_RGBA,    // 4 bytes per pixel packed into R/G/B/A, one framed block per row
+    VISUALMEM_ENCODING_PALETTE_2BPP,  // 4-color palette, 2 bits per pixel, one framed block per row
+    VISUALMEM_ENCODING_PALETTE_4BPP,  // 16-color palette, 4 bits per pixel, one framed block per row
+    VISUALMEM_ENCODING_PALETTE_8BPP,  // 256-color palette, 8 bits per pixel, one framed block per row
+    VISUALMEM_ENCODING_BINARY_FRAMED  // 8 black/white pixels per byte, one framed block per row (no per-byte markers)
+} visualmem_encoding_t;
+
 // === ERROR CODES ===
 typedef enum {
     VISUALMEM_SUCCESS = 0,
@@ -72,7 +91,8 @@ typedef enum {
 
 // === MEMORY ALLOCATION INFO ===
 typedef struct {
-    void* visual_addr;        // Visual coordinate address (x,y encoded)
+    void* visual_addr;        // Visual address (opaque handle: slot + generation)
+    size_t byte_index;       // First payload byte of the allocation
     size_t size;             // Allocated size in bytes
     uint32_t checksum;       // Data integrity checksum
     uint64_t timestamp;      // Allocation timestamp
@@ -80,6 +100,87 @@ typedef struct {
     char label[32];          // Optional allocation label
 } visualmem_allocation_t;
 
+// === ALLOCATION TABLE ===
+// Structure-of-arrays table, grown on demand. Lookups touch only the packed
+// hot arrays; checksums, timestamps and labels live in their own arrays.
+// A handle carries its slot in the low half of a pointer, below two flag
+// bits, which bounds the table: 2^30 - 1 slots on 64-bit builds, 16383 on
+// 32-bit ones. Past that, allocations that need a slot return NULL.
+typedef struct {
+    // Hot: read on every access
+    size_t* byte_index;         // First payload byte
+    size_t* size;               // Allocated size in bytes
+    uint32_t* generation;       // Bumped on free so stale handles no longer match
+    uint8_t* is_active;
+    // Cold
+    uint32_t* checksum;
+    uint64_t* timestamp;
+    char (*label)[32];
+    int* free_slots;            // Stack of inactive slots
+    int free_slot_count;
+    int capacity;               // Slots in each array
+} visualmem_alloc_table_t;
+
+// === ADDRESS SPACE ALLOCATOR ===
+// Buddy allocator state over the payload bytes (see libvisualmem.c)
+typedef struct {
+    size_t base;                // Payload byte of unit 0
+    int unit_count;             // VISUALMEM_ALLOC_UNIT-byte units managed
+    int free_units;             // Units in free blocks
+    uint8_t* block_state;       // Per unit: order (+ free flag) of the block starting there
+    int32_t* free_next;         // Free-list links, valid at free block heads
+    int32_t* free_prev;
+    int32_t free_head[VISUALMEM_ALLOC_MAX_ORDER + 1];
+    uint32_t free_orders;       // Bit k set while order k has a free block
+    uint8_t* dirty;             // Per unit: freed, pixels not zeroed yet
+    int dirty_units;
+    int32_t scrub_cursor;       // Unit where visualmem_scrub resumes
+} visualmem_buddy_t;
+
+// === SMALL OBJECT SLABS ===
+// Unlabelled allocations of up to VISUALMEM_SLAB_MAX_OBJECT bytes share
+// slabs of same-size objects instead of taking an allocation table slot
+typedef struct {
+    size_t byte_index;          // First payload byte of the slab's buddy block
+    uint64_t free_mask;         // Bit i set while object i is free
+    int32_t next;               // Partial list of the size class, or free record list
+    int32_t prev;
+    uint64_t retired_mask;      // Objects whose generation ran out: never handed out again
+    uint8_t size_class;         // Objects are VISUALMEM_SLAB_MIN_OBJECT << size_class bytes
+    uint8_t in_use;             // Slab currently owns a buddy block
+    uint32_t generation[VISUALMEM_SLAB_OBJECTS]; // Bumped on free so stale handles no longer match
+    uint8_t size[VISUALMEM_SLAB_OBJECTS];        // Requested size - 1
+} visualmem_slab_t;
+
+typedef struct {
+    visualmem_slab_t* slabs;
+    int count;                  // Slab records handed out so far
+    int capacity;
+    int32_t partial_head[VISUALMEM_SLAB_CLASSES];  // Slabs with free objects, per size class
+    int32_t free_record;        // Released slab records, reused before new ones
+} visualmem_slab_cache_t;
+
+// === ARENAS ===
+// Bump allocation inside one buddy block; allocations are released only
+// together, by resetting or destroying the arena
+typedef struct {
+    size_t byte_index;          // First payload byte of the arena's buddy block
+    size_t capacity;            // Bytes requested at creation
+    size_t used;                // Bump offset of the next allocation header
+    size_t high_water;          // Highest used offset since creation: bytes destroy marks dirty, bumps clear
+    uint32_t generation;        // Bumped on destroy so stale arena handles no longer match
+    uint32_t epoch;             // Bumped on reset and destroy: invalidates allocation handles
+    int32_t next_free;          // Free record list
+    uint8_t in_use;
+} visualmem_arena_t;
+
+typedef struct {
+    visualmem_arena_t* arenas;
+    int count;                  // Arena records handed out so far
+    int capacity;
+    int32_t free_record;        // Released arena records, reused before new ones
+} visualmem_arena_cache_t;
+
 // === VISUAL MEMORY CONTEXT ===
 typedef struct {
     // Display properties
@@ -87,11 +188,26 @@ typedef struct {
     int height;
     visualmem_mode_t mode;
     
+    // Payload layout
+    visualmem_encoding_t encoding;
+    int bytes_per_row;          // Payload bytes stored per visual row
+    size_t capacity_bytes;      // Total addressable payload bytes
+    
     // Memory management
     void* framebuffer;          // Visual display buffer
     void* ram_buffer;           // Temporary RAM buffer (freed after init)
-    visualmem_allocation_t allocations[VISUALMEM_MAX_ALLOCATIONS];
+    int pixel_bits;             // Bits per stored pixel: 32 (ARGB) or 4 (color index)
+    size_t framebuffer_size;    // Bytes in each pixel buffer when fully materialized
+    size_t resident_bytes;      // Pixel bytes actually allocated (sparse tiles count once written)
+    uint8_t* raw_store;         // Payload bytes while lazy pixels are on (simulate mode)
+    uint64_t* stale_rows;       // Payload rows whose pixels lag the raw store
+    visualmem_alloc_table_t allocations;
     int allocation_count;
+    visualmem_allocation_t allocation_info;  // Record filled by visualmem_get_allocation_info
+    visualmem_buddy_t buddy;    // Free blocks of the payload area
+    visualmem_slab_cache_t slabs;  // Small unlabelled allocations
+    visualmem_arena_cache_t arenas;  // Bump-allocated regions
+    struct visualmem_sync* sync;  // Thread-safe mode state, NULL while off
     
     // Status flags
     int is_initialized;
@@ -118,6 +234,15 @@ typedef struct {
     int height;
 } visualmem_rect_t;
 
+// === VECTORED ACCESS ===
+// One entry of visualmem_writev / visualmem_readv
+typedef struct {
+    void* visual_addr;       // Allocation to access
+    size_t offset;           // First byte inside the allocation
+    void* buffer;            // Source for writev, destination for readv
+    size_t size;             // Bytes to transfer
+} visualmem_iovec_t;
+
 // === CORE LIBRARY FUNCTIONS ===
 
 /**
@@ -130,6 +255,18 @@ typedef struct {
  */
 int visualmem_init(visualmem_context_t* ctx, visualmem_mode_t mode, int width, int height);
 
+/**
+ * Initialize visual memory system with a specific payload encoding
+ * @param ctx Context to initialize
+ * @param mode Operating mode (text/pixel/hybrid/simulate)
+ * @param width Display width
+ * @param height Display height
+ * @param encoding Pixel encoding used for all payload bytes
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_init_with_encoding(visualmem_context_t* ctx, visualmem_mode_t mode,
+                                 int width, int height, visualmem_encoding_t encoding);
+
 /**
  * Cleanup and free all visual memory resources
  * @param ctx Context to cleanup
@@ -144,10 +281,39 @@ void visualmem_cleanup(visualmem_context_t* ctx);
  */
 int visualmem_enter_autonomous_mode(visualmem_context_t* ctx);
 
+/**
+ * Defer pixel encoding (simulate mode only)
+ * While enabled, writes and reads go to a raw byte store and pixels are
+ * only encoded when observed: display, pixel reads, autonomous transition
+ * (which also turns lazy pixels off)
+ * @param ctx Visual memory context
+ * @param enable 1 to defer pixel encoding, 0 to encode pending data and stop
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_set_lazy_pixels(visualmem_context_t* ctx, int enable);
+
+/**
+ * Share the context between threads
+ * Data calls (read, write and their offset and vectored forms, copy, set,
+ * the string calls, visualmem_get_allocation_info) then look allocations up
+ * without a lock, and allocator calls serialize on a writer lock. Blocks and
+ * record arrays taken from readers are reclaimed once no data call that may
+ * still use them is running. An allocation must not be written while
+ * visualmem_realloc or defragmentation moves it.
+ * Cleanup, lazy pixels, the autonomous transition and this call itself need
+ * every other thread to stay out of the context.
+ * @param ctx Context
+ * @param enable 1 to allow concurrent calls, 0 to go back to single-threaded use
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_set_thread_safe(visualmem_context_t* ctx, int enable);
+
 // === MEMORY ALLOCATION FUNCTIONS ===
 
 /**
  * Allocate visual memory (equivalent to malloc)
+ * Unlabelled allocations of up to VISUALMEM_SLAB_MAX_OBJECT bytes are packed
+ * into shared slabs and report an empty label.
  * @param ctx Context
  * @param size Bytes to allocate
  * @param label Optional allocation label
@@ -163,15 +329,78 @@ void* visualmem_alloc(visualmem_context_t* ctx, size_t size, const char* label);
  */
 int visualmem_free(visualmem_context_t* ctx, void* visual_addr);
 
+/**
+ * Allocate several blocks in one call, largest first so small blocks do not
+ * split the space larger ones need
+ * All or nothing: on failure every addrs entry is NULL
+ * @param ctx Context
+ * @param sizes Bytes for each block
+ * @param labels Label for each block, or NULL for all unlabelled
+ * @param count Number of blocks
+ * @param addrs Output: visual address of each block
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_alloc_batch(visualmem_context_t* ctx, const size_t* sizes, const char* const* labels,
+                          int count, void** addrs);
+
+/**
+ * Free several allocations in payload order
+ * Nothing is freed unless every address is live, freeable and listed once
+ * @param ctx Context
+ * @param addrs Addresses to free
+ * @param count Number of addresses
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_free_batch(visualmem_context_t* ctx, void* const* addrs, int count);
+
 /**
  * Reallocate visual memory (equivalent to realloc)
+ * Grows in place when the neighbouring space is free, otherwise moves the
+ * encoded pixels to a new place. Only small unlabelled objects that outgrow
+ * their slab get a new address
  * @param ctx Context
- * @param visual_addr Existing address
- * @param new_size New size in bytes
- * @return New visual address or NULL on failure
+ * @param visual_addr Existing address (NULL allocates)
+ * @param new_size New size in bytes (0 frees)
+ * @return New visual address or NULL on failure (the old address stays valid)
  */
 void* visualmem_realloc(visualmem_context_t* ctx, void* visual_addr, size_t new_size);
 
+/**
+ * Create an arena: one contiguous region for bump allocation
+ * @param ctx Context
+ * @param size Arena capacity in bytes (each allocation also uses VISUALMEM_ARENA_HEADER bytes)
+ * @return Arena address or NULL on failure
+ */
+void* visualmem_arena_create(visualmem_context_t* ctx, size_t size);
+
+/**
+ * Allocate from an arena: a pointer bump, with no allocation record
+ * The result works with every data function; visualmem_free rejects it
+ * @param ctx Context
+ * @param arena Address returned by visualmem_arena_create
+ * @param size Bytes to allocate
+ * @return Visual address or NULL when the arena is full
+ */
+void* visualmem_arena_alloc(visualmem_context_t* ctx, void* arena, size_t size);
+
+/**
+ * Release every allocation of an arena at once, in O(1)
+ * Their addresses stop resolving; their bytes read as zero once bumped again
+ * @param ctx Context
+ * @param arena Arena address
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_arena_reset(visualmem_context_t* ctx, void* arena);
+
+/**
+ * Destroy an arena and return its region, without visiting its allocations
+ * Its pixels are zeroed later, like those of a freed allocation
+ * @param ctx Context
+ * @param arena Arena address
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_arena_destroy(visualmem_context_t* ctx, void* arena);
+
 // === DATA ACCESS FUNCTIONS ===
 
 /**
@@ -194,8 +423,54 @@ int visualmem_write(visualmem_context_t* ctx, void* visual_addr, const void* dat
  */
 int visualmem_read(visualmem_context_t* ctx, void* visual_addr, void* buffer, size_t size);
 
+/**
+ * Write data at an offset inside an allocation; only those bytes are encoded
+ * @param ctx Context
+ * @param visual_addr Target visual address
+ * @param offset First byte of the allocation to write
+ * @param data Source data buffer
+ * @param size Bytes to write (offset + size must fit the allocation)
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_pwrite(visualmem_context_t* ctx, void* visual_addr, size_t offset,
+                     const void* data, size_t size);
+
+/**
+ * Read data from an offset inside an allocation; only those bytes are decoded
+ * @param ctx Context
+ * @param visual_addr Source visual address
+ * @param offset First byte of the allocation to read
+ * @param buffer Destination buffer
+ * @param size Bytes to read (offset + size must fit the allocation)
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_pread(visualmem_context_t* ctx, void* visual_addr, size_t offset,
+                    void* buffer, size_t size);
+
+/**
+ * Write several ranges in one pass
+ * Entries are sorted by payload position and ranges that follow on from
+ * each other are encoded as one run. Every entry is checked before any
+ * byte is written; ranges must not overlap
+ * @param ctx Context
+ * @param iov Ranges to write
+ * @param count Number of entries
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_writev(visualmem_context_t* ctx, const visualmem_iovec_t* iov, int count);
+
+/**
+ * Read several ranges in one pass, merging consecutive ones as for visualmem_writev
+ * @param ctx Context
+ * @param iov Ranges to read
+ * @param count Number of entries
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_readv(visualmem_context_t* ctx, const visualmem_iovec_t* iov, int count);
+
 /**
  * Copy data between visual memory locations
+ * Encoded pixels are copied directly, without decoding
  * @param ctx Context
  * @param dest_addr Destination visual address
  * @param src_addr Source visual address
@@ -206,6 +481,7 @@ int visualmem_copy(visualmem_context_t* ctx, void* dest_addr, void* src_addr, si
 
 /**
  * Set visual memory to specific value
+ * The value is encoded once and its pixels replicated across the range
  * @param ctx Context
  * @param visual_addr Target address
  * @param value Value to set (0-255)
@@ -241,7 +517,7 @@ int visualmem_read_string(visualmem_context_t* ctx, void* visual_addr, char* buf
  * Get allocation information
  * @param ctx Context
  * @param visual_addr Visual address to query
- * @return Allocation info or NULL if not found
+ * @return Allocation info (valid until the thread's next call) or NULL if not found
  */
 const visualmem_allocation_t* visualmem_get_allocation_info(visualmem_context_t* ctx, void* visual_addr);
 
@@ -250,11 +526,18 @@ const visualmem_allocation_t* visualmem_get_allocation_info(visualmem_context_t*
  * @param ctx Context
  * @param total_allocated Output: total allocated bytes
  * @param peak_usage Output: peak memory usage
- * @param fragmentation Output: fragmentation percentage (0-100)
+ * @param fragmentation Output: percentage of free space in holes between allocations (0-100)
  */
 void visualmem_get_stats(visualmem_context_t* ctx, size_t* total_allocated, 
                         size_t* peak_usage, int* fragmentation);
 
+/**
+ * Get payload capacity of the visual data area
+ * @param ctx Context
+ * @return Number of addressable payload bytes for the context's encoding
+ */
+size_t visualmem_get_capacity(visualmem_context_t* ctx);
+
 /**
  * Verify data integrity
  * @param ctx Context
@@ -265,11 +548,34 @@ int visualmem_verify_integrity(visualmem_context_t* ctx, void* visual_addr);
 
 /**
  * Defragment visual memory
+ * Moves live allocations together; visual addresses held by callers stay valid
  * @param ctx Context
  * @return VISUALMEM_SUCCESS or error code
  */
 int visualmem_defragment(visualmem_context_t* ctx);
 
+/**
+ * Run one bounded slice of defragmentation
+ * Moves live allocations, highest first, into lower free space until about
+ * byte_budget payload bytes have moved (at least one allocation per call)
+ * @param ctx Context
+ * @param byte_budget Payload bytes to move in this slice
+ * @param bytes_moved Output: bytes moved, 0 once memory is compact (may be NULL)
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_defragment_step(visualmem_context_t* ctx, size_t byte_budget, size_t* bytes_moved);
+
+/**
+ * Zero the pixels of freed blocks ahead of their reuse
+ * visualmem_free only marks a block dirty; it is zeroed when handed out
+ * again, or earlier by this call (e.g. while the caller is idle)
+ * @param ctx Context
+ * @param byte_budget Stop once about this many bytes were cleared
+ * @param bytes_cleared Output: bytes cleared, 0 once nothing is dirty (may be NULL)
+ * @return VISUALMEM_SUCCESS or error code
+ */
+int visualmem_scrub(visualmem_context_t* ctx, size_t byte_budget, size_t* bytes_cleared);
+
 /**
  * Export visual memory state to file (debugging)
  * @param ctx Context
@@ -285,6 +591,15 @@ int visualmem_export_state(visualmem_context_t* ctx, const char* filename);
  */
 void visualmem_display_contents(visualmem_context_t* ctx, const visualmem_rect_t* rect);
 
+/**
+ * Read one pixel of visual memory as ARGB, whatever the internal storage
+ * @param ctx Visual memory context
+ * @param x Pixel column
+ * @param y Pixel row
+ * @return ARGB color, 0 outside the screen
+ */
+uint32_t visualmem_get_pixel(visualmem_context_t* ctx, int x, int y);
+
 // === ERROR HANDLING ===
 
 /**
@@ -300,6 +615,12 @@ const char* visualmem_get_error_string(visualmem_error_t error_code);
  */
 const char* visualmem_get_version(void);
 
+/**
+ * Get the codec kernel set selected for this CPU
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char* visualmem_get_codec_backend(void);
+
 // === ADVANCED FEATURES ===
 
 /**
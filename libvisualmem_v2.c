@@ -14,6 +14,7 @@
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -23,8 +24,8 @@ extern visualmem_v2_backend_t visualmem_v2_select_best_backend(const visualmem_v
 extern int visualmem_v2_init_hardware_backend(visualmem_v2_context_t* ctx);
 extern void visualmem_v2_cleanup_hardware_backend(visualmem_v2_context_t* ctx);
 extern int visualmem_v2_x11_write_pixel(visualmem_v2_context_t* ctx, int x, int y, uint32_t color);
-extern uint32_t visualmem_v2_x11_read_pixel(visualmem_v2_context_t* ctx, int x, int y);
 extern int visualmem_v2_x11_refresh(visualmem_v2_context_t* ctx);
+extern int visualmem_v2_x11_refresh_region(visualmem_v2_context_t* ctx, int x, int y, int width, int height);
 
 // === INTERNAL CONSTANTS ===
 #define VISUALMEM_V2_MAGIC_HEADER 0x56495355  // "VISU" in hex
@@ -33,6 +34,17 @@ extern int visualmem_v2_x11_refresh(visualmem_v2_context_t* ctx);
 #define VISUALMEM_V2_MEMORY_START_X 20        // Skip header area
 #define VISUALMEM_V2_MEMORY_START_Y 20
 
+// Dense and palette encodings frame each row as one block: sync pixel
+// (tag + row sequence), length pixel (payload bytes), then packed payload
+// pixels.
+#define VISUALMEM_V2_BLOCK_HEADER_PIXELS 2
+#define VISUALMEM_V2_BLOCK_TAG_DENSE_RGB  0xD3
+#define VISUALMEM_V2_BLOCK_TAG_DENSE_RGBA 0xD4
+#define VISUALMEM_V2_BLOCK_TAG_PALETTE_2BPP 0xD5
+#define VISUALMEM_V2_BLOCK_TAG_PALETTE_4BPP 0xD6
+#define VISUALMEM_V2_BLOCK_TAG_PALETTE_8BPP 0xD7
+#define VISUALMEM_V2_SCRUB_BATCH 8            // Freed regions the refresh thread clears per frame
+
 // === UTILITY FUNCTIONS ===
 
 static uint64_t get_timestamp_us(void) {
@@ -41,18 +53,16 @@ static uint64_t get_timestamp_us(void) {
     return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
+// FNV-1a: every input byte affects the result
 static uint32_t calculate_checksum(const void* data, size_t size) {
     const uint8_t* bytes = (const uint8_t*)data;
-    uint32_t checksum = 0;
+    uint32_t checksum = 2166136261u;
     for (size_t i = 0; i < size; i++) {
-        checksum = (checksum << 1) ^ bytes[i];
+        checksum = (checksum ^ bytes[i]) * 16777619u;
     }
     return checksum;
 }
 
-// Suppress unused function warning for now
-__attribute__((unused)) static void* suppress_unused_warning = (void*)calculate_checksum;
-
 // === COORDINATE CONVERSION ===
 
 static inline void* coord_to_addr(int x, int y) {
@@ -65,340 +75,3183 @@ static inline void addr_to_coord(void* addr, int* x, int* y) {
     *y = (val >> 16) & 0xFFFF;
 }
 
-static void calculate_byte_position(int byte_index, int* x, int* y, int width) {
-    int bytes_per_row = (width - VISUALMEM_V2_MEMORY_START_X) / VISUALMEM_V2_BYTE_SPACING_X;
-    if (bytes_per_row <= 0) bytes_per_row = 1;
-    
-    int row = byte_index / bytes_per_row;
-    int col = byte_index % bytes_per_row;
-    
-    *x = VISUALMEM_V2_MEMORY_START_X + (col * VISUALMEM_V2_BYTE_SPACING_X);
-    *y = VISUALMEM_V2_MEMORY_START_Y + (row * VISUALMEM_V2_BYTE_SPACING_Y);
+// Arena allocation addresses carry a stamp of their arena's epoch above the
+// coordinates (never 0, so other addresses have none). Where pointers are
+// 32 bits it takes the y bits above VISUALMEM_V2_MAX_HEIGHT.
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define ADDR_STAMP_SHIFT 32
+#define ADDR_STAMP_MASK 0xFFFFu
+#else
+#define ADDR_STAMP_SHIFT 27
+#define ADDR_STAMP_MASK 0x1Fu
+#endif
+
+static inline uint32_t epoch_stamp(uint32_t epoch) {
+    return epoch % ADDR_STAMP_MASK + 1;
 }
 
-// === DISPLAY REFRESH THREAD ===
+static inline void* stamp_addr(void* addr, uint32_t epoch) {
+    return (void*)((uintptr_t)addr | (uintptr_t)epoch_stamp(epoch) << ADDR_STAMP_SHIFT);
+}
 
-static void* display_refresh_thread(void* arg) {
-    visualmem_v2_context_t* ctx = (visualmem_v2_context_t*)arg;
-    
-    printf("[DISPLAY] Refresh thread started (target: %d Hz)\n", ctx->refresh_rate_hz);
-    
-    int frame_time_us = 1000000 / ctx->refresh_rate_hz;
-    uint64_t frame_count = 0;
-    uint64_t start_time = get_timestamp_us();
+static inline uint32_t addr_stamp(void* addr) {
+    return (uint32_t)((uintptr_t)addr >> ADDR_STAMP_SHIFT) & ADDR_STAMP_MASK;
+}
+
+static inline void* unstamp_addr(void* addr) {
+    return (void*)((uintptr_t)addr & ~((uintptr_t)ADDR_STAMP_MASK << ADDR_STAMP_SHIFT));
+}
+
+// === PAYLOAD LAYOUT ===
+
+static int encoding_bytes_per_pixel(visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_DENSE_RGB: return 3;
+        case VISUALMEM_V2_ENCODING_DENSE_RGBA: return 4;
+        default: return 0; // Binary: 10 pixels per byte
+    }
+}
+
+static int encoding_palette_bits(visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_PALETTE_2BPP: return 2;
+        case VISUALMEM_V2_ENCODING_PALETTE_4BPP: return 4;
+        case VISUALMEM_V2_ENCODING_PALETTE_8BPP: return 8;
+        default: return 0;
+    }
+}
+
+static uint32_t encoding_block_tag(visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_DENSE_RGBA: return VISUALMEM_V2_BLOCK_TAG_DENSE_RGBA;
+        case VISUALMEM_V2_ENCODING_PALETTE_2BPP: return VISUALMEM_V2_BLOCK_TAG_PALETTE_2BPP;
+        case VISUALMEM_V2_ENCODING_PALETTE_4BPP: return VISUALMEM_V2_BLOCK_TAG_PALETTE_4BPP;
+        case VISUALMEM_V2_ENCODING_PALETTE_8BPP: return VISUALMEM_V2_BLOCK_TAG_PALETTE_8BPP;
+        default: return VISUALMEM_V2_BLOCK_TAG_DENSE_RGB;
+    }
+}
+
+// Bit position of each payload byte inside a dense pixel (R, G, B, then A)
+static const int dense_channel_shift[4] = { 16, 8, 0, 24 };
+
+static void compute_layout(visualmem_v2_context_t* ctx) {
+    int rows;
     
-    while (ctx->display_thread_running) {
-        uint64_t frame_start = get_timestamp_us();
-        
-        // Refresh display based on backend
-        if (ctx->backend == VISUALMEM_V2_BACKEND_X11 || 
-            ctx->backend == VISUALMEM_V2_BACKEND_OPENGL) {
-            visualmem_v2_x11_refresh(ctx);
-        }
-        
-        frame_count++;
-        ctx->performance.display_refreshes = frame_count;
-        
-        // Calculate frame rate
-        uint64_t elapsed = get_timestamp_us() - start_time;
-        if (elapsed > 0) {
-            ctx->performance.frame_rate = (double)frame_count * 1000000.0 / elapsed;
-        }
-        
-        // Sleep until next frame
-        uint64_t frame_end = get_timestamp_us();
-        int frame_duration = frame_end - frame_start;
-        
-        if (frame_duration < frame_time_us) {
-            usleep(frame_time_us - frame_duration);
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) {
+        ctx->bytes_per_row = (ctx->width - VISUALMEM_V2_MEMORY_START_X) / VISUALMEM_V2_BYTE_SPACING_X;
+        rows = (ctx->height - VISUALMEM_V2_MEMORY_START_Y) / VISUALMEM_V2_BYTE_SPACING_Y;
+    } else {
+        int payload_pixels = ctx->width - VISUALMEM_V2_MEMORY_START_X - VISUALMEM_V2_BLOCK_HEADER_PIXELS;
+        int palette_bits = encoding_palette_bits(ctx->encoding);
+        if (palette_bits > 0) {
+            ctx->bytes_per_row = payload_pixels * palette_bits / 8;
+        } else {
+            ctx->bytes_per_row = payload_pixels * encoding_bytes_per_pixel(ctx->encoding);
         }
+        rows = ctx->height - VISUALMEM_V2_MEMORY_START_Y;
     }
     
-    printf("[DISPLAY] Refresh thread stopped\n");
-    return NULL;
+    if (ctx->bytes_per_row <= 0) ctx->bytes_per_row = 1;
+    if (rows < 0) rows = 0;
+    ctx->capacity_bytes = (size_t)ctx->bytes_per_row * rows;
 }
 
-// === CORE API IMPLEMENTATION ===
+// First payload pixel column of a row (framed rows start after the header)
+static int payload_origin_x(const visualmem_v2_context_t* ctx) {
+    return VISUALMEM_V2_MEMORY_START_X +
+        (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY ? 0 : VISUALMEM_V2_BLOCK_HEADER_PIXELS);
+}
 
-int visualmem_v2_get_hardware_caps(visualmem_v2_hardware_caps_t* caps) {
-    return visualmem_v2_detect_hardware(caps);
+// Payload bytes that fit in one row of a region width_px pixels wide
+static int region_bytes_per_row(const visualmem_v2_context_t* ctx, int width_px) {
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) {
+        return width_px / VISUALMEM_V2_BYTE_SPACING_X;
+    }
+    if (encoding_palette_bits(ctx->encoding) > 0) {
+        return width_px * encoding_palette_bits(ctx->encoding) / 8;
+    }
+    return width_px * encoding_bytes_per_pixel(ctx->encoding);
 }
 
-int visualmem_v2_init(visualmem_v2_context_t* ctx, 
-                      visualmem_v2_mode_t mode,
-                      int width, int height) {
-    return visualmem_v2_init_with_backend(ctx, VISUALMEM_V2_BACKEND_AUTO, mode, width, height);
+// Pixel position of a payload byte inside a region whose rows hold
+// bytes_per_row bytes starting at (origin_x, origin_y)
+static void locate_byte(const visualmem_v2_context_t* ctx, int origin_x, int origin_y,
+                        int bytes_per_row, size_t byte_index, int* x, int* y, int* channel) {
+    int row = (int)(byte_index / bytes_per_row);
+    int col = (int)(byte_index % bytes_per_row);
+    
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) {
+        *x = origin_x + (col * VISUALMEM_V2_BYTE_SPACING_X);
+        *y = origin_y + (row * VISUALMEM_V2_BYTE_SPACING_Y);
+        *channel = 0;
+    } else if (encoding_palette_bits(ctx->encoding) > 0) {
+        *x = origin_x + col * (8 / encoding_palette_bits(ctx->encoding));
+        *y = origin_y + row;
+        *channel = 0;
+    } else {
+        int bytes_per_pixel = encoding_bytes_per_pixel(ctx->encoding);
+        *x = origin_x + (col / bytes_per_pixel);
+        *y = origin_y + row;
+        *channel = col % bytes_per_pixel;
+    }
 }
 
-int visualmem_v2_init_with_backend(visualmem_v2_context_t* ctx,
-                                   visualmem_v2_backend_t backend,
-                                   visualmem_v2_mode_t mode,
-                                   int width, int height) {
-    if (!ctx) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
-    
-    if (width < VISUALMEM_V2_MIN_WIDTH || width > VISUALMEM_V2_MAX_WIDTH ||
-        height < VISUALMEM_V2_MIN_HEIGHT || height > VISUALMEM_V2_MAX_HEIGHT) {
-        return VISUALMEM_V2_ERROR_INVALID_RESOLUTION;
+static void calculate_byte_position(const visualmem_v2_context_t* ctx, size_t byte_index,
+                                    int* x, int* y, int* channel) {
+    locate_byte(ctx, payload_origin_x(ctx), VISUALMEM_V2_MEMORY_START_Y, ctx->bytes_per_row,
+                byte_index, x, y, channel);
+}
+
+// Pixel footprint of one full payload row
+static int row_pixel_width(const visualmem_v2_context_t* ctx) {
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) {
+        return ctx->bytes_per_row * VISUALMEM_V2_BYTE_SPACING_X;
     }
-    
-    printf("[INIT] Initializing LibVisualMem v2.0...\n");
-    printf("[INIT] Resolution: %dx%d, Mode: %d, Backend: %d\n", width, height, mode, backend);
-    
-    // Initialize context
-    memset(ctx, 0, sizeof(visualmem_v2_context_t));
-    ctx->width = width;
-    ctx->height = height;
-    ctx->mode = mode;
-    ctx->backend = backend;
-    ctx->pixel_format = VISUALMEM_V2_PIXEL_RGBA32;
-    ctx->refresh_rate_hz = 60;
-    ctx->vsync_enabled = 1;
-    ctx->double_buffering = 1;
-    
-    // Initialize mutexes
-    if (pthread_mutex_init(&ctx->context_mutex, NULL) != 0) {
-        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    if (encoding_palette_bits(ctx->encoding) > 0) {
+        return ctx->bytes_per_row * (8 / encoding_palette_bits(ctx->encoding));
     }
-    
-    if (pthread_cond_init(&ctx->display_cond, NULL) != 0) {
-        pthread_mutex_destroy(&ctx->context_mutex);
-        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    return ctx->bytes_per_row / encoding_bytes_per_pixel(ctx->encoding);
+}
+
+static int row_pixel_spacing(const visualmem_v2_context_t* ctx) {
+    return ctx->encoding == VISUALMEM_V2_ENCODING_BINARY ? VISUALMEM_V2_BYTE_SPACING_Y : 1;
+}
+
+// === PALETTE TABLES ===
+// Palette colors sit on a 3-3-2 RGB level grid. Decoding snaps each
+// channel to its nearest level and looks the grid cell up in a symbol
+// table, so colors that lose their low bits on 15/16-bit X visuals still
+// decode exactly. The 2 and 4 bpp palettes use well separated grid colors.
+
+typedef struct {
+    uint32_t colors[256];   // Symbol -> ARGB
+    uint8_t symbols[256];   // 3-3-2 grid cell -> nearest symbol
+} palette_table_t;
+
+static palette_table_t palette_tables[3]; // 2, 4 and 8 bits per pixel
+static uint8_t red_green_level[256];
+static uint8_t blue_level[256];
+static pthread_once_t palette_once = PTHREAD_ONCE_INIT;
+
+static inline uint32_t grid_color(int r, int g, int b) {
+    return 0xFF000000 | ((uint32_t)(r * 255 / 7) << 16) | ((uint32_t)(g * 255 / 7) << 8) | (uint32_t)(b * 255 / 3);
+}
+
+static inline int grid_cell(uint32_t color) {
+    return (red_green_level[(color >> 16) & 0xFF] << 5) |
+           (red_green_level[(color >> 8) & 0xFF] << 2) |
+           blue_level[color & 0xFF];
+}
+
+static const palette_table_t* palette_for(visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_PALETTE_2BPP: return &palette_tables[0];
+        case VISUALMEM_V2_ENCODING_PALETTE_4BPP: return &palette_tables[1];
+        default: return &palette_tables[2];
     }
-    
-    // Detect hardware capabilities
-    int result = visualmem_v2_detect_hardware(&ctx->hardware);
-    if (result != VISUALMEM_V2_SUCCESS) {
-        printf("[INIT] ERROR: Hardware detection failed\n");
-        pthread_cond_destroy(&ctx->display_cond);
-        pthread_mutex_destroy(&ctx->context_mutex);
-        return result;
+}
+
+static void build_palette(palette_table_t* palette, int symbol_count) {
+    for (int cell = 0; cell < 256; cell++) {
+        uint32_t center = grid_color(cell >> 5, (cell >> 2) & 7, cell & 3);
+        int best = 0;
+        long best_distance = -1;
+        for (int symbol = 0; symbol < symbol_count; symbol++) {
+            uint32_t color = palette->colors[symbol];
+            long dr = (long)((center >> 16) & 0xFF) - (long)((color >> 16) & 0xFF);
+            long dg = (long)((center >> 8) & 0xFF) - (long)((color >> 8) & 0xFF);
+            long db = (long)(center & 0xFF) - (long)(color & 0xFF);
+            long distance = dr * dr + dg * dg + db * db;
+            if (best_distance < 0 || distance < best_distance) {
+                best_distance = distance;
+                best = symbol;
+            }
+        }
+        palette->symbols[cell] = (uint8_t)best;
     }
-    
-    // Select backend if auto
-    if (ctx->backend == VISUALMEM_V2_BACKEND_AUTO) {
-        ctx->backend = visualmem_v2_select_best_backend(&ctx->hardware);
+}
+
+static void palette_tables_init(void) {
+    for (int v = 0; v < 256; v++) {
+        red_green_level[v] = (uint8_t)((v * 7 + 127) / 255);
+        blue_level[v] = (uint8_t)((v * 3 + 127) / 255);
     }
     
-    // Initialize hardware backend
-    result = visualmem_v2_init_hardware_backend(ctx);
-    if (result != VISUALMEM_V2_SUCCESS) {
-        printf("[INIT] ERROR: Hardware backend initialization failed\n");
-        pthread_cond_destroy(&ctx->display_cond);
-        pthread_mutex_destroy(&ctx->context_mutex);
-        return result;
+    // 2 bpp: black plus three mutually distant secondaries
+    palette_tables[0].colors[0] = grid_color(0, 0, 0);
+    palette_tables[0].colors[1] = grid_color(7, 7, 0);
+    palette_tables[0].colors[2] = grid_color(7, 0, 3);
+    palette_tables[0].colors[3] = grid_color(0, 7, 3);
+    build_palette(&palette_tables[0], 4);
+    
+    // 4 bpp: red and blue on/off, green in four levels
+    static const int green_levels[4] = { 0, 2, 5, 7 };
+    for (int symbol = 0; symbol < 16; symbol++) {
+        palette_tables[1].colors[symbol] = grid_color((symbol >> 3) * 7, green_levels[(symbol >> 1) & 3],
+                                                      (symbol & 1) * 3);
     }
+    build_palette(&palette_tables[1], 16);
     
-    // Allocate video memory buffer
-    size_t video_memory_size = width * height * VISUALMEM_V2_BYTES_PER_PIXEL;
-    ctx->video_memory = malloc(video_memory_size);
-    if (!ctx->video_memory) {
-        printf("[INIT] ERROR: Failed to allocate video memory buffer\n");
-        visualmem_v2_cleanup_hardware_backend(ctx);
-        pthread_cond_destroy(&ctx->display_cond);
-        pthread_mutex_destroy(&ctx->context_mutex);
-        return VISUALMEM_V2_ERROR_OUT_OF_VIDEO_MEMORY;
+    // 8 bpp: the full grid, symbol == cell
+    for (int symbol = 0; symbol < 256; symbol++) {
+        palette_tables[2].colors[symbol] = grid_color(symbol >> 5, (symbol >> 2) & 7, symbol & 3);
+        palette_tables[2].symbols[symbol] = (uint8_t)symbol;
     }
-    
-    // Clear video memory
-    memset(ctx->video_memory, 0, video_memory_size);
-    
-    // Initialize allocations array mutexes
-    for (int i = 0; i < VISUALMEM_V2_MAX_ALLOCATIONS; i++) {
-        pthread_mutex_init(&ctx->allocations[i].mutex, NULL);
+}
+
+// === PIXEL STORAGE ENGINES ===
+// video_memory holds pixels in the context's pixel format. One engine per
+// format packs/unpacks ARGB at a row pointer; rows are video_stride bytes
+// apart. When the XImage uses the same layout, video_memory *is* the
+// XImage buffer and writes need no XPutPixel conversion; otherwise dirty
+// tiles are converted into the XImage at refresh time.
+
+typedef struct {
+    int bits_per_pixel;
+    void (*store)(uint8_t* row, int x, uint32_t color);
+    uint32_t (*load)(const uint8_t* row, int x);
+    const char* name;
+} pixel_engine_t;
+
+static void store_rgba32(uint8_t* row, int x, uint32_t color) {
+    ((uint32_t*)row)[x] = color;
+}
+
+static uint32_t load_rgba32(const uint8_t* row, int x) {
+    return ((const uint32_t*)row)[x];
+}
+
+static void store_rgb24(uint8_t* row, int x, uint32_t color) {
+    uint8_t* pixel = row + x * 3;
+    pixel[0] = (uint8_t)color;
+    pixel[1] = (uint8_t)(color >> 8);
+    pixel[2] = (uint8_t)(color >> 16);
+}
+
+static uint32_t load_rgb24(const uint8_t* row, int x) {
+    const uint8_t* pixel = row + x * 3;
+    return 0xFF000000 | ((uint32_t)pixel[2] << 16) | ((uint32_t)pixel[1] << 8) | pixel[0];
+}
+
+static void store_rgb16(uint8_t* row, int x, uint32_t color) {
+    ((uint16_t*)row)[x] = (uint16_t)(((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F));
+}
+
+static uint32_t load_rgb16(const uint8_t* row, int x) {
+    uint32_t value = ((const uint16_t*)row)[x];
+    uint32_t r = value >> 11, g = (value >> 5) & 0x3F, b = value & 0x1F;
+    // Replicate the top bits so full-scale channels expand to 255
+    return 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+}
+
+// Monochrome: one bit per pixel, MSB first; light colors (luma above
+// mid-gray) store as 1
+static void store_mono(uint8_t* row, int x, uint32_t color) {
+    int light = ((color >> 16) & 0xFF) + ((color >> 8) & 0xFF) + (color & 0xFF) >= 384;
+    uint8_t mask = (uint8_t)(0x80 >> (x & 7));
+    if (light) {
+        row[x >> 3] |= mask;
+    } else {
+        row[x >> 3] &= (uint8_t)~mask;
     }
-    
-    // Start display refresh thread
-    ctx->display_thread_running = 1;
-    if (pthread_create(&ctx->display_thread, NULL, display_refresh_thread, ctx) != 0) {
-        printf("[INIT] WARNING: Failed to start display refresh thread\n");
-        ctx->display_thread_running = 0;
+}
+
+static uint32_t load_mono(const uint8_t* row, int x) {
+    return (row[x >> 3] & (0x80 >> (x & 7))) ? 0xFFFFFFFF : 0xFF000000;
+}
+
+static const pixel_engine_t pixel_engines[] = {
+    [VISUALMEM_V2_PIXEL_RGBA32]     = { 32, store_rgba32, load_rgba32, "RGBA32" },
+    [VISUALMEM_V2_PIXEL_RGB24]      = { 24, store_rgb24,  load_rgb24,  "RGB24" },
+    [VISUALMEM_V2_PIXEL_RGB16]      = { 16, store_rgb16,  load_rgb16,  "RGB16" },
+    [VISUALMEM_V2_PIXEL_MONOCHROME] = { 1,  store_mono,   load_mono,   "MONOCHROME" }
+};
+
+static inline uint8_t* video_row(const visualmem_v2_context_t* ctx, int y) {
+    return (uint8_t*)ctx->video_memory + (size_t)y * ctx->video_stride;
+}
+
+// Whether payload bytes survive a round trip through the pixel store:
+// dense needs exact 8-bit channels (RGBA also keeps alpha), palettes need
+// at least 5 bits per channel, monochrome only holds black/white bits
+static int format_supports_encoding(visualmem_v2_pixel_format_t format, visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_BINARY:
+            return 1;
+        case VISUALMEM_V2_ENCODING_DENSE_RGBA:
+            return format == VISUALMEM_V2_PIXEL_RGBA32;
+        case VISUALMEM_V2_ENCODING_DENSE_RGB:
+            return format == VISUALMEM_V2_PIXEL_RGBA32 || format == VISUALMEM_V2_PIXEL_RGB24;
+        default:
+            return format != VISUALMEM_V2_PIXEL_MONOCHROME;
+    }
+}
+
+static XImage* backend_image(const visualmem_v2_context_t* ctx) {
+    if (ctx->backend == VISUALMEM_V2_BACKEND_X11 || ctx->backend == VISUALMEM_V2_BACKEND_OPENGL) {
+        return ctx->x11.ximage;
+    }
+    return NULL;
+}
+
+// The XImage buffer can double as the pixel store when its pixels have
+// exactly this engine's in-memory layout
+static int image_matches_format(const XImage* image, visualmem_v2_pixel_format_t format) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (!image || !image->data || image->byte_order != LSBFirst ||
+        image->bits_per_pixel != pixel_engines[format].bits_per_pixel) {
+        return 0;
+    }
+    switch (format) {
+        case VISUALMEM_V2_PIXEL_RGBA32:
+        case VISUALMEM_V2_PIXEL_RGB24:
+            return image->red_mask == 0xFF0000 && image->green_mask == 0x00FF00 && image->blue_mask == 0x0000FF;
+        case VISUALMEM_V2_PIXEL_RGB16:
+            return image->red_mask == 0xF800 && image->green_mask == 0x07E0 && image->blue_mask == 0x001F;
+        default:
+            return 0;
+    }
+#else
+    (void)image;
+    (void)format;
+    return 0;
+#endif
+}
+
+static visualmem_v2_pixel_format_t native_pixel_format(const visualmem_v2_context_t* ctx) {
+    const XImage* image = backend_image(ctx);
+    if (image && image->bits_per_pixel == 16) return VISUALMEM_V2_PIXEL_RGB16;
+    if (image && image->bits_per_pixel == 24) return VISUALMEM_V2_PIXEL_RGB24;
+    return VISUALMEM_V2_PIXEL_RGBA32;
+}
+
+static void release_video_memory(visualmem_v2_context_t* ctx) {
+    if (ctx->video_memory && !ctx->video_memory_shared) {
+        free(ctx->video_memory);
     }
+    ctx->video_memory = NULL;
+    ctx->video_memory_size = 0;
+    ctx->video_memory_shared = 0;
+}
+
+static int setup_video_memory(visualmem_v2_context_t* ctx, visualmem_v2_pixel_format_t format) {
+    XImage* image = backend_image(ctx);
     
-    ctx->is_initialized = 1;
-    ctx->hardware_active = 1;
-    ctx->display_active = 1;
+    release_video_memory(ctx);
     
-    printf("[INIT] LibVisualMem v2.0 initialized successfully\n");
-    printf("[INIT] Backend: %d, Hardware: %s, Video Memory: %zu bytes\n", 
-           ctx->backend, ctx->hardware.gpu_model, video_memory_size);
+    if (image_matches_format(image, format)) {
+        ctx->video_memory = image->data;
+        ctx->video_stride = image->bytes_per_line;
+        ctx->video_memory_shared = 1;
+    } else {
+        // Rows padded to 32 bits like XImage scanlines
+        ctx->video_stride = ((ctx->width * pixel_engines[format].bits_per_pixel + 31) / 32) * 4;
+        ctx->video_memory = calloc(ctx->height, ctx->video_stride);
+        if (!ctx->video_memory) {
+            return VISUALMEM_V2_ERROR_OUT_OF_VIDEO_MEMORY;
+        }
+    }
     
+    ctx->video_memory_size = (size_t)ctx->video_stride * ctx->height;
+    ctx->pixel_format = format;
     return VISUALMEM_V2_SUCCESS;
 }
 
-void visualmem_v2_cleanup(visualmem_v2_context_t* ctx) {
-    if (!ctx || !ctx->is_initialized) return;
-    
-    printf("[CLEANUP] Shutting down LibVisualMem v2.0...\n");
+// Convert a rectangle of the pixel store into the XImage (unshared stores)
+static void sync_region_to_image(visualmem_v2_context_t* ctx, int x0, int y0, int width, int height) {
+    const pixel_engine_t* engine = &pixel_engines[ctx->pixel_format];
+    
+    for (int y = y0; y < y0 + height; y++) {
+        const uint8_t* row = video_row(ctx, y);
+        for (int x = x0; x < x0 + width; x++) {
+            visualmem_v2_x11_write_pixel(ctx, x, y, engine->load(row, x));
+        }
+    }
+}
+
+// === ROW BAND LOCKS ===
+// Pixels are guarded in bands of VISUALMEM_V2_TILE_HEIGHT rows, one
+// reader-writer lock per tile row. Data calls resolve their allocation
+// under context_mutex, drop it, then hold only the bands their bytes
+// cover: shared to read, exclusive to write. Bands rather than allocations
+// are the unit because neighbours can share a pixel (dense channels, arena
+// headers). Lock order: context_mutex, bands upwards, display_mutex.
+
+// Kept out of the header, which builds without POSIX rwlock declarations
+struct visualmem_v2_band_locks {
+    pthread_rwlock_t band[VISUALMEM_V2_MAX_TILE_ROWS];
+};
+
+static int init_pixel_locks(visualmem_v2_context_t* ctx) {
+    struct visualmem_v2_band_locks* locks = malloc(sizeof(*locks));
+    if (!locks) return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    
+    for (int band = 0; band < VISUALMEM_V2_MAX_TILE_ROWS; band++) {
+        if (pthread_rwlock_init(&locks->band[band], NULL) != 0) {
+            while (band-- > 0) pthread_rwlock_destroy(&locks->band[band]);
+            free(locks);
+            return VISUALMEM_V2_ERROR_THREAD_FAILED;
+        }
+    }
+    if (pthread_mutex_init(&ctx->display_mutex, NULL) != 0) {
+        for (int band = 0; band < VISUALMEM_V2_MAX_TILE_ROWS; band++) {
+            pthread_rwlock_destroy(&locks->band[band]);
+        }
+        free(locks);
+        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    }
     
-    // Stop display thread
-    ctx->display_thread_running = 0;
-    if (ctx->display_thread) {
-        pthread_join(ctx->display_thread, NULL);
+    ctx->band_locks = locks;
+    return VISUALMEM_V2_SUCCESS;
+}
+
+static void destroy_pixel_locks(visualmem_v2_context_t* ctx) {
+    pthread_mutex_destroy(&ctx->display_mutex);
+    for (int band = 0; band < VISUALMEM_V2_MAX_TILE_ROWS; band++) {
+        pthread_rwlock_destroy(&ctx->band_locks->band[band]);
+    }
+    free(ctx->band_locks);
+    ctx->band_locks = NULL;
+}
+
+// Lock the bands holding pixel rows y0..y1
+static void lock_rows(visualmem_v2_context_t* ctx, int y0, int y1, int exclusive) {
+    for (int band = y0 / VISUALMEM_V2_TILE_HEIGHT; band <= y1 / VISUALMEM_V2_TILE_HEIGHT; band++) {
+        if (exclusive) {
+            pthread_rwlock_wrlock(&ctx->band_locks->band[band]);
+        } else {
+            pthread_rwlock_rdlock(&ctx->band_locks->band[band]);
+        }
+    }
+}
+
+static void unlock_rows(visualmem_v2_context_t* ctx, int y0, int y1) {
+    for (int band = y1 / VISUALMEM_V2_TILE_HEIGHT; band >= y0 / VISUALMEM_V2_TILE_HEIGHT; band--) {
+        pthread_rwlock_unlock(&ctx->band_locks->band[band]);
+    }
+}
+
+// Counted once per operation, as data calls run in parallel
+static inline void count_pixel_ops(visualmem_v2_context_t* ctx, uint64_t count) {
+    __atomic_fetch_add(&ctx->performance.pixel_operations, count, __ATOMIC_RELAXED);
+}
+
+// === TILE GRID ===
+// Every pixel write marks its tile in three bitmaps, one per consumer:
+// the refresh thread, incremental snapshots and the checksum cache. Each
+// consumer atomically takes and clears its own bits, so writers never
+// block and only changed tiles are pushed, copied or rehashed.
+
+static inline int tile_index(const visualmem_v2_context_t* ctx, int x, int y) {
+    return (y / VISUALMEM_V2_TILE_HEIGHT) * ctx->tile_cols + (x / VISUALMEM_V2_TILE_WIDTH);
+}
+
+static inline void set_tile_bit(uint64_t* bitmap, int tile) {
+    uint64_t bit = 1ULL << (tile & 63);
+    uint64_t* word = &bitmap[tile >> 6];
+    // Skip the atomic when the bit is already set (the common case)
+    if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) {
+        __atomic_fetch_or(word, bit, __ATOMIC_RELEASE);
+    }
+}
+
+static inline void mark_tile_dirty(visualmem_v2_context_t* ctx, int tile) {
+    set_tile_bit(ctx->refresh_dirty, tile);
+    set_tile_bit(ctx->snapshot_dirty, tile);
+    set_tile_bit(ctx->checksum_stale, tile);
+}
+
+static void mark_rect_dirty(visualmem_v2_context_t* ctx, int x, int y, int width, int height) {
+    for (int ty = y / VISUALMEM_V2_TILE_HEIGHT; ty <= (y + height - 1) / VISUALMEM_V2_TILE_HEIGHT; ty++) {
+        for (int tx = x / VISUALMEM_V2_TILE_WIDTH; tx <= (x + width - 1) / VISUALMEM_V2_TILE_WIDTH; tx++) {
+            mark_tile_dirty(ctx, ty * ctx->tile_cols + tx);
+        }
+    }
+}
+
+static void mark_all_tiles_dirty(visualmem_v2_context_t* ctx) {
+    for (int tile = 0; tile < ctx->tile_cols * ctx->tile_rows; tile++) {
+        mark_tile_dirty(ctx, tile);
     }
+}
+
+// Sized once at init: the refresh thread walks the grid without a lock
+static void init_tile_grid(visualmem_v2_context_t* ctx) {
+    ctx->tile_cols = (ctx->width + VISUALMEM_V2_TILE_WIDTH - 1) / VISUALMEM_V2_TILE_WIDTH;
+    ctx->tile_rows = (ctx->height + VISUALMEM_V2_TILE_HEIGHT - 1) / VISUALMEM_V2_TILE_HEIGHT;
     
-    // Free all allocations
-    for (int i = 0; i < ctx->allocation_count; i++) {
-        if (ctx->allocations[i].is_active) {
-            visualmem_v2_free(ctx, ctx->allocations[i].visual_addr);
+    // Nothing has been pushed, snapshotted or hashed yet
+    mark_all_tiles_dirty(ctx);
+}
+
+// Push dirty tiles to the display, merging horizontal runs of tiles into
+// one rectangle per run. A tile row is copied into the XImage under its
+// band's shared lock and pushed once the band is released, so writers wait
+// at most for that copy. A shared store is pushed as it stands: a pixel
+// written meanwhile marks its tile again for the next frame
+static void refresh_dirty_tiles(visualmem_v2_context_t* ctx) {
+    uint64_t taken[VISUALMEM_V2_TILE_WORDS];
+    int any = 0;
+    
+    for (int w = 0; w < VISUALMEM_V2_TILE_WORDS; w++) {
+        taken[w] = __atomic_exchange_n(&ctx->refresh_dirty[w], 0, __ATOMIC_ACQ_REL);
+        any |= taken[w] != 0;
+    }
+    if (!any) return;
+    
+    for (int ty = 0; ty < ctx->tile_rows; ty++) {
+        int run_x[VISUALMEM_V2_MAX_TILE_COLS], run_width[VISUALMEM_V2_MAX_TILE_COLS];
+        int runs = 0;
+        int tx = 0;
+        while (tx < ctx->tile_cols) {
+            int tile = ty * ctx->tile_cols + tx;
+            if (!(taken[tile >> 6] & (1ULL << (tile & 63)))) {
+                tx++;
+                continue;
+            }
+            
+            int run_start = tx;
+            while (tx < ctx->tile_cols) {
+                tile = ty * ctx->tile_cols + tx;
+                if (!(taken[tile >> 6] & (1ULL << (tile & 63)))) break;
+                tx++;
+            }
+            
+            run_x[runs] = run_start * VISUALMEM_V2_TILE_WIDTH;
+            run_width[runs] = tx * VISUALMEM_V2_TILE_WIDTH - run_x[runs];
+            if (run_x[runs] + run_width[runs] > ctx->width) run_width[runs] = ctx->width - run_x[runs];
+            runs++;
+        }
+        if (runs == 0) continue;
+        
+        int y = ty * VISUALMEM_V2_TILE_HEIGHT;
+        int height = VISUALMEM_V2_TILE_HEIGHT;
+        if (y + height > ctx->height) height = ctx->height - y;
+        
+        lock_rows(ctx, y, y, 0);
+        pthread_mutex_lock(&ctx->display_mutex);
+        if (!ctx->video_memory_shared) {
+            for (int r = 0; r < runs; r++) {
+                sync_region_to_image(ctx, run_x[r], y, run_width[r], height);
+            }
         }
+        unlock_rows(ctx, y, y);
+        
+        for (int r = 0; r < runs; r++) {
+            visualmem_v2_x11_refresh_region(ctx, run_x[r], y, run_width[r], height);
+        }
+        pthread_mutex_unlock(&ctx->display_mutex);
+    }
+}
+
+// === BYTE ENCODING/DECODING ===
+
+// Pixel access for the codecs: no locking or counting, callers hold the band
+static inline void put_pixel(visualmem_v2_context_t* ctx, int x, int y, uint32_t color) {
+    if (x < 0 || x >= ctx->width || y < 0 || y >= ctx->height) return;
+    pixel_engines[ctx->pixel_format].store(video_row(ctx, y), x, color);
+    mark_tile_dirty(ctx, tile_index(ctx, x, y));
+}
+
+static inline uint32_t get_pixel(const visualmem_v2_context_t* ctx, int x, int y) {
+    if (x < 0 || x >= ctx->width || y < 0 || y >= ctx->height) return 0;
+    return pixel_engines[ctx->pixel_format].load(video_row(ctx, y), x);
+}
+
+// Pixel whose bytes all decode as 0 in the active encoding
+static uint32_t zero_pixel(const visualmem_v2_context_t* ctx) {
+    if (encoding_palette_bits(ctx->encoding) > 0) return palette_for(ctx->encoding)->colors[0];
+    return ctx->encoding == VISUALMEM_V2_ENCODING_DENSE_RGBA ? 0 : 0xFF000000; // Alpha holds a byte
+}
+
+static void encode_byte(visualmem_v2_context_t* ctx, int byte_x, int byte_y, int channel, uint8_t byte_value) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    if (palette_bits > 0) {
+        // Palette: MSB-first symbols, one pixel each
+        const palette_table_t* palette = palette_for(ctx->encoding);
+        uint8_t mask = (uint8_t)((1 << palette_bits) - 1);
+        for (int shift = 8 - palette_bits; shift >= 0; shift -= palette_bits) {
+            put_pixel(ctx, byte_x++, byte_y, palette->colors[(byte_value >> shift) & mask]);
+        }
+        return;
+    }
+    
+    if (ctx->encoding != VISUALMEM_V2_ENCODING_BINARY) {
+        // Dense: the byte occupies one channel of a shared pixel
+        int shift = dense_channel_shift[channel];
+        uint32_t pixel = get_pixel(ctx, byte_x, byte_y);
+        pixel = (pixel & ~((uint32_t)0xFF << shift)) | ((uint32_t)byte_value << shift);
+        put_pixel(ctx, byte_x, byte_y, pixel);
+        return;
+    }
+    
+    // Start marker (red)
+    put_pixel(ctx, byte_x, byte_y, 0xFFFF0000);
+    
+    // Encode 8 bits
+    for (int bit = 0; bit < 8; bit++) {
+        uint8_t bit_value = (byte_value >> (7 - bit)) & 1;
+        uint32_t pixel_color = bit_value ? 0xFFFFFFFF : 0xFF000000; // White or black
+        put_pixel(ctx, byte_x + 1 + bit, byte_y, pixel_color);
+    }
+    
+    // End marker (green)
+    put_pixel(ctx, byte_x + 9, byte_y, 0xFF00FF00);
+}
+
+static uint8_t decode_byte(visualmem_v2_context_t* ctx, int byte_x, int byte_y, int channel) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    if (palette_bits > 0) {
+        const palette_table_t* palette = palette_for(ctx->encoding);
+        uint8_t byte_value = 0;
+        for (int k = 0; k < 8 / palette_bits; k++) {
+            uint32_t pixel = get_pixel(ctx, byte_x + k, byte_y);
+            byte_value = (uint8_t)((byte_value << palette_bits) | palette->symbols[grid_cell(pixel)]);
+        }
+        return byte_value;
+    }
+    
+    if (ctx->encoding != VISUALMEM_V2_ENCODING_BINARY) {
+        return (uint8_t)(get_pixel(ctx, byte_x, byte_y) >> dense_channel_shift[channel]);
+    }
+    
+    uint8_t byte_value = 0;
+    
+    // Read 8 bits
+    for (int bit = 0; bit < 8; bit++) {
+        uint32_t pixel_color = get_pixel(ctx, byte_x + 1 + bit, byte_y);
+        
+        // Check if pixel represents bit 1 (white)
+        if ((pixel_color & 0x00FFFFFF) == 0x00FFFFFF) {
+            byte_value |= (1 << (7 - bit));
+        }
+    }
+    
+    return byte_value;
+}
+
+static void write_block_headers(visualmem_v2_context_t* ctx) {
+    int rows = (int)(ctx->capacity_bytes / ctx->bytes_per_row);
+    uint32_t tag = encoding_block_tag(ctx->encoding);
+    
+    for (int row = 0; row < rows; row++) {
+        int y = VISUALMEM_V2_MEMORY_START_Y + row;
+        put_pixel(ctx, VISUALMEM_V2_MEMORY_START_X, y,
+                                 0xFF000000 | (tag << 16) | (row & 0xFFFF));
+        put_pixel(ctx, VISUALMEM_V2_MEMORY_START_X + 1, y,
+                                 0xFF000000 | (ctx->bytes_per_row & 0x00FFFFFF));
+    }
+}
+
+// === RECTANGLE PACKER ===
+// Maximal-rectangles packing over the data area of the tiled layout. The
+// free space is kept as the list of all maximal free rectangles, which may
+// overlap. Placing a rectangle splits every free rectangle it touches into
+// the (up to four) maximal pieces around it, then drops pieces contained
+// in another. Any free rectangle then lies inside a single entry, so fixed
+// placements are a containment test. A free adds the rectangle back and
+// merges it only with the free rectangles it touches; that can miss a
+// maximal rectangle, so the list is flagged incomplete and a placement that
+// fails on it rebuilds the list from the live rectangles before giving up.
+
+static int rect_contains(const visualmem_v2_rect_t* outer, const visualmem_v2_rect_t* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->width <= outer->x + outer->width &&
+           inner->y + inner->height <= outer->y + outer->height;
+}
+
+static int rect_intersects(const visualmem_v2_rect_t* a, const visualmem_v2_rect_t* b) {
+    return a->x < b->x + b->width && b->x < a->x + a->width &&
+           a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static int packer_add(visualmem_v2_packer_t* packer, int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) return VISUALMEM_V2_SUCCESS;
+    
+    if (packer->free_count == packer->free_capacity) {
+        int new_capacity = packer->free_capacity ? packer->free_capacity * 2 : 16;
+        visualmem_v2_rect_t* grown = realloc(packer->free_rects, sizeof(*grown) * (size_t)new_capacity);
+        if (!grown) return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+        packer->free_rects = grown;
+        packer->free_capacity = new_capacity;
+    }
+    
+    visualmem_v2_rect_t* rect = &packer->free_rects[packer->free_count++];
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Drop free rectangles contained in another one (duplicates keep one copy)
+static void packer_prune(visualmem_v2_packer_t* packer) {
+    visualmem_v2_rect_t* rects = packer->free_rects;
+    for (int i = 0; i < packer->free_count; i++) {
+        for (int j = i + 1; j < packer->free_count; j++) {
+            if (rect_contains(&rects[j], &rects[i])) {
+                rects[i--] = rects[--packer->free_count];
+                break;
+            }
+            if (rect_contains(&rects[i], &rects[j])) {
+                rects[j--] = rects[--packer->free_count];
+            }
+        }
+    }
+}
+
+// Take a rectangle out of the free space (it must lie inside the data area)
+static int packer_reserve(visualmem_v2_packer_t* packer, const visualmem_v2_rect_t* used) {
+    int result = VISUALMEM_V2_SUCCESS;
+    int i = 0;
+    
+    while (i < packer->free_count) {
+        visualmem_v2_rect_t free_rect = packer->free_rects[i];
+        if (!rect_intersects(&free_rect, used)) {
+            i++;
+            continue;
+        }
+        
+        // Replace it by the maximal pieces left, above, right and below
+        packer->free_rects[i] = packer->free_rects[--packer->free_count];
+        int free_right = free_rect.x + free_rect.width;
+        int free_bottom = free_rect.y + free_rect.height;
+        int used_right = used->x + used->width;
+        int used_bottom = used->y + used->height;
+        if (packer_add(packer, free_rect.x, free_rect.y, used->x - free_rect.x, free_rect.height) ||
+            packer_add(packer, used_right, free_rect.y, free_right - used_right, free_rect.height) ||
+            packer_add(packer, free_rect.x, free_rect.y, free_rect.width, used->y - free_rect.y) ||
+            packer_add(packer, free_rect.x, used_bottom, free_rect.width, free_bottom - used_bottom)) {
+            result = VISUALMEM_V2_ERROR_ALLOCATION_FAILED; // Space is lost until the next rebuild
+            packer->incomplete = 1;
+        }
+    }
+    
+    packer_prune(packer);
+    packer->reserved_pixels += (size_t)used->width * used->height;
+    return result;
+}
+
+// Best short-side fit, ties broken top-left; positions aligned to the grid
+static int packer_find(const visualmem_v2_packer_t* packer, int width, int height,
+                       int align_x, int align_y, visualmem_v2_rect_t* placed) {
+    int found = 0;
+    int best_short = 0, best_long = 0;
+    
+    for (int i = 0; i < packer->free_count; i++) {
+        const visualmem_v2_rect_t* free_rect = &packer->free_rects[i];
+        int x = (free_rect->x + align_x - 1) / align_x * align_x;
+        int y = (free_rect->y + align_y - 1) / align_y * align_y;
+        int spare_w = free_rect->x + free_rect->width - (x + width);
+        int spare_h = free_rect->y + free_rect->height - (y + height);
+        if (spare_w < 0 || spare_h < 0) continue;
+        
+        int short_side = spare_w < spare_h ? spare_w : spare_h;
+        int long_side = spare_w < spare_h ? spare_h : spare_w;
+        if (found && (short_side > best_short ||
+                      (short_side == best_short && (long_side > best_long ||
+                       (long_side == best_long && (y > placed->y || (y == placed->y && x > placed->x))))))) {
+            continue;
+        }
+        
+        found = 1;
+        best_short = short_side;
+        best_long = long_side;
+        placed->x = x;
+        placed->y = y;
+        placed->width = width;
+        placed->height = height;
+    }
+    
+    return found;
+}
+
+static int packer_fits(const visualmem_v2_packer_t* packer, const visualmem_v2_rect_t* rect) {
+    for (int i = 0; i < packer->free_count; i++) {
+        if (rect_contains(&packer->free_rects[i], rect)) return 1;
+    }
+    return 0;
+}
+
+// Keep a free rectangle unless an entry already covers it
+static int packer_offer(visualmem_v2_packer_t* packer, const visualmem_v2_rect_t* rect) {
+    if (packer_fits(packer, rect)) return VISUALMEM_V2_SUCCESS;
+    return packer_add(packer, rect->x, rect->y, rect->width, rect->height);
+}
+
+#define PACKER_MERGE_LIMIT 64   // New rectangles one free may merge further
+
+// Return a placed rectangle to the free space. Each new entry is merged with
+// the entries it overlaps or touches: two such rectangles together cover the
+// strip through their shared span, across both of them. Only entries inside
+// a new one are dropped, so the cost follows the neighbourhood of the free.
+static int packer_free(visualmem_v2_packer_t* packer, const visualmem_v2_rect_t* freed) {
+    int first_new = packer->free_count;
+    packer->reserved_pixels -= (size_t)freed->width * freed->height;
+    packer->incomplete = 1;
+    if (packer_offer(packer, freed) != VISUALMEM_V2_SUCCESS) {
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    for (int n = first_new; n < packer->free_count && n < first_new + PACKER_MERGE_LIMIT; n++) {
+        for (int i = 0; i < packer->free_count; i++) {
+            if (i == n) continue;
+            visualmem_v2_rect_t a = packer->free_rects[n]; // Copies: offers may move the list
+            visualmem_v2_rect_t b = packer->free_rects[i];
+            int left = a.x > b.x ? a.x : b.x;
+            int right = a.x + a.width < b.x + b.width ? a.x + a.width : b.x + b.width;
+            int top = a.y > b.y ? a.y : b.y;
+            int bottom = a.y + a.height < b.y + b.height ? a.y + a.height : b.y + b.height;
+            int outer_left = a.x < b.x ? a.x : b.x;
+            int outer_top = a.y < b.y ? a.y : b.y;
+            int outer_right = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+            int outer_bottom = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+            
+            if (left < right && top <= bottom) {
+                visualmem_v2_rect_t column = { left, outer_top, right - left, outer_bottom - outer_top };
+                if (packer_offer(packer, &column) != VISUALMEM_V2_SUCCESS) {
+                    return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+                }
+            }
+            if (top < bottom && left <= right) {
+                visualmem_v2_rect_t row = { outer_left, top, outer_right - outer_left, bottom - top };
+                if (packer_offer(packer, &row) != VISUALMEM_V2_SUCCESS) {
+                    return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+                }
+            }
+        }
+    }
+    
+    // Drop entries a new rectangle covers
+    visualmem_v2_rect_t* rects = packer->free_rects;
+    for (int i = 0; i < packer->free_count; i++) {
+        for (int j = first_new; j < packer->free_count; j++) {
+            if (j != i && rect_contains(&rects[j], &rects[i])) {
+                rects[i--] = rects[--packer->free_count];
+                break;
+            }
+        }
+    }
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Whole data area free again (after encoding or layout changes)
+static int packer_reset(visualmem_v2_context_t* ctx) {
+    visualmem_v2_packer_t* packer = &ctx->packer;
+    packer->area.x = payload_origin_x(ctx);
+    packer->area.y = VISUALMEM_V2_MEMORY_START_Y;
+    packer->area.width = ctx->width - packer->area.x;
+    packer->area.height = ctx->height - packer->area.y;
+    packer->free_count = 0;
+    packer->reserved_pixels = 0;
+    packer->payload_pixels = 0;
+    packer->incomplete = 0;
+    
+    return packer_add(packer, packer->area.x, packer->area.y, packer->area.width, packer->area.height);
+}
+
+static void packer_release(visualmem_v2_packer_t* packer) {
+    free(packer->free_rects);
+    memset(packer, 0, sizeof(*packer));
+}
+
+// Find a free rectangle of whole tiles inside the data area for size
+// bytes. Candidate shapes are tried smallest area first (then closest to
+// square); the first shape the packer can place wins.
+static int place_tiled(visualmem_v2_context_t* ctx, size_t size,
+                       visualmem_v2_rect_t* placed, size_t* payload_pixels) {
+    int first_col = (payload_origin_x(ctx) + VISUALMEM_V2_TILE_WIDTH - 1) / VISUALMEM_V2_TILE_WIDTH;
+    int first_row = (VISUALMEM_V2_MEMORY_START_Y + VISUALMEM_V2_TILE_HEIGHT - 1) / VISUALMEM_V2_TILE_HEIGHT;
+    int last_col = ctx->width / VISUALMEM_V2_TILE_WIDTH;     // Exclusive: only whole tiles
+    int last_row = ctx->height / VISUALMEM_V2_TILE_HEIGHT;
+    
+    int shape_w[VISUALMEM_V2_MAX_TILE_COLS];
+    int shape_h[VISUALMEM_V2_MAX_TILE_COLS];
+    size_t shape_rows[VISUALMEM_V2_MAX_TILE_COLS];
+    int shapes = 0;
+    
+    for (int w = 1; w <= last_col - first_col; w++) {
+        int bytes_per_row = region_bytes_per_row(ctx, w * VISUALMEM_V2_TILE_WIDTH);
+        if (bytes_per_row <= 0) continue;
+        
+        size_t rows = (size + bytes_per_row - 1) / bytes_per_row;
+        size_t height_px = rows * row_pixel_spacing(ctx);
+        int h = (int)((height_px + VISUALMEM_V2_TILE_HEIGHT - 1) / VISUALMEM_V2_TILE_HEIGHT);
+        if (h > last_row - first_row) continue;
+        
+        // Insertion sort by area, then by squareness in pixels
+        int area = w * h;
+        int skew = abs(w * VISUALMEM_V2_TILE_WIDTH - h * VISUALMEM_V2_TILE_HEIGHT);
+        int pos = shapes++;
+        while (pos > 0) {
+            int prev_area = shape_w[pos - 1] * shape_h[pos - 1];
+            int prev_skew = abs(shape_w[pos - 1] * VISUALMEM_V2_TILE_WIDTH -
+                                shape_h[pos - 1] * VISUALMEM_V2_TILE_HEIGHT);
+            if (prev_area < area || (prev_area == area && prev_skew <= skew)) break;
+            shape_w[pos] = shape_w[pos - 1];
+            shape_h[pos] = shape_h[pos - 1];
+            shape_rows[pos] = shape_rows[pos - 1];
+            pos--;
+        }
+        shape_w[pos] = w;
+        shape_h[pos] = h;
+        shape_rows[pos] = rows;
+    }
+    
+    for (int s = 0; s < shapes; s++) {
+        int width_px = shape_w[s] * VISUALMEM_V2_TILE_WIDTH;
+        if (packer_find(&ctx->packer, width_px, shape_h[s] * VISUALMEM_V2_TILE_HEIGHT,
+                        VISUALMEM_V2_TILE_WIDTH, VISUALMEM_V2_TILE_HEIGHT, placed)) {
+            *payload_pixels = (size_t)width_px * shape_rows[s] * row_pixel_spacing(ctx);
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+// === ADDRESS SPACE ALLOCATOR ===
+// Binary buddy allocator over the payload bytes of the linear layout.
+// Blocks are VISUALMEM_V2_ALLOC_UNIT << order bytes and aligned to their own
+// size relative to the base, so a block's buddy is one flipped bit of its
+// unit index. Alloc pops the smallest non-empty order (found with one bit
+// scan) and splits it down; free merges with free buddies back up. Both
+// are O(log n) and placements never overlap.
+#define BLOCK_FREE 0x80
+#define BLOCK_INTERIOR 0x7F     // Unit inside a block, not its head
+
+static void buddy_push(visualmem_v2_buddy_t* buddy, int32_t unit, int order) {
+    buddy->block_state[unit] = (uint8_t)(BLOCK_FREE | order);
+    buddy->free_prev[unit] = -1;
+    buddy->free_next[unit] = buddy->free_head[order];
+    if (buddy->free_head[order] >= 0) {
+        buddy->free_prev[buddy->free_head[order]] = unit;
+    }
+    buddy->free_head[order] = unit;
+    buddy->free_orders |= 1u << order;
+}
+
+static void buddy_unlink(visualmem_v2_buddy_t* buddy, int32_t unit, int order) {
+    int32_t prev = buddy->free_prev[unit];
+    int32_t next = buddy->free_next[unit];
+    
+    if (prev >= 0) {
+        buddy->free_next[prev] = next;
+    } else {
+        buddy->free_head[order] = next;
+    }
+    if (next >= 0) {
+        buddy->free_prev[next] = prev;
+    }
+    if (buddy->free_head[order] < 0) {
+        buddy->free_orders &= ~(1u << order);
+    }
+}
+
+static void buddy_release(visualmem_v2_buddy_t* buddy) {
+    free(buddy->block_state);
+    free(buddy->free_next);
+    free(buddy->free_prev);
+    buddy->block_state = NULL;
+    buddy->free_next = NULL;
+    buddy->free_prev = NULL;
+    buddy->unit_count = 0;
+    buddy->free_orders = 0;
+}
+
+static int buddy_init(visualmem_v2_buddy_t* buddy, size_t base, size_t limit) {
+    memset(buddy, 0, sizeof(*buddy));
+    for (int order = 0; order <= VISUALMEM_V2_ALLOC_MAX_ORDER; order++) {
+        buddy->free_head[order] = -1;
+    }
+    buddy->base = base;
+    
+    size_t units = limit > base ? (limit - base) / VISUALMEM_V2_ALLOC_UNIT : 0;
+    if (units == 0) return VISUALMEM_V2_SUCCESS;
+    
+    buddy->unit_count = (int)units;
+    buddy->block_state = malloc(units);
+    buddy->free_next = malloc(units * sizeof(int32_t));
+    buddy->free_prev = malloc(units * sizeof(int32_t));
+    if (!buddy->block_state || !buddy->free_next || !buddy->free_prev) {
+        buddy_release(buddy);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    memset(buddy->block_state, BLOCK_INTERIOR, units);
+    
+    // Cover the area with the largest aligned blocks that fit
+    int32_t unit = 0;
+    while (unit < buddy->unit_count) {
+        int order = 0;
+        while (order < VISUALMEM_V2_ALLOC_MAX_ORDER &&
+               (unit & ((1 << (order + 1)) - 1)) == 0 &&
+               unit + (1 << (order + 1)) <= buddy->unit_count) {
+            order++;
+        }
+        buddy_push(buddy, unit, order);
+        unit += 1 << order;
+    }
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Smallest order holding size bytes (VISUALMEM_V2_ALLOC_MAX_ORDER + 1 if none)
+static int buddy_order(size_t size) {
+    size_t units = (size + VISUALMEM_V2_ALLOC_UNIT - 1) / VISUALMEM_V2_ALLOC_UNIT;
+    int order = 0;
+    while (order <= VISUALMEM_V2_ALLOC_MAX_ORDER && ((size_t)1 << order) < units) {
+        order++;
+    }
+    return order;
+}
+
+static int buddy_alloc(visualmem_v2_buddy_t* buddy, size_t size, size_t* byte_index) {
+    int order = buddy_order(size);
+    if (order > VISUALMEM_V2_ALLOC_MAX_ORDER) return 0;
+    
+    uint32_t candidates = buddy->free_orders & ~((1u << order) - 1);
+    if (!candidates) return 0;
+    
+    int found = __builtin_ctz(candidates);
+    int32_t unit = buddy->free_head[found];
+    buddy_unlink(buddy, unit, found);
+    
+    // Split down to the requested order, freeing the upper halves
+    while (found > order) {
+        found--;
+        buddy_push(buddy, unit + (1 << found), found);
+    }
+    
+    buddy->block_state[unit] = (uint8_t)order;
+    *byte_index = buddy->base + (size_t)unit * VISUALMEM_V2_ALLOC_UNIT;
+    return 1;
+}
+
+static void buddy_free(visualmem_v2_buddy_t* buddy, size_t byte_index) {
+    int32_t unit = (int32_t)((byte_index - buddy->base) / VISUALMEM_V2_ALLOC_UNIT);
+    int order = buddy->block_state[unit];
+    
+    // Coalesce with free buddies of the same order
+    while (order < VISUALMEM_V2_ALLOC_MAX_ORDER) {
+        int32_t mate = unit ^ (1 << order);
+        if (mate + (1 << order) > buddy->unit_count ||
+            buddy->block_state[mate] != (BLOCK_FREE | order)) {
+            break;
+        }
+        buddy_unlink(buddy, mate, order);
+        buddy->block_state[unit > mate ? unit : mate] = BLOCK_INTERIOR;
+        if (mate < unit) unit = mate;
+        order++;
+    }
+    
+    buddy_push(buddy, unit, order);
+}
+
+// Resize an allocated block where it is: shrinking frees its upper halves,
+// growing absorbs the free buddies above it. 0 when it cannot grow in place.
+static int buddy_resize(visualmem_v2_buddy_t* buddy, size_t byte_index, size_t size) {
+    int32_t unit = (int32_t)((byte_index - buddy->base) / VISUALMEM_V2_ALLOC_UNIT);
+    int order = buddy->block_state[unit];
+    int wanted = buddy_order(size);
+    if (wanted > VISUALMEM_V2_ALLOC_MAX_ORDER) return 0;
+    
+    // Growing needs every buddy up to the wanted order to be a free upper half
+    for (int k = order; k < wanted; k++) {
+        int32_t mate = unit + (1 << k);
+        if ((unit & ((1 << (k + 1)) - 1)) != 0 || mate + (1 << k) > buddy->unit_count ||
+            buddy->block_state[mate] != (BLOCK_FREE | k)) {
+            return 0;
+        }
+    }
+    for (int k = order; k < wanted; k++) {
+        int32_t mate = unit + (1 << k);
+        buddy_unlink(buddy, mate, k);
+        buddy->block_state[mate] = BLOCK_INTERIOR;
+    }
+    
+    // The upper halves of a shrinking block have an allocated buddy: no merging
+    while (order > wanted) {
+        order--;
+        buddy_push(buddy, unit + (1 << order), order);
+    }
+    
+    buddy->block_state[unit] = (uint8_t)wanted;
+    return 1;
+}
+
+// === ALLOCATION TABLE ===
+// Starts empty (init stays O(1)) and doubles when the free-slot stack runs
+// dry; callers hold context_mutex. A failed grow leaves the table usable at
+// its old capacity. Inactive slots keep a NULL visual address, so lookups
+// scan a single packed pointer array.
+#define TABLE_GROW(table, field, count) do { \
+        void* grown = realloc((table)->field, sizeof(*(table)->field) * (size_t)(count)); \
+        if (!grown) return VISUALMEM_V2_ERROR_ALLOCATION_FAILED; \
+        (table)->field = grown; \
+    } while (0)
+
+static int table_grow(visualmem_v2_alloc_table_t* table) {
+    int old_capacity = table->capacity;
+    if (old_capacity > INT_MAX / 2) return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    int new_capacity = old_capacity ? old_capacity * 2 : VISUALMEM_V2_ALLOC_TABLE_INITIAL;
+    
+    TABLE_GROW(table, visual_addr, new_capacity);
+    TABLE_GROW(table, is_active, new_capacity);
+    TABLE_GROW(table, size, new_capacity);
+    TABLE_GROW(table, byte_offset, new_capacity);
+    TABLE_GROW(table, x, new_capacity);
+    TABLE_GROW(table, y, new_capacity);
+    TABLE_GROW(table, width, new_capacity);
+    TABLE_GROW(table, height, new_capacity);
+    TABLE_GROW(table, payload_pixels, new_capacity);
+    TABLE_GROW(table, checksum, new_capacity);
+    TABLE_GROW(table, timestamp, new_capacity);
+    TABLE_GROW(table, label, new_capacity);
+    TABLE_GROW(table, free_slots, new_capacity);
+    TABLE_GROW(table, scrub_slots, new_capacity);
+    
+    size_t added = (size_t)(new_capacity - old_capacity);
+    memset(table->visual_addr + old_capacity, 0, added * sizeof(*table->visual_addr));
+    memset(table->is_active + old_capacity, 0, added * sizeof(*table->is_active));
+    
+    // Push the new slots so the lowest index is handed out first
+    for (int slot = new_capacity - 1; slot >= old_capacity; slot--) {
+        table->free_slots[table->free_slot_count++] = slot;
+    }
+    table->capacity = new_capacity;
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+static int table_acquire(visualmem_v2_alloc_table_t* table) {
+    if (table->free_slot_count == 0 && table_grow(table) != VISUALMEM_V2_SUCCESS) {
+        return -1;
+    }
+    return table->free_slots[--table->free_slot_count];
+}
+
+static void table_retire(visualmem_v2_alloc_table_t* table, int slot) {
+    table->is_active[slot] = 0;
+    table->visual_addr[slot] = NULL;
+    table->size[slot] = 0;
+    table->free_slots[table->free_slot_count++] = slot;
+}
+
+static void table_release(visualmem_v2_alloc_table_t* table) {
+    free(table->visual_addr);
+    free(table->is_active);
+    free(table->size);
+    free(table->byte_offset);
+    free(table->x);
+    free(table->y);
+    free(table->width);
+    free(table->height);
+    free(table->payload_pixels);
+    free(table->checksum);
+    free(table->timestamp);
+    free(table->label);
+    free(table->free_slots);
+    free(table->scrub_slots);
+    memset(table, 0, sizeof(*table));
+}
+
+// Slot of the live allocation at visual_addr, or -1
+static int table_find(const visualmem_v2_alloc_table_t* table, void* visual_addr) {
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->visual_addr[i] == visual_addr) return i;
+    }
+    return -1;
+}
+
+// Recompute the packer's free space from the live rectangles (tiled layout)
+static int packer_rebuild(visualmem_v2_context_t* ctx) {
+    const visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int result = packer_reset(ctx);
+    
+    for (int i = 0; i < table->capacity && result == VISUALMEM_V2_SUCCESS; i++) {
+        if (!table->is_active[i]) continue;
+        visualmem_v2_rect_t rect = { table->x[i], table->y[i], table->width[i], table->height[i] };
+        result = packer_reserve(&ctx->packer, &rect);
+        ctx->packer.payload_pixels += table->payload_pixels[i];
+    }
+    
+    return result;
+}
+
+// Make an incomplete free list exact; 1 when a failed placement should retry
+static int packer_refresh(visualmem_v2_context_t* ctx) {
+    if (!ctx->packer.incomplete) return 0;
+    packer_rebuild(ctx);
+    return 1;
+}
+
+// === ALLOCATION REGIONS ===
+// Byte addressing for one allocation: linear allocations index into the
+// screen-wide row layout, tiled allocations into their own rectangle.
+
+typedef struct {
+    int origin_x, origin_y;         // First payload pixel
+    int bytes_per_row;
+    size_t base;                    // Byte index of the allocation's first byte
+    size_t size;
+} byte_region_t;
+
+// Callers hold context_mutex
+static void slot_region(const visualmem_v2_context_t* ctx, int slot, byte_region_t* region) {
+    const visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    
+    if (ctx->layout == VISUALMEM_V2_LAYOUT_TILED) {
+        region->origin_x = table->x[slot];
+        region->origin_y = table->y[slot];
+        region->bytes_per_row = region_bytes_per_row(ctx, table->width[slot]);
+        region->base = 0;
+    } else {
+        region->origin_x = payload_origin_x(ctx);
+        region->origin_y = VISUALMEM_V2_MEMORY_START_Y;
+        region->bytes_per_row = ctx->bytes_per_row;
+        region->base = table->byte_offset[slot];
+    }
+    region->size = table->size[slot];
+}
+
+// Arena allocations live inside an arena slot's region. Each one's length
+// sits in the VISUALMEM_V2_ARENA_HEADER bytes before it and its address is
+// the pixel of its first byte, stamped with the arena's epoch. The arena
+// records only where each allocation starts: an address resolves when it
+// names a recorded start in the current epoch, never on the length bytes
+// alone, which caller data can imitate.
+
+// Arena record of a slot, or -1
+static int arena_of_slot(const visualmem_v2_context_t* ctx, int slot) {
+    for (int i = 0; i < ctx->arena_count; i++) {
+        if (ctx->arenas[i].slot == slot) return i;
+    }
+    return -1;
+}
+
+// Offset of the region byte whose first pixel is (x, y); 0 when none starts there
+static int region_byte_at(const visualmem_v2_context_t* ctx, const byte_region_t* region,
+                          int x, int y, size_t* offset) {
+    int dx = x - region->origin_x;
+    int dy = y - region->origin_y;
+    if (dx < 0 || dy < 0 || dy % row_pixel_spacing(ctx) != 0) return 0;
+    
+    size_t col;
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY || palette_bits > 0) {
+        int pixels_per_byte = palette_bits > 0 ? 8 / palette_bits : VISUALMEM_V2_BYTE_SPACING_X;
+        if (dx % pixels_per_byte != 0) return 0;
+        col = (size_t)(dx / pixels_per_byte);
+    } else {
+        col = (size_t)dx * encoding_bytes_per_pixel(ctx->encoding);
+    }
+    if (col >= (size_t)region->bytes_per_row) return 0;
+    
+    size_t byte = (size_t)(dy / row_pixel_spacing(ctx)) * region->bytes_per_row + col;
+    if (byte < region->base || byte - region->base >= region->size) return 0;
+    *offset = byte - region->base;
+    return 1;
+}
+
+// Pixels one payload byte spans, for the pixel counters
+static int pixels_per_byte(const visualmem_v2_context_t* ctx) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) return VISUALMEM_V2_BYTE_SPACING_X;
+    return palette_bits > 0 ? 8 / palette_bits : 1;
+}
+
+// Pixel rows holding count (> 0) bytes of a region, starting first bytes in
+static void region_rows(const visualmem_v2_context_t* ctx, const byte_region_t* region,
+                        size_t first, size_t count, int* y0, int* y1) {
+    int x, channel;
+    locate_byte(ctx, region->origin_x, region->origin_y, region->bytes_per_row,
+                region->base + first, &x, y0, &channel);
+    locate_byte(ctx, region->origin_x, region->origin_y, region->bytes_per_row,
+                region->base + first + count - 1, &x, y1, &channel);
+}
+
+// Callers hold the bands of the bytes' rows
+static void region_store(visualmem_v2_context_t* ctx, const byte_region_t* region,
+                         size_t first, const uint8_t* bytes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int x, y, channel;
+        locate_byte(ctx, region->origin_x, region->origin_y, region->bytes_per_row,
+                    region->base + first + i, &x, &y, &channel);
+        encode_byte(ctx, x, y, channel, bytes[i]);
+    }
+    count_pixel_ops(ctx, count * pixels_per_byte(ctx));
+}
+
+static void region_load(visualmem_v2_context_t* ctx, const byte_region_t* region,
+                        size_t first, uint8_t* bytes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int x, y, channel;
+        locate_byte(ctx, region->origin_x, region->origin_y, region->bytes_per_row,
+                    region->base + first + i, &x, &y, &channel);
+        bytes[i] = decode_byte(ctx, x, y, channel);
+    }
+    count_pixel_ops(ctx, count * pixels_per_byte(ctx));
+}
+
+// region_store / region_load holding just the bands the bytes cover
+static void region_store_locked(visualmem_v2_context_t* ctx, const byte_region_t* region,
+                                size_t first, const uint8_t* bytes, size_t count) {
+    int y0, y1;
+    region_rows(ctx, region, first, count, &y0, &y1);
+    lock_rows(ctx, y0, y1, 1);
+    region_store(ctx, region, first, bytes, count);
+    unlock_rows(ctx, y0, y1);
+}
+
+static void region_load_locked(visualmem_v2_context_t* ctx, const byte_region_t* region,
+                               size_t first, uint8_t* bytes, size_t count) {
+    int y0, y1;
+    region_rows(ctx, region, first, count, &y0, &y1);
+    lock_rows(ctx, y0, y1, 0);
+    region_load(ctx, region, first, bytes, count);
+    unlock_rows(ctx, y0, y1);
+}
+
+// Index of the allocation starting at offset, or -1
+static int arena_start_index(const visualmem_v2_arena_t* arena, size_t offset) {
+    int low = 0, high = arena->start_count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (arena->starts[mid] == offset) return mid;
+        if (arena->starts[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+// Region of the live arena allocation at visual_addr; caller holds context_mutex
+static int arena_find_region(visualmem_v2_context_t* ctx, void* visual_addr, byte_region_t* region) {
+    uint32_t stamp = addr_stamp(visual_addr);
+    if (stamp == 0) return 0;
+    int x, y;
+    addr_to_coord(unstamp_addr(visual_addr), &x, &y);
+    
+    for (int i = 0; i < ctx->arena_count; i++) {
+        const visualmem_v2_arena_t* arena = &ctx->arenas[i];
+        byte_region_t arena_region;
+        size_t offset;
+        if (arena->slot < 0 || epoch_stamp(arena->epoch) != stamp) continue;
+        slot_region(ctx, arena->slot, &arena_region);
+        if (!region_byte_at(ctx, &arena_region, x, y, &offset)) continue;
+        int index = arena_start_index(arena, offset);
+        if (index < 0) continue;
+        
+        // The header sits between allocations, out of reach of bounded writes;
+        // the next start still caps it against raw pixel writes
+        uint8_t header[VISUALMEM_V2_ARENA_HEADER];
+        size_t length = 0;
+        region_load_locked(ctx, &arena_region, offset - VISUALMEM_V2_ARENA_HEADER, header, sizeof(header));
+        for (int b = VISUALMEM_V2_ARENA_HEADER - 1; b >= 0; b--) {
+            length = (length << 8) | header[b];
+        }
+        size_t limit = index + 1 < arena->start_count ?
+            arena->starts[index + 1] - VISUALMEM_V2_ARENA_HEADER : arena->used;
+        if (length == 0 || length > limit - offset) continue;
+        
+        *region = arena_region;
+        region->base += offset;
+        region->size = length;
+        return 1;
+    }
+    return 0;
+}
+
+// === THREAD CACHES ===
+// Each thread takes pages (allocation slots) from the allocator under
+// context_mutex and carves them into blocks of one size class. The owner
+// claims and returns blocks with atomics on the page's bitmap, so its
+// alloc/free pairs never take context_mutex; other threads resolve and
+// free those blocks holding it. Empty pages go back through the scrub
+// queue when their owner holds a spare of the class, when allocation runs
+// out of room, and before the address space is rebuilt. A block's address
+// is the pixel of its first byte, as for arena allocations.
+#define TCACHE_PAGE_MAX_BLOCKS 32
+#define PAGE_RETIRED UINT64_MAX         // used value of a page given back
+
+typedef struct {
+    int slot;                           // Allocation slot holding the page
+    int size_class;                     // Blocks of VISUALMEM_V2_ALLOC_UNIT << size_class bytes
+    byte_region_t region;               // The slot's bytes
+    size_t lead;                        // Bytes skipped so blocks start on a pixel
+    size_t stride;                      // Bytes from one block to the next
+    int blocks;
+    uint64_t used;                      // Bit per handed-out block, PAGE_RETIRED once given back
+    uint64_t dirty;                     // Freed blocks not cleared yet
+    size_t sizes[TCACHE_PAGE_MAX_BLOCKS];  // Bytes asked for, per handed-out block
+} cache_page_t;
+
+typedef struct visualmem_v2_thread_cache {
+    const void* owner;                  // Thread token of the owning thread
+    cache_page_t** pages;               // Changed only by the owner, holding context_mutex
+    int page_count;
+    int page_capacity;
+    uint64_t allocations;               // Blocks handed out, for the performance counters
+    uint64_t deallocations;
+    struct visualmem_v2_thread_cache* next;
+} thread_cache_t;
+
+static uint64_t thread_cache_serials;           // Last serial handed out
+static __thread char thread_token;              // Its address identifies the thread
+static __thread uint64_t current_serial;        // Context of current_cache
+static __thread thread_cache_t* current_cache;
+
+// The calling thread's cache if it has one and caches are on; takes no lock
+static thread_cache_t* own_cache(const visualmem_v2_context_t* ctx) {
+    uint64_t serial = __atomic_load_n(&ctx->thread_cache_serial, __ATOMIC_ACQUIRE);
+    return serial != 0 && serial == current_serial ? current_cache : NULL;
+}
+
+static size_t block_base(const cache_page_t* page, int block) {
+    return page->region.base + page->lead + (size_t)block * page->stride;
+}
+
+// Block of a page that starts at pixel (x, y), or -1
+static int page_block_at(const visualmem_v2_context_t* ctx, const cache_page_t* page, int x, int y) {
+    size_t offset;
+    if (!region_byte_at(ctx, &page->region, x, y, &offset) || offset < page->lead) return -1;
+    
+    offset -= page->lead;
+    if (offset % page->stride != 0 || offset / page->stride >= (size_t)page->blocks) return -1;
+    return (int)(offset / page->stride);
+}
+
+// Page holding the handed-out block at visual_addr. The owner calls this
+// without a lock; other threads hold context_mutex
+static cache_page_t* cache_find(const visualmem_v2_context_t* ctx, const thread_cache_t* cache,
+                                void* visual_addr, int* block) {
+    if (addr_stamp(visual_addr)) return NULL; // Arena allocation
+    int x, y;
+    addr_to_coord(visual_addr, &x, &y);
+    
+    for (int i = 0; i < cache->page_count; i++) {
+        cache_page_t* page = cache->pages[i];
+        uint64_t used = __atomic_load_n(&page->used, __ATOMIC_ACQUIRE);
+        if (used == PAGE_RETIRED) continue;
+        
+        int found = page_block_at(ctx, page, x, y);
+        if (found >= 0 && (used >> found & 1)) {
+            *block = found;
+            return page;
+        }
+    }
+    return NULL;
+}
+
+// cache_find over every thread's cache; caller holds context_mutex
+static cache_page_t* caches_find(const visualmem_v2_context_t* ctx, void* visual_addr,
+                                 int* block, thread_cache_t** owner) {
+    for (thread_cache_t* cache = ctx->thread_caches; cache; cache = cache->next) {
+        cache_page_t* page = cache_find(ctx, cache, visual_addr, block);
+        if (page) {
+            if (owner) *owner = cache;
+            return page;
+        }
+    }
+    return NULL;
+}
+
+static void block_region(const cache_page_t* page, int block, byte_region_t* region) {
+    *region = page->region;
+    region->base = block_base(page, block);
+    region->size = __atomic_load_n(&page->sizes[block], __ATOMIC_RELAXED);
+}
+
+// Region of a cached block of any thread; caller holds context_mutex
+static int cached_region(const visualmem_v2_context_t* ctx, void* visual_addr, byte_region_t* region) {
+    int block;
+    cache_page_t* page = caches_find(ctx, visual_addr, &block, NULL);
+    if (!page) return 0;
+    
+    block_region(page, block, region);
+    return 1;
+}
+
+// Hand a block back to its page; the owner calls this without a lock,
+// other threads hold context_mutex. 1 when the page is now empty
+static int page_release(thread_cache_t* cache, cache_page_t* page, int block) {
+    uint64_t bit = (uint64_t)1 << block;
+    __atomic_fetch_or(&page->dirty, bit, __ATOMIC_RELEASE);
+    uint64_t used = __atomic_fetch_and(&page->used, ~bit, __ATOMIC_ACQ_REL);
+    __atomic_fetch_add(&cache->deallocations, 1, __ATOMIC_RELAXED);
+    return (used & ~bit) == 0;
+}
+
+static int find_region(visualmem_v2_context_t* ctx, void* visual_addr, byte_region_t* region) {
+    // Blocks from the calling thread's cache resolve without the lock
+    thread_cache_t* cache = own_cache(ctx);
+    int block;
+    cache_page_t* page = cache ? cache_find(ctx, cache, visual_addr, &block) : NULL;
+    if (page) {
+        block_region(page, block, region);
+        return 1;
+    }
+    
+    int found = 0;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    int slot = table_find(&ctx->allocations, visual_addr);
+    if (slot >= 0) {
+        slot_region(ctx, slot, region);
+        found = 1;
+    } else {
+        found = arena_find_region(ctx, visual_addr, region) || cached_region(ctx, visual_addr, region);
+    }
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return found;
+}
+
+// Zero count bytes of a region, starting first bytes in; takes the bands itself
+static void clear_region_bytes(visualmem_v2_context_t* ctx, const byte_region_t* region,
+                               size_t first, size_t count) {
+    if (count == 0) return;
+    
+    int y0, y1;
+    region_rows(ctx, region, first, count, &y0, &y1);
+    lock_rows(ctx, y0, y1, 1);
+    for (size_t i = first; i < first + count; i++) {
+        int x, y, channel;
+        locate_byte(ctx, region->origin_x, region->origin_y, region->bytes_per_row,
+                    region->base + i, &x, &y, &channel);
+        encode_byte(ctx, x, y, channel, 0);
+    }
+    unlock_rows(ctx, y0, y1);
+    count_pixel_ops(ctx, count * pixels_per_byte(ctx));
+}
+
+// Paint a rectangle with the encoding's zero pixel row by row, marking its
+// tiles dirty once; takes the bands itself
+static void clear_rect_pixels(visualmem_v2_context_t* ctx, int x0, int y0, int width, int height) {
+    const pixel_engine_t* engine = &pixel_engines[ctx->pixel_format];
+    uint32_t zero = zero_pixel(ctx);
+    int x1 = x0 + width < ctx->width ? x0 + width : ctx->width;
+    int y1 = y0 + height < ctx->height ? y0 + height : ctx->height;
+    if (x0 < 0 || y0 < 0 || x1 <= x0 || y1 <= y0) return;
+    
+    lock_rows(ctx, y0, y1 - 1, 1);
+    for (int y = y0; y < y1; y++) {
+        uint8_t* row = video_row(ctx, y);
+        for (int x = x0; x < x1; x++) {
+            engine->store(row, x, zero);
+        }
+    }
+    
+    mark_rect_dirty(ctx, x0, y0, x1 - x0, y1 - y0);
+    unlock_rows(ctx, y0, y1 - 1);
+    count_pixel_ops(ctx, (uint64_t)(x1 - x0) * (uint64_t)(y1 - y0));
+}
+
+// Copy stored pixels within one row span; rows are in the pixel format
+static void copy_pixels(visualmem_v2_context_t* ctx, int dst_x, int dst_y, int src_x, int src_y, int count) {
+    const pixel_engine_t* engine = &pixel_engines[ctx->pixel_format];
+    uint8_t* dst_row = video_row(ctx, dst_y);
+    const uint8_t* src_row = video_row(ctx, src_y);
+    
+    if (engine->bits_per_pixel % 8 == 0) {
+        size_t pixel_bytes = engine->bits_per_pixel / 8;
+        memmove(dst_row + dst_x * pixel_bytes, src_row + src_x * pixel_bytes, count * pixel_bytes);
+    } else {
+        for (int i = 0; i < count; i++) {
+            engine->store(dst_row, dst_x + i, engine->load(src_row, src_x + i));
+        }
+    }
+    
+    mark_rect_dirty(ctx, dst_x, dst_y, count, 1);
+    count_pixel_ops(ctx, (uint64_t)count);
+}
+
+// Dense bytes share pixels: move one channel into another pixel
+static void copy_channel(visualmem_v2_context_t* ctx, int dst_x, int dst_y, int dst_channel,
+                         int src_x, int src_y, int src_channel) {
+    uint32_t value = (get_pixel(ctx, src_x, src_y) >> dense_channel_shift[src_channel]) & 0xFF;
+    int shift = dense_channel_shift[dst_channel];
+    uint32_t pixel = get_pixel(ctx, dst_x, dst_y);
+    put_pixel(ctx, dst_x, dst_y, (pixel & ~((uint32_t)0xFF << shift)) | (value << shift));
+}
+
+// Copy a run of bytes that stays on one row of both regions
+static void copy_byte_run(visualmem_v2_context_t* ctx, int dst_x, int dst_y, int dst_channel,
+                          int src_x, int src_y, int src_channel, size_t count) {
+    int palette_bits = encoding_palette_bits(ctx->encoding);
+    if (ctx->encoding == VISUALMEM_V2_ENCODING_BINARY) {
+        copy_pixels(ctx, dst_x, dst_y, src_x, src_y, (int)count * VISUALMEM_V2_BYTE_SPACING_X);
+        return;
+    }
+    if (palette_bits > 0) {
+        copy_pixels(ctx, dst_x, dst_y, src_x, src_y, (int)count * (8 / palette_bits));
+        return;
+    }
+    
+    // Dense: whole pixels copy straight across when both runs share a channel phase
+    int bytes_per_pixel = encoding_bytes_per_pixel(ctx->encoding);
+    while (count > 0 && (src_channel != dst_channel || src_channel != 0 || count < (size_t)bytes_per_pixel)) {
+        copy_channel(ctx, dst_x, dst_y, dst_channel, src_x, src_y, src_channel);
+        if (++src_channel == bytes_per_pixel) { src_channel = 0; src_x++; }
+        if (++dst_channel == bytes_per_pixel) { dst_channel = 0; dst_x++; }
+        count--;
+    }
+    
+    int whole = (int)(count / bytes_per_pixel);
+    if (whole > 0) {
+        copy_pixels(ctx, dst_x, dst_y, src_x, src_y, whole);
+    }
+    for (size_t i = (size_t)whole * bytes_per_pixel; i < count; i++) {
+        copy_channel(ctx, dst_x + whole, dst_y, (int)(i % bytes_per_pixel),
+                     src_x + whole, src_y, (int)(i % bytes_per_pixel));
+    }
+}
+
+// Move the first count bytes of one region into another without decoding:
+// each run up to the next row end of either region is one pixel copy.
+// Takes the bands of both regions itself
+static void copy_region_bytes(visualmem_v2_context_t* ctx, const byte_region_t* dst,
+                              const byte_region_t* src, size_t count) {
+    if (count == 0) return;
+    
+    int src_y0, src_y1, dst_y0, dst_y1;
+    region_rows(ctx, src, 0, count, &src_y0, &src_y1);
+    region_rows(ctx, dst, 0, count, &dst_y0, &dst_y1);
+    int y0 = src_y0 < dst_y0 ? src_y0 : dst_y0;
+    int y1 = src_y1 > dst_y1 ? src_y1 : dst_y1;
+    lock_rows(ctx, y0, y1, 1);
+    
+    size_t done = 0;
+    while (done < count) {
+        size_t src_byte = src->base + done;
+        size_t dst_byte = dst->base + done;
+        size_t run = count - done;
+        size_t src_left = src->bytes_per_row - src_byte % src->bytes_per_row;
+        size_t dst_left = dst->bytes_per_row - dst_byte % dst->bytes_per_row;
+        if (run > src_left) run = src_left;
+        if (run > dst_left) run = dst_left;
+        
+        int src_x, src_y, src_channel, dst_x, dst_y, dst_channel;
+        locate_byte(ctx, src->origin_x, src->origin_y, src->bytes_per_row, src_byte,
+                    &src_x, &src_y, &src_channel);
+        locate_byte(ctx, dst->origin_x, dst->origin_y, dst->bytes_per_row, dst_byte,
+                    &dst_x, &dst_y, &dst_channel);
+        copy_byte_run(ctx, dst_x, dst_y, dst_channel, src_x, src_y, src_channel, run);
+        done += run;
+    }
+    
+    unlock_rows(ctx, y0, y1);
+}
+
+// === DEFERRED CLEARING ===
+// visualmem_v2_free only unpublishes an allocation and queues its slot. The
+// refresh thread clears queued regions outside context_mutex and only then
+// returns their space; visualmem_v2_scrub and allocations that run out of
+// room drain the queue on the spot. A queued slot keeps its block or
+// rectangle, so nothing is placed over pixels that are still being cleared.
+
+// Return a slot's space and mark it inactive; caller holds context_mutex
+static void release_slot(visualmem_v2_context_t* ctx, int slot) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    if (ctx->layout != VISUALMEM_V2_LAYOUT_TILED) {
+        buddy_free(&ctx->buddy, table->byte_offset[slot]);
+        table_retire(table, slot);
+        return;
+    }
+    
+    // Its rectangle returns to the packer
+    visualmem_v2_rect_t rect = { table->x[slot], table->y[slot], table->width[slot], table->height[slot] };
+    ctx->packer.payload_pixels -= table->payload_pixels[slot];
+    table_retire(table, slot);
+    if (packer_free(&ctx->packer, &rect) != VISUALMEM_V2_SUCCESS) {
+        packer_rebuild(ctx);
+    }
+}
+
+// Unpublish a live slot and queue it for clearing; caller holds context_mutex
+static void queue_scrub(visualmem_v2_context_t* ctx, int slot) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    table->visual_addr[slot] = NULL;
+    table->scrub_slots[table->scrub_count++] = slot;
+    
+    ctx->allocation_count--;
+    ctx->performance.total_deallocations++;
+}
+
+// Queue empty thread cache pages for clearing, of one cache or of all.
+// keep_spare leaves one empty page per size class. A page whose owner
+// claims a block meanwhile stays. Caller holds context_mutex; returns the
+// number of pages given back
+static int release_cache_pages(visualmem_v2_context_t* ctx, const thread_cache_t* only, int keep_spare) {
+    int released = 0;
+    
+    for (thread_cache_t* cache = ctx->thread_caches; cache; cache = cache->next) {
+        if (only && cache != only) continue;
+        
+        unsigned spares = 0;
+        for (int i = 0; i < cache->page_count; i++) {
+            cache_page_t* page = cache->pages[i];
+            uint64_t empty = 0;
+            if (__atomic_load_n(&page->used, __ATOMIC_ACQUIRE) != 0) continue;
+            if (keep_spare && !(spares & 1u << page->size_class)) {
+                spares |= 1u << page->size_class;
+                continue;
+            }
+            if (!__atomic_compare_exchange_n(&page->used, &empty, PAGE_RETIRED, 0,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            
+            // Pages were never counted as allocations by the caller
+            queue_scrub(ctx, page->slot);
+            ctx->performance.total_deallocations--;
+            released++;
+        }
+    }
+    
+    return released;
+}
+
+// Drop the records of given-back pages; the owner holds context_mutex
+static void cache_prune(thread_cache_t* cache) {
+    int kept = 0;
+    for (int i = 0; i < cache->page_count; i++) {
+        if (__atomic_load_n(&cache->pages[i]->used, __ATOMIC_ACQUIRE) == PAGE_RETIRED) {
+            free(cache->pages[i]);
+        } else {
+            cache->pages[kept++] = cache->pages[i];
+        }
+    }
+    cache->page_count = kept;
+}
+
+// Turn caches off and free them; pages still holding blocks are queued as
+// well. Only for cleanup, with no other thread using the context
+static void release_thread_caches(visualmem_v2_context_t* ctx) {
+    __atomic_store_n(&ctx->thread_cache_serial, 0, __ATOMIC_RELEASE);
+    
+    while (ctx->thread_caches) {
+        thread_cache_t* cache = ctx->thread_caches;
+        for (int i = 0; i < cache->page_count; i++) {
+            if (cache->pages[i]->used != PAGE_RETIRED) {
+                queue_scrub(ctx, cache->pages[i]->slot);
+            }
+            free(cache->pages[i]);
+        }
+        ctx->thread_caches = cache->next;
+        free(cache->pages);
+        free(cache);
+    }
+}
+
+// Clear up to limit queued slots; returns how many were cleared
+static int scrub_pending(visualmem_v2_context_t* ctx, int limit) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int scrubbed = 0;
+    
+    while (scrubbed < limit) {
+        pthread_mutex_lock(&ctx->context_mutex);
+        if (table->scrub_count == 0) {
+            pthread_mutex_unlock(&ctx->context_mutex);
+            break;
+        }
+        int slot = table->scrub_slots[--table->scrub_count];
+        table->scrub_active++;
+        byte_region_t region;
+        slot_region(ctx, slot, &region);
+        visualmem_v2_rect_t rect = { table->x[slot], table->y[slot], table->width[slot], table->height[slot] };
+        int tiled = ctx->layout == VISUALMEM_V2_LAYOUT_TILED;
+        pthread_mutex_unlock(&ctx->context_mutex);
+        
+        if (tiled) {
+            clear_rect_pixels(ctx, rect.x, rect.y, rect.width, rect.height);
+        } else {
+            // Neighbours share these rows: zero only this allocation's bytes
+            clear_region_bytes(ctx, &region, 0, region.size);
+        }
+        
+        pthread_mutex_lock(&ctx->context_mutex);
+        release_slot(ctx, slot);
+        table->scrub_active--;
+        pthread_mutex_unlock(&ctx->context_mutex);
+        scrubbed++;
+    }
+    
+    return scrubbed;
+}
+
+// Clear the whole queue, including slots another thread is clearing.
+// Empty thread cache pages join it first
+static void drain_pending(visualmem_v2_context_t* ctx) {
+    pthread_mutex_lock(&ctx->context_mutex);
+    release_cache_pages(ctx, NULL, 0);
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    scrub_pending(ctx, INT_MAX);
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    while (ctx->allocations.scrub_active > 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        usleep(100);
+        pthread_mutex_lock(&ctx->context_mutex);
+    }
+    pthread_mutex_unlock(&ctx->context_mutex);
+}
+
+#define RECLAIM_ATTEMPTS 4              // Retries of an allocation that ran out of room
+
+// Out of room while freed regions or empty cache pages wait: clear them now
+// so the caller can retry. Caller holds context_mutex, which is dropped meanwhile
+static int reclaim_pending(visualmem_v2_context_t* ctx) {
+    release_cache_pages(ctx, NULL, 0);
+    if (ctx->allocations.scrub_count == 0 && ctx->allocations.scrub_active == 0) return 0;
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    drain_pending(ctx);
+    pthread_mutex_lock(&ctx->context_mutex);
+    return 1;
+}
+
+// Live allocations, or freed ones not yet cleared; caller holds context_mutex
+static int address_space_busy(const visualmem_v2_context_t* ctx) {
+    return ctx->allocation_count > 0 ||
+        ctx->allocations.scrub_count > 0 || ctx->allocations.scrub_active > 0;
+}
+
+// === BATCH ORDERING ===
+// Batched calls take context_mutex once and visit their entries sorted by
+// visual address. Addresses are pixel positions in row-major order, so
+// entries sharing an allocation sit together (it is looked up once) and
+// the pixels are touched front to back. Vectored reads and writes then
+// take the bands their entries cover in a single pass.
+
+typedef struct {
+    void* visual_addr;
+    size_t key;                     // Offset for iovecs, size for allocations
+    int entry;                      // Position in the caller's array
+} batch_entry_t;
+
+static int compare_by_address(const void* a, const void* b) {
+    const batch_entry_t* x = (const batch_entry_t*)a;
+    const batch_entry_t* y = (const batch_entry_t*)b;
+    if (x->visual_addr != y->visual_addr) {
+        return (uintptr_t)x->visual_addr < (uintptr_t)y->visual_addr ? -1 : 1;
+    }
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->entry - y->entry;
+}
+
+static int compare_by_size_desc(const void* a, const void* b) {
+    const batch_entry_t* x = (const batch_entry_t*)a;
+    const batch_entry_t* y = (const batch_entry_t*)b;
+    if (x->key != y->key) return x->key > y->key ? -1 : 1;
+    return x->entry - y->entry;
+}
+
+// Sort iovec entries and resolve each into regions[] (sorted order);
+// caller holds context_mutex. Entries of one allocation may overlap only
+// when reading
+static int resolve_iovecs(visualmem_v2_context_t* ctx, const visualmem_v2_iovec_t* iov, int count,
+                          int writing, batch_entry_t* order, byte_region_t* regions) {
+    for (int i = 0; i < count; i++) {
+        if (!iov[i].visual_addr || !iov[i].buffer || iov[i].size == 0) {
+            return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+        }
+        order[i].visual_addr = iov[i].visual_addr;
+        order[i].key = iov[i].offset;
+        order[i].entry = i;
+    }
+    qsort(order, count, sizeof(batch_entry_t), compare_by_address);
+    
+    for (int i = 0; i < count; i++) {
+        const visualmem_v2_iovec_t* v = &iov[order[i].entry];
+        if (i > 0 && order[i - 1].visual_addr == v->visual_addr) {
+            regions[i] = regions[i - 1];
+            if (writing && v->offset < order[i - 1].key + iov[order[i - 1].entry].size) {
+                return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+            }
+        } else {
+            int slot = table_find(&ctx->allocations, v->visual_addr);
+            if (slot >= 0) {
+                slot_region(ctx, slot, &regions[i]);
+            } else if (!arena_find_region(ctx, v->visual_addr, &regions[i]) &&
+                       !cached_region(ctx, v->visual_addr, &regions[i])) {
+                return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+            }
+        }
+        if (v->offset > regions[i].size || v->size > regions[i].size - v->offset) {
+            return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+        }
+    }
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Undo place_allocation for a slot that was never handed out; caller holds context_mutex
+static void retract_slot(visualmem_v2_context_t* ctx, int slot) {
+    release_slot(ctx, slot);
+    ctx->allocation_count--;
+    ctx->performance.total_allocations--;
+}
+
+// === DISPLAY REFRESH THREAD ===
+
+static void* display_refresh_thread(void* arg) {
+    visualmem_v2_context_t* ctx = (visualmem_v2_context_t*)arg;
+    
+    printf("[DISPLAY] Refresh thread started (target: %d Hz)\n", ctx->refresh_rate_hz);
+    
+    int frame_time_us = 1000000 / ctx->refresh_rate_hz;
+    uint64_t frame_count = 0;
+    uint64_t start_time = get_timestamp_us();
+    
+    while (__atomic_load_n(&ctx->display_thread_running, __ATOMIC_ACQUIRE)) {
+        uint64_t frame_start = get_timestamp_us();
+        
+        // Refresh display based on backend
+        if (ctx->backend == VISUALMEM_V2_BACKEND_X11 || 
+            ctx->backend == VISUALMEM_V2_BACKEND_OPENGL) {
+            refresh_dirty_tiles(ctx);
+        }
+        
+        // Clear freed regions off the allocating threads' path
+        scrub_pending(ctx, VISUALMEM_V2_SCRUB_BATCH);
+        
+        // Counters change under context_mutex, where get_performance reads them
+        frame_count++;
+        uint64_t elapsed = get_timestamp_us() - start_time;
+        pthread_mutex_lock(&ctx->context_mutex);
+        ctx->performance.display_refreshes++;
+        if (elapsed > 0) {
+            ctx->performance.frame_rate = (double)frame_count * 1000000.0 / elapsed;
+        }
+        pthread_mutex_unlock(&ctx->context_mutex);
+        
+        // Sleep until next frame
+        uint64_t frame_end = get_timestamp_us();
+        int frame_duration = frame_end - frame_start;
+        
+        if (frame_duration < frame_time_us) {
+            usleep(frame_time_us - frame_duration);
+        }
+    }
+    
+    printf("[DISPLAY] Refresh thread stopped\n");
+    return NULL;
+}
+
+// === CORE API IMPLEMENTATION ===
+
+int visualmem_v2_get_hardware_caps(visualmem_v2_hardware_caps_t* caps) {
+    return visualmem_v2_detect_hardware(caps);
+}
+
+int visualmem_v2_init(visualmem_v2_context_t* ctx, 
+                      visualmem_v2_mode_t mode,
+                      int width, int height) {
+    return visualmem_v2_init_with_backend(ctx, VISUALMEM_V2_BACKEND_AUTO, mode, width, height);
+}
+
+int visualmem_v2_init_with_backend(visualmem_v2_context_t* ctx,
+                                   visualmem_v2_backend_t backend,
+                                   visualmem_v2_mode_t mode,
+                                   int width, int height) {
+    if (!ctx) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    
+    if (width < VISUALMEM_V2_MIN_WIDTH || width > VISUALMEM_V2_MAX_WIDTH ||
+        height < VISUALMEM_V2_MIN_HEIGHT || height > VISUALMEM_V2_MAX_HEIGHT) {
+        return VISUALMEM_V2_ERROR_INVALID_RESOLUTION;
+    }
+    
+    printf("[INIT] Initializing LibVisualMem v2.0...\n");
+    printf("[INIT] Resolution: %dx%d, Mode: %d, Backend: %d\n", width, height, mode, backend);
+    
+    // Initialize context
+    memset(ctx, 0, sizeof(visualmem_v2_context_t));
+    ctx->width = width;
+    ctx->height = height;
+    ctx->mode = mode;
+    ctx->backend = backend;
+    ctx->pixel_format = VISUALMEM_V2_PIXEL_RGBA32;
+    ctx->encoding = VISUALMEM_V2_ENCODING_BINARY;
+    ctx->layout = VISUALMEM_V2_LAYOUT_LINEAR;
+    compute_layout(ctx);
+    init_tile_grid(ctx);
+    ctx->refresh_rate_hz = 60;
+    ctx->vsync_enabled = 1;
+    ctx->double_buffering = 1;
+    
+    // Initialize mutexes
+    if (pthread_mutex_init(&ctx->context_mutex, NULL) != 0) {
+        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    }
+    
+    if (pthread_cond_init(&ctx->display_cond, NULL) != 0) {
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    }
+    
+    if (init_pixel_locks(ctx) != VISUALMEM_V2_SUCCESS) {
+        pthread_cond_destroy(&ctx->display_cond);
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_THREAD_FAILED;
+    }
+    
+    // Detect hardware capabilities
+    int result = visualmem_v2_detect_hardware(&ctx->hardware);
+    if (result != VISUALMEM_V2_SUCCESS) {
+        printf("[INIT] ERROR: Hardware detection failed\n");
+        destroy_pixel_locks(ctx);
+        pthread_cond_destroy(&ctx->display_cond);
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return result;
+    }
+    
+    // Select backend if auto
+    if (ctx->backend == VISUALMEM_V2_BACKEND_AUTO) {
+        ctx->backend = visualmem_v2_select_best_backend(&ctx->hardware);
+    }
+    
+    // Initialize hardware backend
+    result = visualmem_v2_init_hardware_backend(ctx);
+    if (result != VISUALMEM_V2_SUCCESS) {
+        printf("[INIT] ERROR: Hardware backend initialization failed\n");
+        destroy_pixel_locks(ctx);
+        pthread_cond_destroy(&ctx->display_cond);
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return result;
+    }
+    
+    // Set up the pixel store in the display's native format
+    result = setup_video_memory(ctx, native_pixel_format(ctx));
+    if (result != VISUALMEM_V2_SUCCESS) {
+        printf("[INIT] ERROR: Failed to allocate video memory buffer\n");
+        visualmem_v2_cleanup_hardware_backend(ctx);
+        destroy_pixel_locks(ctx);
+        pthread_cond_destroy(&ctx->display_cond);
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return result;
+    }
+    
+    result = buddy_init(&ctx->buddy, 0, ctx->capacity_bytes);
+    if (result != VISUALMEM_V2_SUCCESS) {
+        printf("[INIT] ERROR: Failed to allocate allocator tables\n");
+        release_video_memory(ctx);
+        visualmem_v2_cleanup_hardware_backend(ctx);
+        destroy_pixel_locks(ctx);
+        pthread_cond_destroy(&ctx->display_cond);
+        pthread_mutex_destroy(&ctx->context_mutex);
+        return result;
+    }
+    
+    // Start display refresh thread
+    ctx->display_thread_running = 1;
+    if (pthread_create(&ctx->display_thread, NULL, display_refresh_thread, ctx) != 0) {
+        printf("[INIT] WARNING: Failed to start display refresh thread\n");
+        ctx->display_thread_running = 0;
+    }
+    
+    ctx->is_initialized = 1;
+    ctx->hardware_active = 1;
+    ctx->display_active = 1;
+    
+    printf("[INIT] LibVisualMem v2.0 initialized successfully\n");
+    printf("[INIT] Backend: %d, Hardware: %s, Video Memory: %zu bytes (%s%s)\n", 
+           ctx->backend, ctx->hardware.gpu_model, ctx->video_memory_size,
+           pixel_engines[ctx->pixel_format].name, ctx->video_memory_shared ? ", shared with XImage" : "");
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+void visualmem_v2_cleanup(visualmem_v2_context_t* ctx) {
+    if (!ctx || !ctx->is_initialized) return;
+    
+    printf("[CLEANUP] Shutting down LibVisualMem v2.0...\n");
+    
+    // Stop display thread
+    __atomic_store_n(&ctx->display_thread_running, 0, __ATOMIC_RELEASE);
+    if (ctx->display_thread) {
+        pthread_join(ctx->display_thread, NULL);
+    }
+    
+    // Free all allocations; arenas and thread cache pages go with their slots
+    release_thread_caches(ctx);
+    for (int i = 0; i < ctx->arena_count; i++) {
+        free(ctx->arenas[i].starts);
+    }
+    free(ctx->arenas);
+    ctx->arenas = NULL;
+    ctx->arena_count = ctx->arena_capacity = 0;
+    for (int i = 0; i < ctx->allocations.capacity && ctx->allocation_count > 0; i++) {
+        if (ctx->allocations.is_active[i]) {
+            visualmem_v2_free(ctx, ctx->allocations.visual_addr[i]);
+        }
+    }
+    drain_pending(ctx);
+    table_release(&ctx->allocations);
+    buddy_release(&ctx->buddy);
+    packer_release(&ctx->packer);
+    
+    // Free video memory (before the backend, which owns a shared buffer)
+    release_video_memory(ctx);
+    
+    // Cleanup hardware backend
+    visualmem_v2_cleanup_hardware_backend(ctx);
+    
+    // Cleanup context mutexes
+    destroy_pixel_locks(ctx);
+    pthread_cond_destroy(&ctx->display_cond);
+    pthread_mutex_destroy(&ctx->context_mutex);
+    
+    ctx->is_initialized = 0;
+    ctx->hardware_active = 0;
+    ctx->display_active = 0;
+    
+    printf("[CLEANUP] Cleanup completed\n");
+}
+
+int visualmem_v2_set_encoding(visualmem_v2_context_t* ctx,
+                              visualmem_v2_encoding_t encoding) {
+    if (!ctx || !ctx->is_initialized) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    
+    int palette_bits = encoding_palette_bits(encoding);
+    if (encoding != VISUALMEM_V2_ENCODING_BINARY &&
+        encoding_bytes_per_pixel(encoding) == 0 && palette_bits == 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    if (!format_supports_encoding(ctx->pixel_format, encoding)) {
+        return VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED;
+    }
+    
+    if (palette_bits > 0) {
+        pthread_once(&palette_once, palette_tables_init);
+    }
+    
+    drain_pending(ctx); // Freed regions finish clearing first
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // Layout can only change while the visual address space is empty
+    if (address_space_busy(ctx)) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    // Capacity changes with the encoding: rebuild the allocator over it
+    visualmem_v2_encoding_t previous = ctx->encoding;
+    buddy_release(&ctx->buddy);
+    ctx->encoding = encoding;
+    compute_layout(ctx);
+    if (buddy_init(&ctx->buddy, 0, ctx->capacity_bytes) != VISUALMEM_V2_SUCCESS) {
+        ctx->encoding = previous;
+        compute_layout(ctx);
+        buddy_init(&ctx->buddy, 0, ctx->capacity_bytes);
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    if (encoding != VISUALMEM_V2_ENCODING_BINARY) {
+        lock_rows(ctx, 0, ctx->height - 1, 1);
+        write_block_headers(ctx);
+        unlock_rows(ctx, 0, ctx->height - 1);
+    }
+    if (ctx->layout == VISUALMEM_V2_LAYOUT_TILED) {
+        packer_reset(ctx); // The data area starts where the new row headers end
+    }
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    printf("[INIT] Encoding set to %d (capacity: %zu bytes)\n", encoding, ctx->capacity_bytes);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+size_t visualmem_v2_get_capacity(visualmem_v2_context_t* ctx) {
+    if (!ctx || !ctx->is_initialized) return 0;
+    return ctx->capacity_bytes;
+}
+
+int visualmem_v2_set_pixel_format(visualmem_v2_context_t* ctx,
+                                  visualmem_v2_pixel_format_t format) {
+    if (!ctx || !ctx->is_initialized) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    
+    if (format < VISUALMEM_V2_PIXEL_RGBA32 || format > VISUALMEM_V2_PIXEL_MONOCHROME) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    if (!format_supports_encoding(format, ctx->encoding)) {
+        return VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED;
+    }
+    
+    drain_pending(ctx); // Freed regions finish clearing first
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // The pixel store is rebuilt empty, so nothing may live in it yet
+    if (address_space_busy(ctx)) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    // Every band: the refresh thread may be reading the old store
+    lock_rows(ctx, 0, ctx->height - 1, 1);
+    int result = setup_video_memory(ctx, format);
+    if (result == VISUALMEM_V2_SUCCESS) {
+        mark_all_tiles_dirty(ctx); // The grid keeps its size, only the store changed
+        if (ctx->encoding != VISUALMEM_V2_ENCODING_BINARY) {
+            write_block_headers(ctx);
+        }
+    }
+    unlock_rows(ctx, 0, ctx->height - 1);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    if (result == VISUALMEM_V2_SUCCESS) {
+        printf("[INIT] Pixel format set to %s (%zu bytes%s)\n", pixel_engines[format].name,
+               ctx->video_memory_size, ctx->video_memory_shared ? ", shared with XImage" : "");
+    }
+    return result;
+}
+
+int visualmem_v2_set_layout(visualmem_v2_context_t* ctx,
+                            visualmem_v2_layout_t layout) {
+    if (!ctx || !ctx->is_initialized) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    
+    if (layout != VISUALMEM_V2_LAYOUT_LINEAR && layout != VISUALMEM_V2_LAYOUT_TILED) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    drain_pending(ctx); // Freed regions finish clearing first
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    if (address_space_busy(ctx)) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    if (layout == VISUALMEM_V2_LAYOUT_TILED && packer_reset(ctx) != VISUALMEM_V2_SUCCESS) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    ctx->layout = layout;
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    printf("[INIT] Layout set to %s (%dx%d tiles of %dx%d)\n",
+           layout == VISUALMEM_V2_LAYOUT_TILED ? "tiled" : "linear",
+           ctx->tile_cols, ctx->tile_rows, VISUALMEM_V2_TILE_WIDTH, VISUALMEM_V2_TILE_HEIGHT);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// === MEMORY ALLOCATION FUNCTIONS ===
+
+// Fill in a placed slot and make it live; caller holds context_mutex
+static void* activate_slot(visualmem_v2_context_t* ctx, int slot, size_t size, const char* label) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    
+    void* visual_addr = coord_to_addr(table->x[slot], table->y[slot]);
+    table->visual_addr[slot] = visual_addr;
+    table->size[slot] = size;
+    table->checksum[slot] = 0;
+    table->timestamp[slot] = get_timestamp_us();
+    table->is_active[slot] = 1;
+    
+    char* slot_label = table->label[slot];
+    if (label) {
+        strncpy(slot_label, label, sizeof(table->label[slot]) - 1);
+        slot_label[sizeof(table->label[slot]) - 1] = '\0';
+    } else {
+        snprintf(slot_label, sizeof(table->label[slot]), "alloc_%d", slot);
+    }
+    
+    ctx->allocation_count++;
+    ctx->performance.total_allocations++;
+    
+    return visual_addr;
+}
+
+static void set_slot_rect(visualmem_v2_alloc_table_t* table, int slot,
+                          const visualmem_v2_rect_t* rect, size_t payload_pixels) {
+    table->x[slot] = rect->x;
+    table->y[slot] = rect->y;
+    table->width[slot] = rect->width;
+    table->height[slot] = rect->height;
+    table->byte_offset[slot] = 0;
+    table->payload_pixels[slot] = payload_pixels;
+}
+
+// Linear layout: the rows a byte range covers
+static void set_slot_span(visualmem_v2_context_t* ctx, int slot, size_t byte_offset, size_t size) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int start_x, start_y, start_channel;
+    calculate_byte_position(ctx, byte_offset, &start_x, &start_y, &start_channel);
+    size_t first_row = byte_offset / ctx->bytes_per_row;
+    size_t last_row = (byte_offset + size - 1) / ctx->bytes_per_row;
+    
+    table->x[slot] = start_x;
+    table->y[slot] = start_y;
+    table->width[slot] = row_pixel_width(ctx);
+    table->height[slot] = (int)(last_row - first_row + 1) * row_pixel_spacing(ctx);
+    table->byte_offset[slot] = byte_offset;
+    table->payload_pixels[slot] = 0;
+}
+
+// Place and activate a byte allocation; caller holds context_mutex. -1 on failure
+static int place_allocation(visualmem_v2_context_t* ctx, size_t size, const char* label) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_acquire(table);
+    if (slot < 0) {
+        return -1; // Allocation table cannot grow
+    }
+    
+    if (ctx->layout == VISUALMEM_V2_LAYOUT_TILED) {
+        visualmem_v2_rect_t rect;
+        size_t payload_pixels;
+        if (!place_tiled(ctx, size, &rect, &payload_pixels) &&
+            !(packer_refresh(ctx) && place_tiled(ctx, size, &rect, &payload_pixels))) {
+            table_retire(table, slot);
+            return -1; // No free tile rectangle large enough
+        }
+        if (packer_reserve(&ctx->packer, &rect) != VISUALMEM_V2_SUCCESS) {
+            table_retire(table, slot);
+            packer_rebuild(ctx);
+            return -1;
+        }
+        
+        set_slot_rect(table, slot, &rect, payload_pixels);
+        ctx->packer.payload_pixels += payload_pixels;
+    } else {
+        // Place the allocation in a free block of the payload area
+        size_t byte_offset;
+        if (!buddy_alloc(&ctx->buddy, size, &byte_offset)) {
+            table_retire(table, slot);
+            return -1; // No free block large enough
+        }
+        
+        set_slot_span(ctx, slot, byte_offset, size);
+    }
+    
+    activate_slot(ctx, slot, size, label);
+    return slot;
+}
+
+// place_allocation, clearing queued frees and retrying when out of room.
+// Other threads may free (and queue) more while the lock is dropped, so
+// the retry repeats a few times; caller holds context_mutex
+static int place_reclaiming(visualmem_v2_context_t* ctx, size_t size, const char* label) {
+    int slot = place_allocation(ctx, size, label);
+    for (int attempt = 0; slot < 0 && attempt < RECLAIM_ATTEMPTS && reclaim_pending(ctx); attempt++) {
+        slot = place_allocation(ctx, size, label);
+    }
+    return slot;
+}
+
+// The calling thread's cache, registered on first use; NULL while caches are off
+static thread_cache_t* thread_cache(visualmem_v2_context_t* ctx) {
+    thread_cache_t* cache = own_cache(ctx);
+    if (cache) return cache;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    uint64_t serial = ctx->thread_cache_serial;
+    if (serial != 0) {
+        // A thread that exited leaves its cache to the next one given its token
+        cache = ctx->thread_caches;
+        while (cache && cache->owner != &thread_token) {
+            cache = cache->next;
+        }
+        if (!cache && (cache = calloc(1, sizeof(*cache))) != NULL) {
+            cache->owner = &thread_token;
+            cache->next = ctx->thread_caches;
+            ctx->thread_caches = cache;
+        }
+        if (cache) {
+            current_serial = serial;
+            current_cache = cache;
+        }
+    }
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return cache;
+}
+
+// Payload bytes of a thread cache page. A small context (binary encoding
+// holds ~22 KB at 800x600) would otherwise be split into a few pages that
+// idle threads keep while others run out of room
+static size_t cache_page_bytes(const visualmem_v2_context_t* ctx) {
+    size_t share = ctx->capacity_bytes / VISUALMEM_V2_TCACHE_PAGE_SHARE;
+    return share < VISUALMEM_V2_TCACHE_PAGE_BYTES ? share : VISUALMEM_V2_TCACHE_PAGE_BYTES;
+}
+
+// Take a new page of a size class for the calling thread, shrinking it
+// when space is short. Empty pages of every thread are given back before
+// giving up; caller holds context_mutex, which may be dropped meanwhile
+static cache_page_t* cache_refill(visualmem_v2_context_t* ctx, thread_cache_t* cache, int size_class) {
+    cache_prune(cache);
+    if (cache->page_count == cache->page_capacity) {
+        int new_capacity = cache->page_capacity ? cache->page_capacity * 2 : 8;
+        cache_page_t** grown = realloc(cache->pages, sizeof(*grown) * (size_t)new_capacity);
+        if (!grown) return NULL;
+        cache->pages = grown;
+        cache->page_capacity = new_capacity;
+    }
+    
+    cache_page_t* page = calloc(1, sizeof(*page));
+    if (!page) return NULL;
+    
+    // Dense payloads start blocks on a pixel so each address names one block
+    size_t align = ctx->encoding == VISUALMEM_V2_ENCODING_BINARY || encoding_palette_bits(ctx->encoding) > 0 ?
+        1 : (size_t)encoding_bytes_per_pixel(ctx->encoding);
+    size_t block_size = (size_t)VISUALMEM_V2_ALLOC_UNIT << size_class;
+    page->stride = (block_size + align - 1) / align * align;
+    size_t most = cache_page_bytes(ctx) / page->stride;
+    if (most > TCACHE_PAGE_MAX_BLOCKS) most = TCACHE_PAGE_MAX_BLOCKS;
+    if (most == 0) most = 1;
+    
+    int slot = -1;
+    size_t blocks = 0;
+    for (int attempt = 0; slot < 0 && attempt <= RECLAIM_ATTEMPTS; attempt++) {
+        // Caches may be turned off, or the layout changed, while the lock is dropped
+        if (attempt > 0 && (!reclaim_pending(ctx) || ctx->thread_cache_serial == 0 ||
+                            ctx->layout != VISUALMEM_V2_LAYOUT_LINEAR)) {
+            break;
+        }
+        for (blocks = most; blocks > 0; blocks /= 2) {
+            slot = place_allocation(ctx, blocks * page->stride + align - 1, "thread cache");
+            if (slot >= 0) break;
+        }
+    }
+    if (slot < 0) {
+        free(page);
+        return NULL;
+    }
+    
+    // Blocks resolve through the page, never the slot; they are counted one by one
+    ctx->allocations.visual_addr[slot] = NULL;
+    ctx->performance.total_allocations--;
+    
+    page->slot = slot;
+    page->size_class = size_class;
+    page->blocks = (int)blocks;
+    slot_region(ctx, slot, &page->region);
+    page->lead = (align - page->region.base % align) % align;
+    cache->pages[cache->page_count++] = page;
+    
+    printf("[ALLOC] Thread cache page of %d x %zu bytes at (%d,%d)\n", page->blocks, page->stride,
+           ctx->allocations.x[slot], ctx->allocations.y[slot]);
+    return page;
+}
+
+// Claim a free block of a page; -1 when it has none or was given back
+static int page_claim(cache_page_t* page) {
+    uint64_t all = ((uint64_t)1 << page->blocks) - 1;
+    uint64_t used = __atomic_load_n(&page->used, __ATOMIC_ACQUIRE);
+    
+    while (used != PAGE_RETIRED && (used & all) != all) {
+        int block = __builtin_ctzll(~used & all);
+        if (__atomic_compare_exchange_n(&page->used, &used, used | (uint64_t)1 << block, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return block;
+        }
+    }
+    return -1;
+}
+
+// Block from the calling thread's cache; NULL leaves the request to the
+// shared allocator
+static void* cache_alloc(visualmem_v2_context_t* ctx, size_t size) {
+    if (__atomic_load_n(&ctx->thread_cache_serial, __ATOMIC_ACQUIRE) == 0 ||
+        size > VISUALMEM_V2_TCACHE_MAX_SIZE || ctx->layout == VISUALMEM_V2_LAYOUT_TILED) {
+        return NULL;
+    }
+    thread_cache_t* cache = thread_cache(ctx);
+    if (!cache) return NULL;
+    
+    // Blocks too large to share a page go to the shared allocator
+    int size_class = buddy_order(size);
+    if (((size_t)VISUALMEM_V2_ALLOC_UNIT << size_class) > cache_page_bytes(ctx)) return NULL;
+    cache_page_t* page = NULL;
+    int block = -1;
+    for (int i = 0; i < cache->page_count && block < 0; i++) {
+        if (cache->pages[i]->size_class != size_class) continue;
+        page = cache->pages[i];
+        block = page_claim(page);
+    }
+    
+    if (block < 0) {
+        pthread_mutex_lock(&ctx->context_mutex);
+        page = ctx->thread_cache_serial != 0 && ctx->layout == VISUALMEM_V2_LAYOUT_LINEAR ?
+            cache_refill(ctx, cache, size_class) : NULL;
+        pthread_mutex_unlock(&ctx->context_mutex);
+        
+        // An empty page can be given back before its first claim
+        block = page ? page_claim(page) : -1;
+        if (block < 0) return NULL;
+    }
+    
+    // Bytes of the block's last owner are cleared on the way out
+    uint64_t bit = (uint64_t)1 << block;
+    byte_region_t region;
+    block_region(page, block, &region);
+    if (__atomic_load_n(&page->dirty, __ATOMIC_ACQUIRE) & bit) {
+        clear_region_bytes(ctx, &region, 0, region.size);
+        __atomic_fetch_and(&page->dirty, ~bit, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&page->sizes[block], size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cache->allocations, 1, __ATOMIC_RELAXED);
+    
+    int x, y, channel;
+    locate_byte(ctx, region.origin_x, region.origin_y, region.bytes_per_row, region.base, &x, &y, &channel);
+    return coord_to_addr(x, y);
+}
+
+// Free a block of the calling thread's cache without the lock; an emptied
+// page goes back if the thread holds another empty one of its class.
+// 0 when visual_addr is not such a block
+static int cache_free(visualmem_v2_context_t* ctx, void* visual_addr) {
+    thread_cache_t* cache = own_cache(ctx);
+    int block;
+    cache_page_t* page = cache ? cache_find(ctx, cache, visual_addr, &block) : NULL;
+    if (!page) return 0;
+    
+    if (page_release(cache, page, block)) {
+        int empty = 0;
+        for (int i = 0; i < cache->page_count; i++) {
+            empty += cache->pages[i]->size_class == page->size_class &&
+                __atomic_load_n(&cache->pages[i]->used, __ATOMIC_ACQUIRE) == 0;
+        }
+        if (empty > 1) {
+            pthread_mutex_lock(&ctx->context_mutex);
+            release_cache_pages(ctx, cache, 1);
+            cache_prune(cache);
+            pthread_mutex_unlock(&ctx->context_mutex);
+        }
+    }
+    return 1;
+}
+
+void* visualmem_v2_alloc(visualmem_v2_context_t* ctx, size_t size, const char* label) {
+    if (!ctx || !ctx->is_initialized || size == 0) return NULL;
+    
+    // Small blocks come from the calling thread's cache when caches are on
+    void* cached = cache_alloc(ctx, size);
+    if (cached) return cached;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // Create allocation
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = place_reclaiming(ctx, size, label);
+    if (slot < 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL;
+    }
+    void* visual_addr = table->visual_addr[slot];
+    
+    printf("[ALLOC] Allocated %zu bytes at (%d,%d) - %s\n", 
+           size, table->x[slot], table->y[slot], table->label[slot]);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return visual_addr;
+}
+
+// Pixel rectangle allocation: at a fixed position, or packed when fixed is NULL
+static void* alloc_rect(visualmem_v2_context_t* ctx, const visualmem_v2_rect_t* fixed,
+                        int width, int height, const char* label) {
+    if (!ctx || !ctx->is_initialized || width <= 0 || height <= 0) return NULL;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // Only the tiled layout hands out screen rectangles
+    if (ctx->layout != VISUALMEM_V2_LAYOUT_TILED) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL;
+    }
+    
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_acquire(table);
+    if (slot < 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL;
+    }
+    
+    visualmem_v2_rect_t rect;
+    int placed;
+    for (int attempt = 0; attempt < 4; attempt++) {
+        if (fixed) {
+            rect = *fixed;
+            placed = packer_fits(&ctx->packer, &rect);
+        } else {
+            placed = packer_find(&ctx->packer, width, height, 1, 1, &rect);
+        }
+        if (placed || !(packer_refresh(ctx) || reclaim_pending(ctx))) break;
+    }
+    if (!placed) {
+        table_retire(table, slot);
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL; // Taken, outside the data area, or no room
+    }
+    if (packer_reserve(&ctx->packer, &rect) != VISUALMEM_V2_SUCCESS) {
+        table_retire(table, slot);
+        packer_rebuild(ctx);
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL;
+    }
+    
+    size_t payload_pixels = (size_t)width * height;
+    set_slot_rect(table, slot, &rect, payload_pixels);
+    ctx->packer.payload_pixels += payload_pixels;
+    
+    // Bytes that fit when the rectangle is used through visualmem_v2_write
+    size_t size = (size_t)region_bytes_per_row(ctx, width) * (height / row_pixel_spacing(ctx));
+    void* visual_addr = activate_slot(ctx, slot, size, label);
+    
+    printf("[ALLOC] Reserved %dx%d rectangle at (%d,%d) - %s\n",
+           width, height, rect.x, rect.y, table->label[slot]);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return visual_addr;
+}
+
+void* visualmem_v2_alloc_at(visualmem_v2_context_t* ctx,
+                            int x, int y, int width, int height,
+                            const char* label) {
+    visualmem_v2_rect_t fixed = { x, y, width, height };
+    return alloc_rect(ctx, &fixed, width, height, label);
+}
+
+void* visualmem_v2_alloc_image(visualmem_v2_context_t* ctx,
+                               int width, int height,
+                               const char* label) {
+    return alloc_rect(ctx, NULL, width, height, label);
+}
+
+int visualmem_v2_free(visualmem_v2_context_t* ctx, void* visual_addr) {
+    if (!ctx || !ctx->is_initialized || !visual_addr) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    if (cache_free(ctx, visual_addr)) {
+        return VISUALMEM_V2_SUCCESS;
+    }
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // Find allocation; arenas go through visualmem_v2_arena_destroy
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_find(table, visual_addr);
+    if (slot < 0) {
+        // A block of another thread's cache
+        thread_cache_t* cache;
+        int block;
+        cache_page_t* page = caches_find(ctx, visual_addr, &block, &cache);
+        if (page) page_release(cache, page, block);
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return page ? VISUALMEM_V2_SUCCESS : VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    if (arena_of_slot(ctx, slot) >= 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    printf("[FREE] Freeing %zu bytes at (%d,%d) - %s\n", 
+           table->size[slot], table->x[slot], table->y[slot], table->label[slot]);
+    
+    // The address stops resolving now; the pixels are cleared in the background
+    queue_scrub(ctx, slot);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_scrub(visualmem_v2_context_t* ctx) {
+    if (!ctx || !ctx->is_initialized) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    drain_pending(ctx);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_alloc_batch(visualmem_v2_context_t* ctx,
+                             const size_t* sizes,
+                             const char* const* labels,
+                             int count,
+                             void** addrs) {
+    if (!ctx || !ctx->is_initialized || !sizes || !addrs || count <= 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    batch_entry_t* order = malloc(count * sizeof(batch_entry_t));
+    if (!order) return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    for (int i = 0; i < count; i++) {
+        addrs[i] = NULL;
+        order[i].visual_addr = NULL;
+        order[i].key = sizes[i];
+        order[i].entry = i;
+        if (sizes[i] == 0) {
+            free(order);
+            return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+        }
+    }
+    
+    // Largest first, so small blocks do not split the space big ones need
+    qsort(order, count, sizeof(batch_entry_t), compare_by_size_desc);
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    int placed = 0;
+    for (; placed < count; placed++) {
+        int entry = order[placed].entry;
+        const char* label = labels ? labels[entry] : NULL;
+        int slot = place_reclaiming(ctx, sizes[entry], label);
+        if (slot < 0) break;
+        addrs[entry] = ctx->allocations.visual_addr[slot];
+    }
+    
+    if (placed < count) {
+        // Hand nothing out: give back what this batch placed
+        while (placed-- > 0) {
+            int entry = order[placed].entry;
+            retract_slot(ctx, table_find(&ctx->allocations, addrs[entry]));
+            addrs[entry] = NULL;
+        }
+        pthread_mutex_unlock(&ctx->context_mutex);
+        free(order);
+        return VISUALMEM_V2_ERROR_OUT_OF_VIDEO_MEMORY;
+    }
+    
+    printf("[ALLOC] Allocated batch of %d blocks\n", count);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    free(order);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_free_batch(visualmem_v2_context_t* ctx, void* const* addrs, int count) {
+    if (!ctx || !ctx->is_initialized || !addrs || count <= 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    batch_entry_t* order = malloc(count * sizeof(batch_entry_t));
+    if (!order) return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    for (int i = 0; i < count; i++) {
+        order[i].visual_addr = addrs[i];
+        order[i].key = 0;
+        order[i].entry = i;
+    }
+    qsort(order, count, sizeof(batch_entry_t), compare_by_address);
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    // Check everything first; sorting puts repeated addresses side by side.
+    // key holds the slot from here on, SIZE_MAX for a cached block
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    byte_region_t region;
+    for (int i = 0; i < count; i++) {
+        int slot = order[i].visual_addr ? table_find(table, order[i].visual_addr) : -1;
+        int cached = slot < 0 && order[i].visual_addr && cached_region(ctx, order[i].visual_addr, &region);
+        if ((slot < 0 && !cached) || (slot >= 0 && arena_of_slot(ctx, slot) >= 0) ||
+            (i > 0 && order[i - 1].visual_addr == order[i].visual_addr)) {
+            pthread_mutex_unlock(&ctx->context_mutex);
+            free(order);
+            return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+        }
+        order[i].key = cached ? SIZE_MAX : (size_t)slot;
+    }
+    
+    size_t freed = 0;
+    for (int i = 0; i < count; i++) {
+        if (order[i].key == SIZE_MAX) {
+            thread_cache_t* cache = NULL;
+            int block;
+            cache_page_t* page = caches_find(ctx, order[i].visual_addr, &block, &cache);
+            freed += page->sizes[block];
+            page_release(cache, page, block);
+            continue;
+        }
+        freed += table->size[order[i].key];
+        queue_scrub(ctx, (int)order[i].key);
+    }
+    
+    printf("[FREE] Freeing batch of %d blocks (%zu bytes)\n", count, freed);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    free(order);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Linear layout: resize the buddy block in place, or move the pixels to a
+// new block (which changes the address)
+static int realloc_linear(visualmem_v2_context_t* ctx, int slot, size_t new_size) {
+    byte_region_t region;
+    slot_region(ctx, slot, &region);
+    
+    if (buddy_resize(&ctx->buddy, region.base, new_size)) {
+        if (new_size < region.size) {
+            clear_region_bytes(ctx, &region, new_size, region.size - new_size);
+        }
+    } else {
+        size_t byte_offset;
+        if (!buddy_alloc(&ctx->buddy, new_size, &byte_offset)) {
+            return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+        }
+        byte_region_t target = region;
+        target.base = byte_offset;
+        copy_region_bytes(ctx, &target, &region, region.size);
+        clear_region_bytes(ctx, &region, 0, region.size);
+        buddy_free(&ctx->buddy, region.base);
+        region.base = byte_offset;
+    }
+    
+    set_slot_span(ctx, slot, region.base, new_size);
+    ctx->allocations.visual_addr[slot] = coord_to_addr(ctx->allocations.x[slot], ctx->allocations.y[slot]);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// Tiled layout: use spare rows of the rectangle, extend it downwards over
+// free space, or move the pixels to a new rectangle (which changes the address)
+static int realloc_tiled(visualmem_v2_context_t* ctx, int slot, size_t new_size) {
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    byte_region_t region;
+    slot_region(ctx, slot, &region);
+    
+    size_t rows = (new_size + region.bytes_per_row - 1) / region.bytes_per_row;
+    size_t height_px = rows * row_pixel_spacing(ctx);
+    if (height_px <= (size_t)table->height[slot]) {
+        if (new_size < region.size) {
+            clear_region_bytes(ctx, &region, new_size, region.size - new_size);
+        }
+        return VISUALMEM_V2_SUCCESS;
+    }
+    
+    int grown_height = (int)((height_px + VISUALMEM_V2_TILE_HEIGHT - 1) /
+                             VISUALMEM_V2_TILE_HEIGHT * VISUALMEM_V2_TILE_HEIGHT);
+    visualmem_v2_rect_t strip = { table->x[slot], table->y[slot] + table->height[slot],
+                                  table->width[slot], grown_height - table->height[slot] };
+    size_t payload_pixels = (size_t)table->width[slot] * height_px;
+    visualmem_v2_rect_t rect;
+    int moved = 0;
+    
+    if (packer_fits(&ctx->packer, &strip) ||
+        (packer_refresh(ctx) && packer_fits(&ctx->packer, &strip))) {
+        rect = strip;
+    } else if (place_tiled(ctx, new_size, &rect, &payload_pixels)) {
+        moved = 1;
+    } else {
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    if (packer_reserve(&ctx->packer, &rect) != VISUALMEM_V2_SUCCESS) {
+        packer_rebuild(ctx);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    if (!moved) {
+        table->height[slot] = grown_height;
+        ctx->packer.payload_pixels += payload_pixels - table->payload_pixels[slot];
+        table->payload_pixels[slot] = payload_pixels;
+        return VISUALMEM_V2_SUCCESS;
+    }
+    
+    byte_region_t target = { rect.x, rect.y, region_bytes_per_row(ctx, rect.width), 0, new_size };
+    copy_region_bytes(ctx, &target, &region, region.size);
+    clear_rect_pixels(ctx, table->x[slot], table->y[slot], table->width[slot], table->height[slot]);
+    visualmem_v2_rect_t old_rect = { table->x[slot], table->y[slot], table->width[slot], table->height[slot] };
+    ctx->packer.payload_pixels += payload_pixels - table->payload_pixels[slot];
+    set_slot_rect(table, slot, &rect, payload_pixels);
+    table->visual_addr[slot] = coord_to_addr(rect.x, rect.y);
+    if (packer_free(&ctx->packer, &old_rect) != VISUALMEM_V2_SUCCESS) {
+        packer_rebuild(ctx);
+    }
+    return VISUALMEM_V2_SUCCESS;
+}
+
+static int resize_slot(visualmem_v2_context_t* ctx, int slot, size_t new_size) {
+    return ctx->layout == VISUALMEM_V2_LAYOUT_TILED ? realloc_tiled(ctx, slot, new_size)
+                                                     : realloc_linear(ctx, slot, new_size);
+}
+
+// Cached blocks have a fixed size: move the bytes to a new allocation
+static void* realloc_cached(visualmem_v2_context_t* ctx, void* visual_addr,
+                            const byte_region_t* region, size_t new_size) {
+    void* new_addr = visualmem_v2_alloc(ctx, new_size, NULL);
+    byte_region_t target;
+    if (!new_addr) return NULL;
+    
+    find_region(ctx, new_addr, &target);
+    copy_region_bytes(ctx, &target, region, region->size < new_size ? region->size : new_size);
+    visualmem_v2_free(ctx, visual_addr);
+    return new_addr;
+}
+
+void* visualmem_v2_realloc(visualmem_v2_context_t* ctx, 
+                           void* visual_addr, 
+                           size_t new_size) {
+    if (!ctx || !ctx->is_initialized) return NULL;
+    if (!visual_addr) return visualmem_v2_alloc(ctx, new_size, NULL);
+    if (new_size == 0) {
+        visualmem_v2_free(ctx, visual_addr);
+        return NULL;
     }
     
-    // Cleanup hardware backend
-    visualmem_v2_cleanup_hardware_backend(ctx);
+    pthread_mutex_lock(&ctx->context_mutex);
     
-    // Free video memory
-    if (ctx->video_memory) {
-        free(ctx->video_memory);
-        ctx->video_memory = NULL;
+    // Arenas stay put: moving one would move every address handed out from it
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_find(table, visual_addr);
+    byte_region_t region;
+    if (slot < 0 && cached_region(ctx, visual_addr, &region)) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return realloc_cached(ctx, visual_addr, &region, new_size);
+    }
+    if (slot < 0 || arena_of_slot(ctx, slot) >= 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL;
     }
     
-    // Cleanup allocation mutexes
-    for (int i = 0; i < VISUALMEM_V2_MAX_ALLOCATIONS; i++) {
-        pthread_mutex_destroy(&ctx->allocations[i].mutex);
+    size_t old_size = table->size[slot];
+    int result = resize_slot(ctx, slot, new_size);
+    if (result != VISUALMEM_V2_SUCCESS && reclaim_pending(ctx)) {
+        // The allocation may have gone while the lock was dropped
+        slot = table_find(table, visual_addr);
+        if (slot >= 0 && arena_of_slot(ctx, slot) < 0) {
+            old_size = table->size[slot];
+            result = resize_slot(ctx, slot, new_size);
+        }
+    }
+    if (result != VISUALMEM_V2_SUCCESS) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL; // Old allocation left as it was
     }
     
-    // Cleanup context mutexes
-    pthread_cond_destroy(&ctx->display_cond);
-    pthread_mutex_destroy(&ctx->context_mutex);
+    table->size[slot] = new_size;
+    void* new_addr = table->visual_addr[slot];
     
-    ctx->is_initialized = 0;
-    ctx->hardware_active = 0;
-    ctx->display_active = 0;
+    printf("[REALLOC] Resized %zu -> %zu bytes at (%d,%d) - %s\n",
+           old_size, new_size, table->x[slot], table->y[slot], table->label[slot]);
     
-    printf("[CLEANUP] Cleanup completed\n");
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return new_addr;
 }
 
-// === MEMORY ALLOCATION FUNCTIONS ===
+// Unused arena record, the array grown if needed; caller holds context_mutex
+static int reserve_arena_record(visualmem_v2_context_t* ctx) {
+    int index = arena_of_slot(ctx, -1);
+    if (index >= 0) return index;
+    
+    if (ctx->arena_count == ctx->arena_capacity) {
+        int new_capacity = ctx->arena_capacity ? ctx->arena_capacity * 2 : 8;
+        visualmem_v2_arena_t* grown = realloc(ctx->arenas, sizeof(*grown) * (size_t)new_capacity);
+        if (!grown) return -1;
+        ctx->arenas = grown;
+        ctx->arena_capacity = new_capacity;
+    }
+    memset(&ctx->arenas[ctx->arena_count], 0, sizeof(visualmem_v2_arena_t));
+    ctx->arenas[ctx->arena_count].slot = -1;
+    return ctx->arena_count++;
+}
 
-void* visualmem_v2_alloc(visualmem_v2_context_t* ctx, size_t size, const char* label) {
+// Arena of an arena address; caller holds context_mutex
+static visualmem_v2_arena_t* find_arena(visualmem_v2_context_t* ctx, void* arena) {
+    int slot = table_find(&ctx->allocations, arena);
+    int index = slot >= 0 ? arena_of_slot(ctx, slot) : -1;
+    return index >= 0 ? &ctx->arenas[index] : NULL;
+}
+
+void* visualmem_v2_arena_create(visualmem_v2_context_t* ctx, size_t size, const char* label) {
     if (!ctx || !ctx->is_initialized || size == 0) return NULL;
     
     pthread_mutex_lock(&ctx->context_mutex);
     
-    if (ctx->allocation_count >= VISUALMEM_V2_MAX_ALLOCATIONS) {
+    // Secure a record first so a placed region never needs undoing
+    int index = reserve_arena_record(ctx);
+    int slot = index >= 0 ? place_allocation(ctx, size, label) : -1;
+    if (index >= 0 && slot < 0 && reclaim_pending(ctx)) {
+        // The record may have been taken while the lock was dropped
+        index = reserve_arena_record(ctx);
+        slot = index >= 0 ? place_allocation(ctx, size, label) : -1;
+    }
+    if (slot < 0) {
         pthread_mutex_unlock(&ctx->context_mutex);
         return NULL;
     }
     
-    // Find free allocation slot
-    int slot = -1;
-    for (int i = 0; i < VISUALMEM_V2_MAX_ALLOCATIONS; i++) {
-        if (!ctx->allocations[i].is_active) {
-            slot = i;
-            break;
-        }
-    }
+    visualmem_v2_arena_t* arena = &ctx->arenas[index];
+    arena->slot = slot;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->start_count = 0; // The epoch carries on from the record's last arena
+    
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    void* visual_addr = table->visual_addr[slot];
+    printf("[ALLOC] Arena of %zu bytes at (%d,%d) - %s\n",
+           size, table->x[slot], table->y[slot], table->label[slot]);
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return visual_addr;
+}
+
+void* visualmem_v2_arena_alloc(visualmem_v2_context_t* ctx, void* arena, size_t size) {
+    if (!ctx || !ctx->is_initialized || !arena || size == 0) return NULL;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
     
-    if (slot == -1) {
+    visualmem_v2_arena_t* record = find_arena(ctx, arena);
+    if (!record) {
         pthread_mutex_unlock(&ctx->context_mutex);
         return NULL;
     }
     
-    // Calculate position for allocation
-    int bytes_per_row = (ctx->width - VISUALMEM_V2_MEMORY_START_X) / VISUALMEM_V2_BYTE_SPACING_X;
-    if (bytes_per_row <= 0) bytes_per_row = 1;
-    
-    int total_allocated_bytes = 0;
-    for (int i = 0; i < ctx->allocation_count; i++) {
-        if (ctx->allocations[i].is_active) {
-            total_allocated_bytes += ctx->allocations[i].size;
+    // Dense payloads start on a pixel so the address names exactly one byte
+    byte_region_t region;
+    slot_region(ctx, record->slot, &region);
+    size_t align = ctx->encoding == VISUALMEM_V2_ENCODING_BINARY || encoding_palette_bits(ctx->encoding) > 0 ?
+        1 : (size_t)encoding_bytes_per_pixel(ctx->encoding);
+    size_t offset = record->used + VISUALMEM_V2_ARENA_HEADER;
+    offset += (align - (region.base + offset) % align) % align;
+    if (offset > region.size || size > region.size - offset) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return NULL; // Arena full
+    }
+    if (record->start_count == record->start_capacity) {
+        int new_capacity = record->start_capacity ? record->start_capacity * 2 : 16;
+        size_t* grown = realloc(record->starts, sizeof(*grown) * (size_t)new_capacity);
+        if (!grown) {
+            pthread_mutex_unlock(&ctx->context_mutex);
+            return NULL;
         }
+        record->starts = grown;
+        record->start_capacity = new_capacity;
     }
+    record->starts[record->start_count++] = offset;
     
-    int start_x, start_y;
-    calculate_byte_position(total_allocated_bytes, &start_x, &start_y, ctx->width);
-    
-    // Check if allocation fits on screen
-    int required_rows = (size + bytes_per_row - 1) / bytes_per_row;
-    if (start_y + (required_rows * VISUALMEM_V2_BYTE_SPACING_Y) >= ctx->height) {
-        pthread_mutex_unlock(&ctx->context_mutex);
-        return NULL; // Not enough screen space
+    // Below the high water mark lie bytes of an earlier epoch: reset left
+    // them so it stays O(1), the bump clears what it hands out
+    if (record->used < record->high_water) {
+        size_t end = offset + size < record->high_water ? offset + size : record->high_water;
+        clear_region_bytes(ctx, &region, record->used, end - record->used);
     }
     
-    // Create allocation
-    visualmem_v2_allocation_t* alloc = &ctx->allocations[slot];
-    alloc->visual_addr = coord_to_addr(start_x, start_y);
-    alloc->size = size;
-    alloc->x = start_x;
-    alloc->y = start_y;
-    alloc->width = bytes_per_row * VISUALMEM_V2_BYTE_SPACING_X;
-    alloc->height = required_rows * VISUALMEM_V2_BYTE_SPACING_Y;
-    alloc->checksum = 0;
-    alloc->timestamp = get_timestamp_us();
-    alloc->is_active = 1;
-    
-    if (label) {
-        strncpy(alloc->label, label, sizeof(alloc->label) - 1);
-        alloc->label[sizeof(alloc->label) - 1] = '\0';
-    } else {
-        snprintf(alloc->label, sizeof(alloc->label), "alloc_%d", slot);
+    uint8_t header[VISUALMEM_V2_ARENA_HEADER];
+    for (int b = 0; b < VISUALMEM_V2_ARENA_HEADER; b++) {
+        header[b] = (uint8_t)(size >> (8 * b));
     }
+    region_store_locked(ctx, &region, offset - VISUALMEM_V2_ARENA_HEADER, header, sizeof(header));
+    record->used = offset + size;
+    if (record->used > record->high_water) record->high_water = record->used;
     
-    ctx->allocation_count++;
-    ctx->performance.total_allocations++;
+    int x, y, channel;
+    locate_byte(ctx, region.origin_x, region.origin_y, region.bytes_per_row,
+                region.base + offset, &x, &y, &channel);
     
-    pthread_mutex_unlock(&ctx->context_mutex);
+    uint32_t epoch = record->epoch;
     
-    printf("[ALLOC] Allocated %zu bytes at (%d,%d) - %s\n", 
-           size, start_x, start_y, alloc->label);
+    pthread_mutex_unlock(&ctx->context_mutex);
     
-    return alloc->visual_addr;
+    return stamp_addr(coord_to_addr(x, y), epoch);
 }
 
-void* visualmem_v2_alloc_at(visualmem_v2_context_t* ctx,
-                            int x, int y, int width, int height,
-                            const char* label) {
-    if (!ctx || !ctx->is_initialized) return NULL;
+int visualmem_v2_arena_reset(visualmem_v2_context_t* ctx, void* arena) {
+    if (!ctx || !ctx->is_initialized || !arena) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
     
-    if (x < 0 || y < 0 || x + width > ctx->width || y + height > ctx->height) {
-        return NULL;
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    visualmem_v2_arena_t* record = find_arena(ctx, arena);
+    if (!record) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
+    // A new epoch retires every allocation address
+    record->used = 0;
+    record->start_count = 0;
+    record->epoch++;
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
     
-    size_t size = width * height; // Simplified size calculation
-    return visualmem_v2_alloc(ctx, size, label);
+    return VISUALMEM_V2_SUCCESS;
 }
 
-int visualmem_v2_free(visualmem_v2_context_t* ctx, void* visual_addr) {
-    if (!ctx || !ctx->is_initialized || !visual_addr) {
+int visualmem_v2_arena_destroy(visualmem_v2_context_t* ctx, void* arena) {
+    if (!ctx || !ctx->is_initialized || !arena) {
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
     pthread_mutex_lock(&ctx->context_mutex);
     
-    // Find allocation
-    int slot = -1;
-    for (int i = 0; i < VISUALMEM_V2_MAX_ALLOCATIONS; i++) {
-        if (ctx->allocations[i].is_active && 
-            ctx->allocations[i].visual_addr == visual_addr) {
-            slot = i;
-            break;
-        }
-    }
-    
-    if (slot == -1) {
+    visualmem_v2_arena_t* record = find_arena(ctx, arena);
+    if (!record) {
         pthread_mutex_unlock(&ctx->context_mutex);
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
-    visualmem_v2_allocation_t* alloc = &ctx->allocations[slot];
+    visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = record->slot;
+    printf("[FREE] Destroying arena of %zu bytes at (%d,%d) - %s\n",
+           table->size[slot], table->x[slot], table->y[slot], table->label[slot]);
     
-    printf("[FREE] Freeing %zu bytes at (%d,%d) - %s\n", 
-           alloc->size, alloc->x, alloc->y, alloc->label);
+    // Only the bytes the arena handed out need clearing (linear layout)
+    table->size[slot] = record->high_water;
+    queue_scrub(ctx, slot);
+    record->slot = -1;
+    record->start_count = 0;
+    record->epoch++;
     
-    // Clear visual area (set to black)
-    for (int y = alloc->y; y < alloc->y + alloc->height && y < ctx->height; y++) {
-        for (int x = alloc->x; x < alloc->x + alloc->width && x < ctx->width; x++) {
-            visualmem_v2_write_pixel(ctx, x, y, 0xFF000000); // Black
-        }
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_get_allocation_info(visualmem_v2_context_t* ctx,
+                                     void* visual_addr,
+                                     visualmem_v2_allocation_t* info) {
+    if (!ctx || !ctx->is_initialized || !visual_addr || !info) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
-    // Mark as inactive
-    alloc->is_active = 0;
-    alloc->visual_addr = NULL;
-    alloc->size = 0;
+    pthread_mutex_lock(&ctx->context_mutex);
     
-    ctx->allocation_count--;
-    ctx->performance.total_deallocations++;
+    const visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_find(table, visual_addr);
+    byte_region_t region;
+    if (slot < 0 && cached_region(ctx, visual_addr, &region)) {
+        // Cached blocks keep only their size; the rest follows from the place
+        int y0, y1;
+        region_rows(ctx, &region, 0, region.size, &y0, &y1);
+        memset(info, 0, sizeof(*info));
+        info->visual_addr = visual_addr;
+        info->size = region.size;
+        info->byte_offset = region.base;
+        addr_to_coord(visual_addr, &info->x, &info->y);
+        info->width = row_pixel_width(ctx);
+        info->height = y1 - y0 + row_pixel_spacing(ctx);
+        info->is_active = 1;
+        snprintf(info->label, sizeof(info->label), "thread cache");
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_SUCCESS;
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    info->visual_addr = visual_addr;
+    info->size = table->size[slot];
+    info->byte_offset = table->byte_offset[slot];
+    info->x = table->x[slot];
+    info->y = table->y[slot];
+    info->width = table->width[slot];
+    info->height = table->height[slot];
+    info->checksum = table->checksum[slot];
+    info->timestamp = table->timestamp[slot];
+    info->is_active = 1;
+    memcpy(info->label, table->label[slot], sizeof(info->label));
     
     pthread_mutex_unlock(&ctx->context_mutex);
     
@@ -407,6 +3260,19 @@ int visualmem_v2_free(visualmem_v2_context_t* ctx, void* visual_addr) {
 
 // === DATA OPERATIONS ===
 
+// Fold one transfer into the throughput figures
+static void record_transfer(visualmem_v2_context_t* ctx, size_t bytes, uint64_t start_time, int writing) {
+    double duration_s = (get_timestamp_us() - start_time) / 1000000.0;
+    double speed_mbps = (bytes / (1024.0 * 1024.0)) / duration_s;
+    uint64_t* total = writing ? &ctx->performance.bytes_written : &ctx->performance.bytes_read;
+    double* average = writing ? &ctx->performance.avg_write_speed_mbps : &ctx->performance.avg_read_speed_mbps;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    *total += bytes;
+    *average = *average == 0 ? speed_mbps : (*average + speed_mbps) / 2.0;
+    pthread_mutex_unlock(&ctx->context_mutex);
+}
+
 int visualmem_v2_write_pixel(visualmem_v2_context_t* ctx, int x, int y, uint32_t color) {
     if (!ctx || !ctx->is_initialized) {
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
@@ -416,30 +3282,13 @@ int visualmem_v2_write_pixel(visualmem_v2_context_t* ctx, int x, int y, uint32_t
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
-    int result = VISUALMEM_V2_SUCCESS;
-    
-    // Write to appropriate backend
-    switch (ctx->backend) {
-        case VISUALMEM_V2_BACKEND_X11:
-        case VISUALMEM_V2_BACKEND_OPENGL:
-            result = visualmem_v2_x11_write_pixel(ctx, x, y, color);
-            break;
-            
-        case VISUALMEM_V2_BACKEND_FRAMEBUFFER:
-            // Framebuffer write implementation would go here
-            result = VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED;
-            break;
-            
-        default:
-            result = VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED;
-            break;
-    }
-    
-    if (result == VISUALMEM_V2_SUCCESS) {
-        ctx->performance.pixel_operations++;
-    }
+    // Store in the pixel format; the backend picks it up at refresh
+    lock_rows(ctx, y, y, 1);
+    put_pixel(ctx, x, y, color);
+    unlock_rows(ctx, y, y);
+    count_pixel_ops(ctx, 1);
     
-    return result;
+    return VISUALMEM_V2_SUCCESS;
 }
 
 uint32_t visualmem_v2_read_pixel(visualmem_v2_context_t* ctx, int x, int y) {
@@ -451,24 +3300,11 @@ uint32_t visualmem_v2_read_pixel(visualmem_v2_context_t* ctx, int x, int y) {
         return 0;
     }
     
-    uint32_t color = 0;
-    
-    // Read from appropriate backend
-    switch (ctx->backend) {
-        case VISUALMEM_V2_BACKEND_X11:
-        case VISUALMEM_V2_BACKEND_OPENGL:
-            color = visualmem_v2_x11_read_pixel(ctx, x, y);
-            break;
-            
-        case VISUALMEM_V2_BACKEND_FRAMEBUFFER:
-            // Framebuffer read implementation would go here
-            break;
-            
-        default:
-            break;
-    }
+    lock_rows(ctx, y, y, 0);
+    uint32_t color = get_pixel(ctx, x, y);
+    unlock_rows(ctx, y, y);
     
-    ctx->performance.pixel_operations++;
+    count_pixel_ops(ctx, 1);
     return color;
 }
 
@@ -476,112 +3312,216 @@ int visualmem_v2_write(visualmem_v2_context_t* ctx,
                        void* visual_addr, 
                        const void* data, 
                        size_t size) {
+    return visualmem_v2_pwrite(ctx, visual_addr, 0, data, size);
+}
+
+int visualmem_v2_read(visualmem_v2_context_t* ctx, 
+                      void* visual_addr, 
+                      void* buffer, 
+                      size_t size) {
+    return visualmem_v2_pread(ctx, visual_addr, 0, buffer, size);
+}
+
+int visualmem_v2_pwrite(visualmem_v2_context_t* ctx,
+                        void* visual_addr,
+                        size_t offset,
+                        const void* data,
+                        size_t size) {
     if (!ctx || !ctx->is_initialized || !visual_addr || !data || size == 0) {
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
+    byte_region_t region;
+    if (!find_region(ctx, visual_addr, &region) ||
+        offset > region.size || size > region.size - offset) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    // Only the bands this range covers are held while encoding
     uint64_t start_time = get_timestamp_us();
+    region_store_locked(ctx, &region, offset, (const uint8_t*)data, size);
+    record_transfer(ctx, size, start_time, 1);
     
-    int x, y;
-    addr_to_coord(visual_addr, &x, &y);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_pread(visualmem_v2_context_t* ctx,
+                       void* visual_addr,
+                       size_t offset,
+                       void* buffer,
+                       size_t size) {
+    if (!ctx || !ctx->is_initialized || !visual_addr || !buffer || size == 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
     
-    const uint8_t* bytes = (const uint8_t*)data;
-    int byte_index = 0;
+    byte_region_t region;
+    if (!find_region(ctx, visual_addr, &region) ||
+        offset > region.size || size > region.size - offset) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
     
-    // Encode each byte as pixels
-    for (size_t i = 0; i < size; i++) {
-        int byte_x, byte_y;
-        calculate_byte_position(byte_index, &byte_x, &byte_y, ctx->width);
-        
-        if (byte_x >= ctx->width - 10 || byte_y >= ctx->height - 2) {
-            break; // Out of screen space
+    // Shared band locks: concurrent readers do not exclude each other
+    uint64_t start_time = get_timestamp_us();
+    region_load_locked(ctx, &region, offset, (uint8_t*)buffer, size);
+    record_transfer(ctx, size, start_time, 0);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_writev(visualmem_v2_context_t* ctx, const visualmem_v2_iovec_t* iov, int count) {
+    if (!ctx || !ctx->is_initialized || !iov || count <= 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    batch_entry_t* order = malloc(count * sizeof(batch_entry_t));
+    byte_region_t* regions = malloc(count * sizeof(byte_region_t));
+    if (!order || !regions) {
+        free(order);
+        free(regions);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
+    
+    uint64_t start_time = get_timestamp_us();
+    size_t total = 0;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    int result = resolve_iovecs(ctx, iov, count, 1, order, regions);
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    if (result == VISUALMEM_V2_SUCCESS) {
+        // One pass over every band the entries cover
+        int y0 = INT_MAX, y1 = -1;
+        for (int i = 0; i < count; i++) {
+            const visualmem_v2_iovec_t* v = &iov[order[i].entry];
+            int first_row, last_row;
+            region_rows(ctx, &regions[i], v->offset, v->size, &first_row, &last_row);
+            if (first_row < y0) y0 = first_row;
+            if (last_row > y1) y1 = last_row;
         }
         
-        // Start marker (red)
-        visualmem_v2_write_pixel(ctx, byte_x, byte_y, 0xFFFF0000);
-        
-        // Encode 8 bits
-        uint8_t byte_value = bytes[i];
-        for (int bit = 0; bit < 8; bit++) {
-            uint8_t bit_value = (byte_value >> (7 - bit)) & 1;
-            uint32_t pixel_color = bit_value ? 0xFFFFFFFF : 0xFF000000; // White or black
-            visualmem_v2_write_pixel(ctx, byte_x + 1 + bit, byte_y, pixel_color);
+        lock_rows(ctx, y0, y1, 1);
+        for (int i = 0; i < count; i++) {
+            const visualmem_v2_iovec_t* v = &iov[order[i].entry];
+            region_store(ctx, &regions[i], v->offset, (const uint8_t*)v->buffer, v->size);
+            total += v->size;
         }
-        
-        // End marker (green)
-        visualmem_v2_write_pixel(ctx, byte_x + 9, byte_y, 0xFF00FF00);
-        
-        byte_index++;
+        unlock_rows(ctx, y0, y1);
     }
     
-    uint64_t end_time = get_timestamp_us();
-    double duration_s = (end_time - start_time) / 1000000.0;
-    double speed_mbps = (size / (1024.0 * 1024.0)) / duration_s;
+    free(order);
+    free(regions);
+    if (result != VISUALMEM_V2_SUCCESS) return result;
     
-    ctx->performance.bytes_written += size;
-    if (ctx->performance.avg_write_speed_mbps == 0) {
-        ctx->performance.avg_write_speed_mbps = speed_mbps;
-    } else {
-        ctx->performance.avg_write_speed_mbps = 
-            (ctx->performance.avg_write_speed_mbps + speed_mbps) / 2.0;
-    }
+    record_transfer(ctx, total, start_time, 1);
     
     return VISUALMEM_V2_SUCCESS;
 }
 
-int visualmem_v2_read(visualmem_v2_context_t* ctx, 
-                      void* visual_addr, 
-                      void* buffer, 
-                      size_t size) {
-    if (!ctx || !ctx->is_initialized || !visual_addr || !buffer || size == 0) {
+int visualmem_v2_readv(visualmem_v2_context_t* ctx, const visualmem_v2_iovec_t* iov, int count) {
+    if (!ctx || !ctx->is_initialized || !iov || count <= 0) {
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
-    uint64_t start_time = get_timestamp_us();
+    batch_entry_t* order = malloc(count * sizeof(batch_entry_t));
+    byte_region_t* regions = malloc(count * sizeof(byte_region_t));
+    if (!order || !regions) {
+        free(order);
+        free(regions);
+        return VISUALMEM_V2_ERROR_ALLOCATION_FAILED;
+    }
     
-    int x, y;
-    addr_to_coord(visual_addr, &x, &y);
+    uint64_t start_time = get_timestamp_us();
+    size_t total = 0;
     
-    uint8_t* bytes = (uint8_t*)buffer;
-    int byte_index = 0;
+    pthread_mutex_lock(&ctx->context_mutex);
+    int result = resolve_iovecs(ctx, iov, count, 0, order, regions);
+    pthread_mutex_unlock(&ctx->context_mutex);
     
-    // Decode each byte from pixels
-    for (size_t i = 0; i < size; i++) {
-        int byte_x, byte_y;
-        calculate_byte_position(byte_index, &byte_x, &byte_y, ctx->width);
-        
-        if (byte_x >= ctx->width - 10 || byte_y >= ctx->height - 2) {
-            break; // Out of screen space
+    if (result == VISUALMEM_V2_SUCCESS) {
+        // One pass over every band the entries cover
+        int y0 = INT_MAX, y1 = -1;
+        for (int i = 0; i < count; i++) {
+            const visualmem_v2_iovec_t* v = &iov[order[i].entry];
+            int first_row, last_row;
+            region_rows(ctx, &regions[i], v->offset, v->size, &first_row, &last_row);
+            if (first_row < y0) y0 = first_row;
+            if (last_row > y1) y1 = last_row;
         }
         
-        uint8_t byte_value = 0;
-        
-        // Read 8 bits
-        for (int bit = 0; bit < 8; bit++) {
-            uint32_t pixel_color = visualmem_v2_read_pixel(ctx, byte_x + 1 + bit, byte_y);
-            
-            // Check if pixel represents bit 1 (white)
-            if ((pixel_color & 0x00FFFFFF) == 0x00FFFFFF) {
-                byte_value |= (1 << (7 - bit));
-            }
+        lock_rows(ctx, y0, y1, 0);
+        for (int i = 0; i < count; i++) {
+            const visualmem_v2_iovec_t* v = &iov[order[i].entry];
+            region_load(ctx, &regions[i], v->offset, (uint8_t*)v->buffer, v->size);
+            total += v->size;
         }
-        
-        bytes[i] = byte_value;
-        byte_index++;
+        unlock_rows(ctx, y0, y1);
     }
     
-    uint64_t end_time = get_timestamp_us();
-    double duration_s = (end_time - start_time) / 1000000.0;
-    double speed_mbps = (size / (1024.0 * 1024.0)) / duration_s;
+    free(order);
+    free(regions);
+    if (result != VISUALMEM_V2_SUCCESS) return result;
     
-    ctx->performance.bytes_read += size;
-    if (ctx->performance.avg_read_speed_mbps == 0) {
-        ctx->performance.avg_read_speed_mbps = speed_mbps;
+    record_transfer(ctx, total, start_time, 0);
+    
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_write_image(visualmem_v2_context_t* ctx,
+                             void* visual_addr,
+                             const void* image_data,
+                             int width, int height,
+                             visualmem_v2_pixel_format_t format) {
+    if (!ctx || !ctx->is_initialized || !visual_addr || !image_data || width <= 0 || height <= 0) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    if (format < VISUALMEM_V2_PIXEL_RGBA32 || format > VISUALMEM_V2_PIXEL_MONOCHROME) {
+        return VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED;
+    }
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    const visualmem_v2_alloc_table_t* table = &ctx->allocations;
+    int slot = table_find(table, visual_addr);
+    if (slot < 0 || ctx->layout != VISUALMEM_V2_LAYOUT_TILED ||
+        width > table->width[slot] || height > table->height[slot]) {
+        pthread_mutex_unlock(&ctx->context_mutex);
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    int x0 = table->x[slot];
+    int y0 = table->y[slot];
+    
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    const pixel_engine_t* source = &pixel_engines[format];
+    const pixel_engine_t* target = &pixel_engines[ctx->pixel_format];
+    size_t source_stride = ((size_t)width * source->bits_per_pixel + 7) / 8;
+    const uint8_t* source_row = (const uint8_t*)image_data;
+    
+    lock_rows(ctx, y0, y0 + height - 1, 1);
+    if (format == ctx->pixel_format && target->bits_per_pixel % 8 == 0) {
+        // Same layout: each image row is one contiguous copy
+        size_t offset = (size_t)x0 * (target->bits_per_pixel / 8);
+        for (int row = 0; row < height; row++, source_row += source_stride) {
+            memcpy(video_row(ctx, y0 + row) + offset, source_row, source_stride);
+        }
     } else {
-        ctx->performance.avg_read_speed_mbps = 
-            (ctx->performance.avg_read_speed_mbps + speed_mbps) / 2.0;
+        for (int row = 0; row < height; row++, source_row += source_stride) {
+            uint8_t* target_row = video_row(ctx, y0 + row);
+            for (int col = 0; col < width; col++) {
+                target->store(target_row, x0 + col, source->load(source_row, col));
+            }
+        }
     }
     
+    mark_rect_dirty(ctx, x0, y0, width, height);
+    unlock_rows(ctx, y0, y0 + height - 1);
+    
+    count_pixel_ops(ctx, (uint64_t)width * height);
+    pthread_mutex_lock(&ctx->context_mutex);
+    ctx->performance.bytes_written += source_stride * height;
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
     return VISUALMEM_V2_SUCCESS;
 }
 
@@ -595,7 +3535,19 @@ int visualmem_v2_refresh_display(visualmem_v2_context_t* ctx) {
     switch (ctx->backend) {
         case VISUALMEM_V2_BACKEND_X11:
         case VISUALMEM_V2_BACKEND_OPENGL:
-            return visualmem_v2_x11_refresh(ctx);
+            // Full refresh: everything pending is pushed with it
+            for (int w = 0; w < VISUALMEM_V2_TILE_WORDS; w++) {
+                __atomic_store_n(&ctx->refresh_dirty[w], 0, __ATOMIC_RELEASE);
+            }
+            lock_rows(ctx, 0, ctx->height - 1, 0);
+            pthread_mutex_lock(&ctx->display_mutex);
+            if (!ctx->video_memory_shared) {
+                sync_region_to_image(ctx, 0, 0, ctx->width, ctx->height);
+            }
+            unlock_rows(ctx, 0, ctx->height - 1);
+            int result = visualmem_v2_x11_refresh(ctx);
+            pthread_mutex_unlock(&ctx->display_mutex);
+            return result;
             
         default:
             return VISUALMEM_V2_SUCCESS; // No-op for other backends
@@ -612,6 +3564,60 @@ int visualmem_v2_set_refresh_rate(visualmem_v2_context_t* ctx, int hz) {
     return VISUALMEM_V2_SUCCESS;
 }
 
+// === TILE TRACKING ===
+
+int visualmem_v2_collect_dirty_tiles(visualmem_v2_context_t* ctx,
+                                     int* tiles, int max_tiles) {
+    if (!ctx || !ctx->is_initialized || !tiles || max_tiles <= 0) return 0;
+    
+    int count = 0;
+    for (int w = 0; w < VISUALMEM_V2_TILE_WORDS && count < max_tiles; w++) {
+        uint64_t bits = __atomic_exchange_n(&ctx->snapshot_dirty[w], 0, __ATOMIC_ACQ_REL);
+        while (bits && count < max_tiles) {
+            int bit = __builtin_ctzll(bits);
+            tiles[count++] = w * 64 + bit;
+            bits &= bits - 1;
+        }
+        
+        // Hand back what did not fit
+        if (bits) {
+            __atomic_fetch_or(&ctx->snapshot_dirty[w], bits, __ATOMIC_RELEASE);
+        }
+    }
+    
+    return count;
+}
+
+uint32_t visualmem_v2_get_tile_checksum(visualmem_v2_context_t* ctx,
+                                        int tile_x, int tile_y) {
+    if (!ctx || !ctx->is_initialized) return 0;
+    if (tile_x < 0 || tile_x >= ctx->tile_cols || tile_y < 0 || tile_y >= ctx->tile_rows) return 0;
+    
+    int tile = tile_y * ctx->tile_cols + tile_x;
+    uint64_t bit = 1ULL << (tile & 63);
+    
+    // Clear before hashing so a concurrent write marks the tile stale again
+    uint64_t previous = __atomic_fetch_and(&ctx->checksum_stale[tile >> 6], ~bit, __ATOMIC_ACQ_REL);
+    if (previous & bit) {
+        uint32_t pixels[VISUALMEM_V2_TILE_WIDTH * VISUALMEM_V2_TILE_HEIGHT];
+        int x0 = tile_x * VISUALMEM_V2_TILE_WIDTH;
+        int y0 = tile_y * VISUALMEM_V2_TILE_HEIGHT;
+        int count = 0;
+        
+        lock_rows(ctx, y0, y0, 0);
+        for (int y = y0; y < y0 + VISUALMEM_V2_TILE_HEIGHT && y < ctx->height; y++) {
+            for (int x = x0; x < x0 + VISUALMEM_V2_TILE_WIDTH && x < ctx->width; x++) {
+                pixels[count++] = get_pixel(ctx, x, y);
+            }
+        }
+        unlock_rows(ctx, y0, y0);
+        count_pixel_ops(ctx, (uint64_t)count);
+        ctx->tile_checksums[tile] = calculate_checksum(pixels, count * sizeof(uint32_t));
+    }
+    
+    return ctx->tile_checksums[tile];
+}
+
 // === PERFORMANCE AND MONITORING ===
 
 int visualmem_v2_get_performance(visualmem_v2_context_t* ctx,
@@ -620,8 +3626,22 @@ int visualmem_v2_get_performance(visualmem_v2_context_t* ctx,
         return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     }
     
+    // pixel_operations is counted with atomics outside the lock
     pthread_mutex_lock(&ctx->context_mutex);
-    *perf = ctx->performance;
+    const visualmem_v2_performance_t* live = &ctx->performance;
+    perf->total_allocations = live->total_allocations;
+    perf->total_deallocations = live->total_deallocations;
+    perf->bytes_written = live->bytes_written;
+    perf->bytes_read = live->bytes_read;
+    perf->avg_write_speed_mbps = live->avg_write_speed_mbps;
+    perf->avg_read_speed_mbps = live->avg_read_speed_mbps;
+    perf->display_refreshes = live->display_refreshes;
+    perf->frame_rate = live->frame_rate;
+    perf->pixel_operations = __atomic_load_n(&live->pixel_operations, __ATOMIC_RELAXED);
+    for (const thread_cache_t* cache = ctx->thread_caches; cache; cache = cache->next) {
+        perf->total_allocations += __atomic_load_n(&cache->allocations, __ATOMIC_RELAXED);
+        perf->total_deallocations += __atomic_load_n(&cache->deallocations, __ATOMIC_RELAXED);
+    }
     pthread_mutex_unlock(&ctx->context_mutex);
     
     return VISUALMEM_V2_SUCCESS;
@@ -631,8 +3651,45 @@ void visualmem_v2_reset_performance(visualmem_v2_context_t* ctx) {
     if (!ctx) return;
     
     pthread_mutex_lock(&ctx->context_mutex);
-    memset(&ctx->performance, 0, sizeof(visualmem_v2_performance_t));
+    visualmem_v2_performance_t* live = &ctx->performance;
+    live->total_allocations = live->total_deallocations = 0;
+    live->bytes_written = live->bytes_read = 0;
+    live->avg_write_speed_mbps = live->avg_read_speed_mbps = 0;
+    live->display_refreshes = 0;
+    live->frame_rate = 0;
+    __atomic_store_n(&live->pixel_operations, 0, __ATOMIC_RELAXED);
+    for (thread_cache_t* cache = ctx->thread_caches; cache; cache = cache->next) {
+        __atomic_store_n(&cache->allocations, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cache->deallocations, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&ctx->context_mutex);
+}
+
+int visualmem_v2_get_packing_stats(visualmem_v2_context_t* ctx,
+                                   visualmem_v2_packing_stats_t* stats) {
+    if (!ctx || !ctx->is_initialized || !stats) {
+        return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    }
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    
+    const visualmem_v2_packer_t* packer = &ctx->packer;
+    memset(stats, 0, sizeof(*stats));
+    if (ctx->layout == VISUALMEM_V2_LAYOUT_TILED) {
+        packer_refresh(ctx); // Report the exact free space, not leftover merge pieces
+        stats->area_pixels = (size_t)packer->area.width * packer->area.height;
+        stats->reserved_pixels = packer->reserved_pixels;
+        stats->payload_pixels = packer->payload_pixels;
+        stats->free_rects = packer->free_count;
+        for (int i = 0; i < packer->free_count; i++) {
+            size_t area = (size_t)packer->free_rects[i].width * packer->free_rects[i].height;
+            if (area > stats->largest_free_pixels) stats->largest_free_pixels = area;
+        }
+    }
+    
     pthread_mutex_unlock(&ctx->context_mutex);
+    
+    return VISUALMEM_V2_SUCCESS;
 }
 
 // === UTILITY FUNCTIONS ===
@@ -678,6 +3735,25 @@ void visualmem_v2_set_debug_mode(visualmem_v2_context_t* ctx, int enabled) {
 
 // === THREAD SAFETY ===
 
+int visualmem_v2_set_thread_cache(visualmem_v2_context_t* ctx, int enabled) {
+    if (!ctx || !ctx->is_initialized) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
+    
+    pthread_mutex_lock(&ctx->context_mutex);
+    if (!enabled) {
+        // Threads fall back to the shared allocator; their live blocks stay put
+        __atomic_store_n(&ctx->thread_cache_serial, 0, __ATOMIC_RELEASE);
+        release_cache_pages(ctx, NULL, 0);
+    } else if (ctx->thread_cache_serial == 0) {
+        // A fresh serial, so no thread picks up a cache of an older context
+        uint64_t serial = __atomic_add_fetch(&thread_cache_serials, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&ctx->thread_cache_serial, serial, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&ctx->context_mutex);
+    
+    printf("[INIT] Thread caches %s\n", enabled ? "enabled" : "disabled");
+    return VISUALMEM_V2_SUCCESS;
+}
+
 int visualmem_v2_lock(visualmem_v2_context_t* ctx) {
     if (!ctx) return VISUALMEM_V2_ERROR_INVALID_ADDRESS;
     return pthread_mutex_lock(&ctx->context_mutex) == 0 ? 
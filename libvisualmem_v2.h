@@ -56,8 +56,25 @@
 #define VISUALMEM_V2_MAX_HEIGHT 1080
 #define VISUALMEM_V2_MIN_WIDTH 640
 #define VISUALMEM_V2_MIN_HEIGHT 480
-#define VISUALMEM_V2_MAX_ALLOCATIONS 2048
-#define VISUALMEM_V2_BYTES_PER_PIXEL 4  // RGBA32
+#define VISUALMEM_V2_ALLOC_TABLE_INITIAL 64  // Allocation slots on first alloc; the table doubles on demand
+#define VISUALMEM_V2_BYTES_PER_PIXEL 4  // RGBA32 (widest pixel format)
+#define VISUALMEM_V2_ALLOC_UNIT 32       // Smallest allocator block in payload bytes (linear layout)
+#define VISUALMEM_V2_ALLOC_MAX_ORDER 26  // Largest block: VISUALMEM_V2_ALLOC_UNIT << 26 bytes
+#define VISUALMEM_V2_ARENA_HEADER 4      // In-band length stored before each arena allocation
+#define VISUALMEM_V2_TCACHE_MAX_SIZE 4096   // Largest allocation served from a thread cache
+#define VISUALMEM_V2_TCACHE_PAGE_BYTES 8192 // Payload bytes a thread cache takes from the allocator at once
+#define VISUALMEM_V2_TCACHE_PAGE_SHARE 64   // A page holds at most capacity / 64 bytes
+
+// === TILE GRID ===
+// The screen is divided into fixed tiles aligned to (0,0). Dirty tracking
+// (refresh, snapshots, checksums) works per tile in every layout; the tiled
+// layout also places each allocation in a rectangle of whole tiles.
+#define VISUALMEM_V2_TILE_WIDTH 64
+#define VISUALMEM_V2_TILE_HEIGHT 16
+#define VISUALMEM_V2_MAX_TILE_COLS ((VISUALMEM_V2_MAX_WIDTH + VISUALMEM_V2_TILE_WIDTH - 1) / VISUALMEM_V2_TILE_WIDTH)
+#define VISUALMEM_V2_MAX_TILE_ROWS ((VISUALMEM_V2_MAX_HEIGHT + VISUALMEM_V2_TILE_HEIGHT - 1) / VISUALMEM_V2_TILE_HEIGHT)
+#define VISUALMEM_V2_MAX_TILES (VISUALMEM_V2_MAX_TILE_COLS * VISUALMEM_V2_MAX_TILE_ROWS)
+#define VISUALMEM_V2_TILE_WORDS ((VISUALMEM_V2_MAX_TILES + 63) / 64)
 
 // === DISPLAY MODES ===
 typedef enum {
@@ -97,9 +114,51 @@ typedef enum {
     VISUALMEM_V2_PIXEL_RGBA32,       // 32-bit RGBA
     VISUALMEM_V2_PIXEL_RGB24,        // 24-bit RGB
     VISUALMEM_V2_PIXEL_RGB16,        // 16-bit RGB565
-    VISUALMEM_V2_PIXEL_MONOCHROME    // 1-bit monochrome
+    VISUALMEM_V2_PIXEL_MONOCHROME    // 1-bit monochrome (binary encoding only)
 } visualmem_v2_pixel_format_t;
 
+// === PAYLOAD ENCODINGS ===
+typedef enum {
+    VISUALMEM_V2_ENCODING_BINARY,        // 10 pixels per byte (start marker, 8 bits, end marker)
+    VISUALMEM_V2_ENCODING_DENSE_RGB,     // 3 bytes per pixel in R/G/B, one framed block per row
+    VISUALMEM_V2_ENCODING_DENSE_RGBA,    // 4 bytes per pixel in R/G/B/A (needs an alpha-preserving backend)
+    VISUALMEM_V2_ENCODING_PALETTE_2BPP,  // 4-color palette, 2 bits per pixel, one framed block per row
+    VISUALMEM_V2_ENCODING_PALETTE_4BPP,  // 16-color palette, 4 bits per pixel, one framed block per row
+    VISUALMEM_V2_ENCODING_PALETTE_8BPP   // 256-color palette, 8 bits per pixel (survives 15/16-bit visuals)
+} visualmem_v2_encoding_t;
+
+// === ALLOCATION LAYOUTS ===
+typedef enum {
+    VISUALMEM_V2_LAYOUT_LINEAR,      // Allocations follow each other by byte index across rows
+    VISUALMEM_V2_LAYOUT_TILED        // Each allocation owns a screen rectangle (whole tiles for byte payloads)
+} visualmem_v2_layout_t;
+
+// === RECTANGLE PACKING ===
+// Screen rectangles of the tiled layout are placed by a maximal-rectangles
+// packer: the free space is kept as the list of all maximal free rectangles
+typedef struct {
+    int x, y;
+    int width, height;
+} visualmem_v2_rect_t;
+
+typedef struct {
+    visualmem_v2_rect_t area;       // Packable data area
+    visualmem_v2_rect_t* free_rects;
+    int free_count;
+    int free_capacity;
+    size_t reserved_pixels;         // Pixels inside placed rectangles
+    size_t payload_pixels;          // Pixels their owners asked for
+    int incomplete;                 // Frees may have left free space out of the list
+} visualmem_v2_packer_t;
+
+typedef struct {
+    size_t area_pixels;             // Pixels in the packable data area
+    size_t reserved_pixels;         // Pixels inside placed rectangles
+    size_t payload_pixels;          // Pixels their owners asked for (the rest is rounding waste)
+    size_t largest_free_pixels;     // Area of the largest free rectangle
+    int free_rects;                 // Maximal free rectangles tracked
+} visualmem_v2_packing_stats_t;
+
 // === HARDWARE CAPABILITIES ===
 typedef struct {
     int has_x11;                     // X11 support available
@@ -149,15 +208,75 @@ typedef struct {
 typedef struct {
     void* visual_addr;              // Visual coordinate address
     size_t size;                    // Allocated size in bytes
+    size_t byte_offset;             // First payload byte (linear layout)
     int x, y;                       // Screen coordinates
-    int width, height;              // Allocation dimensions
+    int width, height;              // Allocation dimensions (tile-aligned in tiled layout)
     uint32_t checksum;              // Data integrity checksum
     uint64_t timestamp;             // Allocation timestamp
     int is_active;                  // Allocation status
     char label[64];                 // Allocation label
-    pthread_mutex_t mutex;          // Thread safety
 } visualmem_v2_allocation_t;
 
+// === ALLOCATION TABLE ===
+// Structure-of-arrays table, grown on demand under context_mutex. Lookups
+// scan only the packed hot arrays; placement and bookkeeping stay apart.
+typedef struct {
+    // Hot: scanned on every lookup
+    void** visual_addr;             // Visual coordinate address
+    uint8_t* is_active;
+    size_t* size;                   // Allocated size in bytes
+    size_t* byte_offset;            // First payload byte (linear layout)
+    // Placement: screen rectangle (tile-aligned in tiled layout)
+    int* x;
+    int* y;
+    int* width;
+    int* height;
+    size_t* payload_pixels;         // Pixels asked for (tiled layout; the rest is rounding)
+    // Cold
+    uint32_t* checksum;
+    uint64_t* timestamp;
+    char (*label)[64];
+    int* free_slots;                // Stack of inactive slots
+    int free_slot_count;
+    int* scrub_slots;               // Freed slots whose pixels are not cleared yet
+    int scrub_count;
+    int scrub_active;               // Slots being cleared outside context_mutex
+    int capacity;                   // Slots in each array
+} visualmem_v2_alloc_table_t;
+
+// === ADDRESS SPACE ALLOCATOR ===
+// Buddy allocator state over the linear payload bytes
+typedef struct {
+    size_t base;                    // Payload byte of unit 0
+    int unit_count;                 // VISUALMEM_V2_ALLOC_UNIT-byte units managed
+    uint8_t* block_state;           // Per unit: order (+ free flag) of the block starting there
+    int32_t* free_next;             // Free-list links, valid at free block heads
+    int32_t* free_prev;
+    int32_t free_head[VISUALMEM_V2_ALLOC_MAX_ORDER + 1];
+    uint32_t free_orders;           // Bit k set while order k has a free block
+} visualmem_v2_buddy_t;
+
+// === ARENAS ===
+// Bump state of an arena; its region is an ordinary allocation slot
+typedef struct {
+    int slot;                       // Allocation slot of the arena, -1 for a released record
+    size_t used;                    // Byte offset of the next allocation header
+    size_t high_water;              // Highest used offset since creation; bumps below it clear first
+    uint32_t epoch;                 // Bumped on reset and destroy: stamped into allocation addresses
+    size_t* starts;                 // First byte of each allocation this epoch, ascending
+    int start_count;
+    int start_capacity;
+} visualmem_v2_arena_t;
+
+// === VECTORED ACCESS ===
+// One entry of visualmem_v2_writev / visualmem_v2_readv
+typedef struct {
+    void* visual_addr;              // Allocation to access
+    size_t offset;                  // First byte inside it
+    void* buffer;                   // Source for writev, destination for readv
+    size_t size;                    // Bytes to transfer
+} visualmem_v2_iovec_t;
+
 // === PERFORMANCE METRICS ===
 typedef struct {
     uint64_t total_allocations;     // Total allocations made
@@ -179,6 +298,17 @@ typedef struct {
     visualmem_v2_mode_t mode;
     visualmem_v2_backend_t backend;
     visualmem_v2_pixel_format_t pixel_format;
+    visualmem_v2_encoding_t encoding;
+    int bytes_per_row;              // Payload bytes per visual row
+    size_t capacity_bytes;          // Addressable payload bytes
+    visualmem_v2_layout_t layout;   // Allocation placement
+    
+    // Tile grid
+    int tile_cols, tile_rows;
+    uint64_t refresh_dirty[VISUALMEM_V2_TILE_WORDS];     // Tiles not yet pushed to the display
+    uint64_t snapshot_dirty[VISUALMEM_V2_TILE_WORDS];    // Tiles changed since the last collect
+    uint64_t checksum_stale[VISUALMEM_V2_TILE_WORDS];    // Tiles whose cached checksum is out of date
+    uint32_t tile_checksums[VISUALMEM_V2_MAX_TILES];
     
     // Hardware contexts
     visualmem_v2_x11_context_t x11;
@@ -187,13 +317,25 @@ typedef struct {
     visualmem_v2_hardware_caps_t hardware;
     
     // Memory management
-    void* video_memory;             // Real video memory buffer
-    visualmem_v2_allocation_t allocations[VISUALMEM_V2_MAX_ALLOCATIONS];
+    void* video_memory;             // Pixel store in pixel_format (may be the XImage buffer)
+    size_t video_memory_size;       // Bytes in video_memory
+    int video_stride;               // Bytes per pixel row in video_memory
+    int video_memory_shared;        // video_memory belongs to the XImage (same layout)
+    visualmem_v2_alloc_table_t allocations;
     int allocation_count;
+    visualmem_v2_buddy_t buddy;     // Free blocks of the linear payload area
+    visualmem_v2_packer_t packer;   // Free rectangles of the tiled layout
+    visualmem_v2_arena_t* arenas;   // Arena records, released ones reused
+    int arena_count;
+    int arena_capacity;
+    struct visualmem_v2_thread_cache* thread_caches;  // One per thread that allocated from a cache
+    uint64_t thread_cache_serial;   // Nonzero while thread caches are on
     
     // Threading and synchronization
     pthread_t display_thread;       // Display refresh thread
-    pthread_mutex_t context_mutex;  // Context protection
+    pthread_mutex_t context_mutex;  // Allocator state: table, buddy, packer, arenas
+    pthread_mutex_t display_mutex;  // XImage copies and backend pushes
+    struct visualmem_v2_band_locks* band_locks;  // Pixels: a reader-writer lock per tile row
     pthread_cond_t display_cond;    // Display synchronization
     int display_thread_running;     // Thread control flag
     
@@ -232,6 +374,31 @@ int visualmem_v2_init_with_backend(visualmem_v2_context_t* ctx,
  */
 void visualmem_v2_cleanup(visualmem_v2_context_t* ctx);
 
+/**
+ * Select payload encoding (only before the first allocation)
+ */
+int visualmem_v2_set_encoding(visualmem_v2_context_t* ctx,
+                              visualmem_v2_encoding_t encoding);
+
+/**
+ * Get payload capacity in bytes for the current encoding
+ */
+size_t visualmem_v2_get_capacity(visualmem_v2_context_t* ctx);
+
+/**
+ * Select pixel storage format (only before the first allocation)
+ * Init picks the format matching the display; MONOCHROME stores binary
+ * encoded data in 1/32 of the RGBA32 memory
+ */
+int visualmem_v2_set_pixel_format(visualmem_v2_context_t* ctx,
+                                  visualmem_v2_pixel_format_t format);
+
+/**
+ * Select allocation layout (only before the first allocation)
+ */
+int visualmem_v2_set_layout(visualmem_v2_context_t* ctx,
+                            visualmem_v2_layout_t layout);
+
 /**
  * Get hardware capabilities
  */
@@ -248,23 +415,88 @@ void* visualmem_v2_alloc(visualmem_v2_context_t* ctx,
 
 /**
  * Allocate visual memory at specific coordinates
+ * Reserves exactly that pixel rectangle (tiled layout); NULL if any of it is taken
  */
 void* visualmem_v2_alloc_at(visualmem_v2_context_t* ctx,
                             int x, int y, int width, int height,
                             const char* label);
 
 /**
- * Free visual memory allocation
+ * Allocate a pixel rectangle for an image, packed wherever it fits best
+ * (tiled layout). Fill it with visualmem_v2_write_image
+ */
+void* visualmem_v2_alloc_image(visualmem_v2_context_t* ctx,
+                               int width, int height,
+                               const char* label);
+
+/**
+ * Free visual memory allocation. Returns at once: the refresh thread clears
+ * the pixels outside the context lock, then the space is reused
  */
 int visualmem_v2_free(visualmem_v2_context_t* ctx, void* visual_addr);
 
 /**
- * Reallocate visual memory (resize)
+ * Allocate count blocks under one lock, largest first. labels may be NULL.
+ * All or nothing: on failure every addrs entry is NULL
+ */
+int visualmem_v2_alloc_batch(visualmem_v2_context_t* ctx,
+                             const size_t* sizes,
+                             const char* const* labels,
+                             int count,
+                             void** addrs);
+
+/**
+ * Free count allocations under one lock. Nothing is freed unless every
+ * address is live, freeable and listed once
+ */
+int visualmem_v2_free_batch(visualmem_v2_context_t* ctx, void* const* addrs, int count);
+
+/**
+ * Clear every freed region still waiting for the refresh thread and
+ * return its space now
+ */
+int visualmem_v2_scrub(visualmem_v2_context_t* ctx);
+
+/**
+ * Copy out the allocation record for a visual address
+ */
+int visualmem_v2_get_allocation_info(visualmem_v2_context_t* ctx,
+                                     void* visual_addr,
+                                     visualmem_v2_allocation_t* info);
+
+/**
+ * Reallocate visual memory (resize): grows in place when the space next to
+ * the allocation is free, otherwise copies its pixels to a new place and
+ * returns the new address. NULL on failure leaves the old allocation intact.
  */
 void* visualmem_v2_realloc(visualmem_v2_context_t* ctx, 
                            void* visual_addr, 
                            size_t new_size);
 
+/**
+ * Create an arena: one allocation whose bytes are handed out by
+ * visualmem_v2_arena_alloc and released together
+ */
+void* visualmem_v2_arena_create(visualmem_v2_context_t* ctx, size_t size, const char* label);
+
+/**
+ * Bump-allocate from an arena. The address works with read and write;
+ * it is never freed on its own. NULL when the arena is full
+ */
+void* visualmem_v2_arena_alloc(visualmem_v2_context_t* ctx, void* arena, size_t size);
+
+/**
+ * Release every allocation of an arena in O(1), without touching pixels;
+ * later arena allocations clear the bytes they reuse
+ */
+int visualmem_v2_arena_reset(visualmem_v2_context_t* ctx, void* arena);
+
+/**
+ * Destroy an arena with no per-allocation work; the bytes it handed out
+ * are cleared in the background, as for visualmem_v2_free
+ */
+int visualmem_v2_arena_destroy(visualmem_v2_context_t* ctx, void* arena);
+
 // === DATA OPERATIONS ===
 
 /**
@@ -283,6 +515,36 @@ int visualmem_v2_read(visualmem_v2_context_t* ctx,
                       void* buffer, 
                       size_t size);
 
+/**
+ * Write size bytes starting offset bytes into an allocation
+ */
+int visualmem_v2_pwrite(visualmem_v2_context_t* ctx,
+                        void* visual_addr,
+                        size_t offset,
+                        const void* data,
+                        size_t size);
+
+/**
+ * Read size bytes starting offset bytes into an allocation
+ */
+int visualmem_v2_pread(visualmem_v2_context_t* ctx,
+                       void* visual_addr,
+                       size_t offset,
+                       void* buffer,
+                       size_t size);
+
+/**
+ * Write several ranges under one lock, in pixel order, looking each
+ * allocation up once. Every entry is checked before any byte is written;
+ * entries must not overlap
+ */
+int visualmem_v2_writev(visualmem_v2_context_t* ctx, const visualmem_v2_iovec_t* iov, int count);
+
+/**
+ * Read several ranges under one lock, in pixel order
+ */
+int visualmem_v2_readv(visualmem_v2_context_t* ctx, const visualmem_v2_iovec_t* iov, int count);
+
 /**
  * Write pixel directly to screen coordinates
  */
@@ -298,6 +560,8 @@ uint32_t visualmem_v2_read_pixel(visualmem_v2_context_t* ctx,
 
 /**
  * Write image data to visual memory
+ * Pixels go to the allocation's rectangle, row by row from its top-left
+ * corner; rows already in the context's pixel format are copied whole
  */
 int visualmem_v2_write_image(visualmem_v2_context_t* ctx,
                              void* visual_addr,
@@ -328,6 +592,22 @@ int visualmem_v2_set_vsync(visualmem_v2_context_t* ctx, int enabled);
 int visualmem_v2_screenshot(visualmem_v2_context_t* ctx, 
                             const char* filename);
 
+// === TILE TRACKING ===
+
+/**
+ * Collect tiles changed since the previous call (for incremental snapshots)
+ * Fills tile indices (tile_y * tile_cols + tile_x), returns the count;
+ * tiles that do not fit in max_tiles stay marked for the next call
+ */
+int visualmem_v2_collect_dirty_tiles(visualmem_v2_context_t* ctx,
+                                     int* tiles, int max_tiles);
+
+/**
+ * Get checksum of one tile's pixels (recomputed only after a change)
+ */
+uint32_t visualmem_v2_get_tile_checksum(visualmem_v2_context_t* ctx,
+                                        int tile_x, int tile_y);
+
 // === PERFORMANCE AND MONITORING ===
 
 /**
@@ -341,6 +621,12 @@ int visualmem_v2_get_performance(visualmem_v2_context_t* ctx,
  */
 void visualmem_v2_reset_performance(visualmem_v2_context_t* ctx);
 
+/**
+ * Get rectangle packing statistics (tiled layout)
+ */
+int visualmem_v2_get_packing_stats(visualmem_v2_context_t* ctx,
+                                   visualmem_v2_packing_stats_t* stats);
+
 /**
  * Get memory usage statistics
  */
@@ -375,9 +661,26 @@ const char* visualmem_v2_get_error_string(visualmem_v2_error_t error);
 void visualmem_v2_set_debug_mode(visualmem_v2_context_t* ctx, int enabled);
 
 // === THREAD SAFETY ===
+// Allocation calls serialize on context_mutex. Reads and writes hold it
+// only to resolve an address, then lock just the bands of pixel rows they
+// touch (shared for reads), so readers never wait for each other and
+// writers to different bands run in parallel.
+//
+// With thread caches on, small linear-layout allocations come from pages
+// (allocation slots of VISUALMEM_V2_TCACHE_PAGE_BYTES, less on small
+// contexts) that each thread carves into blocks of one size class. A thread allocates, frees and
+// resolves its own blocks without context_mutex; freeing a block of another
+// thread takes it. Cached blocks keep their size but no label or checksum.
+
+/**
+ * Serve allocations up to VISUALMEM_V2_TCACHE_MAX_SIZE bytes from
+ * per-thread caches. Turning them off returns empty pages; blocks still
+ * handed out stay valid until freed
+ */
+int visualmem_v2_set_thread_cache(visualmem_v2_context_t* ctx, int enabled);
 
 /**
- * Lock context for thread-safe operations
+ * Lock the allocator state; data calls on other threads keep running
  */
 int visualmem_v2_lock(visualmem_v2_context_t* ctx);
 
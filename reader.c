@@ -60,6 +60,71 @@ void scan_visual_memory(VisualRAM* vram) {
     printf("\n");
 }
 
+// Block-framed binary rows (libvisualmem VISUALMEM_ENCODING_BINARY_FRAMED):
+// sync pixel with tag 0xD8 and a 16-bit sequence number, length pixel with
+// the payload size in bytes, then 8 black/white pixels per byte.
+#define FRAME_TAG_BINARY 0xD8
+#define FRAME_HEADER_PIXELS 2
+
+static uint8_t decode_framed_byte(VisualRAM* vram, int x, int y) {
+    uint8_t byte_value = 0;
+    for (int bit = 0; bit < BITS_PER_BYTE; bit++) {
+        uint32_t pixel_color = get_pixel_color(vram, x + bit, y);
+        if ((pixel_color & 0x00FFFFFF) == (COLOR_BIT_1 & 0x00FFFFFF)) {
+            byte_value |= (1 << (7 - bit));
+        }
+    }
+    return byte_value;
+}
+
+void scan_framed_blocks(VisualRAM* vram) {
+    printf("=== Scanning Visual Memory for Framed Blocks ===\n");
+    
+    int blocks_found = 0;
+    int previous_sequence = -1;
+    
+    for (int y = 0; y < WINDOW_HEIGHT; y++) {
+        for (int x = 0; x + FRAME_HEADER_PIXELS < WINDOW_WIDTH; x++) {
+            uint32_t sync = get_pixel_color(vram, x, y);
+            if (((sync >> 16) & 0xFF) != FRAME_TAG_BINARY) continue;
+            
+            // A valid length must fit in the rest of the row
+            int length = (int)(get_pixel_color(vram, x + 1, y) & 0x00FFFFFF);
+            int payload_x = x + FRAME_HEADER_PIXELS;
+            if (length <= 0 || payload_x + length * BITS_PER_BYTE > WINDOW_WIDTH) continue;
+            
+            int sequence = (int)(sync & 0xFFFF);
+            if (previous_sequence >= 0 && sequence != ((previous_sequence + 1) & 0xFFFF)) {
+                printf("Warning: block sequence jumps from %d to %d at row %d\n",
+                       previous_sequence, sequence, y);
+            }
+            previous_sequence = sequence;
+            
+            // Preview the first printable run of the payload
+            char preview[33];
+            int preview_len = 0;
+            int nonzero = 0;
+            for (int i = 0; i < length; i++) {
+                uint8_t byte_value = decode_framed_byte(vram, payload_x + i * BITS_PER_BYTE, y);
+                if (byte_value) nonzero++;
+                if (preview_len < 32 && byte_value >= 32 && byte_value <= 126) {
+                    preview[preview_len++] = (char)byte_value;
+                }
+            }
+            preview[preview_len] = '\0';
+            
+            if (nonzero > 0) {
+                printf("Block %d at (%d,%d): %d bytes, %d non-zero, text: '%s'\n",
+                       sequence, x, y, length, nonzero, preview);
+            }
+            blocks_found++;
+            break; // One block per row
+        }
+    }
+    
+    printf("%d framed blocks found\n\n", blocks_found);
+}
+
 int reader_main() {
     VisualRAM vram = {0};
     
@@ -88,7 +153,8 @@ int reader_main() {
         printf("2. Memory dump (hex view)\n");
         printf("3. Scan for strings\n");
         printf("4. Read raw byte\n");
-        printf("5. Exit\n");
+        printf("5. Scan for framed blocks\n");
+        printf("6. Exit\n");
         printf("Choice: ");
         
         if (scanf("%d", &choice) != 1) {
@@ -139,6 +205,10 @@ int reader_main() {
             }
             
             case 5:
+                scan_framed_blocks(&vram);
+                break;
+                
+            case 6:
                 printf("Exiting reader...\n");
                 visual_ram_cleanup(&vram);
                 return 0;
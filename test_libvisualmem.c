@@ -14,6 +14,7 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
 
 // === TEST framework ===
 static int tests_run = 0;
@@ -458,6 +459,1113 @@ static int test_visual_display(void) {
     TEST_END();
 }
 
+static int test_dense_encoding(void) {
+    TEST_START("Dense RGB/RGBA Payload Encoding");
+    
+    visualmem_context_t binary_ctx;
+    visualmem_init(&binary_ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    size_t binary_capacity = visualmem_get_capacity(&binary_ctx);
+    visualmem_cleanup(&binary_ctx);
+    
+    visualmem_encoding_t encodings[] = { VISUALMEM_ENCODING_DENSE_RGB, VISUALMEM_ENCODING_DENSE_RGBA };
+    
+    for (int e = 0; e < 2; e++) {
+        visualmem_context_t ctx;
+        int result = visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        TEST_ASSERT(result == VISUALMEM_SUCCESS, "Dense initialization successful");
+        
+        size_t capacity = visualmem_get_capacity(&ctx);
+        TEST_ASSERT(capacity >= binary_capacity * 30, "Dense capacity at least 30x binary capacity");
+        
+        uint8_t test_data[4096];
+        for (int i = 0; i < 4096; i++) {
+            test_data[i] = (uint8_t)((i * 31) ^ (i >> 4));
+        }
+        
+        void* addr = visualmem_alloc(&ctx, sizeof(test_data), "dense_block");
+        TEST_ASSERT(addr != NULL, "Dense allocation successful");
+        TEST_ASSERT(visualmem_write(&ctx, addr, test_data, sizeof(test_data)) == VISUALMEM_SUCCESS,
+                    "Dense write successful");
+        
+        visualmem_enter_autonomous_mode(&ctx);
+        
+        uint8_t read_data[4096];
+        TEST_ASSERT(visualmem_read(&ctx, addr, read_data, sizeof(read_data)) == VISUALMEM_SUCCESS,
+                    "Dense read successful");
+        TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0,
+                    "Dense data preserved across autonomous transition");
+        
+        printf("  Encoding %d: capacity %zu bytes (binary: %zu bytes, %.1fx)\n",
+               encodings[e], capacity, binary_capacity, (double)capacity / binary_capacity);
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    visualmem_context_t invalid_ctx;
+    TEST_ASSERT(visualmem_init_with_encoding(&invalid_ctx, VISUALMEM_MODE_SIMULATE, 800, 600,
+                                             (visualmem_encoding_t)42) == VISUALMEM_ERROR_INVALID_MODE,
+                "Unknown encoding rejected");
+    
+    TEST_END();
+}
+
+static int test_codec_kernels(void) {
+    TEST_START("Bulk Codec Kernels (Runtime Dispatch)");
+    
+    const char* backend = visualmem_get_codec_backend();
+    TEST_ASSERT(backend != NULL, "Codec backend selected");
+    printf("  Active codec backend: %s\n", backend);
+    
+    // Pixel mode keeps 32-bit pixels, so the binary span kernels run
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_PIXEL, 800, 600);
+    
+    // Odd-sized allocation so spans start and end mid-row
+    size_t size = 5 * 256 + 37;
+    uint8_t* test_data = malloc(size);
+    uint8_t* read_data = malloc(size);
+    for (size_t i = 0; i < size; i++) {
+        test_data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    
+    void* filler = visualmem_alloc(&ctx, 13, "row_offset");
+    void* addr = visualmem_alloc(&ctx, size, "kernel_span");
+    TEST_ASSERT(filler != NULL && addr != NULL, "Allocations successful");
+    
+    TEST_ASSERT(visualmem_write(&ctx, addr, test_data, size) == VISUALMEM_SUCCESS, "Span write successful");
+    TEST_ASSERT(visualmem_read(&ctx, addr, read_data, size) == VISUALMEM_SUCCESS, "Span read successful");
+    TEST_ASSERT(memcmp(test_data, read_data, size) == 0, "All byte values round-trip across rows");
+    
+    visualmem_enter_autonomous_mode(&ctx);
+    memset(read_data, 0, size);
+    visualmem_read(&ctx, addr, read_data, size);
+    TEST_ASSERT(memcmp(test_data, read_data, size) == 0, "Span data identical in autonomous mode");
+    
+    free(test_data);
+    free(read_data);
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_row_spans(void) {
+    TEST_START("Row-Span Partial Writes");
+    
+    // Narrow dense surface: 3-byte pixels and short rows, so neighbouring
+    // allocations share pixels and cross row breaks
+    visualmem_context_t ctx;
+    visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 100, 240, VISUALMEM_ENCODING_DENSE_RGB);
+    
+    size_t size = 200;
+    uint8_t pattern[4][200];
+    uint8_t read_data[200];
+    void* addrs[4];
+    for (int a = 0; a < 4; a++) {
+        for (size_t i = 0; i < size; i++) {
+            pattern[a][i] = (uint8_t)(i * 13 + a * 71 + 5);
+        }
+        addrs[a] = visualmem_alloc(&ctx, size, "span_block");
+        TEST_ASSERT(addrs[a] != NULL, "Allocation successful");
+    }
+    
+    // Write out of order so later writes land next to existing data
+    int order[4] = { 3, 1, 0, 2 };
+    for (int k = 0; k < 4; k++) {
+        int a = order[k];
+        TEST_ASSERT(visualmem_write(&ctx, addrs[a], pattern[a], size) == VISUALMEM_SUCCESS, "Span write successful");
+    }
+    
+    int intact = 1;
+    for (int a = 0; a < 4; a++) {
+        visualmem_read(&ctx, addrs[a], read_data, size);
+        if (memcmp(pattern[a], read_data, size) != 0) intact = 0;
+    }
+    TEST_ASSERT(intact, "Partial pixels keep neighbouring bytes");
+    
+    // Clearing a block must not disturb the blocks sharing its edge pixels
+    TEST_ASSERT(visualmem_free(&ctx, addrs[2]) == VISUALMEM_SUCCESS, "Free successful");
+    visualmem_read(&ctx, addrs[1], read_data, size);
+    TEST_ASSERT(memcmp(pattern[1], read_data, size) == 0, "Preceding block intact after free");
+    visualmem_read(&ctx, addrs[3], read_data, size);
+    TEST_ASSERT(memcmp(pattern[3], read_data, size) == 0, "Following block intact after free");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_palette_encoding(void) {
+    TEST_START("Palette Encodings (2/4/8 Bits per Pixel)");
+    
+    visualmem_encoding_t encodings[3] = {
+        VISUALMEM_ENCODING_PALETTE_2BPP, VISUALMEM_ENCODING_PALETTE_4BPP, VISUALMEM_ENCODING_PALETTE_8BPP
+    };
+    int bits[3] = { 2, 4, 8 };
+    uint8_t test_data[200];
+    uint8_t read_data[200];
+    for (int i = 0; i < 200; i++) {
+        test_data[i] = (uint8_t)(i * 37 + 11);
+    }
+    
+    for (int e = 0; e < 3; e++) {
+        visualmem_context_t ctx;
+        int result = visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 320, 240, encodings[e]);
+        TEST_ASSERT(result == VISUALMEM_SUCCESS, "Palette context initialized");
+        
+        // One framed block per row: payload pixels * bits / 8 bytes
+        int payload_pixels = 320 - 20 - 2;
+        TEST_ASSERT(ctx.bytes_per_row == payload_pixels * bits[e] / 8, "Row capacity matches bits per pixel");
+        
+        void* addr = visualmem_alloc(&ctx, sizeof(test_data), "palette_data");
+        TEST_ASSERT(addr != NULL, "Allocation successful");
+        visualmem_write(&ctx, addr, test_data, sizeof(test_data));
+        visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+        TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Palette round-trip");
+        
+        // Simulate a 16-bit (RGB565) display dropping low channel bits
+        visualmem_enter_autonomous_mode(&ctx);
+        uint32_t* pixels = (uint32_t*)ctx.framebuffer;
+        for (int i = 0; i < ctx.width * ctx.height; i++) {
+            pixels[i] &= 0xFFF8FCF8;
+        }
+        memset(read_data, 0, sizeof(read_data));
+        visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+        TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Decode survives RGB565 quantization");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_framed_binary(void) {
+    TEST_START("Block-Framed Binary Encoding");
+    
+    visualmem_context_t ctx;
+    int result = visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600,
+                                              VISUALMEM_ENCODING_BINARY_FRAMED);
+    TEST_ASSERT(result == VISUALMEM_SUCCESS, "Framed binary context initialized");
+    
+    // 8 pixels per byte after a 2-pixel block header on every row
+    TEST_ASSERT(ctx.bytes_per_row == (800 - 20 - 2) / 8, "Row holds 8 pixels per byte");
+    TEST_ASSERT(ctx.capacity_bytes == (size_t)ctx.bytes_per_row * (600 - 20), "Every row carries a block");
+    
+    uint32_t* pixels = (uint32_t*)ctx.ram_buffer;
+    uint32_t sync = pixels[(20 + 5) * ctx.width + 20];
+    uint32_t length = pixels[(20 + 5) * ctx.width + 21];
+    TEST_ASSERT(((sync >> 16) & 0xFF) == 0xD8 && (sync & 0xFFFF) == 5, "Sync pixel carries tag and sequence");
+    TEST_ASSERT((int)(length & 0x00FFFFFF) == ctx.bytes_per_row, "Length pixel carries block size");
+    
+    uint8_t test_data[150];
+    uint8_t read_data[150];
+    for (int i = 0; i < 150; i++) {
+        test_data[i] = (uint8_t)(i * 29 + 3);
+    }
+    void* addr = visualmem_alloc(&ctx, sizeof(test_data), "framed_data");
+    TEST_ASSERT(addr != NULL, "Allocation successful");
+    visualmem_write(&ctx, addr, test_data, sizeof(test_data));
+    
+    // Payload pixels are pure bit pixels, no per-byte markers
+    int markers = 0;
+    for (int x = 22; x < 22 + 8 * 40; x++) {
+        uint32_t color = pixels[20 * ctx.width + x];
+        if (color == VISUALMEM_COLOR_START || color == VISUALMEM_COLOR_END) markers++;
+    }
+    TEST_ASSERT(markers == 0, "No marker pixels inside the payload");
+    
+    visualmem_enter_autonomous_mode(&ctx);
+    visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+    TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Framed data persists after transition");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_indexed_framebuffer(void) {
+    TEST_START("Indexed Simulate Framebuffer");
+    
+    visualmem_context_t ctx;
+    int result = visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 801, 600);
+    TEST_ASSERT(result == VISUALMEM_SUCCESS, "Simulate context initialized");
+    
+    // Two 4-bit color indices per byte, rows padded to a whole byte
+    TEST_ASSERT(ctx.pixel_bits == 4, "Binary simulate mode stores color indices");
+    TEST_ASSERT(ctx.framebuffer_size == (size_t)401 * 600, "Framebuffer is 1/8 of 32-bit pixels");
+    TEST_ASSERT(visualmem_get_pixel(&ctx, 0, 0) == VISUALMEM_COLOR_FREE, "Untouched pixels read as free");
+    
+    uint8_t test_data[300];
+    uint8_t read_data[300];
+    for (int i = 0; i < 300; i++) {
+        test_data[i] = (uint8_t)(i * 53 + 7);
+    }
+    void* addr = visualmem_alloc(&ctx, sizeof(test_data), "indexed_data");
+    TEST_ASSERT(addr != NULL, "Allocation successful");
+    visualmem_write(&ctx, addr, test_data, sizeof(test_data));
+    visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+    TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Indexed round-trip");
+    
+    // Pixels expand to the public colors: first byte group of the header
+    TEST_ASSERT(visualmem_get_pixel(&ctx, 20, 20) == VISUALMEM_COLOR_START, "Start marker expands to ARGB");
+    TEST_ASSERT(visualmem_get_pixel(&ctx, 29, 20) == VISUALMEM_COLOR_END, "End marker expands to ARGB");
+    uint32_t bit = visualmem_get_pixel(&ctx, 21, 20);
+    TEST_ASSERT(bit == VISUALMEM_COLOR_BIT_0 || bit == VISUALMEM_COLOR_BIT_1, "Bit pixels expand to ARGB");
+    
+    visualmem_enter_autonomous_mode(&ctx);
+    memset(read_data, 0, sizeof(read_data));
+    visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+    TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Indexed data persists after transition");
+    visualmem_display_contents(&ctx, &(visualmem_rect_t){ 18, 18, 40, 4 });
+    visualmem_cleanup(&ctx);
+    
+    // Encodings with arbitrary colors keep full pixels
+    visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, VISUALMEM_ENCODING_BINARY_FRAMED);
+    TEST_ASSERT(ctx.pixel_bits == 32 && ctx.framebuffer_size == (size_t)800 * 600 * 4, "Framed encodings keep 32-bit pixels");
+    visualmem_cleanup(&ctx);
+    
+    TEST_END();
+}
+
+static int test_sparse_framebuffer(void) {
+    TEST_START("Sparse Framebuffer Tiles");
+    
+    visualmem_context_t ctx;
+    int result = visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 1920, 1080);
+    TEST_ASSERT(result == VISUALMEM_SUCCESS, "Full HD context initialized");
+    
+    // Only the tile holding the encoded context header is materialized
+    size_t initial = ctx.resident_bytes;
+    printf("    Resident after init: %zu of %zu bytes\n", initial, ctx.framebuffer_size);
+    TEST_ASSERT(initial > 0 && initial <= ctx.framebuffer_size / 32, "Startup memory independent of resolution");
+    TEST_ASSERT(visualmem_get_pixel(&ctx, 1000, 1000) == VISUALMEM_COLOR_FREE, "Untouched tiles read as free");
+    
+    uint8_t test_data[2000];
+    uint8_t read_data[2000];
+    for (int i = 0; i < 2000; i++) {
+        test_data[i] = (uint8_t)(i * 11 + 1);
+    }
+    void* addr = visualmem_alloc(&ctx, sizeof(test_data), "sparse_data");
+    TEST_ASSERT(addr != NULL, "Allocation successful");
+    TEST_ASSERT(visualmem_write(&ctx, addr, test_data, sizeof(test_data)) == VISUALMEM_SUCCESS, "Write materializes tiles");
+    TEST_ASSERT(ctx.resident_bytes > initial && ctx.resident_bytes < ctx.framebuffer_size / 4,
+                "Resident memory follows stored data");
+    
+    // Tiles move to the framebuffer without copying
+    size_t before = ctx.resident_bytes;
+    visualmem_enter_autonomous_mode(&ctx);
+    TEST_ASSERT(ctx.resident_bytes == before, "Transition hands tiles over");
+    visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+    TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Sparse data persists after transition");
+    
+    visualmem_cleanup(&ctx);
+    TEST_ASSERT(ctx.resident_bytes == 0, "All tiles released");
+    TEST_END();
+}
+
+static int test_lazy_pixels(void) {
+    TEST_START("Lazy Pixel Materialization");
+    
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_PIXEL, 800, 600);
+    TEST_ASSERT(visualmem_set_lazy_pixels(&ctx, 1) == VISUALMEM_ERROR_INVALID_MODE, "Lazy pixels limited to simulate mode");
+    visualmem_cleanup(&ctx);
+    
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 1920, 1080);
+    TEST_ASSERT(visualmem_set_lazy_pixels(&ctx, 1) == VISUALMEM_SUCCESS, "Lazy pixels enabled");
+    
+    uint8_t test_data[4000];
+    uint8_t read_data[4000];
+    for (int i = 0; i < 4000; i++) {
+        test_data[i] = (uint8_t)(i * 17 + 9);
+    }
+    void* addr = visualmem_alloc(&ctx, sizeof(test_data), "lazy_data");
+    TEST_ASSERT(addr != NULL, "Allocation successful");
+    
+    // Writes only reach the raw store: no tile is materialized for them
+    size_t resident = ctx.resident_bytes;
+    visualmem_write(&ctx, addr, test_data, sizeof(test_data));
+    TEST_ASSERT(ctx.resident_bytes == resident, "Write defers pixel encoding");
+    visualmem_read(&ctx, addr, read_data, sizeof(read_data));
+    TEST_ASSERT(memcmp(test_data, read_data, sizeof(test_data)) == 0, "Stale range reads from raw store");
+    
+    // Observing a pixel encodes everything pending
+    TEST_ASSERT(visualmem_get_pixel(&ctx, 20, 20) == VISUALMEM_COLOR_START, "Pixel read materializes");
+    TEST_ASSERT(ctx.resident_bytes > resident, "Pending rows encoded");
+    
+    visualmem_write_string(&ctx, addr, "deferred");
+    visualmem_enter_autonomous_mode(&ctx);
+    TEST_ASSERT(ctx.raw_store == NULL, "Transition encodes and drops the raw store");
+    char text[16];
+    visualmem_read_string(&ctx, addr, text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "deferred") == 0, "Deferred data persists after transition");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_allocator_churn(void) {
+    TEST_START("Allocator Placement and Coalescing");
+    
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    
+    // Mixed sizes, each filled with its own pattern
+    enum { COUNT = 24 };
+    void* addrs[COUNT];
+    size_t sizes[COUNT];
+    uint8_t pattern[700];
+    uint8_t read_data[700];
+    for (int i = 0; i < COUNT; i++) {
+        sizes[i] = 17 + (size_t)(i * 97) % 600;
+        addrs[i] = visualmem_alloc(&ctx, sizes[i], "churn");
+        TEST_ASSERT(addrs[i] != NULL, "Allocation successful");
+        memset(pattern, 0x30 + i, sizes[i]);
+        visualmem_write(&ctx, addrs[i], pattern, sizes[i]);
+    }
+    
+    // No two live ranges overlap
+    int overlaps = 0;
+    for (int i = 0; i < COUNT; i++) {
+        for (int j = i + 1; j < COUNT; j++) {
+            size_t a = visualmem_get_allocation_info(&ctx, addrs[i])->byte_index;
+            size_t b = visualmem_get_allocation_info(&ctx, addrs[j])->byte_index;
+            if (a < b + sizes[j] && b < a + sizes[i]) overlaps++;
+        }
+    }
+    TEST_ASSERT(overlaps == 0, "Allocations never overlap");
+    
+    // Free every other block and refill the holes
+    for (int i = 0; i < COUNT; i += 2) {
+        visualmem_free(&ctx, addrs[i]);
+    }
+    for (int i = 0; i < COUNT; i += 2) {
+        addrs[i] = visualmem_alloc(&ctx, sizes[i], "refill");
+        TEST_ASSERT(addrs[i] != NULL, "Freed space reused");
+        memset(pattern, 0x80 + i, sizes[i]);
+        visualmem_write(&ctx, addrs[i], pattern, sizes[i]);
+    }
+    
+    int intact = 1;
+    for (int i = 0; i < COUNT; i++) {
+        memset(pattern, (i % 2 ? 0x30 : 0x80) + i, sizes[i]);
+        visualmem_read(&ctx, addrs[i], read_data, sizes[i]);
+        if (memcmp(pattern, read_data, sizes[i]) != 0) intact = 0;
+    }
+    TEST_ASSERT(intact, "Neighbouring data survives churn");
+    
+    // Once everything is freed, the buddies coalesce into large blocks again
+    for (int i = 0; i < COUNT; i++) {
+        visualmem_free(&ctx, addrs[i]);
+    }
+    void* big = visualmem_alloc(&ctx, ctx.capacity_bytes / 2 + 1, "big");
+    TEST_ASSERT(big != NULL, "Free space coalesces");
+    TEST_ASSERT(visualmem_alloc(&ctx, ctx.capacity_bytes, "too_big") == NULL, "Oversized request rejected");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_stale_handles(void) {
+    TEST_START("Stale Address Detection");
+    
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 640, 480);
+    
+    uint8_t data[16] = {0};
+    void* first = visualmem_alloc(&ctx, sizeof(data), "first");
+    TEST_ASSERT(first != NULL, "Allocation successful");
+    TEST_ASSERT(visualmem_free(&ctx, first) == VISUALMEM_SUCCESS, "Free successful");
+    
+    // The freed address no longer resolves
+    TEST_ASSERT(visualmem_get_allocation_info(&ctx, first) == NULL, "Freed address has no info");
+    TEST_ASSERT(visualmem_write(&ctx, first, data, sizeof(data)) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                "Write after free rejected");
+    TEST_ASSERT(visualmem_free(&ctx, first) == VISUALMEM_ERROR_INVALID_ADDRESS, "Double free rejected");
+    
+    // Reusing the slot hands out a different address; the old one stays dead
+    void* second = visualmem_alloc(&ctx, sizeof(data), "second");
+    TEST_ASSERT(second != NULL && second != first, "Reused slot gets a fresh address");
+    TEST_ASSERT(visualmem_read(&ctx, first, data, sizeof(data)) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                "Stale address cannot reach the new allocation");
+    TEST_ASSERT(visualmem_read(&ctx, second, data, sizeof(data)) == VISUALMEM_SUCCESS, "New address works");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_allocation_table_growth(void) {
+    TEST_START("Growable Allocation Table");
+    
+    visualmem_context_t ctx;
+    visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 1024, 768, VISUALMEM_ENCODING_DENSE_RGBA);
+    TEST_ASSERT(ctx.allocations.capacity == 0, "Table starts empty");
+    
+    // Well past the old fixed limit of 1024 slots
+    enum { COUNT = 5000 };
+    static void* addrs[COUNT];
+    int allocated = 0;
+    for (int i = 0; i < COUNT; i++) {
+        addrs[i] = visualmem_alloc(&ctx, 16, "entry");
+        if (addrs[i]) allocated++;
+    }
+    TEST_ASSERT(allocated == COUNT, "Every allocation gets a slot");
+    TEST_ASSERT(ctx.allocations.capacity >= COUNT, "Table grew on demand");
+    
+    uint32_t first = 0xCAFE0001, last = 0xCAFE1388, value = 0;
+    visualmem_write(&ctx, addrs[0], &first, sizeof(first));
+    visualmem_write(&ctx, addrs[COUNT - 1], &last, sizeof(last));
+    visualmem_read(&ctx, addrs[0], &value, sizeof(value));
+    TEST_ASSERT(value == first, "First allocation intact");
+    visualmem_read(&ctx, addrs[COUNT - 1], &value, sizeof(value));
+    TEST_ASSERT(value == last, "Last allocation intact");
+    
+    visualmem_cleanup(&ctx);
+    TEST_ASSERT(ctx.allocations.capacity == 0, "Table released on cleanup");
+    TEST_END();
+}
+
+static int count_allocations(visualmem_context_t* ctx, size_t size, const char* label) {
+    int count = 0;
+    while (visualmem_alloc(ctx, size, label)) count++;
+    return count;
+}
+
+static int test_slab_allocations(void) {
+    TEST_START("Small Object Slabs");
+    
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    
+    // Unlabelled small objects never touch the allocation table
+    enum { COUNT = 100 };
+    void* addrs[COUNT];
+    uint8_t pattern[24], read_data[24];
+    int allocated = 0;
+    for (int i = 0; i < COUNT; i++) {
+        addrs[i] = visualmem_alloc(&ctx, sizeof(pattern), NULL);
+        if (!addrs[i]) continue;
+        allocated++;
+        memset(pattern, i, sizeof(pattern));
+        visualmem_write(&ctx, addrs[i], pattern, sizeof(pattern));
+    }
+    TEST_ASSERT(allocated == COUNT, "Small allocations successful");
+    TEST_ASSERT(ctx.allocations.capacity == 0, "No allocation records used");
+    
+    int intact = 1;
+    for (int i = 0; i < COUNT; i++) {
+        memset(pattern, i, sizeof(pattern));
+        visualmem_read(&ctx, addrs[i], read_data, sizeof(read_data));
+        if (memcmp(pattern, read_data, sizeof(pattern)) != 0) intact = 0;
+    }
+    TEST_ASSERT(intact, "Packed neighbours stay intact");
+    
+    const visualmem_allocation_t* info = visualmem_get_allocation_info(&ctx, addrs[5]);
+    TEST_ASSERT(info && info->size == sizeof(pattern), "Slab object reports its size");
+    TEST_ASSERT(visualmem_write(&ctx, addrs[5], pattern, sizeof(pattern) + 1) == VISUALMEM_ERROR_INVALID_SIZE,
+                "Writes bounded by the requested size");
+    
+    visualmem_free(&ctx, addrs[5]);
+    TEST_ASSERT(visualmem_read(&ctx, addrs[5], read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                "Freed slab object rejected");
+    
+    // Emptied slabs go back to the allocator and coalesce
+    for (int i = 0; i < COUNT; i++) {
+        if (i != 5) visualmem_free(&ctx, addrs[i]);
+    }
+    TEST_ASSERT(ctx.total_allocated == 0, "All bytes returned");
+    TEST_ASSERT(visualmem_alloc(&ctx, ctx.capacity_bytes / 2 + 1, "big") != NULL, "Slab blocks coalesce");
+    visualmem_cleanup(&ctx);
+    
+    // One object reused far past 256 times never revives an old handle; the
+    // keeper holds the slab so the freed object comes straight back
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    void* keeper = visualmem_alloc(&ctx, 24, NULL);
+    void* first = visualmem_alloc(&ctx, 24, NULL);
+    visualmem_free(&ctx, first);
+    int distinct = 1;
+    for (int cycle = 0; cycle < 1000; cycle++) {
+        void* again = visualmem_alloc(&ctx, 24, NULL);
+        distinct &= again != NULL && again != first &&
+            visualmem_read(&ctx, first, read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS;
+        visualmem_free(&ctx, again);
+    }
+    TEST_ASSERT(distinct, "Stale slab handle rejected after 1000 reuses");
+    
+    // An object whose handle generation would wrap is retired for good
+    visualmem_slab_t* slab = &ctx.slabs.slabs[0];
+    slab->generation[1] = sizeof(uintptr_t) == 8 ? UINT32_MAX : UINT16_MAX;
+    void* last = visualmem_alloc(&ctx, 24, NULL);
+    visualmem_free(&ctx, last);
+    void* next = visualmem_alloc(&ctx, 24, NULL);
+    TEST_ASSERT((slab->retired_mask & 2) && next != NULL &&
+                visualmem_read(&ctx, first, read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                "Wrapped object retired, its first handle stays stale");
+    visualmem_free(&ctx, next);
+    visualmem_free(&ctx, keeper);
+    TEST_ASSERT(ctx.total_allocated == 0, "Slab with a retired object still empties");
+    visualmem_cleanup(&ctx);
+    
+    // Packing beats one allocator block per object
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    int labelled = count_allocations(&ctx, 16, "record");
+    visualmem_cleanup(&ctx);
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    int packed = count_allocations(&ctx, 16, NULL);
+    visualmem_cleanup(&ctx);
+    printf("  16-byte objects: %d with records, %d in slabs\n", labelled, packed);
+    TEST_ASSERT(packed >= 2 * labelled - VISUALMEM_SLAB_OBJECTS, "Slabs hold more small objects");
+    
+    TEST_END();
+}
+
+static int test_defragmentation(void) {
+    TEST_START("Incremental Defragmentation");
+    
+    visualmem_context_t ctx;
+    visualmem_init(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600);
+    
+    // A slab object plus records filling the whole payload area
+    uint8_t pattern[64], read_data[64];
+    void* small = visualmem_alloc(&ctx, 16, NULL);
+    memset(pattern, 0xA5, 16);
+    visualmem_write(&ctx, small, pattern, 16);
+    
+    enum { MAX_RECORDS = 1024 };
+    static void* addrs[MAX_RECORDS];
+    int count = 0;
+    while (count < MAX_RECORDS && (addrs[count] = visualmem_alloc(&ctx, sizeof(pattern), "record"))) {
+        memset(pattern, count, sizeof(pattern));
+        visualmem_write(&ctx, addrs[count], pattern, sizeof(pattern));
+        count++;
+    }
+    TEST_ASSERT(count > 100 && count < MAX_RECORDS, "Payload area filled");
+    
+    // Free every other record: plenty of space, but all of it in holes
+    void* stale = addrs[0];
+    for (int i = 0; i < count; i += 2) {
+        visualmem_free(&ctx, addrs[i]);
+        addrs[i] = NULL;
+    }
+    int before, after;
+    visualmem_get_stats(&ctx, NULL, NULL, &before);
+    TEST_ASSERT(visualmem_alloc(&ctx, 2 * sizeof(pattern), "wide") == NULL, "Fragmented space refuses a wider block");
+    
+    // Compact in small slices
+    size_t moved;
+    int steps = 0, result;
+    do {
+        result = visualmem_defragment_step(&ctx, 256, &moved);
+        steps++;
+    } while (result == VISUALMEM_SUCCESS && moved > 0);
+    TEST_ASSERT(result == VISUALMEM_SUCCESS, "Steps successful");
+    visualmem_get_stats(&ctx, NULL, NULL, &after);
+    printf("  Fragmentation: %d%% before, %d%% after %d steps\n", before, after, steps);
+    TEST_ASSERT(steps > 2, "Work split across slices");
+    TEST_ASSERT(before >= 90 && after < 10, "Free space gathered");
+    TEST_ASSERT(visualmem_defragment(&ctx) == VISUALMEM_SUCCESS, "Compact memory stays put");
+    
+    // Caller-held addresses still reach their data
+    int intact = 1;
+    for (int i = 1; i < count; i += 2) {
+        memset(pattern, i, sizeof(pattern));
+        if (visualmem_read(&ctx, addrs[i], read_data, sizeof(read_data)) != VISUALMEM_SUCCESS ||
+            memcmp(pattern, read_data, sizeof(pattern)) != 0) {
+            intact = 0;
+        }
+    }
+    TEST_ASSERT(intact, "Moved records intact behind their addresses");
+    memset(pattern, 0xA5, 16);
+    visualmem_read(&ctx, small, read_data, 16);
+    TEST_ASSERT(memcmp(pattern, read_data, 16) == 0, "Moved slab intact");
+    TEST_ASSERT(visualmem_read(&ctx, stale, read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                "Freed address stays stale");
+    TEST_ASSERT(visualmem_alloc(&ctx, 16 * sizeof(pattern), "wide") != NULL,
+                "Recovered space takes a wide block");
+    
+    visualmem_cleanup(&ctx);
+    TEST_END();
+}
+
+static int test_realloc(void) {
+    TEST_START("Reallocation");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGB,
+        VISUALMEM_ENCODING_PALETTE_4BPP, VISUALMEM_ENCODING_BINARY_FRAMED
+    };
+    uint8_t pattern[300], read_data[300];
+    for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)(i * 7 + 3);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        // First block of a fresh context: its buddies above are free
+        void* record = visualmem_alloc(&ctx, 40, "record");
+        visualmem_write(&ctx, record, pattern, 40);
+        size_t home = visualmem_get_allocation_info(&ctx, record)->byte_index;
+        TEST_ASSERT(visualmem_realloc(&ctx, record, 120) == record, "Grow keeps the address");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, record)->byte_index == home, "Grown in place");
+        
+        // A neighbour blocks in-place growth: the pixels move instead
+        void* neighbour = visualmem_alloc(&ctx, 100, "neighbour");
+        visualmem_write(&ctx, neighbour, pattern + 100, 100);
+        visualmem_write(&ctx, record, pattern, 120);
+        TEST_ASSERT(visualmem_realloc(&ctx, record, 300) == record, "Moved allocation keeps the address");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, record)->byte_index != home, "Grown by moving");
+        visualmem_read(&ctx, record, read_data, 120);
+        TEST_ASSERT(memcmp(read_data, pattern, 120) == 0, "Moved data intact");
+        visualmem_read(&ctx, neighbour, read_data, 100);
+        TEST_ASSERT(memcmp(read_data, pattern + 100, 100) == 0, "Neighbour untouched");
+        
+        TEST_ASSERT(visualmem_realloc(&ctx, record, 50) == record, "Shrink in place");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, record)->size == 50, "Shrunk size reported");
+        TEST_ASSERT(ctx.total_allocated == 150, "Statistics follow the new sizes");
+        
+        // Small objects resize within their slab, then move out of it
+        void* small = visualmem_alloc(&ctx, 20, NULL);
+        visualmem_write(&ctx, small, pattern, 20);
+        TEST_ASSERT(visualmem_realloc(&ctx, small, 30) == small, "Small object grows in its slab");
+        void* grown = visualmem_realloc(&ctx, small, 200);
+        TEST_ASSERT(grown != NULL && grown != small, "Small object moves when it outgrows the slab");
+        visualmem_read(&ctx, grown, read_data, 20);
+        TEST_ASSERT(memcmp(read_data, pattern, 20) == 0, "Small object data moved");
+        TEST_ASSERT(visualmem_read(&ctx, small, read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                    "Old small address released");
+        
+        TEST_ASSERT(visualmem_realloc(&ctx, grown, ctx.capacity_bytes) == NULL, "Oversized request fails");
+        visualmem_read(&ctx, grown, read_data, 20);
+        TEST_ASSERT(memcmp(read_data, pattern, 20) == 0, "Failed realloc leaves data alone");
+        TEST_ASSERT(visualmem_realloc(&ctx, grown, 0) == NULL && ctx.allocation_count == 2, "Zero size frees");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_copy_and_set(void) {
+    TEST_START("Pixel-Domain Copy and Set");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGB, VISUALMEM_ENCODING_DENSE_RGBA,
+        VISUALMEM_ENCODING_PALETTE_2BPP, VISUALMEM_ENCODING_BINARY_FRAMED
+    };
+    uint8_t pattern[300], expected[300], read_data[300];
+    for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)(i * 13 + 1);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        void* source = visualmem_alloc(&ctx, sizeof(pattern), "source");
+        void* dest = visualmem_alloc(&ctx, sizeof(pattern), "dest");
+        void* small[3];
+        for (int i = 0; i < 3; i++) {
+            small[i] = visualmem_alloc(&ctx, 5, NULL);
+            visualmem_write(&ctx, small[i], pattern, 5);
+        }
+        visualmem_write(&ctx, source, pattern, sizeof(pattern));
+        
+        TEST_ASSERT(visualmem_copy(&ctx, dest, source, sizeof(pattern)) == VISUALMEM_SUCCESS, "Copy successful");
+        visualmem_read(&ctx, dest, read_data, sizeof(read_data));
+        TEST_ASSERT(memcmp(read_data, pattern, sizeof(pattern)) == 0, "Copied data matches");
+        TEST_ASSERT(visualmem_copy(&ctx, dest, dest, 10) == VISUALMEM_SUCCESS, "Copy onto itself");
+        TEST_ASSERT(visualmem_copy(&ctx, small[0], source, 6) == VISUALMEM_ERROR_INVALID_SIZE,
+                    "Copy bounded by the destination");
+        
+        TEST_ASSERT(visualmem_set(&ctx, source, 0x5A, 151) == VISUALMEM_SUCCESS, "Set successful");
+        memcpy(expected, pattern, sizeof(expected));
+        memset(expected, 0x5A, 151);
+        visualmem_read(&ctx, source, read_data, sizeof(read_data));
+        TEST_ASSERT(memcmp(read_data, expected, sizeof(expected)) == 0, "Set range filled, tail kept");
+        
+        // Unaligned objects sharing dense pixels keep their neighbours
+        visualmem_set(&ctx, small[1], 0xC3, 5);
+        visualmem_read(&ctx, small[0], read_data, 5);
+        int neighbours = memcmp(read_data, pattern, 5) == 0;
+        visualmem_read(&ctx, small[2], read_data, 5);
+        neighbours = neighbours && memcmp(read_data, pattern, 5) == 0;
+        visualmem_read(&ctx, small[1], read_data, 5);
+        TEST_ASSERT(neighbours && read_data[0] == 0xC3 && read_data[4] == 0xC3, "Small set leaves neighbours");
+        
+        // Both work on the framebuffer alone
+        visualmem_enter_autonomous_mode(&ctx);
+        TEST_ASSERT(visualmem_copy(&ctx, source, dest, sizeof(pattern)) == VISUALMEM_SUCCESS &&
+                    visualmem_set(&ctx, dest, 0x00, 20) == VISUALMEM_SUCCESS, "Copy and set in autonomous mode");
+        visualmem_read(&ctx, source, read_data, sizeof(read_data));
+        TEST_ASSERT(memcmp(read_data, pattern, sizeof(pattern)) == 0, "Autonomous copy matches");
+        visualmem_read(&ctx, dest, read_data, 21);
+        TEST_ASSERT(read_data[19] == 0 && read_data[20] == pattern[20], "Autonomous set matches");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_arenas(void) {
+    TEST_START("Arena Allocation");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGB, VISUALMEM_ENCODING_PALETTE_4BPP
+    };
+    uint8_t pattern[64], read_data[64];
+    for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)(i * 5 + 9);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        void* spacer = visualmem_alloc(&ctx, 1024, "spacer");
+        void* arena = visualmem_arena_create(&ctx, 2048);
+        TEST_ASSERT(arena != NULL && ctx.allocation_count == 2 && ctx.total_allocated == 3072,
+                    "Arena created and counted once");
+        
+        // Bump allocations until the arena is full
+        void* blocks[64];
+        int count = 0;
+        while (count < 64 && (blocks[count] = visualmem_arena_alloc(&ctx, arena, 40)) != NULL) {
+            visualmem_write(&ctx, blocks[count], pattern + (count % 24), 40);
+            count++;
+        }
+        TEST_ASSERT(count == 2048 / (40 + VISUALMEM_ARENA_HEADER), "Arena filled by bumping");
+        int intact = 1;
+        for (int i = 0; i < count; i++) {
+            visualmem_read(&ctx, blocks[i], read_data, 40);
+            if (memcmp(read_data, pattern + (i % 24), 40) != 0) intact = 0;
+        }
+        TEST_ASSERT(intact, "Arena allocations keep their data");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, blocks[3])->size == 40, "Size read from the arena");
+        TEST_ASSERT(visualmem_free(&ctx, blocks[0]) == VISUALMEM_ERROR_INVALID_ADDRESS &&
+                    visualmem_free(&ctx, arena) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                    "Arena memory is not freed one by one");
+        
+        // The last allocation grows in place, others are copied to the top
+        TEST_ASSERT(visualmem_arena_reset(&ctx, arena) == VISUALMEM_SUCCESS, "Arena reset");
+        TEST_ASSERT(visualmem_read(&ctx, blocks[0], read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                    "Reset retires every allocation");
+        void* first = visualmem_arena_alloc(&ctx, arena, 10);
+        visualmem_read(&ctx, first, read_data, 10);
+        int zero = 1;
+        for (int i = 0; i < 10; i++) if (read_data[i]) zero = 0;
+        TEST_ASSERT(zero, "Bytes reused after reset read as zero");
+        visualmem_write(&ctx, first, pattern, 10);
+        TEST_ASSERT(visualmem_realloc(&ctx, first, 30) == first, "Last allocation grows in place");
+        visualmem_read(&ctx, first, read_data, 30);
+        for (int i = 10; i < 30; i++) if (read_data[i]) zero = 0;
+        TEST_ASSERT(zero, "Grown bytes read as zero");
+        void* second = visualmem_arena_alloc(&ctx, arena, 8);
+        void* moved = visualmem_realloc(&ctx, first, 50);
+        visualmem_read(&ctx, moved, read_data, 10);
+        TEST_ASSERT(moved != NULL && moved != first && memcmp(read_data, pattern, 10) == 0,
+                    "Inner allocation grows by copying");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, second)->size == 8, "Neighbour untouched");
+        
+        // Compaction moves the arena; its addresses follow
+        visualmem_write(&ctx, moved, pattern, 50);
+        visualmem_free(&ctx, spacer);
+        visualmem_defragment(&ctx);
+        visualmem_read(&ctx, moved, read_data, 50);
+        TEST_ASSERT(memcmp(read_data, pattern, 50) == 0, "Arena data moved by defragmentation");
+        
+        TEST_ASSERT(visualmem_arena_destroy(&ctx, arena) == VISUALMEM_SUCCESS, "Arena destroyed");
+        TEST_ASSERT(visualmem_arena_alloc(&ctx, arena, 4) == NULL &&
+                    visualmem_read(&ctx, moved, read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS &&
+                    visualmem_arena_destroy(&ctx, arena) == VISUALMEM_ERROR_INVALID_ADDRESS,
+                    "Destroy retires the arena and its allocations");
+        TEST_ASSERT(ctx.allocation_count == 0 && ctx.total_allocated == 0, "Statistics released");
+        
+        // Reused space reads as zero
+        void* after = visualmem_alloc(&ctx, 64, "after");
+        visualmem_read(&ctx, after, read_data, 64);
+        zero = 1;
+        for (int i = 0; i < 64; i++) if (read_data[i]) zero = 0;
+        TEST_ASSERT(zero, "Destroyed arena leaves cleared pixels");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_deferred_clearing(void) {
+    TEST_START("Deferred Clearing");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGB, VISUALMEM_ENCODING_PALETTE_2BPP
+    };
+    uint8_t pattern[1000], read_data[1000];
+    for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)(i * 3 + 1);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        // Free only marks the block; reuse hands it out zeroed
+        void* first = visualmem_alloc(&ctx, sizeof(pattern), "first");
+        visualmem_write(&ctx, first, pattern, sizeof(pattern));
+        size_t home = visualmem_get_allocation_info(&ctx, first)->byte_index;
+        TEST_ASSERT(visualmem_free(&ctx, first) == VISUALMEM_SUCCESS && ctx.buddy.dirty_units > 0,
+                    "Free defers clearing");
+        void* reuse = visualmem_alloc(&ctx, 600, "reuse");
+        TEST_ASSERT(visualmem_get_allocation_info(&ctx, reuse)->byte_index == home, "Block reused");
+        visualmem_read(&ctx, reuse, read_data, 600);
+        int zero = 1;
+        for (int i = 0; i < 600; i++) if (read_data[i]) zero = 0;
+        TEST_ASSERT(zero, "Reused block reads as zero");
+        
+        // Growing in place claims the dirty tail too
+        visualmem_write(&ctx, reuse, pattern, 600);
+        TEST_ASSERT(visualmem_realloc(&ctx, reuse, 1000) == reuse, "Grown over the dirty tail");
+        visualmem_read(&ctx, reuse, read_data, 1000);
+        zero = memcmp(read_data, pattern, 600) == 0;
+        for (int i = 600; i < 1000; i++) if (read_data[i]) zero = 0;
+        TEST_ASSERT(zero, "Grown bytes read as zero");
+        
+        // The scrubber clears ahead of reuse in bounded slices
+        visualmem_free(&ctx, reuse);
+        size_t cleared, total = 0, widest = 0;
+        int slices = 0;
+        do {
+            visualmem_scrub(&ctx, 256, &cleared);
+            if (cleared > widest) widest = cleared;
+            total += cleared;
+            slices++;
+        } while (cleared > 0 && slices < 100);
+        TEST_ASSERT(widest <= 256, "Scrub slices within budget");
+        TEST_ASSERT(ctx.buddy.dirty_units == 0 && total >= sizeof(pattern) && slices > 2,
+                    "Scrubber drains dirty blocks");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_offset_access(void) {
+    TEST_START("Offset Reads and Writes");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGB,
+        VISUALMEM_ENCODING_PALETTE_4BPP, VISUALMEM_ENCODING_BINARY_FRAMED
+    };
+    uint8_t record[4096], read_data[4096];
+    for (size_t i = 0; i < sizeof(record); i++) record[i] = (uint8_t)(i * 11 + 5);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        void* large = visualmem_alloc(&ctx, sizeof(record), "record");
+        visualmem_write(&ctx, large, record, sizeof(record));
+        
+        // Update one field in the middle, then read it back on its own
+        const uint8_t field[7] = { 1, 2, 3, 4, 5, 6, 7 };
+        TEST_ASSERT(visualmem_pwrite(&ctx, large, 3001, field, sizeof(field)) == VISUALMEM_SUCCESS,
+                    "Write at offset");
+        memcpy(record + 3001, field, sizeof(field));
+        TEST_ASSERT(visualmem_pread(&ctx, large, 2999, read_data, 11) == VISUALMEM_SUCCESS &&
+                    memcmp(read_data, record + 2999, 11) == 0, "Read at offset");
+        visualmem_read(&ctx, large, read_data, sizeof(record));
+        TEST_ASSERT(memcmp(read_data, record, sizeof(record)) == 0, "Surrounding bytes kept");
+        
+        // Bounds are those of the allocation
+        TEST_ASSERT(visualmem_pwrite(&ctx, large, sizeof(record) - 1, field, 1) == VISUALMEM_SUCCESS &&
+                    visualmem_pread(&ctx, large, sizeof(record) - 1, read_data, 1) == VISUALMEM_SUCCESS &&
+                    read_data[0] == field[0], "Last byte reachable");
+        TEST_ASSERT(visualmem_pwrite(&ctx, large, sizeof(record) - 3, field, 4) == VISUALMEM_ERROR_INVALID_SIZE &&
+                    visualmem_pread(&ctx, large, sizeof(record) + 1, read_data, 1) == VISUALMEM_ERROR_INVALID_SIZE &&
+                    visualmem_pread(&ctx, large, (size_t)-1, read_data, 2) == VISUALMEM_ERROR_INVALID_SIZE,
+                    "Past the end rejected");
+        
+        // Slab objects and arena allocations take offsets too
+        void* small = visualmem_alloc(&ctx, 24, NULL);
+        void* arena = visualmem_arena_create(&ctx, 256);
+        void* bumped = visualmem_arena_alloc(&ctx, arena, 24);
+        TEST_ASSERT(visualmem_pwrite(&ctx, small, 17, field, sizeof(field)) == VISUALMEM_SUCCESS &&
+                    visualmem_pwrite(&ctx, bumped, 17, field, sizeof(field)) == VISUALMEM_SUCCESS,
+                    "Small and arena writes at offset");
+        visualmem_pread(&ctx, small, 17, read_data, sizeof(field));
+        int fields = memcmp(read_data, field, sizeof(field)) == 0;
+        visualmem_pread(&ctx, bumped, 17, read_data, sizeof(field));
+        fields = fields && memcmp(read_data, field, sizeof(field)) == 0;
+        TEST_ASSERT(fields && visualmem_pwrite(&ctx, small, 18, field, sizeof(field)) == VISUALMEM_ERROR_INVALID_SIZE,
+                    "Small and arena reads at offset");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+static int test_batched_operations(void) {
+    TEST_START("Vectored and Batched Operations");
+    
+    const visualmem_encoding_t encodings[] = {
+        VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGBA, VISUALMEM_ENCODING_PALETTE_2BPP
+    };
+    uint8_t source[2048], read_data[2048];
+    for (size_t i = 0; i < sizeof(source); i++) source[i] = (uint8_t)(i * 13 + 1);
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        
+        // Mixed table and slab blocks come back in the caller's order
+        const size_t sizes[] = { 16, 2048, 40, 700 };
+        const char* const labels[] = { NULL, "frame", NULL, "index" };
+        void* blocks[4];
+        TEST_ASSERT(visualmem_alloc_batch(&ctx, sizes, labels, 4, blocks) == VISUALMEM_SUCCESS &&
+                    blocks[0] && blocks[1] && blocks[2] && blocks[3], "Batch allocation");
+        const visualmem_allocation_t* info = visualmem_get_allocation_info(&ctx, blocks[3]);
+        TEST_ASSERT(info && info->size == 700 && strcmp(info->label, "index") == 0, "Batch sizes and labels");
+        
+        // Out-of-order pieces of one block merge into a single run
+        visualmem_iovec_t pieces[] = {
+            { blocks[1], 1024, source + 1024, 1024 }, { blocks[0], 0, source, 16 },
+            { blocks[1], 0, source, 512 }, { blocks[1], 512, source + 512, 512 },
+            { blocks[3], 100, source + 100, 50 }
+        };
+        TEST_ASSERT(visualmem_writev(&ctx, pieces, 5) == VISUALMEM_SUCCESS, "Vectored write");
+        visualmem_read(&ctx, blocks[1], read_data, 2048);
+        int matches = memcmp(read_data, source, 2048) == 0;
+        visualmem_pread(&ctx, blocks[3], 100, read_data, 50);
+        TEST_ASSERT(matches && memcmp(read_data, source + 100, 50) == 0, "Vectored write contents");
+        
+        uint8_t head[16], middle[600], tail[16];
+        visualmem_iovec_t reads[] = {
+            { blocks[1], 1000, middle, 600 }, { blocks[0], 0, head, 16 }, { blocks[1], 1600, tail, 16 }
+        };
+        TEST_ASSERT(visualmem_readv(&ctx, reads, 3) == VISUALMEM_SUCCESS &&
+                    memcmp(head, source, 16) == 0 && memcmp(middle, source + 1000, 600) == 0 &&
+                    memcmp(tail, source + 1600, 16) == 0, "Vectored read");
+        
+        // A bad entry rejects the whole vector before anything is written
+        const uint8_t zeros[16] = { 0 };
+        visualmem_iovec_t overlap[] = { { blocks[0], 0, (void*)zeros, 8 }, { blocks[0], 4, (void*)zeros, 8 } };
+        visualmem_iovec_t past_end[] = { { blocks[0], 0, (void*)zeros, 8 }, { blocks[2], 36, (void*)zeros, 8 } };
+        TEST_ASSERT(visualmem_writev(&ctx, overlap, 2) == VISUALMEM_ERROR_INVALID_ADDRESS &&
+                    visualmem_writev(&ctx, past_end, 2) == VISUALMEM_ERROR_INVALID_SIZE, "Bad vectors rejected");
+        visualmem_read(&ctx, blocks[0], read_data, 16);
+        TEST_ASSERT(memcmp(read_data, source, 16) == 0, "Rejected vector left memory untouched");
+        
+        // Freeing is all or nothing too
+        void* repeated[] = { blocks[0], blocks[2], blocks[0] };
+        TEST_ASSERT(visualmem_free_batch(&ctx, repeated, 3) == VISUALMEM_ERROR_INVALID_ADDRESS &&
+                    visualmem_read(&ctx, blocks[2], read_data, 40) == VISUALMEM_SUCCESS, "Repeated address rejected");
+        TEST_ASSERT(visualmem_free_batch(&ctx, blocks, 4) == VISUALMEM_SUCCESS && ctx.allocation_count == 0 &&
+                    visualmem_read(&ctx, blocks[1], read_data, 1) == VISUALMEM_ERROR_INVALID_ADDRESS, "Batch free");
+        
+        // A batch that cannot fit hands out nothing
+        const size_t too_big[] = { 64, visualmem_get_capacity(&ctx), 64 };
+        void* none[3];
+        TEST_ASSERT(visualmem_alloc_batch(&ctx, too_big, NULL, 3, none) == VISUALMEM_ERROR_OUT_OF_MEMORY &&
+                    !none[0] && !none[1] && !none[2] && ctx.allocation_count == 0, "Failed batch rolled back");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
+typedef struct {
+    visualmem_context_t* ctx;
+    void* block;
+    void** probes;          // Handles the churn thread frees and reuses
+    uint8_t seed;
+    int failures;
+} thread_safe_worker_t;
+
+static void* thread_safe_worker(void* arg) {
+    thread_safe_worker_t* worker = (thread_safe_worker_t*)arg;
+    uint8_t pattern[256], read_data[256];
+    
+    for (int round = 0; round < 200; round++) {
+        for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)(worker->seed + round + i);
+        size_t offset = (size_t)(round % 4) * 256;
+        if (visualmem_pwrite(worker->ctx, worker->block, offset, pattern, 256) != VISUALMEM_SUCCESS ||
+            visualmem_pread(worker->ctx, worker->block, offset, read_data, 256) != VISUALMEM_SUCCESS ||
+            memcmp(read_data, pattern, 256) != 0) {
+            worker->failures++;
+        }
+        
+        // Live or stale, a churned handle must resolve cleanly either way.
+        // The offset is past any allocation, so the call stops after the
+        // lookup: the churn thread may reuse the bytes of a stale handle
+        void* probe = __atomic_load_n(&worker->probes[round % 65], __ATOMIC_RELAXED);
+        if (probe) visualmem_pread(worker->ctx, probe, SIZE_MAX, read_data, 1);
+    }
+    return NULL;
+}
+
+static int test_thread_safe_mode(void) {
+    TEST_START("Thread-Safe Mode");
+    
+    const visualmem_encoding_t encodings[] = { VISUALMEM_ENCODING_BINARY, VISUALMEM_ENCODING_DENSE_RGBA };
+    
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        visualmem_context_t ctx;
+        visualmem_init_with_encoding(&ctx, VISUALMEM_MODE_SIMULATE, 800, 600, encodings[e]);
+        TEST_ASSERT(visualmem_set_thread_safe(&ctx, 1) == VISUALMEM_SUCCESS, "Thread-safe mode enabled");
+        
+        // Readers and writers of their own blocks run while another thread
+        // grows, shrinks and recycles the allocator underneath them
+        thread_safe_worker_t workers[4];
+        pthread_t threads[4];
+        void* probes[65] = { NULL };  // Churned blocks, then the latest arena allocation
+        for (int t = 0; t < 4; t++) {
+            workers[t].ctx = &ctx;
+            workers[t].probes = probes;
+            workers[t].block = visualmem_alloc(&ctx, 1024, "worker");
+            workers[t].seed = (uint8_t)(t * 61);
+            workers[t].failures = 0;
+        }
+        void* arena = visualmem_arena_create(&ctx, 2048);
+        for (int t = 0; t < 4; t++) pthread_create(&threads[t], NULL, thread_safe_worker, &workers[t]);
+        
+        void* churn[64] = { NULL };
+        int churn_ok = 1;
+        for (int round = 0; round < 400; round++) {
+            int slot = (round * 7) % 64;
+            if (churn[slot]) {
+                if (round % 3 == 0) {
+                    void* moved = visualmem_realloc(&ctx, churn[slot], 48 + (size_t)(round % 5) * 300);
+                    if (moved) churn[slot] = moved;
+                } else {
+                    churn_ok &= visualmem_free(&ctx, churn[slot]) == VISUALMEM_SUCCESS;
+                    churn[slot] = NULL;
+                }
+            } else {
+                churn[slot] = visualmem_alloc(&ctx, 24 + (size_t)(round % 9) * 120, NULL);
+            }
+            if (churn[slot]) __atomic_store_n(&probes[slot], churn[slot], __ATOMIC_RELAXED);
+            
+            // Resets retire the arena's allocation handles under the readers
+            if (round % 10 == 0) visualmem_arena_reset(&ctx, arena);
+            void* bumped = visualmem_arena_alloc(&ctx, arena, 64);
+            if (bumped) __atomic_store_n(&probes[64], bumped, __ATOMIC_RELAXED);
+        }
+        for (int t = 0; t < 4; t++) pthread_join(threads[t], NULL);
+        
+        int failures = 0;
+        for (int t = 0; t < 4; t++) failures += workers[t].failures;
+        TEST_ASSERT(churn_ok && failures == 0, "Concurrent access while the allocator churns");
+        
+        for (int slot = 0; slot < 64; slot++) {
+            if (churn[slot]) visualmem_free(&ctx, churn[slot]);
+        }
+        for (int t = 0; t < 4; t++) visualmem_free(&ctx, workers[t].block);
+        visualmem_arena_destroy(&ctx, arena);
+        TEST_ASSERT(ctx.allocation_count == 0, "All blocks released");
+        
+        TEST_ASSERT(visualmem_set_thread_safe(&ctx, 0) == VISUALMEM_SUCCESS, "Thread-safe mode disabled");
+        void* after = visualmem_alloc(&ctx, 64, NULL);
+        TEST_ASSERT(after && visualmem_free(&ctx, after) == VISUALMEM_SUCCESS, "Single-threaded use afterwards");
+        
+        visualmem_cleanup(&ctx);
+    }
+    
+    TEST_END();
+}
+
 // === MAIN TEST RUNNER ===
 int main(void) {
     print_test_header();
@@ -473,6 +1581,26 @@ int main(void) {
     test_autonomous_operations();
     test_error_conditions();
     test_visual_display();
+    test_dense_encoding();
+    test_codec_kernels();
+    test_row_spans();
+    test_palette_encoding();
+    test_framed_binary();
+    test_indexed_framebuffer();
+    test_sparse_framebuffer();
+    test_lazy_pixels();
+    test_allocator_churn();
+    test_stale_handles();
+    test_allocation_table_growth();
+    test_slab_allocations();
+    test_defragmentation();
+    test_realloc();
+    test_copy_and_set();
+    test_arenas();
+    test_deferred_clearing();
+    test_offset_access();
+    test_batched_operations();
+    test_thread_safe_mode();
     
     clock_t end_time = clock();
     double test_duration = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
@@ -499,7 +1627,27 @@ int main(void) {
         printf("✅ Complex data structure handling\n");
         printf("✅ Operations in fully autonomous mode\n");
         printf("✅ Error handling and edge cases\n");
-        printf("✅ Visual memory display and debugging\n\n");
+        printf("✅ Visual memory display and debugging\n");
+        printf("✅ Dense RGB/RGBA payload encoding\n");
+        printf("✅ Bulk codec kernels with runtime dispatch\n");
+        printf("✅ Row-span partial writes\n");
+        printf("✅ Palette encodings (2/4/8 bits per pixel)\n");
+        printf("✅ Block-framed binary encoding\n");
+        printf("✅ Indexed simulate framebuffer\n");
+        printf("✅ Sparse framebuffer tiles\n");
+        printf("✅ Lazy pixel materialization\n");
+        printf("✅ Non-overlapping allocator with coalescing\n");
+        printf("✅ Stale address detection\n");
+        printf("✅ Growable allocation table\n");
+        printf("✅ Small object slabs\n");
+        printf("✅ Incremental defragmentation\n");
+        printf("✅ Reallocation in place and by pixel copy\n");
+        printf("✅ Pixel-domain copy and set\n");
+        printf("✅ Arenas with O(1) reset\n");
+        printf("✅ Deferred clearing of freed blocks\n");
+        printf("✅ Offset reads and writes\n");
+        printf("✅ Vectored and batched operations\n");
+        printf("✅ Thread-safe mode with lock-free lookups\n\n");
         
         printf("CONCLUSION:\n");
         printf("LibVisualMem is FULLY FUNCTIONAL and ready for production use.\n");
@@ -0,0 +1,1007 @@
+/**
+ * LibVisualMem v2.0 - Test Suite
+ * ==============================
+ *
+ * Validates the v2 core (encodings, layouts, allocators, data paths)
+ * against an in-memory display backend, so it runs without X11 or Xvfb.
+ * Link with libvisualmem_v2.c in place of hardware_interface.c.
+ *
+ * Copyright (C) 2025 - Visual Memory Systems v2.0
+ */
+
+#include "libvisualmem_v2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// === TEST framework ===
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST_START(name) \
+    do { \
+        printf("\n=== Test %d: %s ===\n", ++tests_run, name); \
+    } while(0)
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✅ %s\n", message); \
+        } else { \
+            printf("  ❌ %s\n", message); \
+            return 0; \
+        } \
+    } while(0)
+
+#define TEST_END() \
+    do { \
+        tests_passed++; \
+        printf("  ✅ Test passed\n"); \
+        return 1; \
+    } while(0)
+
+// === STUB DISPLAY BACKEND ===
+// Stands in for hardware_interface.c: an XImage in plain memory that the
+// refresh path pushes nowhere. Depth 24 shares its buffer with the RGBA32
+// engine, depth 16 with RGB565.
+static int stub_depth = 24;
+static int stub_region_refreshes = 0;
+
+int visualmem_v2_detect_hardware(visualmem_v2_hardware_caps_t* caps) {
+    memset(caps, 0, sizeof(*caps));
+    caps->has_x11 = 1;
+    strcpy(caps->gpu_model, "stub");
+    return 0;
+}
+
+visualmem_v2_backend_t visualmem_v2_select_best_backend(const visualmem_v2_hardware_caps_t* caps) {
+    (void)caps;
+    return VISUALMEM_V2_BACKEND_X11;
+}
+
+int visualmem_v2_init_hardware_backend(visualmem_v2_context_t* ctx) {
+    XImage* image = calloc(1, sizeof(XImage));
+    if (!image) return VISUALMEM_V2_ERROR_INIT_FAILED;
+
+    image->width = ctx->width;
+    image->height = ctx->height;
+    image->format = ZPixmap;
+    image->byte_order = LSBFirst;
+    image->bitmap_unit = 32;
+    image->bitmap_bit_order = LSBFirst;
+    image->bitmap_pad = 32;
+    image->depth = stub_depth;
+    image->bits_per_pixel = stub_depth == 16 ? 16 : 32;
+    image->bytes_per_line = ctx->width * image->bits_per_pixel / 8;
+    image->red_mask = stub_depth == 16 ? 0xF800 : 0xFF0000;
+    image->green_mask = stub_depth == 16 ? 0x07E0 : 0x00FF00;
+    image->blue_mask = stub_depth == 16 ? 0x001F : 0x0000FF;
+    image->data = calloc(1, (size_t)image->bytes_per_line * ctx->height);
+    if (!image->data) {
+        free(image);
+        return VISUALMEM_V2_ERROR_INIT_FAILED;
+    }
+    XInitImage(image);
+
+    ctx->x11.ximage = image;
+    ctx->x11.display = (Display*)1; // Never dereferenced by the core
+    ctx->x11.depth = stub_depth;
+    return VISUALMEM_V2_SUCCESS;
+}
+
+void visualmem_v2_cleanup_hardware_backend(visualmem_v2_context_t* ctx) {
+    if (ctx->x11.ximage) {
+        free(ctx->x11.ximage->data);
+        free(ctx->x11.ximage);
+        ctx->x11.ximage = NULL;
+    }
+}
+
+static int mask_shift(unsigned long mask) {
+    int shift = 0;
+    while (mask && !(mask & 1)) {
+        mask >>= 1;
+        shift++;
+    }
+    return shift;
+}
+
+static int mask_bits(unsigned long mask) {
+    int bits = 0;
+    for (mask >>= mask_shift(mask); mask & 1; mask >>= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+static unsigned long pack_channel(uint32_t value, unsigned long mask) {
+    int bits = mask_bits(mask);
+    unsigned long scaled = bits >= 8 ? (unsigned long)value << (bits - 8) : value >> (8 - bits);
+    return (scaled << mask_shift(mask)) & mask;
+}
+
+static uint32_t unpack_channel(unsigned long pixel, unsigned long mask) {
+    int bits = mask_bits(mask);
+    unsigned long value = (pixel & mask) >> mask_shift(mask);
+    if (bits >= 8) return (uint32_t)(value >> (bits - 8));
+    return (uint32_t)(value * 255 / ((1UL << bits) - 1));
+}
+
+int visualmem_v2_x11_write_pixel(visualmem_v2_context_t* ctx, int x, int y, uint32_t color) {
+    XImage* image = ctx->x11.ximage;
+    if (!image) return VISUALMEM_V2_ERROR_DISPLAY_UNAVAILABLE;
+    XPutPixel(image, x, y, pack_channel((color >> 16) & 0xFF, image->red_mask) |
+                           pack_channel((color >> 8) & 0xFF, image->green_mask) |
+                           pack_channel(color & 0xFF, image->blue_mask));
+    return VISUALMEM_V2_SUCCESS;
+}
+
+uint32_t visualmem_v2_x11_read_pixel(visualmem_v2_context_t* ctx, int x, int y) {
+    XImage* image = ctx->x11.ximage;
+    if (!image) return 0;
+    unsigned long pixel = XGetPixel(image, x, y);
+    return 0xFF000000 | (unpack_channel(pixel, image->red_mask) << 16) |
+           (unpack_channel(pixel, image->green_mask) << 8) | unpack_channel(pixel, image->blue_mask);
+}
+
+int visualmem_v2_x11_refresh(visualmem_v2_context_t* ctx) {
+    (void)ctx;
+    return VISUALMEM_V2_SUCCESS;
+}
+
+int visualmem_v2_x11_refresh_region(visualmem_v2_context_t* ctx, int x, int y, int width, int height) {
+    (void)ctx; (void)x; (void)y; (void)width; (void)height;
+    __atomic_add_fetch(&stub_region_refreshes, 1, __ATOMIC_RELAXED);
+    return VISUALMEM_V2_SUCCESS;
+}
+
+// === UTILITY FUNCTIONS ===
+static const visualmem_v2_encoding_t all_encodings[] = {
+    VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_ENCODING_DENSE_RGB, VISUALMEM_V2_ENCODING_DENSE_RGBA,
+    VISUALMEM_V2_ENCODING_PALETTE_2BPP, VISUALMEM_V2_ENCODING_PALETTE_4BPP, VISUALMEM_V2_ENCODING_PALETTE_8BPP
+};
+#define ENCODING_COUNT ((int)(sizeof(all_encodings) / sizeof(all_encodings[0])))
+
+static const char* encoding_name(visualmem_v2_encoding_t encoding) {
+    switch (encoding) {
+        case VISUALMEM_V2_ENCODING_BINARY: return "binary";
+        case VISUALMEM_V2_ENCODING_DENSE_RGB: return "dense RGB";
+        case VISUALMEM_V2_ENCODING_DENSE_RGBA: return "dense RGBA";
+        case VISUALMEM_V2_ENCODING_PALETTE_2BPP: return "palette 2bpp";
+        case VISUALMEM_V2_ENCODING_PALETTE_4BPP: return "palette 4bpp";
+        case VISUALMEM_V2_ENCODING_PALETTE_8BPP: return "palette 8bpp";
+    }
+    return "?";
+}
+
+// Fresh 800x600 context on the stub backend with the given encoding and layout
+static visualmem_v2_context_t* open_context(visualmem_v2_encoding_t encoding, visualmem_v2_layout_t layout) {
+    visualmem_v2_context_t* ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) return NULL;
+    if (visualmem_v2_init(ctx, VISUALMEM_V2_MODE_XVFB, 800, 600) != VISUALMEM_V2_SUCCESS ||
+        visualmem_v2_set_encoding(ctx, encoding) != VISUALMEM_V2_SUCCESS ||
+        visualmem_v2_set_layout(ctx, layout) != VISUALMEM_V2_SUCCESS) {
+        if (ctx->is_initialized) visualmem_v2_cleanup(ctx);
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void close_context(visualmem_v2_context_t* ctx) {
+    visualmem_v2_cleanup(ctx);
+    free(ctx);
+}
+
+static visualmem_v2_allocation_t allocation_info(visualmem_v2_context_t* ctx, void* addr) {
+    visualmem_v2_allocation_t info;
+    memset(&info, 0, sizeof(info));
+    visualmem_v2_get_allocation_info(ctx, addr, &info);
+    return info;
+}
+
+static int rects_overlap(const visualmem_v2_allocation_t* a, const visualmem_v2_allocation_t* b) {
+    return a->x < b->x + b->width && b->x < a->x + a->width &&
+           a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static int all_zero(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i]) return 0;
+    }
+    return 1;
+}
+
+// === INDIVIDUAL TESTS ===
+
+static int test_initialization(void) {
+    TEST_START("Initialization on the Stub Backend");
+
+    visualmem_v2_context_t* ctx = calloc(1, sizeof(*ctx));
+    TEST_ASSERT(ctx && visualmem_v2_init(ctx, VISUALMEM_V2_MODE_XVFB, 800, 600) == VISUALMEM_V2_SUCCESS,
+                "Context initialized");
+    TEST_ASSERT(ctx->pixel_format == VISUALMEM_V2_PIXEL_RGBA32 && ctx->video_memory_shared,
+                "RGBA32 store shared with the display image");
+    TEST_ASSERT(ctx->layout == VISUALMEM_V2_LAYOUT_LINEAR && visualmem_v2_get_capacity(ctx) > 0,
+                "Linear layout with payload capacity");
+
+    // The pixel store is the display image
+    visualmem_v2_write_pixel(ctx, 5, 5, 0xFF123456);
+    TEST_ASSERT((((uint32_t*)ctx->x11.ximage->data)[5 * 800 + 5] & 0xFFFFFF) == 0x123456 &&
+                visualmem_v2_read_pixel(ctx, 5, 5) == 0xFF123456, "Pixel lands in the display image");
+
+    TEST_ASSERT(visualmem_v2_set_encoding(ctx, (visualmem_v2_encoding_t)99) == VISUALMEM_V2_ERROR_INVALID_ADDRESS,
+                "Unknown encoding rejected");
+    void* held = visualmem_v2_alloc(ctx, 10, "held");
+    TEST_ASSERT(visualmem_v2_set_encoding(ctx, VISUALMEM_V2_ENCODING_DENSE_RGB) == VISUALMEM_V2_ERROR_ALLOCATION_FAILED,
+                "Encoding fixed while allocations are live");
+    visualmem_v2_free(ctx, held);
+
+    close_context(ctx);
+    TEST_END();
+}
+
+static int test_encoding_roundtrips(void) {
+    TEST_START("Round Trips for Every Encoding and Layout");
+
+    const size_t sizes[] = { 1, 10, 100, 1000, 3000 };
+    uint8_t data[3000], read_data[3000];
+
+    for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            visualmem_v2_context_t* ctx = open_context(all_encodings[e], (visualmem_v2_layout_t)layout);
+            printf("  -- %s, %s layout\n", encoding_name(all_encodings[e]), layout ? "tiled" : "linear");
+            TEST_ASSERT(ctx != NULL, "Context opened");
+
+            void* addrs[5];
+            for (int k = 0; k < 5; k++) {
+                for (size_t i = 0; i < sizes[k]; i++) data[i] = (uint8_t)(i * 7 + k * 31 + e);
+                addrs[k] = visualmem_v2_alloc(ctx, sizes[k], "roundtrip");
+                TEST_ASSERT(addrs[k] && visualmem_v2_write(ctx, addrs[k], data, sizes[k]) == VISUALMEM_V2_SUCCESS,
+                            "Allocated and written");
+            }
+            int intact = 1;
+            for (int k = 0; k < 5; k++) {
+                for (size_t i = 0; i < sizes[k]; i++) data[i] = (uint8_t)(i * 7 + k * 31 + e);
+                if (visualmem_v2_read(ctx, addrs[k], read_data, sizes[k]) != VISUALMEM_V2_SUCCESS ||
+                    memcmp(data, read_data, sizes[k]) != 0) {
+                    intact = 0;
+                }
+            }
+            TEST_ASSERT(intact, "Every block reads back what was written");
+            TEST_ASSERT(visualmem_v2_write(ctx, addrs[1], data, 11) == VISUALMEM_V2_ERROR_INVALID_ADDRESS,
+                        "Overrun rejected");
+
+            close_context(ctx);
+        }
+    }
+
+    TEST_END();
+}
+
+static int test_pixel_formats(void) {
+    TEST_START("Pixel Formats");
+
+    const visualmem_v2_pixel_format_t formats[] = {
+        VISUALMEM_V2_PIXEL_RGBA32, VISUALMEM_V2_PIXEL_RGB24, VISUALMEM_V2_PIXEL_RGB16, VISUALMEM_V2_PIXEL_MONOCHROME
+    };
+    const int bits[] = { 32, 24, 16, 1 };
+    uint8_t data[5000], read_data[5000];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 13 + 5);
+
+    // Every format with every encoding it can carry, in both layouts
+    for (int f = 0; f < 4; f++) {
+        for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+            for (int e = 0; e < ENCODING_COUNT; e++) {
+                visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_BINARY, (visualmem_v2_layout_t)layout);
+                TEST_ASSERT(ctx != NULL, "Context opened");
+                TEST_ASSERT(visualmem_v2_set_pixel_format(ctx, formats[f]) == VISUALMEM_V2_SUCCESS,
+                            "Any format carries binary payloads");
+                TEST_ASSERT(ctx->video_memory_size == ((size_t)800 * 600 * bits[f] + 7) / 8,
+                            "Pixel store sized for the format");
+                int result = visualmem_v2_set_encoding(ctx, all_encodings[e]);
+                if (result == VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED) {
+                    close_context(ctx);
+                    continue;
+                }
+                printf("  -- %d bpp, %s, %s layout\n", bits[f], encoding_name(all_encodings[e]),
+                       layout ? "tiled" : "linear");
+                TEST_ASSERT(result == VISUALMEM_V2_SUCCESS, "Encoding accepted");
+
+                void* addr = visualmem_v2_alloc(ctx, sizeof(data), "format");
+                TEST_ASSERT(addr && visualmem_v2_write(ctx, addr, data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                            visualmem_v2_read(ctx, addr, read_data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                            memcmp(data, read_data, sizeof(data)) == 0, "Round trip");
+                close_context(ctx);
+            }
+        }
+    }
+
+    // Encodings the format cannot hold are refused, both ways round
+    visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_LAYOUT_LINEAR);
+    TEST_ASSERT(ctx != NULL, "Context opened");
+    visualmem_v2_set_pixel_format(ctx, VISUALMEM_V2_PIXEL_MONOCHROME);
+    TEST_ASSERT(!ctx->video_memory_shared, "Monochrome store kept apart from the display image");
+    TEST_ASSERT(visualmem_v2_set_encoding(ctx, VISUALMEM_V2_ENCODING_PALETTE_2BPP) == VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED,
+                "Monochrome refuses palettes");
+    visualmem_v2_write_pixel(ctx, 7, 9, 0xFFFFFFFF);
+    TEST_ASSERT(visualmem_v2_refresh_display(ctx) == VISUALMEM_V2_SUCCESS &&
+                (((uint32_t*)ctx->x11.ximage->data)[9 * 800 + 7] & 0xFFFFFF) == 0xFFFFFF,
+                "Monochrome pixels reach the display image");
+    visualmem_v2_set_pixel_format(ctx, VISUALMEM_V2_PIXEL_RGB24);
+    visualmem_v2_set_encoding(ctx, VISUALMEM_V2_ENCODING_DENSE_RGB);
+    TEST_ASSERT(visualmem_v2_set_pixel_format(ctx, VISUALMEM_V2_PIXEL_RGB16) == VISUALMEM_V2_ERROR_HARDWARE_UNSUPPORTED,
+                "RGB565 refuses dense RGB");
+    void* held = visualmem_v2_alloc(ctx, 10, "held");
+    TEST_ASSERT(visualmem_v2_set_pixel_format(ctx, VISUALMEM_V2_PIXEL_RGBA32) == VISUALMEM_V2_ERROR_ALLOCATION_FAILED,
+                "Format fixed while allocations are live");
+    visualmem_v2_free(ctx, held);
+    close_context(ctx);
+
+    // A 16-bit display shares its image with the RGB565 engine
+    stub_depth = 16;
+    ctx = open_context(VISUALMEM_V2_ENCODING_PALETTE_4BPP, VISUALMEM_V2_LAYOUT_LINEAR);
+    stub_depth = 24;
+    TEST_ASSERT(ctx && ctx->pixel_format == VISUALMEM_V2_PIXEL_RGB16 && ctx->video_memory_shared,
+                "RGB565 store shared with a 16-bit display");
+    void* addr = visualmem_v2_alloc(ctx, sizeof(data), "565");
+    TEST_ASSERT(addr && visualmem_v2_write(ctx, addr, data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                visualmem_v2_read(ctx, addr, read_data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                memcmp(data, read_data, sizeof(data)) == 0, "Palette round trip on a 16-bit display");
+    visualmem_v2_write_pixel(ctx, 1, 1, 0xFFFFFFFF);
+    TEST_ASSERT(visualmem_v2_read_pixel(ctx, 1, 1) == 0xFFFFFFFF, "White survives RGB565");
+    close_context(ctx);
+
+    TEST_END();
+}
+
+static int test_tiled_layout(void) {
+    TEST_START("Tiled Layout");
+
+    visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_DENSE_RGB, VISUALMEM_V2_LAYOUT_TILED);
+    TEST_ASSERT(ctx != NULL, "Tiled context opened");
+
+    // Byte payloads own whole tiles that never overlap
+    const size_t sizes[] = { 10, 100, 1000, 3000, 50 };
+    void* addrs[5];
+    visualmem_v2_allocation_t infos[5];
+    uint8_t data[3000];
+    memset(data, 0x5A, sizeof(data));
+    int aligned = 1, disjoint = 1;
+    for (int k = 0; k < 5; k++) {
+        addrs[k] = visualmem_v2_alloc(ctx, sizes[k], "tile");
+        TEST_ASSERT(addrs[k] != NULL, "Tiled allocation");
+        infos[k] = allocation_info(ctx, addrs[k]);
+        if (infos[k].x % VISUALMEM_V2_TILE_WIDTH || infos[k].y % VISUALMEM_V2_TILE_HEIGHT ||
+            infos[k].width % VISUALMEM_V2_TILE_WIDTH || infos[k].height % VISUALMEM_V2_TILE_HEIGHT ||
+            infos[k].x + infos[k].width > 800 || infos[k].y + infos[k].height > 600) {
+            aligned = 0;
+        }
+        for (int j = 0; j < k; j++) {
+            if (rects_overlap(&infos[k], &infos[j])) disjoint = 0;
+        }
+        visualmem_v2_write(ctx, addrs[k], data, sizes[k]);
+    }
+    TEST_ASSERT(aligned, "Rectangles are tile-aligned and on screen");
+    TEST_ASSERT(disjoint, "Rectangles do not overlap");
+    TEST_ASSERT(visualmem_v2_set_layout(ctx, VISUALMEM_V2_LAYOUT_LINEAR) != VISUALMEM_V2_SUCCESS,
+                "Layout fixed while allocations are live");
+
+    // A write dirties only the tiles of its own rectangle
+    int tiles[VISUALMEM_V2_MAX_TILES];
+    visualmem_v2_collect_dirty_tiles(ctx, tiles, VISUALMEM_V2_MAX_TILES);
+    TEST_ASSERT(visualmem_v2_collect_dirty_tiles(ctx, tiles, VISUALMEM_V2_MAX_TILES) == 0, "Dirty set drained");
+    int tile_x = infos[2].x / VISUALMEM_V2_TILE_WIDTH, tile_y = infos[2].y / VISUALMEM_V2_TILE_HEIGHT;
+    uint32_t before = visualmem_v2_get_tile_checksum(ctx, tile_x, tile_y);
+    uint32_t elsewhere = visualmem_v2_get_tile_checksum(ctx, 0, 0);
+    data[0] ^= 0xFF;
+    visualmem_v2_write(ctx, addrs[2], data, 1);
+    TEST_ASSERT(visualmem_v2_collect_dirty_tiles(ctx, tiles, VISUALMEM_V2_MAX_TILES) == 1 &&
+                tiles[0] == tile_y * ctx->tile_cols + tile_x, "One byte dirties one tile");
+    TEST_ASSERT(visualmem_v2_get_tile_checksum(ctx, tile_x, tile_y) != before &&
+                visualmem_v2_get_tile_checksum(ctx, 0, 0) == elsewhere, "Only that tile checksum changes");
+
+    // A freed rectangle is reused once cleared
+    TEST_ASSERT(visualmem_v2_free(ctx, addrs[1]) == VISUALMEM_V2_SUCCESS, "Tiled free");
+    visualmem_v2_scrub(ctx);
+    TEST_ASSERT(visualmem_v2_alloc(ctx, 100, "again") == addrs[1], "Freed rectangle reused");
+
+    close_context(ctx);
+    TEST_END();
+}
+
+static int test_rect_packing(void) {
+    TEST_START("Rectangle Packing and Images");
+
+    visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_LAYOUT_LINEAR);
+    TEST_ASSERT(ctx != NULL, "Context opened");
+    TEST_ASSERT(visualmem_v2_alloc_at(ctx, 100, 100, 50, 40, "linear") == NULL, "alloc_at needs the tiled layout");
+    close_context(ctx);
+
+    ctx = open_context(VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_LAYOUT_TILED);
+    TEST_ASSERT(ctx != NULL, "Tiled context opened");
+
+    // Fixed rectangles are exact and exclusive
+    void* fixed = visualmem_v2_alloc_at(ctx, 100, 100, 50, 40, "fixed");
+    visualmem_v2_allocation_t f = allocation_info(ctx, fixed);
+    TEST_ASSERT(fixed && f.x == 100 && f.y == 100 && f.width == 50 && f.height == 40, "Exact rectangle reserved");
+    TEST_ASSERT(visualmem_v2_alloc_at(ctx, 120, 120, 10, 10, "inside") == NULL &&
+                visualmem_v2_alloc_at(ctx, 90, 90, 20, 20, "corner") == NULL, "Overlapping rectangles rejected");
+    TEST_ASSERT(visualmem_v2_alloc_at(ctx, 790, 590, 20, 20, "edge") == NULL &&
+                visualmem_v2_alloc_at(ctx, 0, 0, 10, 10, "reserved") == NULL, "Off-screen and reserved area rejected");
+    void* beside = visualmem_v2_alloc_at(ctx, 150, 100, 10, 10, "beside");
+    visualmem_v2_allocation_t n = allocation_info(ctx, beside);
+    TEST_ASSERT(beside != NULL, "Touching rectangle accepted");
+
+    // Images pack around them without overlap
+    void* bytes = visualmem_v2_alloc(ctx, 1000, "bytes");
+    visualmem_v2_allocation_t b = allocation_info(ctx, bytes);
+    TEST_ASSERT(bytes && !rects_overlap(&b, &f) && !rects_overlap(&b, &n), "Byte payload placed clear of them");
+    enum { IMAGES = 60 };
+    void* images[IMAGES];
+    visualmem_v2_allocation_t placed[IMAGES];
+    size_t area = (size_t)f.width * f.height + (size_t)n.width * n.height + (size_t)b.width * b.height;
+    int exact = 1, disjoint = 1;
+    for (int i = 0; i < IMAGES; i++) {
+        int width = 17 + (i * 37) % 53, height = 9 + (i * 23) % 31;
+        images[i] = visualmem_v2_alloc_image(ctx, width, height, NULL);
+        TEST_ASSERT(images[i] != NULL, "Image placed");
+        placed[i] = allocation_info(ctx, images[i]);
+        if (placed[i].width != width || placed[i].height != height) exact = 0;
+        if (rects_overlap(&placed[i], &f) || rects_overlap(&placed[i], &n) || rects_overlap(&placed[i], &b)) disjoint = 0;
+        for (int j = 0; j < i; j++) {
+            if (rects_overlap(&placed[i], &placed[j])) disjoint = 0;
+        }
+        area += (size_t)width * height;
+    }
+    TEST_ASSERT(exact, "Images get exactly their size");
+    TEST_ASSERT(disjoint, "No two rectangles overlap");
+    visualmem_v2_packing_stats_t stats;
+    TEST_ASSERT(visualmem_v2_get_packing_stats(ctx, &stats) == VISUALMEM_V2_SUCCESS &&
+                stats.reserved_pixels == area, "Packing stats count every reserved pixel");
+
+    // Image blits: same format verbatim, other formats converted
+    uint32_t pixels[20 * 10];
+    for (int i = 0; i < 200; i++) pixels[i] = 0xFF000000u | (uint32_t)(i * 4099);
+    void* picture = visualmem_v2_alloc_image(ctx, 20, 10, "picture");
+    visualmem_v2_allocation_t p = allocation_info(ctx, picture);
+    TEST_ASSERT(visualmem_v2_write_image(ctx, picture, pixels, 20, 10, VISUALMEM_V2_PIXEL_RGBA32) == VISUALMEM_V2_SUCCESS,
+                "RGBA32 image written");
+    int same = 1;
+    for (int y = 0; y < 10; y++) {
+        for (int x = 0; x < 20; x++) {
+            if (visualmem_v2_read_pixel(ctx, p.x + x, p.y + y) != pixels[y * 20 + x]) same = 0;
+        }
+    }
+    TEST_ASSERT(same, "Image pixels land in its rectangle");
+    uint8_t rgb[20 * 10 * 3];
+    for (int i = 0; i < 200; i++) {
+        rgb[i * 3] = (uint8_t)i;
+        rgb[i * 3 + 1] = 7;
+        rgb[i * 3 + 2] = 200;
+    }
+    TEST_ASSERT(visualmem_v2_write_image(ctx, picture, rgb, 20, 10, VISUALMEM_V2_PIXEL_RGB24) == VISUALMEM_V2_SUCCESS &&
+                (visualmem_v2_read_pixel(ctx, p.x + 5, p.y + 1) & 0xFFFFFF) == (200u << 16 | 7u << 8 | 25u),
+                "RGB24 image converted");
+    TEST_ASSERT(visualmem_v2_write_image(ctx, picture, pixels, 21, 10, VISUALMEM_V2_PIXEL_RGBA32) != VISUALMEM_V2_SUCCESS,
+                "Oversized image rejected");
+
+    // Freeing everything leaves one free rectangle again
+    for (int i = 0; i < IMAGES; i++) visualmem_v2_free(ctx, images[i]);
+    visualmem_v2_free(ctx, picture);
+    visualmem_v2_free(ctx, fixed);
+    visualmem_v2_free(ctx, beside);
+    visualmem_v2_free(ctx, bytes);
+    visualmem_v2_scrub(ctx);
+    TEST_ASSERT(visualmem_v2_get_packing_stats(ctx, &stats) == VISUALMEM_V2_SUCCESS &&
+                stats.reserved_pixels == 0 && stats.free_rects == 1 &&
+                stats.largest_free_pixels == stats.area_pixels, "Free rectangles merge back");
+    void* whole = visualmem_v2_alloc_image(ctx, 780, 580, "whole");
+    TEST_ASSERT(whole != NULL, "Whole area available");
+
+    // A freed rectangle merges with the free space around it
+    visualmem_v2_free(ctx, whole);
+    visualmem_v2_scrub(ctx);
+    void* upper = visualmem_v2_alloc_at(ctx, 100, 100, 50, 40, "upper");
+    void* lower = visualmem_v2_alloc_at(ctx, 100, 140, 50, 40, "lower");
+    TEST_ASSERT(upper && lower, "Stacked rectangles placed");
+    visualmem_v2_free(ctx, upper);
+    visualmem_v2_scrub(ctx);
+    TEST_ASSERT(visualmem_v2_alloc_at(ctx, 90, 90, 70, 50, "spanning") != NULL, "Freed and neighbouring space reused together");
+    TEST_ASSERT(visualmem_v2_alloc_at(ctx, 120, 130, 10, 20, "overlap") == NULL, "Live rectangle still reserved");
+
+    close_context(ctx);
+    TEST_END();
+}
+
+static int test_allocator_churn(void) {
+    TEST_START("Buddy Allocator and Table Growth");
+
+    visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_DENSE_RGB, VISUALMEM_V2_LAYOUT_LINEAR);
+    TEST_ASSERT(ctx != NULL, "Context opened");
+
+    // More blocks than the initial table holds, none overlapping
+    enum { BLOCKS = 200 };
+    void* addrs[BLOCKS];
+    visualmem_v2_allocation_t infos[BLOCKS];
+    for (int i = 0; i < BLOCKS; i++) {
+        size_t size = 20 + (size_t)(i * 37) % 700;
+        addrs[i] = visualmem_v2_alloc(ctx, size, "churn");
+        TEST_ASSERT(addrs[i] != NULL, "Block allocated");
+        uint8_t tag = (uint8_t)i;
+        visualmem_v2_pwrite(ctx, addrs[i], size - 1, &tag, 1);
+        infos[i] = allocation_info(ctx, addrs[i]);
+    }
+    TEST_ASSERT(ctx->allocations.capacity >= BLOCKS && ctx->allocation_count == BLOCKS, "Table grew");
+    int disjoint = 1;
+    for (int i = 0; i < BLOCKS; i++) {
+        for (int j = 0; j < i; j++) {
+            if (infos[i].byte_offset < infos[j].byte_offset + infos[j].size &&
+                infos[j].byte_offset < infos[i].byte_offset + infos[i].size) {
+                disjoint = 0;
+            }
+        }
+    }
+    TEST_ASSERT(disjoint, "Byte ranges do not overlap");
+
+    // Free every other block, then the rest: the buddies coalesce again
+    for (int i = 0; i < BLOCKS; i += 2) visualmem_v2_free(ctx, addrs[i]);
+    int kept = 1;
+    for (int i = 1; i < BLOCKS; i += 2) {
+        uint8_t tag = 0;
+        visualmem_v2_pread(ctx, addrs[i], infos[i].size - 1, &tag, 1);
+        if (tag != (uint8_t)i) kept = 0;
+    }
+    TEST_ASSERT(kept, "Survivors keep their data");
+    TEST_ASSERT(visualmem_v2_free(ctx, addrs[0]) == VISUALMEM_V2_ERROR_INVALID_ADDRESS, "Double free rejected");
+    for (int i = 1; i < BLOCKS; i += 2) visualmem_v2_free(ctx, addrs[i]);
+    visualmem_v2_scrub(ctx);
+    size_t whole = visualmem_v2_get_capacity(ctx) / 2;
+    void* big = visualmem_v2_alloc(ctx, whole, "big");
+    TEST_ASSERT(big != NULL, "Coalesced space serves half the capacity");
+
+    close_context(ctx);
+    TEST_END();
+}
+
+static int test_realloc(void) {
+    TEST_START("Reallocation");
+
+    uint8_t data[4000], read_data[4000];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 5 + 3);
+
+    for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+        visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_PALETTE_4BPP, (visualmem_v2_layout_t)layout);
+        TEST_ASSERT(ctx != NULL, "Context opened");
+
+        // Growing past a neighbour moves the block and keeps its bytes
+        void* block = visualmem_v2_alloc(ctx, 1000, "grow");
+        void* neighbour = visualmem_v2_alloc(ctx, 1000, "neighbour");
+        visualmem_v2_write(ctx, block, data, 1000);
+        void* grown = visualmem_v2_realloc(ctx, block, 4000);
+        TEST_ASSERT(grown != NULL, "Grown");
+        visualmem_v2_read(ctx, grown, read_data, 1000);
+        TEST_ASSERT(memcmp(read_data, data, 1000) == 0, "Contents preserved");
+        TEST_ASSERT(visualmem_v2_write(ctx, grown, data, 4000) == VISUALMEM_V2_SUCCESS, "New size writable");
+
+        // Shrinking stays in place
+        TEST_ASSERT(visualmem_v2_realloc(ctx, grown, 100) == grown, "Shrunk in place");
+        TEST_ASSERT(allocation_info(ctx, grown).size == 100 &&
+                    visualmem_v2_write(ctx, grown, data, 101) != VISUALMEM_V2_SUCCESS, "Shrunk bounds enforced");
+        TEST_ASSERT(visualmem_v2_realloc(ctx, neighbour, visualmem_v2_get_capacity(ctx) * 2) == NULL &&
+                    allocation_info(ctx, neighbour).size == 1000, "Failed growth leaves the block");
+
+        close_context(ctx);
+    }
+
+    TEST_END();
+}
+
+static int test_arenas(void) {
+    TEST_START("Arenas");
+
+    const visualmem_v2_encoding_t encodings[] = { VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_ENCODING_PALETTE_8BPP };
+    for (int run = 0; run < 4; run++) {
+        visualmem_v2_layout_t layout = run < 2 ? VISUALMEM_V2_LAYOUT_LINEAR : VISUALMEM_V2_LAYOUT_TILED;
+        visualmem_v2_context_t* ctx = open_context(encodings[run % 2], layout);
+        TEST_ASSERT(ctx != NULL, "Context opened");
+
+        void* arena = visualmem_v2_arena_create(ctx, 1024, "frame");
+        TEST_ASSERT(arena != NULL, "Arena created");
+        void* a = visualmem_v2_arena_alloc(ctx, arena, 100);
+        void* b = visualmem_v2_arena_alloc(ctx, arena, 200);
+        TEST_ASSERT(a && b && a != b, "Bump allocations");
+        uint8_t data[200], read_data[200];
+        memset(data, 0xA5, sizeof(data));
+        TEST_ASSERT(visualmem_v2_write(ctx, b, data, 200) == VISUALMEM_V2_SUCCESS &&
+                    visualmem_v2_read(ctx, b, read_data, 200) == VISUALMEM_V2_SUCCESS &&
+                    memcmp(data, read_data, 200) == 0, "Arena allocation round trip");
+        TEST_ASSERT(visualmem_v2_write(ctx, a, data, 101) != VISUALMEM_V2_SUCCESS, "Arena bounds enforced");
+        TEST_ASSERT(visualmem_v2_free(ctx, a) != VISUALMEM_V2_SUCCESS, "Arena allocation not freed alone");
+        TEST_ASSERT(visualmem_v2_arena_alloc(ctx, arena, 2000) == NULL, "Full arena refuses");
+
+        // Caller bytes that look like a length header name no allocation:
+        // try the pixel 4 bytes into an allocation whose data reads {8,0,0,0}
+        void* forger = visualmem_v2_arena_alloc(ctx, arena, 100);
+        const uint8_t fake_header[4] = { 8, 0, 0, 0 };
+        visualmem_v2_write(ctx, forger, fake_header, sizeof(fake_header));
+        uintptr_t byte_pixels = ctx->encoding == VISUALMEM_V2_ENCODING_BINARY ? 10 : 1;
+        void* forged = (void*)((uintptr_t)forger + 4 * byte_pixels);
+        TEST_ASSERT(visualmem_v2_read(ctx, forged, read_data, 1) == VISUALMEM_V2_ERROR_INVALID_ADDRESS &&
+                    visualmem_v2_read(ctx, (void*)((uintptr_t)forged & 0xFFFFFFFFu), read_data, 1) ==
+                        VISUALMEM_V2_ERROR_INVALID_ADDRESS, "Forged header does not resolve");
+
+        // Reset retires every address, even where a new allocation lands,
+        // and the reused bytes read as zero
+        visualmem_v2_write(ctx, a, data, 100);
+        TEST_ASSERT(visualmem_v2_arena_reset(ctx, arena) == VISUALMEM_V2_SUCCESS, "Arena reset");
+        void* renewed = visualmem_v2_arena_alloc(ctx, arena, 150);
+        TEST_ASSERT(renewed != NULL && renewed != a &&
+                    visualmem_v2_read(ctx, renewed, read_data, 150) == VISUALMEM_V2_SUCCESS, "New address after reset");
+        TEST_ASSERT(all_zero(read_data, 150), "Bytes reused after reset read as zero");
+        TEST_ASSERT(visualmem_v2_read(ctx, a, read_data, 1) == VISUALMEM_V2_ERROR_INVALID_ADDRESS &&
+                    visualmem_v2_write(ctx, b, data, 1) == VISUALMEM_V2_ERROR_INVALID_ADDRESS,
+                    "Addresses from before the reset are stale");
+        visualmem_v2_arena_reset(ctx, arena);
+        TEST_ASSERT(visualmem_v2_arena_alloc(ctx, arena, 1000) != NULL, "Whole arena available after reset");
+        TEST_ASSERT(visualmem_v2_arena_destroy(ctx, arena) == VISUALMEM_V2_SUCCESS &&
+                    visualmem_v2_arena_alloc(ctx, arena, 10) == NULL &&
+                    visualmem_v2_read(ctx, renewed, read_data, 1) == VISUALMEM_V2_ERROR_INVALID_ADDRESS,
+                    "Destroyed arena refuses");
+
+        close_context(ctx);
+    }
+
+    TEST_END();
+}
+
+static int test_deferred_free(void) {
+    TEST_START("Deferred Clearing of Freed Blocks");
+
+    uint8_t data[1000], read_data[1000];
+    memset(data, 0xC3, sizeof(data));
+
+    for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            visualmem_v2_context_t* ctx = open_context(all_encodings[e], (visualmem_v2_layout_t)layout);
+            printf("  -- %s, %s layout\n", encoding_name(all_encodings[e]), layout ? "tiled" : "linear");
+            TEST_ASSERT(ctx != NULL, "Context opened");
+
+            void* first = visualmem_v2_alloc(ctx, sizeof(data), "first");
+            visualmem_v2_write(ctx, first, data, sizeof(data));
+            TEST_ASSERT(visualmem_v2_free(ctx, first) == VISUALMEM_V2_SUCCESS, "Free returns at once");
+            TEST_ASSERT(visualmem_v2_read(ctx, first, read_data, 1) == VISUALMEM_V2_ERROR_INVALID_ADDRESS,
+                        "Freed address unpublished");
+
+            // Reuse waits for the clear, whichever side does it
+            void* reuse = visualmem_v2_alloc(ctx, sizeof(data), "reuse");
+            TEST_ASSERT(reuse != NULL && visualmem_v2_read(ctx, reuse, read_data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                        all_zero(read_data, sizeof(data)), "New block reads as zero");
+
+            // Scrubbed ahead of time, one of the written places comes back cleared
+            visualmem_v2_write(ctx, reuse, data, sizeof(data));
+            visualmem_v2_free(ctx, reuse);
+            TEST_ASSERT(visualmem_v2_scrub(ctx) == VISUALMEM_V2_SUCCESS && ctx->allocations.scrub_count == 0,
+                        "Scrub drains the queue");
+            void* again = visualmem_v2_alloc(ctx, sizeof(data), "again");
+            TEST_ASSERT((again == first || again == reuse) && visualmem_v2_read(ctx, again, read_data, sizeof(data)) == VISUALMEM_V2_SUCCESS &&
+                        all_zero(read_data, sizeof(data)), "Reused block reads as zero");
+
+            close_context(ctx);
+        }
+    }
+
+    TEST_END();
+}
+
+static int test_offset_access(void) {
+    TEST_START("Offset Reads and Writes");
+
+    const visualmem_v2_encoding_t encodings[] = {
+        VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_ENCODING_DENSE_RGBA, VISUALMEM_V2_ENCODING_PALETTE_2BPP
+    };
+    uint8_t record[4096], read_data[4096];
+    for (size_t i = 0; i < sizeof(record); i++) record[i] = (uint8_t)(i * 11 + 5);
+    const uint8_t field[7] = { 1, 2, 3, 4, 5, 6, 7 };
+
+    for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+        for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+            visualmem_v2_context_t* ctx = open_context(encodings[e], (visualmem_v2_layout_t)layout);
+            TEST_ASSERT(ctx != NULL, "Context opened");
+
+            void* large = visualmem_v2_alloc(ctx, sizeof(record), "record");
+            visualmem_v2_write(ctx, large, record, sizeof(record));
+            TEST_ASSERT(visualmem_v2_pwrite(ctx, large, 3001, field, sizeof(field)) == VISUALMEM_V2_SUCCESS,
+                        "Write at offset");
+            uint8_t expected[4096];
+            memcpy(expected, record, sizeof(record));
+            memcpy(expected + 3001, field, sizeof(field));
+            TEST_ASSERT(visualmem_v2_pread(ctx, large, 2999, read_data, 11) == VISUALMEM_V2_SUCCESS &&
+                        memcmp(read_data, expected + 2999, 11) == 0, "Read at offset");
+            visualmem_v2_read(ctx, large, read_data, sizeof(record));
+            TEST_ASSERT(memcmp(read_data, expected, sizeof(record)) == 0, "Surrounding bytes kept");
+            TEST_ASSERT(visualmem_v2_pwrite(ctx, large, sizeof(record) - 3, field, 4) != VISUALMEM_V2_SUCCESS &&
+                        visualmem_v2_pread(ctx, large, (size_t)-1, read_data, 2) != VISUALMEM_V2_SUCCESS,
+                        "Past the end rejected");
+
+            close_context(ctx);
+        }
+    }
+
+    TEST_END();
+}
+
+static int test_batched_operations(void) {
+    TEST_START("Vectored and Batched Operations");
+
+    visualmem_v2_context_t* ctx = open_context(VISUALMEM_V2_ENCODING_PALETTE_8BPP, VISUALMEM_V2_LAYOUT_LINEAR);
+    TEST_ASSERT(ctx != NULL, "Context opened");
+
+    uint8_t source[2048], read_data[2048];
+    for (size_t i = 0; i < sizeof(source); i++) source[i] = (uint8_t)(i * 13 + 1);
+
+    const size_t sizes[] = { 16, 2048, 40, 700 };
+    const char* const labels[] = { NULL, "frame", NULL, "index" };
+    void* blocks[4];
+    TEST_ASSERT(visualmem_v2_alloc_batch(ctx, sizes, labels, 4, blocks) == VISUALMEM_V2_SUCCESS &&
+                blocks[0] && blocks[1] && blocks[2] && blocks[3], "Batch allocation");
+    visualmem_v2_allocation_t info = allocation_info(ctx, blocks[3]);
+    TEST_ASSERT(info.size == 700 && strcmp(info.label, "index") == 0, "Batch sizes and labels");
+
+    visualmem_v2_iovec_t pieces[] = {
+        { blocks[1], 1024, source + 1024, 1024 }, { blocks[0], 0, source, 16 },
+        { blocks[1], 0, source, 1024 }, { blocks[3], 100, source + 100, 50 }
+    };
+    TEST_ASSERT(visualmem_v2_writev(ctx, pieces, 4) == VISUALMEM_V2_SUCCESS, "Vectored write");
+    visualmem_v2_read(ctx, blocks[1], read_data, 2048);
+    TEST_ASSERT(memcmp(read_data, source, 2048) == 0, "Vectored write contents");
+
+    uint8_t head[16], tail[50];
+    visualmem_v2_iovec_t reads[] = { { blocks[3], 100, tail, 50 }, { blocks[0], 0, head, 16 } };
+    TEST_ASSERT(visualmem_v2_readv(ctx, reads, 2) == VISUALMEM_V2_SUCCESS &&
+                memcmp(head, source, 16) == 0 && memcmp(tail, source + 100, 50) == 0, "Vectored read");
+    visualmem_v2_iovec_t overrun[] = { { blocks[0], 10, source, 7 } };
+    TEST_ASSERT(visualmem_v2_writev(ctx, overrun, 1) != VISUALMEM_V2_SUCCESS, "Vectored overrun rejected");
+
+    // Batch frees are all or nothing
+    void* twice[] = { blocks[0], blocks[0] };
+    TEST_ASSERT(visualmem_v2_free_batch(ctx, twice, 2) != VISUALMEM_V2_SUCCESS &&
+                visualmem_v2_read(ctx, blocks[0], head, 16) == VISUALMEM_V2_SUCCESS, "Duplicate batch frees nothing");
+    TEST_ASSERT(visualmem_v2_free_batch(ctx, blocks, 4) == VISUALMEM_V2_SUCCESS &&
+                ctx->allocation_count == 0, "Batch free");
+
+    close_context(ctx);
+    TEST_END();
+}
+
+// Shared by the concurrency test's threads
+#define RW_THREADS 4
+static visualmem_v2_context_t* rw_ctx;
+static void* rw_blocks[RW_THREADS];
+static int rw_failures = 0;
+static int rw_done = 0;
+
+static void* rw_worker(void* arg) {
+    int id = (int)(intptr_t)arg;
+    uint8_t pattern[301], read_data[301];
+    for (int iter = 0; iter < 150; iter++) {
+        for (int i = 0; i < 301; i++) pattern[i] = (uint8_t)(i * 31 + id * 7 + iter);
+        visualmem_v2_iovec_t pieces[2] = { { rw_blocks[id], 0, pattern, 150 }, { rw_blocks[id], 150, pattern + 150, 151 } };
+        if (visualmem_v2_pwrite(rw_ctx, rw_blocks[id], 0, pattern, 301) != VISUALMEM_V2_SUCCESS ||
+            visualmem_v2_pread(rw_ctx, rw_blocks[id], 0, read_data, 301) != VISUALMEM_V2_SUCCESS ||
+            memcmp(pattern, read_data, 301) != 0 ||
+            visualmem_v2_writev(rw_ctx, pieces, 2) != VISUALMEM_V2_SUCCESS) {
+            __atomic_add_fetch(&rw_failures, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+static void* rw_churn(void* arg) {
+    (void)arg;
+    for (int i = 0; i < 200; i++) {
+        void* addr = visualmem_v2_alloc(rw_ctx, 50 + (size_t)(i % 300), NULL);
+        if (addr) {
+            visualmem_v2_write(rw_ctx, addr, "xxxxxxxxxx", 10);
+            visualmem_v2_free(rw_ctx, addr);
+        }
+    }
+    return NULL;
+}
+
+// Pushes frames and samples the counters while the others run
+static void* rw_refresher(void* arg) {
+    (void)arg;
+    while (!__atomic_load_n(&rw_done, __ATOMIC_ACQUIRE)) {
+        visualmem_v2_performance_t perf;
+        visualmem_v2_write_pixel(rw_ctx, 1, 1, 0xFF00FF00);
+        if (visualmem_v2_refresh_display(rw_ctx) != VISUALMEM_V2_SUCCESS ||
+            visualmem_v2_get_performance(rw_ctx, &perf) != VISUALMEM_V2_SUCCESS || perf.frame_rate < 0) {
+            __atomic_add_fetch(&rw_failures, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+static int test_concurrent_access(void) {
+    TEST_START("Concurrent Reads, Writes and Refreshes");
+
+    for (int layout = VISUALMEM_V2_LAYOUT_LINEAR; layout <= VISUALMEM_V2_LAYOUT_TILED; layout++) {
+        rw_ctx = open_context(VISUALMEM_V2_ENCODING_DENSE_RGB, (visualmem_v2_layout_t)layout);
+        TEST_ASSERT(rw_ctx != NULL, "Context opened");
+        for (int t = 0; t < RW_THREADS; t++) {
+            rw_blocks[t] = visualmem_v2_alloc(rw_ctx, 301, "worker");
+        }
+
+        rw_done = 0;
+        int refreshes_before = __atomic_load_n(&stub_region_refreshes, __ATOMIC_RELAXED);
+        pthread_t threads[RW_THREADS + 1], refresher;
+        pthread_create(&refresher, NULL, rw_refresher, NULL);
+        for (int t = 0; t < RW_THREADS; t++) {
+            pthread_create(&threads[t], NULL, rw_worker, (void*)(intptr_t)t);
+        }
+        pthread_create(&threads[RW_THREADS], NULL, rw_churn, NULL);
+        for (int t = 0; t <= RW_THREADS; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        __atomic_store_n(&rw_done, 1, __ATOMIC_RELEASE);
+        pthread_join(refresher, NULL);
+
+        TEST_ASSERT(rw_failures == 0, "Every transfer succeeded and read back intact");
+        TEST_ASSERT(__atomic_load_n(&stub_region_refreshes, __ATOMIC_RELAXED) > refreshes_before,
+                    "Dirty tiles pushed to the display");
+        TEST_ASSERT(rw_ctx->allocation_count == RW_THREADS, "Churn left no allocation behind");
+        close_context(rw_ctx);
+    }
+
+    TEST_END();
+}
+
+// Shared by the thread cache test's threads
+#define TC_THREADS 8
+#define TC_ITERATIONS 3000
+static visualmem_v2_context_t* tc_ctx;
+static void* tc_left[TC_THREADS];
+static int tc_failures = 0;
+static int tc_dirty = 0;
+
+// Small blocks of every cached size class, so each thread holds pages of
+// several classes at once
+static void* tc_worker(void* arg) {
+    int id = (int)(intptr_t)arg;
+    uint8_t pattern[516], read_data[516];
+    for (int iter = 0; iter < TC_ITERATIONS; iter++) {
+        size_t size = 16 + (size_t)(id * 97 + iter * 13) % 500;
+        memset(pattern, id * 16 + iter, size);
+        void* addr = visualmem_v2_alloc(tc_ctx, size, NULL);
+        if (!addr) {
+            __atomic_add_fetch(&tc_failures, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (visualmem_v2_read(tc_ctx, addr, read_data, size) != VISUALMEM_V2_SUCCESS ||
+            !all_zero(read_data, size)) {
+            __atomic_add_fetch(&tc_dirty, 1, __ATOMIC_RELAXED);
+        }
+        if (visualmem_v2_write(tc_ctx, addr, pattern, size) != VISUALMEM_V2_SUCCESS ||
+            visualmem_v2_read(tc_ctx, addr, read_data, size) != VISUALMEM_V2_SUCCESS ||
+            memcmp(pattern, read_data, size) != 0 ||
+            visualmem_v2_free(tc_ctx, addr) != VISUALMEM_V2_SUCCESS) {
+            __atomic_add_fetch(&tc_failures, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Left for the main thread to read and free
+    memset(pattern, 0x5A + id, 100);
+    tc_left[id] = visualmem_v2_alloc(tc_ctx, 100, NULL);
+    if (!tc_left[id] || visualmem_v2_write(tc_ctx, tc_left[id], pattern, 100) != VISUALMEM_V2_SUCCESS) {
+        __atomic_add_fetch(&tc_failures, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static int test_thread_caches(void) {
+    TEST_START("Thread Caches on a Small Context");
+
+    // 800x600 binary holds ~22 KB: pages must leave room for every thread
+    for (int enabled = 0; enabled <= 1; enabled++) {
+        tc_ctx = open_context(VISUALMEM_V2_ENCODING_BINARY, VISUALMEM_V2_LAYOUT_LINEAR);
+        TEST_ASSERT(tc_ctx != NULL, "Context opened");
+        TEST_ASSERT(visualmem_v2_set_thread_cache(tc_ctx, enabled) == VISUALMEM_V2_SUCCESS,
+                    enabled ? "Thread caches on" : "Thread caches off");
+
+        tc_failures = 0;
+        tc_dirty = 0;
+        pthread_t threads[TC_THREADS];
+        for (int t = 0; t < TC_THREADS; t++) {
+            pthread_create(&threads[t], NULL, tc_worker, (void*)(intptr_t)t);
+        }
+        for (int t = 0; t < TC_THREADS; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        TEST_ASSERT(tc_failures == 0, "Every allocation succeeded and read back intact");
+        TEST_ASSERT(tc_dirty == 0, "Reused blocks read zero");
+
+        // Blocks of exited threads resolve and free from another thread
+        int remote = 1;
+        uint8_t read_data[100];
+        for (int t = 0; t < TC_THREADS; t++) {
+            visualmem_v2_allocation_t info = allocation_info(tc_ctx, tc_left[t]);
+            remote &= info.size == 100 &&
+                visualmem_v2_read(tc_ctx, tc_left[t], read_data, 100) == VISUALMEM_V2_SUCCESS &&
+                read_data[0] == 0x5A + t && read_data[99] == 0x5A + t;
+        }
+        TEST_ASSERT(remote, "Blocks resolve from another thread");
+        TEST_ASSERT(visualmem_v2_free_batch(tc_ctx, tc_left, TC_THREADS) == VISUALMEM_V2_SUCCESS,
+                    "Blocks freed from another thread");
+
+        // Turning caches off hands the empty pages back
+        visualmem_v2_performance_t perf;
+        visualmem_v2_set_thread_cache(tc_ctx, 0);
+        visualmem_v2_get_performance(tc_ctx, &perf);
+        TEST_ASSERT(tc_ctx->allocation_count == 0 && perf.total_allocations == perf.total_deallocations,
+                    "Nothing left allocated");
+        close_context(tc_ctx);
+    }
+
+    TEST_END();
+}
+
+int main(void) {
+    printf("===================================================================\n");
+    printf("          LIBVISUALMEM V2 - VALIDATION SUITE (STUB DISPLAY)\n");
+    printf("===================================================================\n");
+
+    clock_t start_time = clock();
+
+    test_initialization();
+    test_encoding_roundtrips();
+    test_pixel_formats();
+    test_tiled_layout();
+    test_rect_packing();
+    test_allocator_churn();
+    test_realloc();
+    test_arenas();
+    test_deferred_free();
+    test_offset_access();
+    test_batched_operations();
+    test_concurrent_access();
+    test_thread_caches();
+
+    clock_t end_time = clock();
+    double test_duration = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
+
+    printf("\n===================================================================\n");
+    printf("                     FINAL TEST RESULTS\n");
+    printf("===================================================================\n\n");
+
+    printf("Tests executed: %d\n", tests_run);
+    printf("Tests passed: %d\n", tests_passed);
+    printf("Success rate: %.1f%%\n", (float)tests_passed / tests_run * 100);
+    printf("Execution time: %.3f seconds\n", test_duration);
+
+    if (tests_passed == tests_run) {
+        printf("\n🎉 ALL V2 TESTS PASSED 🎉\n\n");
+
+        printf("VALIDATED FEATURES:\n");
+        printf("✅ Initialization on a display-less backend\n");
+        printf("✅ Round trips for every encoding in both layouts\n");
+        printf("✅ RGBA32, RGB24, RGB565 and monochrome pixel formats\n");
+        printf("✅ Tiled, tile-aligned allocation layout\n");
+        printf("✅ Rectangle packing for fixed and image allocations\n");
+        printf("✅ Buddy allocator and growable allocation table\n");
+        printf("✅ Reallocation in place and by move\n");
+        printf("✅ Arenas with O(1) reset\n");
+        printf("✅ Deferred clearing of freed blocks\n");
+        printf("✅ Offset reads and writes\n");
+        printf("✅ Vectored and batched operations\n");
+        printf("✅ Concurrent data path with refreshes\n");
+        printf("✅ Per-thread allocation caches\n\n");
+        return 0;
+    } else {
+        printf("\n⚠️ SOME TESTS FAILED - REVIEW REQUIRED ⚠️\n");
+        printf("Failed tests: %d\n", tests_run - tests_passed);
+        return 1;
+    }
+}
@@ -355,7 +355,7 @@ static void* thread_benchmark_worker(void* arg) {
         uint64_t start = get_timestamp_ns();
         
         // Allocation
-        void* addr = visualmem_v2_alloc(data->ctx, data->data_size, 0, 0, 100, 100);
+        void* addr = visualmem_v2_alloc(data->ctx, data->data_size, NULL);
         if (addr) {
             // Écriture
             if (visualmem_v2_write(data->ctx, addr, test_data, data->data_size) == 0) {
@@ -398,6 +398,9 @@ static int test_multithreading_enhanced(visualmem_v2_context_t* ctx) {
     double total_throughput = 0.0;
     double avg_success_rate = 0.0;
     
+    // Les petits blocs de chaque thread viennent de son cache local
+    visualmem_v2_set_thread_cache(ctx, 1);
+    
     // Configuration des threads
     for (int i = 0; i < MULTITHREAD_TESTS; i++) {
         thread_data[i].ctx = ctx;
@@ -455,7 +458,7 @@ static int test_compression_analysis(visualmem_v2_context_t* ctx) {
         pattern->pattern_func(test_data, test_size);
         
         // Test avec LibVisualMem
-        void* addr = visualmem_v2_alloc(ctx, test_size, 0, 0, 100, 100);
+        void* addr = visualmem_v2_alloc(ctx, test_size, NULL);
         if (addr) {
             uint64_t start = get_timestamp_ns();
             int write_result = visualmem_v2_write(ctx, addr, test_data, test_size);
@@ -500,7 +503,7 @@ static int test_gpu_memory_usage(visualmem_v2_context_t* ctx) {
         
         pattern_sequential(test_data, test_size);
         
-        void* addr = visualmem_v2_alloc(ctx, test_size, 0, 0, 100, 100);
+        void* addr = visualmem_v2_alloc(ctx, test_size, NULL);
         if (addr) {
             uint64_t start = get_timestamp_ns();
             int write_result = visualmem_v2_write(ctx, addr, test_data, test_size);
@@ -555,7 +558,7 @@ static int test_headless_environment(void) {
         uint8_t* test_data = malloc(test_size);
         pattern_sequential(test_data, test_size);
         
-        void* addr = visualmem_v2_alloc(&ctx, test_size, 0, 0, 100, 100);
+        void* addr = visualmem_v2_alloc(&ctx, test_size, NULL);
         if (addr) {
             uint64_t start = get_timestamp_ns();
             int write_result = visualmem_v2_write(&ctx, addr, test_data, test_size);
@@ -613,7 +616,7 @@ static int test_stress_24h(visualmem_v2_context_t* ctx) {
         if (test_data) {
             pattern_random(test_data, test_size);
             
-            void* addr = visualmem_v2_alloc(ctx, test_size, 0, 0, 100, 100);
+            void* addr = visualmem_v2_alloc(ctx, test_size, NULL);
             if (addr) {
                 if (visualmem_v2_write(ctx, addr, test_data, test_size) != 0) {
                     errors++;
@@ -671,7 +674,7 @@ static int test_performance_benchmark_enhanced(visualmem_v2_context_t* ctx) {
         int success_count = 0;
         
         for (int i = 0; i < size_config->iterations && !interrupted; i++) {
-            void* addr = visualmem_v2_alloc(ctx, size_config->size, 0, 0, 100, 100);
+            void* addr = visualmem_v2_alloc(ctx, size_config->size, NULL);
             if (addr) {
                 uint64_t start = get_timestamp_ns();
                 